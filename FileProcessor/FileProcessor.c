@@ -9,7 +9,8 @@ FileProcessor.c
         Crea tantos hilos como sucursales bancarias se hayan configurado.
 
         Se comunica con el proceso Monitor utilizando named pipe, y se sincroniza con dicho proceso
-        utilizando un semáforo común.
+        utilizando un semáforo común o, con SNAPSHOT_READS=1, publicando una marca de confirmación
+        hasta la que Monitor puede leer sin esperar.
 
         Escribe datos de la operación en los ficheros de log.
 
@@ -28,6 +29,8 @@ FileProcessor.c
         -h/--help
 */ 
 
+// truncate no se declara con -std=c99
+#define _DEFAULT_SOURCE
 
 #include "FileProcessor.h"  // Declaración de funciones de este módulo
 
@@ -38,6 +41,8 @@ FileProcessor.c
 
 // Mutex para seguridad de hilos
 pthread_mutex_t mutex_escritura_pipe = PTHREAD_MUTEX_INITIALIZER;
+// Perfil de contención del mutex (LOCK_PROFILING=1)
+static BloqueoPerfilado perfil_mutex_escritura_pipe = BLOQUEO_PERFILADO("mutex_escritura_pipe");
 
 // Tamaño de mensaje para el pipe de comunicación entre FileProcessor y Monitor
 #define MESSAGE_SIZE 100
@@ -57,19 +62,17 @@ int pipe_send(const char *message) {
     // y seguirá adelante sin hacer nada adicional.
 
     // Leer variable de configuración para ver si hace falta utilizar el pipe
-    const char *monitor_activo;
-    monitor_activo = obtener_valor_configuracion("MONITOR_ACTIVO", "NO");
-    if (strcmp(monitor_activo, "NO") == 0) {
+    const ParametrosConfiguracion *parametros = obtenerParametros();
+    if (!parametros->monitor_activo) {
         // Si el monitor no está activo retornamos
         // printf("Monitor no activo, mensaje monitor: %s", message);
         return 0;
     }
 
     // Bloquear el mutex
-    pthread_mutex_lock(&mutex_escritura_pipe);
+    bloquearMutexPerfilado(&perfil_mutex_escritura_pipe, &mutex_escritura_pipe, __func__);
 
-    const char * pipeName;
-    pipeName = obtener_valor_configuracion("PIPE_NAME", "/tmp/pipeAudita");
+    const char *pipeName = parametros->nombre_pipe;
     // Cambiamos el umask antes de crear el pipe para que se asignen correctamente
     // los permisos de grupo
     // ver: https://stackoverflow.com/questions/11909505/posix-shared-memory-and-semaphores-permissions-set-incorrectly-by-open-calls
@@ -95,7 +98,7 @@ int pipe_send(const char *message) {
     close(pipefd);
 
     // Desbloquear el mutex
-    pthread_mutex_unlock(&mutex_escritura_pipe);
+    desbloquearMutexPerfilado(&perfil_mutex_escritura_pipe, &mutex_escritura_pipe);
 
     return 0;
 }
@@ -116,6 +119,14 @@ sem_t *semaforo_consolidar_ficheros_entrada;
 // Nombre del semáforo
 const char *semName;
 
+// Con SNAPSHOT_READS=1 Monitor lee hasta la marca de confirmación sin coger el semáforo, y los hilos
+// de FileProcessor sólo tienen que excluirse entre ellos para añadir datos al consolidado
+int lectura_instantanea = 0;
+pthread_mutex_t mutex_consolidacion = PTHREAD_MUTEX_INITIALIZER;
+// Perfil de contención del acceso al consolidado (LOCK_PROFILING=1)
+static BloqueoPerfilado perfil_semaforo_consolidar = BLOQUEO_PERFILADO("semaforo_consolidar_ficheros_entrada");
+static BloqueoPerfilado perfil_mutex_consolidacion = BLOQUEO_PERFILADO("mutex_consolidacion");
+
 
 // Variables para memoria compartida
 const char *shared_mem_name;
@@ -125,94 +136,227 @@ size_t shared_mem_current_size = 0;
 size_t shared_mem_size = 0;
 size_t shared_mem_used_space = 0;
 
+// Función que amplía la memoria compartida al SHARED_MEMORY_INITIAL_SIZE en vigor (se puede aumentar recargando
+// fp.conf con SIGHUP) si así caben "necesario" bytes. Se llama con el acceso exclusivo al consolidado
+// Monitor proyecta el tamaño real del objeto en cada lectura, así que ve la ampliación
+// Devuelve EXIT_SUCCESS o -1 si no es posible ampliarla
+int ampliar_memoria_compartida(size_t necesario) {
+    size_t nuevo_tamano = (size_t)obtenerParametros()->tamano_memoria_compartida;
+    if (nuevo_tamano < necesario) {
+        return -1;
+    }
+    if (ftruncate(shared_mem_fd, nuevo_tamano) == -1) {
+        escribirEnLog(LOG_ERROR, "shared_memory", "Error al ampliar la memoria compartida a %zu bytes\n", nuevo_tamano);
+        return -1;
+    }
+    void *nueva_direccion = mmap(0, nuevo_tamano, PROT_READ | PROT_WRITE, MAP_SHARED, shared_mem_fd, 0);
+    if (nueva_direccion == MAP_FAILED) {
+        escribirEnLog(LOG_ERROR, "shared_memory", "Error al mapear la memoria compartida ampliada\n");
+        return -1;
+    }
+    munmap(shared_mem_addr, shared_mem_size);
+    shared_mem_addr = nueva_direccion;
+    shared_mem_size = nuevo_tamano;
+    shared_mem_current_size = nuevo_tamano;
+    escribirEnLog(LOG_INFO, "shared_memory", "Memoria compartida ampliada a %zu bytes\n", nuevo_tamano);
+    return EXIT_SUCCESS;
+}
+
+// Función que obtiene el acceso exclusivo para añadir datos al consolidado
+void bloquearConsolidacion() {
+    if (lectura_instantanea) {
+        bloquearMutexPerfilado(&perfil_mutex_consolidacion, &mutex_consolidacion, __func__);
+    } else {
+        esperarSemaforoPerfilado(&perfil_semaforo_consolidar, semaforo_consolidar_ficheros_entrada, __func__);
+    }
+}
+
+// Función que libera el acceso exclusivo para añadir datos al consolidado
+void desbloquearConsolidacion() {
+    if (lectura_instantanea) {
+        desbloquearMutexPerfilado(&perfil_mutex_consolidacion, &mutex_consolidacion);
+    } else {
+        liberarSemaforoPerfilado(&perfil_semaforo_consolidar, semaforo_consolidar_ficheros_entrada);
+    }
+}
+
+// Función que guarda la identidad de un fichero (0 y 0 si no existe) y devuelve su tamaño
+static long long identificarFichero(const struct stat *info, int existe, IdentidadConsolidado *identidad) {
+    identidad->dispositivo = existe ? (unsigned long long)info->st_dev : 0;
+    identidad->inodo = existe ? (unsigned long long)info->st_ino : 0;
+    return existe ? (long long)info->st_size : 0;
+}
+
+// Función que obtiene el tamaño actual de los datos consolidados (fichero, memoria compartida y almacén columnar)
+// y la identidad de cada destino, que los lotes de agregados y los resúmenes guardan junto a sus rangos
+void medirConsolidacion(PosicionesConsolidado *posiciones) {
+    const ParametrosConfiguracion *parametros = obtenerParametros();
+    char nombre_fichero[PATH_MAX];
+    struct stat info;
+    snprintf(nombre_fichero, sizeof(nombre_fichero), "%s/%s", parametros->carpeta_datos, parametros->fichero_consolidado);
+    posiciones->fichero = identificarFichero(&info, stat(nombre_fichero, &info) == 0, &posiciones->identidad_fichero);
+    posiciones->memoria = (long long)shared_mem_used_space;
+    identificarFichero(&info, parametros->usar_memoria_compartida && fstat(shared_mem_fd, &info) == 0, &posiciones->identidad_memoria);
+    posiciones->columnar = 0;
+    identificarFichero(&info, 0, &posiciones->identidad_columnar);
+    if (parametros->almacen_columnar) {
+        snprintf(nombre_fichero, sizeof(nombre_fichero), "%s/%s", parametros->carpeta_datos, parametros->fichero_columnar);
+        posiciones->columnar = identificarFichero(&info, stat(nombre_fichero, &info) == 0, &posiciones->identidad_columnar);
+    }
+}
+
+// Función que deja el consolidado (fichero o memoria compartida) como estaba antes de un fichero de sucursal
+// que no se ha podido consolidar entero. Se llama con el acceso exclusivo cogido y antes de publicar la marca
+void deshacerConsolidacion(int id_hilo, const PosicionesConsolidado *antes, const char *archivo_consolidado) {
+    if (obtenerParametros()->usar_memoria_compartida) {
+        shared_mem_used_space = (size_t)antes->memoria;
+    } else if (truncate(archivo_consolidado, antes->fichero) != 0) {
+        escribirEnLog(LOG_ERROR, "file_processor: deshacerConsolidacion", "Hilo %02d: Error al recortar %s a %lld bytes\n",
+            id_hilo, archivo_consolidado, antes->fichero);
+        return;
+    }
+    escribirEnLog(LOG_WARNING, "file_processor: deshacerConsolidacion", "Hilo %02d: se deshacen los registros copiados al consolidado\n", id_hilo);
+}
+
+// Función que entrega a los escritores del lote una línea ya copiada al consolidado
+// La línea se separa en campos una sola vez para todos ellos
+static void anadirLineaLote(int id_hilo, LoteConsolidacion *lote, const char *linea) {
+    if (lote->segmentos == NULL && lote->columnar == NULL && lote->agregados == NULL && lote->resumen == NULL) {
+        return;
+    }
+    char copia[MAX_LINE_LENGTH];
+    char *campos[NUM_CAMPOS_REGISTRO];
+    snprintf(copia, sizeof(copia), "%s", linea);
+    int completa = separarCamposRegistro(copia, campos) == 0;
+    anadirRegistroSegmentos(lote->segmentos, id_hilo, linea, campos[2]);
+    if (completa) {
+        anadirRegistroColumnar(lote->columnar, campos);
+        anadirRegistroAgregados(lote->agregados, campos);
+        anadirRegistroResumen(lote->resumen, campos);
+    }
+}
+
+// Función que publica la marca de confirmación con el tamaño actual de los datos consolidados
+// Se llama con el acceso exclusivo cogido, cuando los datos de un fichero de sucursal están completos
+void publicarConsolidacion(const PosicionesConsolidado *posiciones) {
+    if (!lectura_instantanea) {
+        return;
+    }
+    publicarMarcaConfirmacion(posiciones);
+}
+
+// Contadores e histogramas de las series de métricas de los hilos de observación (una serie por sucursal)
+const DefinicionMetricas definicion_metricas = {
+    "FileProcessor",
+    3, {"ficheros", "registros", "bytes"}, {CONTADOR_ACUMULADO, CONTADOR_ACUMULADO, CONTADOR_ACUMULADO},
+    2, {"espera acceso", "proceso fichero"}
+};
+
+// Hilos de observación en marcha por número de hilo (NUM_PROCESOS se puede cambiar al recargar fp.conf)
+int hilos_observacion_activos[MAX_HILOS_OBSERVACION + 1];
+pthread_mutex_t mutex_hilos_observacion = PTHREAD_MUTEX_INITIALIZER;
+
 // Función que se encarga de crear tantos hilos de configuración como se hayan definido 
 // en el fichero de configuración
 // Los hilos se implementan en la función hilo_observador
+// Se llama al arrancar y después de recargar fp.conf: sólo crea los hilos que no están en marcha
+// (los que sobran al reducir NUM_PROCESOS terminan solos, ver continuarHiloObservacion)
 void crear_hilos_observacion(){
     // Obtener el número de hilos a crear
     int num_hilos; 
     
-    //atoi recibe un string (numero de hilos a crear en este caso) y lo convierte en integer
-    num_hilos = atoi(obtener_valor_configuracion("NUM_PROCESOS", "5"));
+    num_hilos = obtenerParametros()->num_procesos;
     escribirEnLog(LOG_INFO, "file_processor: crear_hilos_observacion", "Necesario crear %02d hilos de observación\n",num_hilos);
 
-     // Dimensionar pool de hilos observadores
-    pthread_t tid[num_hilos];
-
     // Crear los hilos observadores
-    for (int i = 0; i < num_hilos; i++) {
+    pthread_mutex_lock(&mutex_hilos_observacion);
+    for (int i = 1; i <= num_hilos; i++) {
+        if (hilos_observacion_activos[i]) {
+            continue;
+        }
         int *a = malloc(sizeof(int));
-        *a = i + 1;
-        escribirEnLog(LOG_INFO, "file_processor: crear_hilos_observacion", "Creado hilo número %02d\n", i+1);
-        if (pthread_create(&tid[i], NULL, hilo_observador, a) != 0) {
+        *a = i;
+        escribirEnLog(LOG_INFO, "file_processor: crear_hilos_observacion", "Creado hilo número %02d\n", i);
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, hilo_observador, a) != 0) {
             escribirEnLog(LOG_ERROR, "file_processor: crear_hilos_observacion", "Error al crear el hilo de observación");
             exit(EXIT_FAILURE);
         }
-        sleep(1);
-    }
-
-    // Desanclar los hilos para que se ejecuten de forma independiente
-    for (int i = 0; i < num_hilos; i++) {
         //El detach se utiliza para que el create no tenga que esperar a un join
-        if (pthread_detach(tid[i]) != 0) {
+        if (pthread_detach(tid) != 0) {
             escribirEnLog(LOG_ERROR, "file_processor: crear_hilos_observacion", "Error al desanclar el hilo de observación");
             exit(EXIT_FAILURE);
         }
+        hilos_observacion_activos[i] = 1;
+        pthread_mutex_unlock(&mutex_hilos_observacion);
+        sleep(1);
+        pthread_mutex_lock(&mutex_hilos_observacion);
     }
+    pthread_mutex_unlock(&mutex_hilos_observacion);
     return;
 }
 
+// Función que indica si un hilo de observación tiene que seguir con el NUM_PROCESOS en vigor
+// Si no tiene que seguir lo marca como terminado
+int continuarHiloObservacion(int id_hilo) {
+    pthread_mutex_lock(&mutex_hilos_observacion);
+    int continuar = id_hilo <= obtenerParametros()->num_procesos;
+    if (!continuar) {
+        hilos_observacion_activos[id_hilo] = 0;
+    }
+    pthread_mutex_unlock(&mutex_hilos_observacion);
+    return continuar;
+}
+
 // Función que implementa el Hilo que se encarga de procesar los ficheros 
 // que aparezcan en la carpeta de datos de entrada y que cumplan con un patron de nombre
 //      1) En primer lugar los mueve a una carpeta de procesados (dentro de datos) propia del hilo
 //      2) Y después añade todos los registros CSV al fichero de consolidación en la carpeta de datos
 void *hilo_observador(void *arg) {
     int id_hilo = *((int *)arg);
+    free(arg);
 
 
     // Preparar la ruta de la carpeta de datos de la sucursal
-    const char *path_files;
-    path_files = obtener_valor_configuracion("PATH_FILES", "../Datos");
-    const char *path_sucursales;
-    path_sucursales = obtener_valor_configuracion("PATH_SUCURSALES", "files_data");
-    const char *nombre_directorio_sucursal;
-    nombre_directorio_sucursal = obtener_valor_configuracion("NOMBRE_DIRECTORIO_SUCURSAL", "Sucursal");
+    const ParametrosConfiguracion *parametros = obtenerParametros();
+    const char *path_files = parametros->carpeta_datos;
+    const char *path_sucursales = parametros->carpeta_sucursales;
+    const char *nombre_directorio_sucursal = parametros->nombre_directorio_sucursal;
     char carpeta_datos[PATH_MAX];
     // Ejemplo: ../Datos/files_data/Sucursal001
     snprintf(carpeta_datos, sizeof(carpeta_datos), "%s/%s/%s%03d", path_files, path_sucursales, nombre_directorio_sucursal, id_hilo);
 
     // Preparar carpeta de procesos
-    const char *prefijo_carpeta_procesos;
-    prefijo_carpeta_procesos = obtener_valor_configuracion("PREFIJO_CARPETAS_PROCESO", "procesados");
+    const char *prefijo_carpeta_procesos = parametros->prefijo_carpetas_proceso;
     // Preparar la ruta de la carpeta de "en proceso"
     char carpeta_proceso[PATH_MAX];
     snprintf(carpeta_proceso, sizeof(carpeta_proceso), "%s/%s%03d", carpeta_datos, prefijo_carpeta_procesos, id_hilo);
-    char *horaFinalTexto;
+    char horaFinalTexto[10];
 
     // Patrón de nombre de ficheros a procesar por este hilo "SU001"
     // Recuperar  el prefijo del fichero de configuración
-    const char *prefijo_ficheros;
-    prefijo_ficheros = obtener_valor_configuracion("PREFIJO_FICHEROS", "SU");
+    const char *prefijo_ficheros = parametros->prefijo_ficheros;
     // Crear el patrón de nombre de los ficheros a procesar
     char patronNombre[20];
     sprintf(patronNombre,"%s%03d",prefijo_ficheros, id_hilo);
     char sucursal[10];
     snprintf(sucursal,sizeof(sucursal), "%s%03d", prefijo_ficheros, id_hilo);
+    nombrarHiloPerfilBloqueos(sucursal);
 
     // Preparar la ruta del archivo de consolidación
-    const char *archivo_consolidado;
-    archivo_consolidado = obtener_valor_configuracion("INVENTORY_FILE", "consolidado.csv");
+    const char *archivo_consolidado = parametros->fichero_consolidado;
     // Preparar la ruta completa de archivo consolidado
     char archivo_consolidado_completo[PATH_MAX];
     snprintf(archivo_consolidado_completo, sizeof(archivo_consolidado_completo), "%s/%s", path_files, archivo_consolidado);
 
     // Obtener parámetro para ver si hay que copiar los registros en fichero CSV o en memoria compartida
-    const char * char_use_shared_memory;
-    char_use_shared_memory = obtener_valor_configuracion("USE_SHARED_MEMORY", "0");
-    int use_shared_memory = atoi(char_use_shared_memory);
+    int use_shared_memory = parametros->usar_memoria_compartida;
 
     int contador_archivos = 1;
 
+    // Serie de métricas de la sucursal (NULL si SHARED_METRICS no vale 1)
+    SerieMetricas *serie_metricas = obtenerSerieMetricas(sucursal);
+
     escribirEnLog(LOG_INFO, "file_processor: hilo_observador", "Hilo observación %02d: observando carpeta %s patrón nombre: %s\n", id_hilo, carpeta_datos, patronNombre);
 
     // Bucle infinito para observar la carpeta
@@ -220,12 +364,22 @@ void *hilo_observador(void *arg) {
         DIR *dir;
         struct dirent *entrada;
 
+        // Al principio de cada vuelta el hilo no guarda punteros a los parámetros de configuración
+        // (los que usa son de los que sólo se aplican al reiniciar) y termina si se ha reducido NUM_PROCESOS
+        estado_quiescente_configuracion();
+        if (!continuarHiloObservacion(id_hilo)) {
+            escribirEnLog(LOG_INFO, "file_processor: hilo_observador", "Hilo observación %02d: terminado por NUM_PROCESOS\n", id_hilo);
+            break;
+        }
+
         // Abrir la carpeta de datos
         dir = opendir(carpeta_datos);
         if (dir == NULL) {
             perror("Error al abrir el directorio");
             escribirEnLog(LOG_ERROR, "file_processor: hilo_observador", "Hilo observación %02d: no existe carpeta %s \n", id_hilo, carpeta_datos);
             //exit(EXIT_FAILURE);
+            sleep(1);
+            continue;
         }
 
         // Comprobar archivos en la carpeta de datos
@@ -236,7 +390,8 @@ void *hilo_observador(void *arg) {
             char archivo_origen_corto[PATH_MAX];
             char archivo_destino[PATH_MAX];
             char mensaje[100];
-            char *horaInicioTexto;
+            char horaInicioTexto[10];
+            long long inicio_ns;
             
             // Verificar si el nombre del archivo cumple con el patrón del nombre
             if (strncmp(entrada->d_name, patronNombre, 5) == 0) {
@@ -246,7 +401,8 @@ void *hilo_observador(void *arg) {
                 escribirEnLog(LOG_GENERAL, "file_processor: hilo_observador", "%02d:::Iniciando proceso fichero %s\n", id_hilo, entrada->d_name);
 
                 // Registrar hora inicio (se utiliza en el log)
-                horaInicioTexto = obtener_hora_actual();
+                obtener_hora_actual(horaInicioTexto);
+                inicio_ns = obtener_nanosegundos_monotonicos();
 
                 // Construir la ruta completa del archivo
                 snprintf(ruta_archivo, sizeof(ruta_archivo), "%s/%s", carpeta_datos, entrada->d_name);
@@ -273,7 +429,9 @@ void *hilo_observador(void *arg) {
 
                     // Esperar en el semáforo para evitar colisiones
                     escribirEnLog(LOG_INFO, "file_processor: hilo_observador", "Hilo %02d: esperando semáforo...\n", id_hilo);
-                    sem_wait(semaforo_consolidar_ficheros_entrada);
+                    long long espera_ns = obtener_nanosegundos_monotonicos();
+                    bloquearConsolidacion();
+                    registrarDuracionMetrica(serie_metricas, HISTOGRAMA_ESPERA_ACCESO, obtener_nanosegundos_monotonicos() - espera_ns);
                     // Comprobar si la carpeta de "en proceso" existe, en caso contrario la creamos
                     struct stat st = {0};
                     if (stat(carpeta_proceso, &st) == -1) {
@@ -284,25 +442,67 @@ void *hilo_observador(void *arg) {
                     if (mover_archivo(id_hilo, archivo_origen, archivo_destino) == EXIT_SUCCESS) {
                         // Una vez movido, hay que copiar las líneas al fichero de consolidación
                         int num_registros;
+                        // Posiciones de los datos consolidados antes y después de añadir el fichero
+                        PosicionesConsolidado antes, despues;
+                        medirConsolidacion(&antes);
+
+                        // Los segmentos por fecha, el almacén columnar, los agregados parciales y el resumen del lote
+                        // (si están activados) reciben los registros en la misma pasada que los copia al consolidado
+                        LoteConsolidacion lote;
+                        lote.segmentos = iniciarLoteSegmentos();
+                        lote.columnar = iniciarLoteColumnar();
+                        lote.agregados = iniciarLoteAgregados();
+                        lote.resumen = iniciarLoteResumen();
 
                         // Hay que escribir los registros en el fichero CSV o en memoria compartida
                         if (use_shared_memory != 1) {
                             // Hay que escribir en fichero
-                            num_registros = copiar_registros(id_hilo, sucursal, archivo_destino, archivo_consolidado_completo);
+                            num_registros = copiar_registros(id_hilo, sucursal, archivo_destino, archivo_consolidado_completo, &lote);
                         } else {
-                            num_registros = copiar_registros_memoria(id_hilo, sucursal, archivo_destino);
+                            num_registros = copiar_registros_memoria(id_hilo, sucursal, archivo_destino, &lote);
                         }
-                        
+
+                        // Si no se puede escribir el almacén columnar el fichero no se consolida: se deshace lo copiado
+                        // para no publicar una marca de confirmación que incluya un grupo a medias
+                        if (terminarLoteColumnar(id_hilo, lote.columnar, archivo_destino, num_registros != -1) == -1 && num_registros != -1) {
+                            deshacerConsolidacion(id_hilo, &antes, archivo_consolidado_completo);
+                            num_registros = -1;
+                        }
+                        terminarLoteSegmentos(id_hilo, lote.segmentos, archivo_destino, num_registros != -1);
+                        // Los agregados parciales y el resumen del lote llevan las posiciones de sus datos consolidados
+                        // (el resumen permite a Monitor saltarse los lotes irrelevantes)
+                        medirConsolidacion(&despues);
+                        terminarLoteAgregados(id_hilo, lote.agregados, archivo_destino, num_registros != -1, &antes, &despues);
+                        terminarLoteResumen(id_hilo, lote.resumen, archivo_destino, num_registros != -1, &antes, &despues);
+
                         // Devuelve -1 en caso de error
                         if (num_registros != -1) {
                             // Copia de los registros correcta
                             contador_archivos++;
 
+                            // Publicar la marca de confirmación y enviar mensaje a Monitor a través del named pipe
+                            // Se hace cuando están escritos todos los datos del fichero, para que Monitor los vea todos
+                            publicarConsolidacion(&despues);
+                            if (use_shared_memory != 1) {
+                                snprintf(mensaje, sizeof(mensaje), "Fichero consolidado actualizado por FileProcessor Hilo %02d con %01d registros", id_hilo, num_registros);
+                            } else {
+                                snprintf(mensaje, sizeof(mensaje), "Memoria compartida actualizada por FileProcessor Hilo %02d con %01d registros", id_hilo, num_registros);
+                            }
+                            pipe_send(mensaje);
+                            escribirEnLog(LOG_INFO, "hilo_observacion", "Hilo %02d: Escrito mensaje en pipe: %s\n", id_hilo, mensaje);
+
                             // Escribir el log
                             // Registrar hora final (se utiliza en el log)
-                            horaFinalTexto = obtener_hora_actual();
+                            obtener_hora_actual(horaFinalTexto);
                             // Formato: NoPROCESO:::INICIO:::FIN:::NOMBRE_FICHERO:::NoOperacionesConsolidadas 
                             escribirEnLog(LOG_GENERAL, "file_processor: hilo_observador", "%02d:::%s:::%s:::%s:::%0d\n", id_hilo, horaInicioTexto, horaFinalTexto, archivo_origen_corto, num_registros);
+                            escribirEnLog(LOG_INFO, "file_processor: hilo_observador", "Hilo %02d: fichero %s procesado en %.3f ms\n",
+                                id_hilo, archivo_origen_corto, (obtener_nanosegundos_monotonicos() - inicio_ns) / 1000000.0);
+                            // Métricas de la sucursal para fpstat
+                            sumarMetrica(serie_metricas, METRICA_FICHEROS, 1);
+                            sumarMetrica(serie_metricas, METRICA_REGISTROS, num_registros);
+                            sumarMetrica(serie_metricas, METRICA_BYTES, use_shared_memory != 1 ? despues.fichero - antes.fichero : despues.memoria - antes.memoria);
+                            registrarDuracionMetrica(serie_metricas, HISTOGRAMA_PROCESO_FICHERO, obtener_nanosegundos_monotonicos() - inicio_ns);
 
                             // Informar al Monitor
                             // Utilizamos (volatile size_t){sizeof(mensaje)} para evitar el truncation warning de compilación
@@ -317,7 +517,7 @@ void *hilo_observador(void *arg) {
                     }
 
                     // Liberar el semáforo
-                    sem_post(semaforo_consolidar_ficheros_entrada);
+                    desbloquearConsolidacion();
                     escribirEnLog(LOG_INFO, "file_processor: hilo_observador", "Hilo %02d: liberado semáforo.\n", id_hilo);
                 }
             }
@@ -352,7 +552,7 @@ int mover_archivo(int id_hilo, const char *archivo_origen, const char *archivo_d
 // Función que copia los registros CSV de un archivo en otro o en memoria compartida
 // Se utiliza para copiar los registros de los ficheros CSV de las sucursales al 
 // fichero consolidado
-int copiar_registros(int id_hilo, const char *sucursal, const char *archivo_origen, const char *archivo_consolidado) {
+int copiar_registros(int id_hilo, const char *sucursal, const char *archivo_origen, const char *archivo_consolidado, LoteConsolidacion *lote) {
     escribirEnLog(LOG_INFO, "hilo_observacion", "Hilo %02d: Copiando registros CSV de %s a %s\n", id_hilo, archivo_origen, archivo_consolidado);
 
     FILE *archivo_entrada, *archivo_salida;
@@ -385,6 +585,7 @@ int copiar_registros(int id_hilo, const char *sucursal, const char *archivo_orig
         snprintf(linea_escribir, (volatile size_t){sizeof(linea_escribir)}, "%s;%s",sucursal, linea);
 
         fputs(linea_escribir, archivo_salida);
+        anadirLineaLote(id_hilo, lote, linea_escribir);
         num_registros++;
     }
     // Cierra los archivos
@@ -394,18 +595,13 @@ int copiar_registros(int id_hilo, const char *sucursal, const char *archivo_orig
 
     escribirEnLog(LOG_INFO, "hilo_observacion", "Hilo %02d: Copiados registros CSV de %s a %s\n", id_hilo, archivo_origen, archivo_consolidado);
 
-    // Enviar mensaje a Monitor a través del named pipe
-    snprintf(linea_escribir, (volatile size_t){sizeof(linea_escribir)}, "Fichero consolidado actualizado por FileProcessor Hilo %02d con %01d registros", id_hilo, num_registros);
-    pipe_send(linea_escribir);
-    escribirEnLog(LOG_INFO, "hilo_observacion", "Hilo %02d: Escrito mensaje en pipe: %s\n", id_hilo, linea_escribir);
-
     return num_registros;
 }
 
 // Función que copia los registros CSV de un archivo en otro o en memoria compartida
 // Se utiliza para copiar los registros de los ficheros CSV de las sucursales al 
 // fichero consolidado
-int copiar_registros_memoria(int id_hilo, const char *sucursal, const char *archivo_origen) {
+int copiar_registros_memoria(int id_hilo, const char *sucursal, const char *archivo_origen, LoteConsolidacion *lote) {
     escribirEnLog(LOG_INFO, "hilo_observacion", "Hilo %02d: Copiando registros CSV de %s a memoria compartida\n", id_hilo, archivo_origen);
 
     FILE *archivo_entrada;
@@ -434,14 +630,16 @@ int copiar_registros_memoria(int id_hilo, const char *sucursal, const char *arch
         // resultado = write_line_to_shared_memory(shared_mem_addr, &shared_mem_used_space, &shared_mem_current_size, linea_escribir);
         line_length = strlen(linea_escribir);
         //printf("used_space=%lu, current_size=%lu, line_length=%lu\n", *used_space, *current_size, line_length);
-        if (shared_mem_used_space + line_length > shared_mem_current_size) {
-            // Si no hay espacio suficiente, tenemos que ampliar la memoria compartida
+        if (shared_mem_used_space + line_length > shared_mem_current_size
+            && ampliar_memoria_compartida(shared_mem_used_space + line_length) != EXIT_SUCCESS) {
+            // Si no hay espacio suficiente y SHARED_MEMORY_INITIAL_SIZE no permite ampliarla
             escribirEnLog(LOG_ERROR, "hilo_observacion", "No es posible ampliar la memoria compartida, amplie el parámetro en fichero de configuración y vuelva a procesar todos los ficheros\n");
             return EXIT_FAILURE;
         }
         // Copiar la línea al espacio de memoria compartida
         strncpy(shared_mem_addr + shared_mem_used_space, linea_escribir, line_length);
         shared_mem_used_space += line_length;
+        anadirLineaLote(id_hilo, lote, linea_escribir);
         num_registros++;
     }
     // Cierra los archivos
@@ -450,11 +648,6 @@ int copiar_registros_memoria(int id_hilo, const char *sucursal, const char *arch
 
     escribirEnLog(LOG_INFO, "hilo_observacion", "Hilo %02d: Copiados registros CSV de %s a %s\n", id_hilo, archivo_origen, "memoria compartida");
 
-    // Enviar mensaje a Monitor a través del named pipe
-    snprintf(linea_escribir, (volatile size_t){sizeof(linea_escribir)}, "Memoria compartida actualizada por FileProcessor Hilo %02d con %01d registros", id_hilo, num_registros);
-    pipe_send(linea_escribir);
-    escribirEnLog(LOG_INFO, "hilo_observacion", "Hilo %02d: Escrito mensaje en pipe: %s\n", id_hilo, linea_escribir);
-
     return num_registros;
 }
 
@@ -548,9 +741,8 @@ void crear_estructura_directorios() {
 // Función para leer el fichero consolidado en memoria compartida
 int leer_memoria_compartida() {
     // Obtener parámetro para ver si hay que copiar los registros en fichero CSV o en memoria compartida
-    const char * char_use_shared_memory;
-    char_use_shared_memory = obtener_valor_configuracion("USE_SHARED_MEMORY", "0");
-    int use_shared_memory = atoi(char_use_shared_memory);
+    const ParametrosConfiguracion *parametros = obtenerParametros();
+    int use_shared_memory = parametros->usar_memoria_compartida;
 
     // Ver si hay que escribir los registros en el fichero CSV o en memoria compartida
     if (use_shared_memory != 1) {
@@ -560,10 +752,8 @@ int leer_memoria_compartida() {
 
     // Si hay que utilizar memoria compartida, tenemos que leer el fichero consolidado en memoria compartida
     // Obtener el nombre del fichero de datos
-    const char *carpeta_datos;
-    carpeta_datos = obtener_valor_configuracion("PATH_FILES", "../datos");
-    const char *fichero_datos;
-    fichero_datos = obtener_valor_configuracion("INVENTORY_FILE", "file.csv");
+    const char *carpeta_datos = parametros->carpeta_datos;
+    const char *fichero_datos = parametros->fichero_consolidado;
     char nombre_completo_fichero_datos[PATH_MAX];
     sprintf(nombre_completo_fichero_datos, "%s/%s", carpeta_datos, fichero_datos);
 
@@ -583,8 +773,9 @@ int leer_memoria_compartida() {
         // Escribir en memoria compartida
         line_length = strlen(line);
         //printf("used_space=%lu, current_size=%lu, line_length=%lu\n", *used_space, *current_size, line_length);
-        if (shared_mem_used_space + line_length > shared_mem_current_size) {
-            // Si no hay espacio suficiente, tenemos que ampliar la memoria compartida
+        if (shared_mem_used_space + line_length > shared_mem_current_size
+            && ampliar_memoria_compartida(shared_mem_used_space + line_length) != EXIT_SUCCESS) {
+            // Si no hay espacio suficiente y SHARED_MEMORY_INITIAL_SIZE no permite ampliarla
             escribirEnLog(LOG_ERROR, "hilo_observacion", "No es posible ampliar la memoria compartida, amplie el parámetro en fichero de configuración y vuelva a procesar todos los ficheros\n");
             return EXIT_FAILURE;
         }
@@ -608,29 +799,60 @@ int display_shared_memory(void *shmaddr, size_t size) {
     return EXIT_SUCCESS;
 }
 
-// Función de manejador de señal CTRL-C
+// Recarga de fp.conf pendiente (la hace main, fuera del manejador de señal)
+int recarga_parametros_solicitada = 0;
+
+// Función de manejador de señal SIGHUP: main vuelve a leer fp.conf (también LOG_LEVEL)
+void sighup_handler(int sig) {
+    // Con -std=c99 signal() deja la acción por defecto al entregar la señal: volver a instalar el manejador
+    // para que un segundo SIGHUP no termine el proceso
+    signal(sig, sighup_handler);
+    __atomic_store_n(&recarga_parametros_solicitada, 1, __ATOMIC_RELEASE);
+}
+
+// Informe del perfil de bloqueos pendiente (lo escribe main, fuera del manejador de señal)
+int informe_bloqueos_solicitado = 0;
+
+// Función de manejador de señal SIGUSR1: main añade el informe del perfil de bloqueos a LOCK_PROFILING_FILE
+void sigusr1_handler(int sig) {
+    signal(sig, sigusr1_handler);
+    __atomic_store_n(&informe_bloqueos_solicitado, 1, __ATOMIC_RELEASE);
+}
+
+// Terminación pendiente: número de la señal recibida (la hace main, fuera del manejador de señal)
+int terminacion_solicitada = 0;
+
+// Función de manejador de señal CTRL-C: main libera los recursos y termina
+// El manejador no se vuelve a instalar, así que un segundo CTRL-C termina el proceso sin esperar
 void ctrlc_handler(int sig) {
+    __atomic_store_n(&terminacion_solicitada, sig, __ATOMIC_RELEASE);
+}
+
+// Función que libera los recursos compartidos y termina el programa después de CTRL-C
+void terminarFileProcessor(int sig) {
     printf("file_processor: Se ha presionado CTRL-C. Terminando la ejecución.\n");
-    escribirEnLog(LOG_INFO, "file_processor: ctrlc_handler", "Interrupción %2d. Se ha pulsado CTRL-C\n", sig);
+    escribirEnLog(LOG_INFO, "file_processor: terminarFileProcessor", "Interrupción %2d. Se ha pulsado CTRL-C\n", sig);
 
     // Acciones que hay que realizar al terminar el programa
     // Cerrar el semáforo
     sem_close(semaforo_consolidar_ficheros_entrada);
     // Borrar el semáforo
     sem_unlink(semName);
+    // Borrar la marca de confirmación (Monitor vuelve a leer los datos completos)
+    eliminarMarcaConfirmacion();
+    // Borrar la página de métricas
+    terminarMetricasCompartidas();
+    // Último informe del perfil de bloqueos (LOCK_PROFILING=1)
+    escribirInformePerfilBloqueos("fin de la ejecución");
 
     // En caso de que se esté utilizando memoria compartida hay que volcarla a fichero y liberarla
     // Obtener parámetro para ver si hay que copiar los registros en fichero CSV o en memoria compartida
-    const char * char_use_shared_memory;
-    char_use_shared_memory = obtener_valor_configuracion("USE_SHARED_MEMORY", "0");
-    int use_shared_memory = atoi(char_use_shared_memory);
-    if (use_shared_memory == 1) {
+    const ParametrosConfiguracion *parametros = obtenerParametros();
+    if (parametros->usar_memoria_compartida) {
         // Volcar el contenido de la memoria compartida a fichero
         // Preparar la ruta completa de archivo consolidado
-        const char *path_files;
-        path_files = obtener_valor_configuracion("PATH_FILES", "../Datos");
-        const char *archivo_consolidado;
-        archivo_consolidado = obtener_valor_configuracion("INVENTORY_FILE", "consolidado.csv");
+        const char *path_files = parametros->carpeta_datos;
+        const char *archivo_consolidado = parametros->fichero_consolidado;
         char archivo_consolidado_completo[PATH_MAX];
         snprintf(archivo_consolidado_completo, sizeof(archivo_consolidado_completo), "%s/%s", path_files, archivo_consolidado);
 
@@ -673,8 +895,8 @@ void ctrlc_handler(int sig) {
     }
     
 
-    escribirEnLog(LOG_INFO, "file_processor: ctrlc_handler", "Semáforo semaforo_consolidar_ficheros_entrada cerrado y borrado\n");
-    escribirEnLog(LOG_INFO, "file_processor: ctrlc_handler", "Proceso terminado\n");
+    escribirEnLog(LOG_INFO, "file_processor: terminarFileProcessor", "Semáforo semaforo_consolidar_ficheros_entrada cerrado y borrado\n");
+    escribirEnLog(LOG_INFO, "file_processor: terminarFileProcessor", "Proceso terminado\n");
 
     // Fin del programa
     exit(EXIT_SUCCESS);
@@ -693,18 +915,35 @@ int main(int argc, char *argv[]) //argc es el contador de parámetros y argv es
     // Escritura en log de inicio de ejecución
     escribirEnLog(LOG_GENERAL, "file_processor: main", "Iniciando ejecución FileProcessor\n");
 
+    // Leer y validar el fichero de configuración (avisa en el log de las claves desconocidas y los valores no válidos)
+    const ParametrosConfiguracion *parametros = obtenerParametros();
+
+    // Perfil de contención de los bloqueos (antes de crear los hilos)
+    iniciarPerfilBloqueos(parametros->perfil_bloqueos, parametros->fichero_perfil_bloqueos, "FileProcessor");
+    nombrarHiloPerfilBloqueos("main");
+
     // Registra el manejador de señal para SIGINT para CTRL-C
     if (signal(SIGINT, ctrlc_handler) == SIG_ERR) {
         escribirEnLog(LOG_ERROR, "file_processor: main", "No se pudo capturar SIGINT\n");
         return EXIT_FAILURE;
     }
+    // Registra el manejador de señal para SIGHUP para cambiar el nivel de log sin reiniciar
+    if (signal(SIGHUP, sighup_handler) == SIG_ERR) {
+        escribirEnLog(LOG_ERROR, "file_processor: main", "No se pudo capturar SIGHUP\n");
+        return EXIT_FAILURE;
+    }
+    // Registra el manejador de señal para SIGUSR1 para escribir el informe del perfil de bloqueos
+    if (signal(SIGUSR1, sigusr1_handler) == SIG_ERR) {
+        escribirEnLog(LOG_ERROR, "file_processor: main", "No se pudo capturar SIGUSR1\n");
+        return EXIT_FAILURE;
+    }
 
 
     // Vamos a crear un semáforo con un nombre común para file procesor y monitor de forma que podamos utilizarlo
     // para asegurar el acceso a recursos comunes desde ambos procesos. 
     // Creamos un semáforo de 1 recursos con nombre definido en SEMAPHOR_NAME y permisos de lectura y escritura
     // Pongo los permisos 0660 para que eñ semáforo pueda ser utilizado por usuarios del mismo grupo
-    semName = obtener_valor_configuracion("SEMAPHORE_NAME", "/semaforo");
+    semName = parametros->nombre_semaforo;
     // Temporalmente cambiamos a umask(0) para que se establezcan correctamente los permisos de grupo
     // ver: https://stackoverflow.com/questions/11909505/posix-shared-memory-and-semaphores-permissions-set-incorrectly-by-open-calls
     mode_t old_umask = umask(0);
@@ -720,15 +959,31 @@ int main(int argc, char *argv[]) //argc es el contador de parámetros y argv es
     // Asegurarnos de que existe la estructura de directorios
     crear_estructura_directorios();
 
+    // Segmentos del consolidado por día u hora (SEGMENT_PARTITIONING=NINGUNO/DIA/HORA)
+    // (el valor ya está validado en obtenerParametros)
+    ParticionadoSegmentos particionado_segmentos = PARTICIONADO_NINGUNO;
+    if (strcmp(parametros->particionado_segmentos, "DIA") == 0) {
+        particionado_segmentos = PARTICIONADO_DIA;
+    } else if (strcmp(parametros->particionado_segmentos, "HORA") == 0) {
+        particionado_segmentos = PARTICIONADO_HORA;
+    }
+    char carpeta_segmentos[PATH_MAX];
+    snprintf(carpeta_segmentos, sizeof(carpeta_segmentos), "%s/%s", parametros->carpeta_datos, parametros->carpeta_segmentos);
+    inicializarSegmentosConsolidados(carpeta_segmentos, particionado_segmentos);
+
+    // Almacén columnar del consolidado (COLUMNAR_STORE=1)
+    if (parametros->almacen_columnar) {
+        char fichero_columnar[PATH_MAX];
+        snprintf(fichero_columnar, sizeof(fichero_columnar), "%s/%s", parametros->carpeta_datos, parametros->fichero_columnar);
+        inicializarAlmacenColumnar(fichero_columnar, parametros->filas_grupo_columnar);
+    }
+
     // En caso de que se esté utilizando memoria compartida hay que crearla y tratar de leer el fichero
-    const char * char_use_shared_memory;
-    char_use_shared_memory = obtener_valor_configuracion("USE_SHARED_MEMORY", "0");
-    int use_shared_memory = atoi(char_use_shared_memory);
-    if (use_shared_memory == 1) {
+    if (parametros->usar_memoria_compartida) {
         // Vamos a crear la memoria compartida
         // Obtener los valores de la memoria compartida del fichero de configuración
-        shared_mem_name = obtener_valor_configuracion("SHARED_MEMORY_NAME", "/my_shared_memory");;
-        int size = atoi(obtener_valor_configuracion("SHARED_MEMORY_INITIAL_SIZE", "1024"));
+        shared_mem_name = parametros->nombre_memoria_compartida;
+        int size = parametros->tamano_memoria_compartida;
         shared_mem_size = size;
         shared_mem_current_size = shared_mem_size;
         shared_mem_used_space = 0;
@@ -768,6 +1023,42 @@ int main(int argc, char *argv[]) //argc es el contador de parámetros y argv es
         }
     }
 
+    // Agregados parciales de los patrones por fichero de sucursal (PARTIAL_AGGREGATES=1)
+    // Después de crear la memoria compartida: los lotes se comparan con los datos consolidados actuales
+    if (parametros->agregados_parciales) {
+        char fichero_agregados[PATH_MAX];
+        snprintf(fichero_agregados, sizeof(fichero_agregados), "%s/%s", parametros->carpeta_datos, parametros->fichero_agregados);
+        PosicionesConsolidado actuales;
+        medirConsolidacion(&actuales);
+        inicializarAgregadosParciales(fichero_agregados, &actuales);
+    }
+
+    // Resúmenes de los lotes consolidados (BATCH_SUMMARIES=1), también comparados con los datos actuales
+    if (parametros->resumenes_lotes) {
+        char fichero_resumenes[PATH_MAX];
+        snprintf(fichero_resumenes, sizeof(fichero_resumenes), "%s/%s", parametros->carpeta_datos, parametros->fichero_resumenes);
+        PosicionesConsolidado actuales;
+        medirConsolidacion(&actuales);
+        inicializarResumenesLotes(fichero_resumenes, parametros->bits_bloom_resumen, &actuales);
+    }
+
+    // Página de métricas para fpstat (antes de crear los hilos, que dan de alta su serie al arrancar)
+    if (parametros->metricas_compartidas) {
+        iniciarMetricasCompartidas(parametros->nombre_metricas_compartidas, &definicion_metricas);
+    }
+
+    // Lectura sin semáforo desde Monitor: publicar la marca de confirmación con los datos que ya hay
+    lectura_instantanea = parametros->lectura_instantanea;
+    if (lectura_instantanea) {
+        if (inicializarMarcaConfirmacion(parametros->nombre_marca_confirmacion) != 0) {
+            escribirEnLog(LOG_ERROR, "file_processor: main", "Error al crear la marca de confirmación\n");
+            return EXIT_FAILURE;
+        }
+        PosicionesConsolidado posiciones;
+        medirConsolidacion(&posiciones);
+        publicarConsolidacion(&posiciones);
+    }
+
     //Creación de los hilos de observación de ficheros de las sucursales
     crear_hilos_observacion();
     
@@ -775,11 +1066,30 @@ int main(int argc, char *argv[]) //argc es el contador de parámetros y argv es
     escribirEnLog(LOG_INFO, "file_processor: main", "Entrando en ejecucion indefinida\n");
 
     while (1){
-        sleep(10); //Solo para evitar que el main salga y se consuma mucha CPU
+        sleep(1); //Solo para evitar que el main salga y se consuma mucha CPU
+        int senal_terminacion = __atomic_exchange_n(&terminacion_solicitada, 0, __ATOMIC_ACQ_REL);
+        if (senal_terminacion != 0) {
+            // CTRL-C: liberar los recursos compartidos y terminar
+            terminarFileProcessor(senal_terminacion);
+        }
+        estado_quiescente_configuracion();
+        if (__atomic_exchange_n(&recarga_parametros_solicitada, 0, __ATOMIC_ACQ_REL)) {
+            // SIGHUP: aplicar fp.conf y arrancar los hilos que falten si ha aumentado NUM_PROCESOS
+            if (recargarParametros() == EXIT_SUCCESS) {
+                crear_hilos_observacion();
+            }
+        }
+        if (__atomic_exchange_n(&informe_bloqueos_solicitado, 0, __ATOMIC_ACQ_REL)) {
+            if (escribirInformePerfilBloqueos("SIGUSR1") == EXIT_SUCCESS) {
+                escribirEnLog(LOG_INFO, "file_processor: main", "Informe del perfil de bloqueos añadido a %s\n", parametros->fichero_perfil_bloqueos);
+            } else {
+                escribirEnLog(LOG_WARNING, "file_processor: main", "SIGUSR1: no hay informe del perfil de bloqueos (LOCK_PROFILING=%d)\n", parametros->perfil_bloqueos);
+            }
+        }
     }
 
     // Código inaccesible, el programa lo acabará le usuario con CTRL+C 
-    // de forma que los semáforos y recursos se liberarán en el manejador
+    // de forma que los semáforos y recursos se liberarán en terminarFileProcessor
     return EXIT_SUCCESS;
 
 }
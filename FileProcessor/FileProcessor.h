@@ -29,16 +29,45 @@
 #include "config_files.h"   // Funciones para generación de logs
 #include "utilidades.h"     // Funciones para generación de logs
 #include "constants.h"      // Constantes de la aplicación
+#include "segmentos_consolidados.h" // Segmentos del consolidado particionados por fecha
+#include "almacen_columnar.h"   // Almacén columnar del consolidado
+#include "confirmacion_consolidado.h"   // Marca de confirmación para la lectura sin semáforo
+#include "agregados_parciales.h"        // Agregados parciales de los patrones por fichero de sucursal
+#include "resumenes_lotes.h"            // Resúmenes de los lotes para saltar los irrelevantes
+#include "parametros_configuracion.h"    // Parámetros de fp.conf con tipo
+#include "metricas_proceso.h"            // Métricas en memoria compartida para fpstat
+#include "perfil_bloqueos.h"             // Perfil de contención de los bloqueos (LOCK_PROFILING)
 
 #pragma endregion Librerias
 
+// Contadores e histogramas de las series de métricas de los hilos de observación (ver definicion_metricas)
+enum { METRICA_FICHEROS, METRICA_REGISTROS, METRICA_BYTES };
+enum { HISTOGRAMA_ESPERA_ACCESO, HISTOGRAMA_PROCESO_FICHERO };
+
+// Escritores que reciben los registros de un fichero de sucursal en la misma pasada que los copia al consolidado
+// (NULL los que no están activados)
+typedef struct LOTE_CONSOLIDACION {
+    LoteSegmentos *segmentos;
+    LoteColumnar *columnar;
+    LoteAgregados *agregados;
+    LoteResumen *resumen;
+} LoteConsolidacion;
+
 // Para evitar que se puedan llegar a declarar  las funciones varias veces
 #pragma once
 
+void crear_hilos_observacion();
+int continuarHiloObservacion(int id_hilo);
 void *hilo_observador(void *arg);
+void bloquearConsolidacion();
+void desbloquearConsolidacion();
+void medirConsolidacion(PosicionesConsolidado *posiciones);
+void deshacerConsolidacion(int id_hilo, const PosicionesConsolidado *antes, const char *archivo_consolidado);
+void publicarConsolidacion(const PosicionesConsolidado *posiciones);
 int mover_archivo(int id_hilo, const char *archivo_origen, const char *archivo_destino);
-int copiar_registros(int id_hilo, const char *sucursal, const char *archivo_origen, const char *archivo_consolidado);
-int copiar_registros_memoria(int id_hilo, const char *sucursal, const char *archivo_origen);
+int copiar_registros(int id_hilo, const char *sucursal, const char *archivo_origen, const char *archivo_consolidado, LoteConsolidacion *lote);
+int copiar_registros_memoria(int id_hilo, const char *sucursal, const char *archivo_origen, LoteConsolidacion *lote);
+int ampliar_memoria_compartida(size_t necesario);
 void imprimirUso();
 int procesarParametrosLlamada(int argc, char *argv[]);
 int pipe_send(const char *message);
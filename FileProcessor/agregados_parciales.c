@@ -0,0 +1,237 @@
+// ------------------------------------------------------------------
+// AGREGADOS PARCIALES DE LOS PATRONES POR FICHERO DE SUCURSAL
+// ------------------------------------------------------------------
+
+#include "agregados_parciales.h"
+#include "log_files.h"
+#include "config_files.h"
+#include "utilidades.h"
+
+#pragma region AgregadosParciales
+/*
+    Con PARTIAL_AGGREGATES=1, al consolidar cada fichero de sucursal FileProcessor calcula para cada patrón
+    el valor acumulado de cada usuario en cada cubo de tiempo y lo añade como un lote al fichero
+    PARTIAL_FILE (ver formato_agregados.h). Monitor combina los lotes en sus ventanas en lugar de volver
+    a recorrer los registros.
+
+    Los filtros y las acumulaciones de los patrones son los de patrones_fraude.c en Monitor:
+        patrón 1: número de registros           patrón 2: número de registros con importe negativo
+        patrón 3: número de registros con error patrón 4: registros de cada tipo de operación
+        patrón 5: suma de los importes
+    Los registros llegan de la misma pasada que los copia al consolidado (iniciarLoteAgregados,
+    anadirRegistroAgregados y terminarLoteAgregados), sin volver a leer el fichero de sucursal.
+    Los lotes se escriben con el acceso exclusivo al consolidado cogido y antes de publicar la marca de
+    confirmación. Si FileProcessor se para a mitad de un lote, al arrancar se recorta el lote incompleto.
+    Cada lote lleva la identidad de los datos consolidados que resume: si al arrancar el consolidado es
+    otro (o se ha recortado), los lotes ya no sirven y se vacía el fichero.
+*/
+
+// Estado del fichero de agregados
+static pthread_mutex_t mutex_agregados = PTHREAD_MUTEX_INITIALIZER;
+static char fichero_agregados[PATH_MAX];
+static int agregados_activos = 0;
+
+// Valor acumulado de un usuario en un cubo de un patrón
+typedef struct AGREGADO_CUBO {
+    int patron;
+    char *usuario;
+    long long inicio;
+    long long cantidad;
+    int operaciones[4];
+} AgregadoCubo;
+
+static void liberarAgregadoCubo(gpointer datos) {
+    AgregadoCubo *agregado = (AgregadoCubo *)datos;
+    g_free(agregado->usuario);
+    g_free(agregado);
+}
+
+// Función que comprueba si una línea de lote está completa y es del tipo indicado
+static int lineaLoteCompleta(const char *linea, char tipo) {
+    size_t longitud = strlen(linea);
+    return longitud > 2 && linea[0] == tipo && linea[1] == ';' && linea[longitud - 1] == '\n';
+}
+
+// Función que lee la cabecera L;... de un lote: número de filas, posiciones finales e identidad de los datos
+// Devuelve 0 o -1 si la cabecera no tiene el formato de formato_agregados.h
+static int leerCabeceraLote(const char *linea, int *filas, PosicionesConsolidado *hasta) {
+    int leidos = sscanf(linea + 2, "%d;%*[-0-9];%*[-0-9];%lld;%*[-0-9];%lld;%*[-0-9];%lld;%llu:%llu;%llu:%llu;%llu:%llu", filas,
+        &hasta->fichero, &hasta->memoria, &hasta->columnar,
+        &hasta->identidad_fichero.dispositivo, &hasta->identidad_fichero.inodo,
+        &hasta->identidad_memoria.dispositivo, &hasta->identidad_memoria.inodo,
+        &hasta->identidad_columnar.dispositivo, &hasta->identidad_columnar.inodo);
+    return leidos == 10 && *filas >= 0 ? 0 : -1;
+}
+
+// Función que prepara el fichero de agregados y recorta un lote incompleto al final
+// actuales son las posiciones e identidad de los datos consolidados al arrancar: si los lotes son de otros datos,
+// el fichero se vacía
+// Devuelve 0 o -1 en caso de error (los agregados quedan desactivados)
+int inicializarAgregadosParciales(const char *nombre_fichero, const PosicionesConsolidado *actuales) {
+    pthread_mutex_lock(&mutex_agregados);
+    snprintf(fichero_agregados, sizeof(fichero_agregados), "%s", nombre_fichero);
+    agregados_activos = 0;
+    FILE *fichero = fopen(nombre_fichero, "a+");
+    if (fichero == NULL) {
+        escribirEnLog(LOG_ERROR, "agregados_parciales", "No se puede abrir el fichero de agregados %s\n", nombre_fichero);
+        pthread_mutex_unlock(&mutex_agregados);
+        return -1;
+    }
+    rewind(fichero);
+    char linea[MAX_LINE_LENGTH];
+    long long fin_completo = 0;
+    long lotes = 0;
+    int filas_pendientes = 0;
+    int correcto = 1;
+    int otros_datos = 0;
+    while (correcto && !otros_datos && fgets(linea, sizeof(linea), fichero) != NULL) {
+        if (filas_pendientes == 0) {
+            PosicionesConsolidado hasta;
+            correcto = lineaLoteCompleta(linea, 'L');
+            // Una cabecera completa de otro formato o de otros datos consolidados invalida todos los lotes
+            otros_datos = correcto && (leerCabeceraLote(linea, &filas_pendientes, &hasta) != 0 || !mismosDatosConsolidados(&hasta, actuales));
+        } else {
+            correcto = lineaLoteCompleta(linea, 'A');
+            filas_pendientes--;
+        }
+        if (correcto && !otros_datos && filas_pendientes == 0) {
+            fin_completo = ftell(fichero);
+            lotes++;
+        }
+    }
+    int resultado = 0;
+    if (otros_datos) {
+        escribirEnLog(LOG_WARNING, "agregados_parciales", "Los lotes de %s son de otros datos consolidados, se vacía el fichero\n", nombre_fichero);
+        lotes = 0;
+        if (ftruncate(fileno(fichero), 0) != 0) {
+            resultado = -1;
+        }
+    } else if (fin_completo < ftell(fichero)) {
+        escribirEnLog(LOG_WARNING, "agregados_parciales", "Recortado un lote incompleto al final de %s (%lld bytes)\n",
+            nombre_fichero, (long long)ftell(fichero) - fin_completo);
+        if (ftruncate(fileno(fichero), fin_completo) != 0) {
+            resultado = -1;
+        }
+    }
+    fclose(fichero);
+    if (resultado == 0) {
+        agregados_activos = 1;
+        escribirEnLog(LOG_INFO, "agregados_parciales", "Fichero de agregados %s: %ld lotes\n", nombre_fichero, lotes);
+    }
+    pthread_mutex_unlock(&mutex_agregados);
+    return resultado;
+}
+
+// Función que acumula un registro en el cubo de un patrón
+static void acumularCubo(GHashTable *cubos, int patron, long long ancho, const char *usuario, long long instante, long long cantidad, int tipo_operacion) {
+    long long inicio = instante - instante % ancho;
+    char clave[MAX_LINE_LENGTH];
+    snprintf(clave, sizeof(clave), "%d;%s;%lld", patron, usuario, inicio);
+    AgregadoCubo *agregado = g_hash_table_lookup(cubos, clave);
+    if (agregado == NULL) {
+        agregado = g_new0(AgregadoCubo, 1);
+        agregado->patron = patron;
+        agregado->usuario = g_strdup(usuario);
+        agregado->inicio = inicio;
+        g_hash_table_insert(cubos, g_strdup(clave), agregado);
+    }
+    agregado->cantidad += cantidad;
+    if (tipo_operacion >= 1 && tipo_operacion <= 4) {
+        agregado->operaciones[tipo_operacion - 1]++;
+    }
+}
+
+// Agregados de un fichero de sucursal mientras se consolidan sus registros
+struct LOTE_AGREGADOS {
+    GHashTable *cubos;      // patrón;usuario;inicio -> AgregadoCubo
+    int num_registros;
+};
+
+// Función que empieza a calcular los agregados de un fichero de sucursal
+// Devuelve el lote o NULL si los agregados no están activados. El fichero queda reservado hasta terminarLoteAgregados
+LoteAgregados *iniciarLoteAgregados() {
+    pthread_mutex_lock(&mutex_agregados);
+    if (!agregados_activos) {
+        pthread_mutex_unlock(&mutex_agregados);
+        return NULL;
+    }
+    LoteAgregados *lote = malloc(sizeof(LoteAgregados));
+    lote->cubos = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, liberarAgregadoCubo);
+    lote->num_registros = 0;
+    return lote;
+}
+
+// Función que acumula los campos de un registro completo (ver separarCamposRegistro) en los cubos del lote
+void anadirRegistroAgregados(LoteAgregados *lote, char *const campos[NUM_CAMPOS_REGISTRO]) {
+    static const long long anchos[NUM_PATRONES_AGREGADOS] = ANCHOS_CUBOS_AGREGADOS;
+    if (lote == NULL) {
+        return;
+    }
+    lote->num_registros++;
+    long long instante = convertirFechaHora(campos[2]);
+    if (instante < 0) {
+        // Los patrones no tienen en cuenta los registros sin fecha de inicio válida
+        return;
+    }
+    const char *usuario = campos[4];
+    int tipo_operacion2 = atoi(campos[6]);
+    // atoi se detiene en el " €" del importe
+    int importe = atoi(campos[7]);
+    acumularCubo(lote->cubos, 1, anchos[0], usuario, instante, 1, 0);
+    if (importe < 0) {
+        acumularCubo(lote->cubos, 2, anchos[1], usuario, instante, 1, 0);
+    }
+    if (strcmp(campos[8], "Error") == 0) {
+        acumularCubo(lote->cubos, 3, anchos[2], usuario, instante, 1, 0);
+    }
+    acumularCubo(lote->cubos, 4, anchos[3], usuario, instante, 0, tipo_operacion2);
+    acumularCubo(lote->cubos, 5, anchos[4], usuario, instante, importe, 0);
+}
+
+// Función que termina el lote: lo añade al fichero de agregados y lo libera
+// desde y hasta son las posiciones de los datos consolidados antes y después de añadir el fichero
+// Si correcto es 0 (el fichero no se ha podido consolidar) el lote se descarta sin escribirlo
+// Devuelve el número de registros del lote o -1 en caso de error
+int terminarLoteAgregados(int id_hilo, LoteAgregados *lote, const char *archivo_origen, int correcto,
+    const PosicionesConsolidado *desde, const PosicionesConsolidado *hasta) {
+    static const long long anchos[NUM_PATRONES_AGREGADOS] = ANCHOS_CUBOS_AGREGADOS;
+    if (lote == NULL) {
+        return 0;
+    }
+    int resultado = 0;
+    FILE *fichero = correcto ? fopen(fichero_agregados, "a") : NULL;
+    if (!correcto) {
+        lote->num_registros = 0;
+    } else if (fichero == NULL) {
+        escribirEnLog(LOG_ERROR, "agregados_parciales", "Hilo %02d: Error al abrir el fichero de agregados %s\n", id_hilo, fichero_agregados);
+        resultado = -1;
+    } else {
+        fprintf(fichero, "L;%u;%d;%lld;%lld;%lld;%lld;%lld;%lld;%llu:%llu;%llu:%llu;%llu:%llu\n", g_hash_table_size(lote->cubos), lote->num_registros,
+            desde->fichero, hasta->fichero, desde->memoria, hasta->memoria, desde->columnar, hasta->columnar,
+            hasta->identidad_fichero.dispositivo, hasta->identidad_fichero.inodo,
+            hasta->identidad_memoria.dispositivo, hasta->identidad_memoria.inodo,
+            hasta->identidad_columnar.dispositivo, hasta->identidad_columnar.inodo);
+        GHashTableIter iter;
+        gpointer clave, valor;
+        g_hash_table_iter_init(&iter, lote->cubos);
+        while (g_hash_table_iter_next(&iter, &clave, &valor)) {
+            AgregadoCubo *agregado = (AgregadoCubo *)valor;
+            fprintf(fichero, "A;%d;%lld;%s;%lld;%lld;%d;%d;%d;%d\n", agregado->patron, anchos[agregado->patron - 1], agregado->usuario,
+                agregado->inicio, agregado->cantidad, agregado->operaciones[0], agregado->operaciones[1], agregado->operaciones[2], agregado->operaciones[3]);
+        }
+        if (fclose(fichero) != 0) {
+            escribirEnLog(LOG_ERROR, "agregados_parciales", "Hilo %02d: Error al escribir el fichero de agregados %s\n", id_hilo, fichero_agregados);
+            resultado = -1;
+        } else {
+            escribirEnLog(LOG_INFO, "agregados_parciales", "Hilo %02d: %d registros de %s en %u agregados parciales\n",
+                id_hilo, lote->num_registros, archivo_origen, g_hash_table_size(lote->cubos));
+        }
+    }
+    int num_registros = lote->num_registros;
+    g_hash_table_destroy(lote->cubos);
+    free(lote);
+    pthread_mutex_unlock(&mutex_agregados);
+    return resultado == 0 ? num_registros : -1;
+}
+
+#pragma endregion AgregadosParciales
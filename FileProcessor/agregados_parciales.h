@@ -0,0 +1,32 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <pthread.h>        // Tratamiento de hilos y mutex
+#include <unistd.h>         // Gestión de procesos, acceso a archivos, pipe, control de señales
+#include <linux/limits.h>   // Define varias constantes que representan los límites del sistema en sistemas operativos Linux
+#include <glib.h>           // Diccionarios GLib para acumular los agregados de un fichero
+
+#include "constants.h"                  // Constantes de la aplicación
+#include "formato_agregados.h"          // Formato del fichero de agregados parciales
+#include "confirmacion_consolidado.h"   // Posiciones de los datos consolidados
+#include "utilidades.h"                 // Campos de una línea del consolidado
+#pragma endregion Librerias
+
+// Agregados de un fichero de sucursal mientras se consolidan sus registros (ver agregados_parciales.c)
+typedef struct LOTE_AGREGADOS LoteAgregados;
+
+
+int inicializarAgregadosParciales(const char *nombre_fichero, const PosicionesConsolidado *actuales);
+
+LoteAgregados *iniciarLoteAgregados();
+
+void anadirRegistroAgregados(LoteAgregados *lote, char *const campos[NUM_CAMPOS_REGISTRO]);
+
+int terminarLoteAgregados(int id_hilo, LoteAgregados *lote, const char *archivo_origen, int correcto,
+    const PosicionesConsolidado *desde, const PosicionesConsolidado *hasta);
@@ -0,0 +1,409 @@
+// ------------------------------------------------------------------
+// ALMACÉN COLUMNAR DEL CONSOLIDADO
+// ------------------------------------------------------------------
+
+// truncate no se declara con -std=c99
+#define _DEFAULT_SOURCE
+
+#include "almacen_columnar.h"
+#include "log_files.h"
+#include "config_files.h"
+#include "utilidades.h"
+
+#pragma region AlmacenColumnar
+/*
+    Además del consolidado en CSV, FileProcessor puede guardar los registros en un almacén columnar
+    (COLUMNAR_STORE=1, fichero COLUMNAR_FILE en PATH_FILES) con el formato de formato_columnar.h.
+
+    Los registros de cada fichero de sucursal se agrupan en grupos de hasta COLUMNAR_ROW_GROUP filas.
+    El último grupo de cada fichero se escribe aunque no esté lleno, para que Monitor lo vea al recibir
+    el aviso por el pipe. Los grupos se escriben con el semáforo cogido, igual que el consolidado, o antes
+    de publicar la marca de confirmación (SNAPSHOT_READS=1), así que Monitor nunca lee un grupo a medio
+    escribir; si FileProcessor se para a mitad de un grupo, al arrancar se recorta el grupo incompleto.
+
+    Los registros llegan de la misma pasada que los copia al consolidado (iniciarLoteColumnar,
+    anadirRegistroColumnar y terminarLoteColumnar). Si falla la escritura de un grupo, el almacén se recorta
+    hasta el tamaño que tenía al empezar el lote: no queda un grupo a medias delante de los grupos siguientes.
+*/
+
+// Longitud máxima de un texto del almacén (la longitud se guarda en un byte)
+#define MAX_TEXTO_COLUMNAR 255
+
+// Estado del almacén: sólo se modifica entre iniciarLoteColumnar y terminarLoteColumnar
+static pthread_mutex_t mutex_almacen_columnar = PTHREAD_MUTEX_INITIALIZER;
+static char fichero_almacen[PATH_MAX];
+static int filas_grupo = 0;     // 0: almacén desactivado
+
+// Buffer de bytes de una columna
+typedef struct BUFFER_COLUMNA {
+    unsigned char *datos;
+    size_t usado;
+    size_t capacidad;
+} BufferColumna;
+
+// Diccionario de una columna dentro de un grupo de filas
+// Las columnas con diccionario tienen pocos valores distintos: basta con una búsqueda lineal
+typedef struct DICCIONARIO_COLUMNA {
+    char (*valores)[MAX_TEXTO_COLUMNAR + 1];
+    uint16_t *identificadores;
+    int num_valores;
+} DiccionarioColumna;
+
+// Grupo de filas en construcción
+typedef struct GRUPO_FILAS {
+    int num_filas;
+    DiccionarioColumna sucursal;
+    DiccionarioColumna usuario;
+    DiccionarioColumna tipo_operacion1;
+    DiccionarioColumna estado;
+    BufferColumna operacion;
+    int64_t *instantes_inicio;
+    int64_t *instantes_fin;
+    int32_t *tipos_operacion2;
+    int32_t *importes;
+} GrupoFilas;
+
+// Función que añade bytes a un buffer, ampliándolo si hace falta
+static void anadirBytesColumna(BufferColumna *buffer, const void *datos, size_t longitud) {
+    if (buffer->usado + longitud > buffer->capacidad) {
+        size_t capacidad = buffer->capacidad == 0 ? 4096 : buffer->capacidad;
+        while (buffer->usado + longitud > capacidad) {
+            capacidad *= 2;
+        }
+        buffer->datos = realloc(buffer->datos, capacidad);
+        buffer->capacidad = capacidad;
+    }
+    memcpy(buffer->datos + buffer->usado, datos, longitud);
+    buffer->usado += longitud;
+}
+
+// Función que añade un texto con su longitud (uint8) a un buffer
+static void anadirTextoColumna(BufferColumna *buffer, const char *texto) {
+    size_t longitud = strlen(texto);
+    if (longitud > MAX_TEXTO_COLUMNAR) {
+        longitud = MAX_TEXTO_COLUMNAR;
+    }
+    uint8_t longitud_byte = (uint8_t)longitud;
+    anadirBytesColumna(buffer, &longitud_byte, 1);
+    anadirBytesColumna(buffer, texto, longitud);
+}
+
+// Función que devuelve el identificador de un valor en el diccionario, añadiéndolo si no existe
+static uint16_t identificadorDiccionario(DiccionarioColumna *diccionario, const char *valor) {
+    for (int i = 0; i < diccionario->num_valores; i++) {
+        if (strcmp(diccionario->valores[i], valor) == 0) {
+            return (uint16_t)i;
+        }
+    }
+    snprintf(diccionario->valores[diccionario->num_valores], MAX_TEXTO_COLUMNAR + 1, "%s", valor);
+    return (uint16_t)diccionario->num_valores++;
+}
+
+// Función que codifica una columna con diccionario
+static void codificarDiccionario(BufferColumna *buffer, const DiccionarioColumna *diccionario, int num_filas) {
+    uint32_t entradas = (uint32_t)diccionario->num_valores;
+    uint8_t bytes_identificador = entradas <= 256 ? 1 : 2;
+    anadirBytesColumna(buffer, &entradas, sizeof(entradas));
+    anadirBytesColumna(buffer, &bytes_identificador, 1);
+    for (int i = 0; i < diccionario->num_valores; i++) {
+        anadirTextoColumna(buffer, diccionario->valores[i]);
+    }
+    for (int i = 0; i < num_filas; i++) {
+        if (bytes_identificador == 1) {
+            uint8_t identificador = (uint8_t)diccionario->identificadores[i];
+            anadirBytesColumna(buffer, &identificador, 1);
+        } else {
+            anadirBytesColumna(buffer, &diccionario->identificadores[i], 2);
+        }
+    }
+}
+
+static void crearDiccionario(DiccionarioColumna *diccionario, int filas) {
+    diccionario->valores = malloc(sizeof(*diccionario->valores) * filas);
+    diccionario->identificadores = malloc(sizeof(uint16_t) * filas);
+    diccionario->num_valores = 0;
+}
+
+static void liberarDiccionario(DiccionarioColumna *diccionario) {
+    free(diccionario->valores);
+    free(diccionario->identificadores);
+}
+
+static void crearGrupoFilas(GrupoFilas *grupo, int filas) {
+    memset(grupo, 0, sizeof(*grupo));
+    crearDiccionario(&grupo->sucursal, filas);
+    crearDiccionario(&grupo->usuario, filas);
+    crearDiccionario(&grupo->tipo_operacion1, filas);
+    crearDiccionario(&grupo->estado, filas);
+    grupo->instantes_inicio = malloc(sizeof(int64_t) * filas);
+    grupo->instantes_fin = malloc(sizeof(int64_t) * filas);
+    grupo->tipos_operacion2 = malloc(sizeof(int32_t) * filas);
+    grupo->importes = malloc(sizeof(int32_t) * filas);
+}
+
+static void vaciarGrupoFilas(GrupoFilas *grupo) {
+    grupo->num_filas = 0;
+    grupo->sucursal.num_valores = 0;
+    grupo->usuario.num_valores = 0;
+    grupo->tipo_operacion1.num_valores = 0;
+    grupo->estado.num_valores = 0;
+    grupo->operacion.usado = 0;
+}
+
+static void liberarGrupoFilas(GrupoFilas *grupo) {
+    liberarDiccionario(&grupo->sucursal);
+    liberarDiccionario(&grupo->usuario);
+    liberarDiccionario(&grupo->tipo_operacion1);
+    liberarDiccionario(&grupo->estado);
+    free(grupo->operacion.datos);
+    free(grupo->instantes_inicio);
+    free(grupo->instantes_fin);
+    free(grupo->tipos_operacion2);
+    free(grupo->importes);
+}
+
+// Función que convierte un importe con formato "131 €", "-49 €" o "12,50 €" en céntimos
+static int32_t convertirImporteCentimos(const char *texto) {
+    char *fin;
+    long euros = strtol(texto, &fin, 10);
+    long centimos = 0;
+    if (*fin == '.' || *fin == ',') {
+        const char *decimales = fin + 1;
+        for (int i = 0; i < 2; i++) {
+            centimos *= 10;
+            if (decimales[0] >= '0' && decimales[0] <= '9') {
+                centimos += decimales[0] - '0';
+                decimales++;
+            }
+        }
+    }
+    int negativo = euros < 0 || (euros == 0 && strchr(texto, '-') != NULL && strchr(texto, '-') < fin);
+    return (int32_t)(euros * 100 + (negativo ? -centimos : centimos));
+}
+
+// Función que añade al grupo los campos de un registro completo (ver separarCamposRegistro)
+static void anadirCamposGrupo(GrupoFilas *grupo, char *const campos[NUM_CAMPOS_REGISTRO]) {
+    int fila = grupo->num_filas++;
+    grupo->sucursal.identificadores[fila] = identificadorDiccionario(&grupo->sucursal, campos[0]);
+    anadirTextoColumna(&grupo->operacion, campos[1]);
+    grupo->instantes_inicio[fila] = convertirFechaHora(campos[2]);
+    grupo->instantes_fin[fila] = convertirFechaHora(campos[3]);
+    grupo->usuario.identificadores[fila] = identificadorDiccionario(&grupo->usuario, campos[4]);
+    grupo->tipo_operacion1.identificadores[fila] = identificadorDiccionario(&grupo->tipo_operacion1, campos[5]);
+    grupo->tipos_operacion2[fila] = atoi(campos[6]);
+    grupo->importes[fila] = convertirImporteCentimos(campos[7]);
+    grupo->estado.identificadores[fila] = identificadorDiccionario(&grupo->estado, campos[8]);
+}
+
+// Función que codifica el grupo de filas y lo añade al final del almacén
+static int escribirGrupoFilas(GrupoFilas *grupo) {
+    if (grupo->num_filas == 0) {
+        return 0;
+    }
+    int n = grupo->num_filas;
+    BufferColumna columnas[NUM_COLUMNAS_ALMACEN];
+    memset(columnas, 0, sizeof(columnas));
+    CabeceraGrupoFilas cabecera;
+    memset(&cabecera, 0, sizeof(cabecera));
+    cabecera.magia = MAGIA_GRUPO_FILAS;
+    cabecera.num_filas = (uint32_t)n;
+    cabecera.instante_minimo = -1;
+    cabecera.instante_maximo = -1;
+    cabecera.importe_minimo = grupo->importes[0];
+    cabecera.importe_maximo = grupo->importes[0];
+
+    codificarDiccionario(&columnas[COLUMNA_SUCURSAL], &grupo->sucursal, n);
+    anadirBytesColumna(&columnas[COLUMNA_OPERACION], grupo->operacion.datos, grupo->operacion.usado);
+    int64_t anterior = 0;
+    for (int i = 0; i < n; i++) {
+        int64_t instante = grupo->instantes_inicio[i];
+        int64_t delta_inicio = i == 0 ? instante : instante - anterior;
+        int64_t delta_fin = grupo->instantes_fin[i] - instante;
+        anadirBytesColumna(&columnas[COLUMNA_FECHA_INICIO], &delta_inicio, sizeof(delta_inicio));
+        anadirBytesColumna(&columnas[COLUMNA_FECHA_FIN], &delta_fin, sizeof(delta_fin));
+        anadirBytesColumna(&columnas[COLUMNA_TIPO_OPERACION2], &grupo->tipos_operacion2[i], sizeof(int32_t));
+        anadirBytesColumna(&columnas[COLUMNA_IMPORTE], &grupo->importes[i], sizeof(int32_t));
+        anterior = instante;
+        // Estadísticas del grupo
+        if (instante >= 0 && (cabecera.instante_minimo < 0 || instante < cabecera.instante_minimo)) {
+            cabecera.instante_minimo = instante;
+        }
+        if (instante > cabecera.instante_maximo) {
+            cabecera.instante_maximo = instante;
+        }
+        if (grupo->importes[i] < cabecera.importe_minimo) {
+            cabecera.importe_minimo = grupo->importes[i];
+        }
+        if (grupo->importes[i] > cabecera.importe_maximo) {
+            cabecera.importe_maximo = grupo->importes[i];
+        }
+    }
+    codificarDiccionario(&columnas[COLUMNA_USUARIO], &grupo->usuario, n);
+    codificarDiccionario(&columnas[COLUMNA_TIPO_OPERACION1], &grupo->tipo_operacion1, n);
+    codificarDiccionario(&columnas[COLUMNA_ESTADO], &grupo->estado, n);
+
+    FILE *fichero = fopen(fichero_almacen, "ab");
+    int resultado = fichero != NULL ? 0 : -1;
+    if (fichero != NULL) {
+        for (int c = 0; c < NUM_COLUMNAS_ALMACEN; c++) {
+            cabecera.bytes_columnas[c] = (uint32_t)columnas[c].usado;
+        }
+        if (fwrite(&cabecera, sizeof(cabecera), 1, fichero) != 1) {
+            resultado = -1;
+        }
+        for (int c = 0; c < NUM_COLUMNAS_ALMACEN && resultado == 0; c++) {
+            if (columnas[c].usado > 0 && fwrite(columnas[c].datos, columnas[c].usado, 1, fichero) != 1) {
+                resultado = -1;
+            }
+        }
+        if (fclose(fichero) != 0) {
+            resultado = -1;
+        }
+    }
+    if (resultado != 0) {
+        escribirEnLog(LOG_ERROR, "almacen_columnar", "Error al escribir un grupo de %d filas en %s\n", n, fichero_almacen);
+    }
+    for (int c = 0; c < NUM_COLUMNAS_ALMACEN; c++) {
+        free(columnas[c].datos);
+    }
+    vaciarGrupoFilas(grupo);
+    return resultado;
+}
+
+// Función que prepara el almacén: lo crea si no existe y recorta un grupo incompleto al final
+// Devuelve 0 o -1 si el fichero no es un almacén columnar (el almacén queda desactivado)
+int inicializarAlmacenColumnar(const char *nombre_fichero, int filas_por_grupo) {
+    pthread_mutex_lock(&mutex_almacen_columnar);
+    snprintf(fichero_almacen, sizeof(fichero_almacen), "%s", nombre_fichero);
+    filas_grupo = 0;
+    if (filas_por_grupo < 1 || filas_por_grupo > 65535) {
+        escribirEnLog(LOG_WARNING, "almacen_columnar", "COLUMNAR_ROW_GROUP=%d fuera de rango (1..65535), se utiliza 4096\n", filas_por_grupo);
+        filas_por_grupo = 4096;
+    }
+
+    FILE *fichero = fopen(nombre_fichero, "a+b");
+    if (fichero == NULL) {
+        escribirEnLog(LOG_ERROR, "almacen_columnar", "No se puede abrir el almacén columnar %s\n", nombre_fichero);
+        pthread_mutex_unlock(&mutex_almacen_columnar);
+        return -1;
+    }
+    struct stat info;
+    fstat(fileno(fichero), &info);
+    int resultado = 0;
+    long long grupos = 0;
+    if (info.st_size == 0) {
+        fwrite(MAGIA_ALMACEN_COLUMNAR, LONGITUD_MAGIA_ALMACEN_COLUMNAR, 1, fichero);
+    } else {
+        char magia[LONGITUD_MAGIA_ALMACEN_COLUMNAR];
+        rewind(fichero);
+        if (fread(magia, LONGITUD_MAGIA_ALMACEN_COLUMNAR, 1, fichero) != 1
+            || memcmp(magia, MAGIA_ALMACEN_COLUMNAR, LONGITUD_MAGIA_ALMACEN_COLUMNAR) != 0) {
+            escribirEnLog(LOG_ERROR, "almacen_columnar", "%s no es un almacén columnar\n", nombre_fichero);
+            resultado = -1;
+        } else {
+            // Recorrer los grupos completos
+            long long posicion = LONGITUD_MAGIA_ALMACEN_COLUMNAR;
+            CabeceraGrupoFilas cabecera;
+            while (fseek(fichero, posicion, SEEK_SET) == 0 && fread(&cabecera, sizeof(cabecera), 1, fichero) == 1
+                && cabecera.magia == MAGIA_GRUPO_FILAS) {
+                long long bytes = 0;
+                for (int c = 0; c < NUM_COLUMNAS_ALMACEN; c++) {
+                    bytes += cabecera.bytes_columnas[c];
+                }
+                if (posicion + (long long)sizeof(cabecera) + bytes > (long long)info.st_size) {
+                    break;
+                }
+                posicion += sizeof(cabecera) + bytes;
+                grupos++;
+            }
+            if (posicion < (long long)info.st_size) {
+                escribirEnLog(LOG_WARNING, "almacen_columnar", "Recortado un grupo incompleto al final de %s (%lld bytes)\n",
+                    nombre_fichero, (long long)info.st_size - posicion);
+                if (ftruncate(fileno(fichero), posicion) != 0) {
+                    resultado = -1;
+                }
+            }
+        }
+    }
+    fclose(fichero);
+    if (resultado == 0) {
+        filas_grupo = filas_por_grupo;
+        escribirEnLog(LOG_INFO, "almacen_columnar", "Almacén columnar %s: %lld grupos, grupos de hasta %d filas\n", nombre_fichero, grupos, filas_grupo);
+    }
+    pthread_mutex_unlock(&mutex_almacen_columnar);
+    return resultado;
+}
+
+// Registros de un fichero de sucursal que se están añadiendo al almacén
+struct LOTE_COLUMNAR {
+    GrupoFilas grupo;
+    long long inicio;       // Tamaño del almacén al empezar el lote
+    int num_registros;
+    int resultado;          // -1 si ha fallado la escritura de algún grupo
+};
+
+// Función que empieza a añadir los registros de un fichero de sucursal al almacén columnar
+// Devuelve el lote o NULL si el almacén no está activado. El almacén queda reservado hasta terminarLoteColumnar
+LoteColumnar *iniciarLoteColumnar() {
+    pthread_mutex_lock(&mutex_almacen_columnar);
+    if (filas_grupo == 0) {
+        pthread_mutex_unlock(&mutex_almacen_columnar);
+        return NULL;
+    }
+    LoteColumnar *lote = malloc(sizeof(LoteColumnar));
+    crearGrupoFilas(&lote->grupo, filas_grupo);
+    lote->num_registros = 0;
+    lote->resultado = 0;
+    struct stat info;
+    if (stat(fichero_almacen, &info) != 0) {
+        escribirEnLog(LOG_ERROR, "almacen_columnar", "No se puede obtener el tamaño del almacén columnar %s\n", fichero_almacen);
+        lote->resultado = -1;
+    }
+    lote->inicio = lote->resultado == 0 ? (long long)info.st_size : 0;
+    return lote;
+}
+
+// Función que añade un registro completo al lote y escribe el grupo de filas cuando se llena
+void anadirRegistroColumnar(LoteColumnar *lote, char *const campos[NUM_CAMPOS_REGISTRO]) {
+    if (lote == NULL || lote->resultado != 0) {
+        return;
+    }
+    anadirCamposGrupo(&lote->grupo, campos);
+    lote->num_registros++;
+    if (lote->grupo.num_filas == filas_grupo) {
+        lote->resultado = escribirGrupoFilas(&lote->grupo);
+    }
+}
+
+// Función que termina el lote: escribe el último grupo, aunque no esté lleno, y libera el lote
+// Si correcto es 0 (el fichero no se ha podido consolidar) o ha fallado alguna escritura, el almacén se recorta
+// hasta el tamaño que tenía al empezar el lote
+// Devuelve el número de registros añadidos o -1 si ha fallado la escritura del almacén
+int terminarLoteColumnar(int id_hilo, LoteColumnar *lote, const char *archivo_origen, int correcto) {
+    if (lote == NULL) {
+        return 0;
+    }
+    if (correcto && lote->resultado == 0) {
+        lote->resultado = escribirGrupoFilas(&lote->grupo);
+    }
+    int num_registros = lote->num_registros;
+    if (!correcto || lote->resultado != 0) {
+        num_registros = 0;
+        if (truncate(fichero_almacen, lote->inicio) != 0) {
+            escribirEnLog(LOG_ERROR, "almacen_columnar", "Hilo %02d: Error al recortar el almacén columnar %s a %lld bytes\n",
+                id_hilo, fichero_almacen, lote->inicio);
+        } else if (lote->resultado != 0) {
+            escribirEnLog(LOG_WARNING, "almacen_columnar", "Hilo %02d: Recortado el almacén columnar %s a %lld bytes, se descartan los registros de %s\n",
+                id_hilo, fichero_almacen, lote->inicio, archivo_origen);
+        }
+    } else {
+        escribirEnLog(LOG_INFO, "almacen_columnar", "Hilo %02d: %d registros de %s añadidos al almacén columnar\n", id_hilo, num_registros, archivo_origen);
+    }
+    int resultado = lote->resultado;
+    liberarGrupoFilas(&lote->grupo);
+    free(lote);
+    pthread_mutex_unlock(&mutex_almacen_columnar);
+    return resultado == 0 ? num_registros : -1;
+}
+
+#pragma endregion AlmacenColumnar
@@ -0,0 +1,30 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <pthread.h>        // Tratamiento de hilos y mutex
+#include <unistd.h>         // Gestión de procesos, acceso a archivos, pipe, control de señales
+#include <sys/stat.h>       // Definiciones y estructuras para trabajar con estados de archivos Linux
+#include <linux/limits.h>   // Define varias constantes que representan los límites del sistema en sistemas operativos Linux
+
+#include "constants.h"          // Constantes de la aplicación
+#include "formato_columnar.h"   // Formato en disco del almacén columnar
+#include "utilidades.h"         // Campos de una línea del consolidado
+#pragma endregion Librerias
+
+// Registros de un fichero de sucursal que se están añadiendo al almacén (ver almacen_columnar.c)
+typedef struct LOTE_COLUMNAR LoteColumnar;
+
+
+int inicializarAlmacenColumnar(const char *nombre_fichero, int filas_por_grupo);
+
+LoteColumnar *iniciarLoteColumnar();
+
+void anadirRegistroColumnar(LoteColumnar *lote, char *const campos[NUM_CAMPOS_REGISTRO]);
+
+int terminarLoteColumnar(int id_hilo, LoteColumnar *lote, const char *archivo_origen, int correcto);
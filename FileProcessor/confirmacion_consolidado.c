@@ -0,0 +1,101 @@
+// ------------------------------------------------------------------
+// MARCA DE CONFIRMACIÓN DEL CONSOLIDADO
+// ------------------------------------------------------------------
+
+#include "confirmacion_consolidado.h"
+#include "log_files.h"
+
+#pragma region ConfirmacionConsolidado
+/*
+    Con SNAPSHOT_READS=1 FileProcessor publica después de cada fichero de sucursal la marca de confirmación
+    (ver marca_confirmacion.h) y Monitor lee los datos consolidados hasta la marca sin coger el semáforo.
+    Los hilos de FileProcessor publican la marca de uno en uno (con el cerrojo de consolidación cogido),
+    así que la marca sólo avanza.
+*/
+
+static MarcaConfirmacion *marca = NULL;
+static const char *nombre_marca = NULL;
+
+// Función que crea la memoria compartida de la marca de confirmación
+// Devuelve 0 o -1 en caso de error (en ese caso no se publica la marca)
+int inicializarMarcaConfirmacion(const char *nombre) {
+    // Cambiamos el umask para que se asignen correctamente los permisos de grupo
+    mode_t old_umask = umask(0);
+    int descriptor = shm_open(nombre, O_CREAT | O_RDWR, 0660);
+    umask(old_umask);
+    if (descriptor == -1) {
+        escribirEnLog(LOG_ERROR, "confirmacion_consolidado", "Error al crear la marca de confirmación %s\n", nombre);
+        return -1;
+    }
+    if (ftruncate(descriptor, sizeof(MarcaConfirmacion)) == -1) {
+        escribirEnLog(LOG_ERROR, "confirmacion_consolidado", "Error al establecer el tamaño de la marca de confirmación %s\n", nombre);
+        close(descriptor);
+        return -1;
+    }
+    void *direccion = mmap(0, sizeof(MarcaConfirmacion), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    close(descriptor);
+    if (direccion == MAP_FAILED) {
+        escribirEnLog(LOG_ERROR, "confirmacion_consolidado", "Error al mapear la marca de confirmación %s\n", nombre);
+        return -1;
+    }
+    marca = (MarcaConfirmacion *)direccion;
+    nombre_marca = nombre;
+    // Si la marca queda de una ejecución anterior, el contador de secuencia tiene que seguir siendo par
+    if (__atomic_load_n(&marca->secuencia, __ATOMIC_RELAXED) % 2 == 1) {
+        __atomic_store_n(&marca->secuencia, marca->secuencia + 1, __ATOMIC_RELEASE);
+    }
+    escribirEnLog(LOG_INFO, "confirmacion_consolidado", "Creada marca de confirmación %s\n", nombre);
+    return 0;
+}
+
+// Función que publica hasta dónde están completos los datos consolidados
+void publicarMarcaConfirmacion(const PosicionesConsolidado *posiciones) {
+    if (marca == NULL) {
+        return;
+    }
+    uint64_t secuencia = __atomic_load_n(&marca->secuencia, __ATOMIC_RELAXED);
+    __atomic_store_n(&marca->secuencia, secuencia + 1, __ATOMIC_RELAXED);
+    // Los campos no se pueden escribir antes de que el contador sea impar
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&marca->bytes_fichero, posiciones->fichero, __ATOMIC_RELAXED);
+    __atomic_store_n(&marca->bytes_memoria, posiciones->memoria, __ATOMIC_RELAXED);
+    __atomic_store_n(&marca->bytes_columnar, posiciones->columnar, __ATOMIC_RELAXED);
+    __atomic_store_n(&marca->publicaciones, marca->publicaciones + 1, __ATOMIC_RELAXED);
+    // El contador par se publica después de los campos (y de los datos consolidados que confirman)
+    __atomic_store_n(&marca->secuencia, secuencia + 2, __ATOMIC_RELEASE);
+    escribirEnLog(LOG_DEBUG, "confirmacion_consolidado", "Marca de confirmación: fichero %lld memoria %lld columnar %lld\n",
+        posiciones->fichero, posiciones->memoria, posiciones->columnar);
+}
+
+// Función que libera y borra la memoria compartida de la marca de confirmación
+void eliminarMarcaConfirmacion() {
+    if (marca == NULL) {
+        return;
+    }
+    munmap(marca, sizeof(MarcaConfirmacion));
+    marca = NULL;
+    if (shm_unlink(nombre_marca) == -1) {
+        escribirEnLog(LOG_ERROR, "confirmacion_consolidado", "Error al eliminar la marca de confirmación %s\n", nombre_marca);
+    } else {
+        escribirEnLog(LOG_INFO, "confirmacion_consolidado", "Eliminada marca de confirmación %s\n", nombre_marca);
+    }
+}
+
+// Función que comprueba si los datos consolidados que terminaban en 'anteriores' son el principio de los actuales:
+// cada destino es el mismo fichero (dispositivo e inodo) y no es más corto que entonces
+// Devuelve 1 si lo son o 0 si el consolidado se ha sustituido o recortado
+int mismosDatosConsolidados(const PosicionesConsolidado *anteriores, const PosicionesConsolidado *actuales) {
+    const IdentidadConsolidado *identidades[3][2] = {
+        {&anteriores->identidad_fichero, &actuales->identidad_fichero},
+        {&anteriores->identidad_memoria, &actuales->identidad_memoria},
+        {&anteriores->identidad_columnar, &actuales->identidad_columnar}
+    };
+    for (int i = 0; i < 3; i++) {
+        if (identidades[i][0]->dispositivo != identidades[i][1]->dispositivo || identidades[i][0]->inodo != identidades[i][1]->inodo) {
+            return 0;
+        }
+    }
+    return anteriores->fichero <= actuales->fichero && anteriores->memoria <= actuales->memoria && anteriores->columnar <= actuales->columnar;
+}
+
+#pragma endregion ConfirmacionConsolidado
@@ -0,0 +1,41 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <unistd.h>         // Gestión de procesos, acceso a archivos, pipe, control de señales
+#include <sys/stat.h>       // Definiciones y estructuras para trabajar con estados de archivos Linux
+#include <fcntl.h>          // Proporciona funciones y constantes para controlar archivos y descriptores de archivo en Linux
+#include <sys/mman.h>       // Memoria compartida
+
+#include "marca_confirmacion.h" // Formato de la marca de confirmación compartida con Monitor
+#pragma endregion Librerias
+
+
+// Identidad (dispositivo e inodo) de uno de los destinos de los datos consolidados (0 y 0 si no se utiliza)
+typedef struct IDENTIDAD_CONSOLIDADO {
+    unsigned long long dispositivo;
+    unsigned long long inodo;
+} IdentidadConsolidado;
+
+// Bytes que ocupan los datos consolidados en cada uno de sus destinos
+typedef struct POSICIONES_CONSOLIDADO {
+    long long fichero;      // Fichero consolidado
+    long long memoria;      // Memoria compartida
+    long long columnar;     // Almacén columnar
+    IdentidadConsolidado identidad_fichero;
+    IdentidadConsolidado identidad_memoria;
+    IdentidadConsolidado identidad_columnar;
+} PosicionesConsolidado;
+
+int inicializarMarcaConfirmacion(const char *nombre);
+
+void publicarMarcaConfirmacion(const PosicionesConsolidado *posiciones);
+
+void eliminarMarcaConfirmacion();
+
+int mismosDatosConsolidados(const PosicionesConsolidado *anteriores, const PosicionesConsolidado *actuales);
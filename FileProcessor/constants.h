@@ -3,4 +3,11 @@
 #pragma once
 
 // Nombre del fichero de configuración
-#define FICHERO_CONFIGURACION "conf/fp.conf"
\ No newline at end of file
+#define FICHERO_CONFIGURACION "conf/fp.conf"
+
+// Segmentos del consolidado particionados por fecha
+#define FICHERO_MANIFIESTO_SEGMENTOS "manifiesto.csv"
+#define MAX_NOMBRE_SEGMENTO 64
+
+// Máximo de hilos de observación (valor máximo de NUM_PROCESOS)
+#define MAX_HILOS_OBSERVACION 999
@@ -0,0 +1,63 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdint.h>         // Enteros de tamaño fijo para el formato en disco
+#pragma endregion Librerias
+
+/*
+    Formato del almacén columnar del consolidado (COLUMNAR_STORE=1)
+    Este fichero tiene que ser igual en FileProcessor y Monitor
+
+    El fichero empieza con MAGIA_ALMACEN_COLUMNAR y después tiene grupos de filas. FileProcessor sólo
+    añade grupos al final. Cada grupo tiene una CabeceraGrupoFilas seguida de sus columnas, en el orden
+    de ColumnaAlmacen y una detrás de otra. La cabecera indica los bytes de cada columna, así que un
+    lector puede saltar las columnas que no necesita.
+
+    Codificación de las columnas de un grupo de n filas (enteros en el orden de bytes de la máquina):
+        - diccionario (sucursal, usuario, tipo de operación, estado):
+              uint32 entradas, uint8 bytes por identificador (1 o 2),
+              entradas x (uint8 longitud + texto), n identificadores
+        - texto (número de operación): n x (uint8 longitud + texto)
+        - fecha de inicio: n x int64, la primera en segundos desde 01/01/1970 y el resto como
+          diferencia con la fila anterior
+        - fecha de fin: n x int64, diferencia con la fecha de inicio de la misma fila
+        - tipo de operación 2: n x int32
+        - importe: n x int32 en céntimos
+    Las fechas mal formadas se guardan como -1 (las diferencias las reproducen exactamente)
+*/
+
+#define MAGIA_ALMACEN_COLUMNAR "FPCOL01\n"
+#define LONGITUD_MAGIA_ALMACEN_COLUMNAR 8
+#define MAGIA_GRUPO_FILAS 0x50524752u   // "RGRP"
+
+// Columnas del almacén (una por campo del registro consolidado)
+typedef enum COLUMNA_ALMACEN {
+    COLUMNA_SUCURSAL,
+    COLUMNA_OPERACION,
+    COLUMNA_FECHA_INICIO,
+    COLUMNA_FECHA_FIN,
+    COLUMNA_USUARIO,
+    COLUMNA_TIPO_OPERACION1,
+    COLUMNA_TIPO_OPERACION2,
+    COLUMNA_IMPORTE,
+    COLUMNA_ESTADO,
+    NUM_COLUMNAS_ALMACEN
+} ColumnaAlmacen;
+
+// Máscara de columnas que necesita un lector
+#define MASCARA_COLUMNA(columna) (1u << (columna))
+#define COLUMNAS_TODAS ((1u << NUM_COLUMNAS_ALMACEN) - 1)
+
+// Cabecera de un grupo de filas con las estadísticas mínimo/máximo
+typedef struct CABECERA_GRUPO_FILAS {
+    uint32_t magia;
+    uint32_t num_filas;
+    uint32_t bytes_columnas[NUM_COLUMNAS_ALMACEN];
+    int32_t importe_minimo;         // Céntimos
+    int32_t importe_maximo;
+    int64_t instante_minimo;        // Fecha de inicio en segundos desde 01/01/1970 (sin contar las fechas mal formadas)
+    int64_t instante_maximo;
+} CabeceraGrupoFilas;
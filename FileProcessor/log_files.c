@@ -2,9 +2,13 @@
 // LIBRERIA DE FUNCIONES PARA ESCRITURA EN LOS FICHEROS DE LOG
 // ------------------------------------------------------------------
 
+// nanosleep no se declara con -std=c99
+#define _DEFAULT_SOURCE
+
 #include "log_files.h"
 #include "utilidades.h"
-#include "config_files.h"
+#include "parametros_configuracion.h"
+#include "perfil_bloqueos.h"
 
 #pragma region FicherosLog
 /*
@@ -18,167 +22,841 @@
             LOG_INFO: mensajes informativos acerca del funcionamiento de la aplicación, se escribe en LOG_FILE_APP
             LOG_WARNING: mensajes de advertencia (de momento no los he utilizado), se escribe en LOG_FILE_APP
             LOG_ERROR: mensajes de error que indican que algo ha funcionado incorrectamente, se escribe en LOG_FILE_APP
+
+    Escritura asíncrona (LOG_ASYNC=1):
+        escribirEnLog sólo formatea el mensaje y lo deja en un anillo propio del hilo que llama (un productor y
+        un consumidor, sin mutex). Un hilo escritor vacía los anillos en orden de llegada, mantiene abiertos los
+        dos ficheros de log y escribe por lotes.
+        Si el anillo de un hilo está lleno, con LOG_ASYNC_FULL_POLICY=DESCARTAR el mensaje se descarta (el
+        escritor deja en el log cuántos se han descartado) y con BLOQUEAR el hilo espera a que haya sitio.
+        Al terminar el proceso (exit) se escriben los mensajes pendientes y se cierran los ficheros.
+        Si el anillo del hilo está en uso (mensaje escrito desde un manejador de señal que ha interrumpido
+        otro mensaje del mismo hilo) o ya no quedan anillos libres, el mensaje se escribe de forma síncrona.
+
+    Log binario (LOG_FORMAT=BINARIO, sólo con escritura asíncrona):
+        En lugar de LOG_FILE_APP se escribe LOG_FILE_BIN con el formato de formato_log_binario.h. Cada pareja
+        formato/módulo literal recibe un identificador la primera vez que se usa, y los mensajes sólo guardan
+        el identificador, el instante y los argumentos sin formatear. La herramienta LogDecode lo convierte en
+        el texto de LOG_FILE_APP. Los mensajes LOG_GENERAL se siguen escribiendo en texto en LOG_FILE y por
+        pantalla, y los que se escriben de forma síncrona van en texto a LOG_FILE_APP.
+
+    Rotación (LOG_ROTATE_*): el log de la aplicación (LOG_FILE_APP o LOG_FILE_BIN) se rota por tamaño o por
+    tiempo, ver rotacion_log.c. Con log binario cada fichero empieza una sesión y se decodifica por separado.
+
+    Los nombres de los ficheros, la escritura asíncrona y el formato se toman una vez, con el primer mensaje, de
+    los parámetros de la lectura inicial (ver parametros_configuracion.c). Los mensajes que escribe la propia
+    lectura inicial (errores del fichero de configuración) se guardan y se escriben justo después.
 */
 
 //Mutex para seguridad de los hilos, garantiza que dos hilos no podrán escribir a la vez en el fichero de log
 pthread_mutex_t mutex_escritura_log = PTHREAD_MUTEX_INITIALIZER;
+// Perfil de contención del mutex (LOCK_PROFILING=1), el sitio es el módulo del mensaje
+static BloqueoPerfilado perfil_mutex_escritura_log = BLOQUEO_PERFILADO("mutex_escritura_log");
 
+// Mensaje pendiente de escribir
+typedef struct ENTRADA_LOG {
+    unsigned long long secuencia;   // Orden de llegada entre todos los hilos
+    long long instante_ns;          // Nanosegundos desde 01/01/1970
+    NivelLog nivel;
+    int id_formato;                 // Formato del log binario, o -1 si el mensaje ya está formateado
+    int longitud;                   // Bytes de argumentos en "mensaje" (log binario)
+    char modulo[64];                // Sólo en los mensajes ya formateados
+    char mensaje[255];              // Texto del mensaje o argumentos sin formatear (log binario)
+} EntradaLog;
 
-/*
-    Función de escritura en fichero de log segura para hilos
-        NivelLog es el nivel de log para ese mensaje
-        Módulo es una cadena que describe la parte del programa que ha generado el mensaje de log; ejemplo: hilopatronfraude
-        Formato es cadena de formato C que aplicaremos para formatear los parametros del mensaje
-    ... Número variable de parametro que compondrán el mensaje de log; ejemplo: numHilo, numRegistrosProcesados, etc
-    
-    Ejemplo de como llamar a la función: 
-        escribirEnLog(LOG_INFO, "hilo_patron_fraude_2", "Hilo %02d: Registro que cumple el patrón Clave: %s, Registros a la vez: %d\n", id_hilo, registro->clave, registro->cantidad);
-*/
-void escribirEnLog(NivelLog nivelLog, const char *modulo, const char *formato, ...) {
+// Formato registrado para el log binario
+typedef struct FORMATO_LOG {
+    const char *formato;            // Literales de la llamada a escribirEnLog
+    const char *modulo;
+    int id;
+    int num_conversiones;           // -1 si el formato no se puede codificar en binario
+    ConversionFormatoLog conversiones[MAX_CONVERSIONES_FORMATO_LOG];
+} FormatoLog;
 
-    // Primero comparar el nivel de log del mensaje con el nivel de log solicitado 
-    // en el fichero de configuración para escribir en el log únicamente si es necesario
+// Anillo de mensajes de un hilo: sólo escribe el hilo propietario y sólo lee el hilo escritor
+typedef struct ANILLO_LOG {
+    EntradaLog *entradas;
+    unsigned long capacidad;        // Potencia de 2
+    unsigned long cabeza;           // Siguiente posición que lee el escritor
+    unsigned long cola;             // Siguiente posición que escribe el propietario
+    unsigned long descartados;      // Mensajes descartados por anillo lleno
+    int ocupado;                    // El propietario está escribiendo un mensaje
+} AnilloLog;
 
-    // Obtener el nivel de log solicitado en el fichero de configuración
-    const char *log_level_configuracion;
-    log_level_configuracion = obtener_valor_configuracion("LOG_LEVEL", "LOG_INFO");
-    // Calculo el nivel_log_solicitado (según typedef) a partir de la cadena log_level_configuracion
-    NivelLog nivel_log_solicitado;
-    if (strcmp(log_level_configuracion, "DEBUG") == 0) {
-        nivel_log_solicitado = LOG_DEBUG;
-    } else if (strcmp(log_level_configuracion, "GENERAL") == 0) {
-        nivel_log_solicitado = LOG_GENERAL;
-    } else if (strcmp(log_level_configuracion, "INFO") == 0) {
-        nivel_log_solicitado = LOG_INFO;
-    } else if (strcmp(log_level_configuracion, "WARNING") == 0) {
-        nivel_log_solicitado = LOG_WARNING;
-    } else if (strcmp(log_level_configuracion, "ERROR") == 0) {
-        nivel_log_solicitado = LOG_ERROR;
-    } else {
-        // En caso de error ponemos LOG_DEBUG
-        nivel_log_solicitado = LOG_DEBUG;
-    }
-        
-    // Ver si es necesario escribir en el log, en función del niveLog y log_level
-
-    // En principio no es necesario escribir en el log
-    int escribirLog = 0;
-    //Ahora vemos si hay que escribir
-    if (nivel_log_solicitado == LOG_DEBUG) {
-        // Si en el fichero de configuracion LOG_DEBUG, registramos todos los mensajes
-        escribirLog = 1;
-    } else if (nivelLog == LOG_GENERAL) {
-        // Los mensajes de nivel de depuración LOG_GENERAL siempre se escriben
-        escribirLog = 1;
-    } else if (nivel_log_solicitado == LOG_INFO && (nivelLog == LOG_INFO || nivelLog == LOG_WARNING || nivelLog == LOG_ERROR)) {
-        // Si en el fichero de configuracion LOG_INFO, registramos LOG_INFO, LOG_WARNING, LOG_ERROR
-        escribirLog = 1;
-    } else if (nivel_log_solicitado == LOG_WARNING && (nivelLog == LOG_WARNING || nivelLog == LOG_ERROR)) {
-        // Si en el fichero de configuracion LOG_WARNING, registramos , LOG_WARNING, LOG_ERROR
-        escribirLog = 1;
-    } else if (nivel_log_solicitado == LOG_ERROR && nivelLog == LOG_ERROR) {
-        // Si en el fichero de configuracion LOG_ERROR, registramos LOG_ERROR
-        escribirLog = 1;
+#define MAX_ANILLOS_LOG 64
+#define MAX_FORMATOS_LOG 4096
+#define TAMANO_TABLA_FORMATOS_LOG 8192     // Potencia de 2, el doble de MAX_FORMATOS_LOG
+
+// Ficheros de log (LOG_FILE, LOG_FILE_APP, LOG_FILE_BIN), se asignan en inicializarLog
+static const char *fichero_log_general = ARCHIVO_LOG;
+static const char *fichero_log_aplicacion = ARCHIVO_LOG_APP;
+static const char *fichero_log_binario = ARCHIVO_LOG_BIN;
+
+// Mensajes escritos durante la lectura inicial de la configuración (sólo los escribe el hilo que la hace)
+#define MAX_MENSAJES_PENDIENTES_LOG 64
+static EntradaLog mensajes_pendientes_log[MAX_MENSAJES_PENDIENTES_LOG];
+static int num_mensajes_pendientes_log = 0;     // Se lee y escribe con __atomic
+
+// Estado de la escritura asíncrona
+static pthread_once_t inicializacion_log = PTHREAD_ONCE_INIT;
+static int log_asincrono = 0;               // Se lee y escribe con __atomic
+static int bloquear_lleno = 0;
+static unsigned long capacidad_anillos = 1024;
+static unsigned long long secuencia_log = 0;
+static AnilloLog *anillos_log[MAX_ANILLOS_LOG];
+static int num_anillos_log = 0;
+static pthread_mutex_t mutex_anillos_log = PTHREAD_MUTEX_INITIALIZER;
+static __thread AnilloLog *anillo_hilo = NULL;
+static __thread int anillo_hilo_imposible = 0;
+
+// Log binario
+static int log_binario = 0;
+// Tabla hash (por los punteros del formato y el módulo) que se consulta sin mutex; las posiciones
+// se publican con __atomic una vez rellenas
+static FormatoLog *tabla_formatos_log[TAMANO_TABLA_FORMATOS_LOG];
+static FormatoLog *formatos_log[MAX_FORMATOS_LOG];      // Por identificador
+static int num_formatos_log = 0;
+static pthread_mutex_t mutex_formatos_log = PTHREAD_MUTEX_INITIALIZER;
+static unsigned char formatos_definidos[MAX_FORMATOS_LOG];  // Sólo hilo escritor
+
+// Rotación del log de la aplicación (ver rotacion_log.c): la hace el hilo escritor, o el hilo que escribe
+// con escritura síncrona (sólo cuando el escritor no tiene abierto LOG_FILE_APP)
+static RotacionLog rotacion_escritor;
+static RotacionLog rotacion_sincrona;
+static int rotacion_sincrona_configurada = 0;
+
+// Hilo escritor
+static pthread_t hilo_escritor_log;
+static int terminar_escritor = 0;
+static int escritor_dormido = 0;
+static pthread_mutex_t mutex_escritor_log = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t condicion_escritor_log = PTHREAD_COND_INITIALIZER;
+static unsigned long descartados_informados = 0;
+
+// Función que escribe un mensaje en los ficheros de log de texto ya abiertos
+// Formato fichero log aplicación: FECHA HORA - [NIVEL] - MODULO: MENSAJE
+static void escribirEntradaTexto(FILE *archivo_log_aplicacion, const EntradaLog *entrada) {
+    const FechaHoraFormateada *fechaHora = obtenerFechaHoraFormateada((time_t)(entrada->instante_ns / 1000000000LL));
+    fprintf(archivo_log_aplicacion, "%s - [%s] - %s: %s", fechaHora->fecha_hora, nombreNivelLog(entrada->nivel), entrada->modulo, entrada->mensaje);
+}
+
+// Función que escribe un registro del log binario
+static void escribirRegistroBinario(FILE *archivo_log_binario, TipoRegistroLog tipo, int id_formato, int nivel, long long instante_ns,
+        const char *modulo, const void *datos, size_t longitud_datos) {
+    size_t longitud_modulo = modulo != NULL ? strlen(modulo) : 0;
+    CabeceraRegistroLog cabecera;
+    cabecera.instante_ns = instante_ns;
+    cabecera.tipo = (uint16_t)tipo;
+    cabecera.id_formato = (uint16_t)id_formato;
+    cabecera.nivel = (uint16_t)nivel;
+    cabecera.longitud = (uint16_t)((modulo != NULL ? sizeof(uint16_t) + longitud_modulo : 0) + longitud_datos);
+    fwrite(&cabecera, sizeof(cabecera), 1, archivo_log_binario);
+    if (modulo != NULL) {
+        uint16_t longitud = (uint16_t)longitud_modulo;
+        fwrite(&longitud, sizeof(longitud), 1, archivo_log_binario);
+        fwrite(modulo, 1, longitud_modulo, archivo_log_binario);
     }
-    
-    // Si no hay que escribir en el log, retornamos sin escribir en log
-    if (escribirLog == 0) {
+    fwrite(datos, 1, longitud_datos, archivo_log_binario);
+}
+
+// Función que escribe un mensaje en el log binario ya abierto (con la definición de su formato si es el primero)
+static void escribirEntradaBinaria(FILE *archivo_log_binario, const EntradaLog *entrada) {
+    if (entrada->id_formato < 0) {
+        escribirRegistroBinario(archivo_log_binario, REGISTRO_LOG_TEXTO, 0, entrada->nivel, entrada->instante_ns,
+            entrada->modulo, entrada->mensaje, strlen(entrada->mensaje));
         return;
-    }    
+    }
+    if (!formatos_definidos[entrada->id_formato]) {
+        const FormatoLog *formato = formatos_log[entrada->id_formato];
+        escribirRegistroBinario(archivo_log_binario, REGISTRO_LOG_DEFINICION, formato->id, 0, entrada->instante_ns,
+            formato->modulo, formato->formato, strlen(formato->formato));
+        formatos_definidos[entrada->id_formato] = 1;
+    }
+    escribirRegistroBinario(archivo_log_binario, REGISTRO_LOG_MENSAJE, entrada->id_formato, entrada->nivel, entrada->instante_ns,
+        NULL, entrada->mensaje, entrada->longitud);
+}
 
-    //Si el programa llega hasta aquí es que hay que escribir
-    // Bloquear el mutex
-    pthread_mutex_lock(&mutex_escritura_log);
+// Función que escribe un mensaje en los ficheros de log ya abiertos
+// Formato fichero log general (sólo LOG_GENERAL, también por pantalla): FECHA:::HORA:::MENSAJE
+static void escribirEntradaLog(FILE *archivo_log_aplicacion, FILE *archivo_log_general, const EntradaLog *entrada, int binario) {
+    if (binario) {
+        escribirEntradaBinaria(archivo_log_aplicacion, entrada);
+    } else {
+        escribirEntradaTexto(archivo_log_aplicacion, entrada);
+    }
 
-    // Obtener el nombre del archivo de log de aplicacion del fichero de configuración
-    const char *fichero_log_aplicacion;
-    fichero_log_aplicacion = obtener_valor_configuracion("LOG_FILE_APP", ARCHIVO_LOG_APP);
-    FILE *archivo_log_aplicacion = fopen(fichero_log_aplicacion, "a");
-    //Si hay un error, liberar el mutex para que no se quede estancado el programa
-    if (archivo_log_aplicacion == NULL) {
+    if (entrada->nivel == LOG_GENERAL) {
+        const FechaHoraFormateada *fechaHora = obtenerFechaHoraFormateada((time_t)(entrada->instante_ns / 1000000000LL));
+        fprintf(archivo_log_general, "%s:::%s", fechaHora->fecha_hora2, entrada->mensaje);
+        printf("%s:::%s", fechaHora->fecha_hora2, entrada->mensaje);
+    }
+}
+
+// Función que empieza una sesión en el log binario (con la cabecera del fichero si está vacío)
+// Los formatos se vuelven a definir dentro de la sesión
+static void iniciarSesionLogBinario(FILE *archivo_log_binario) {
+    fseek(archivo_log_binario, 0, SEEK_END);
+    if (ftell(archivo_log_binario) == 0) {
+        fwrite(MAGIA_LOG_BINARIO, 1, LONGITUD_MAGIA_LOG_BINARIO, archivo_log_binario);
+    }
+    struct timespec ahora;
+    clock_gettime(CLOCK_REALTIME, &ahora);
+    escribirRegistroBinario(archivo_log_binario, REGISTRO_LOG_SESION, 0, 0, ahora.tv_sec * 1000000000LL + ahora.tv_nsec, NULL, NULL, 0);
+    memset(formatos_definidos, 0, sizeof(formatos_definidos));
+}
+
+// Función que abre los dos ficheros de log en modo añadir
+// Con binario abre LOG_FILE_BIN en lugar de LOG_FILE_APP y empieza una sesión nueva
+// Devuelve 0 o -1 si no se ha podido abrir alguno (no queda ninguno abierto)
+static int abrirFicherosLog(FILE **archivo_log_aplicacion, FILE **archivo_log_general, int binario) {
+    if (binario) {
+        *archivo_log_aplicacion = fopen(fichero_log_binario, "ab");
+    } else {
+        *archivo_log_aplicacion = fopen(fichero_log_aplicacion, "a");
+    }
+    if (*archivo_log_aplicacion == NULL) {
         fprintf(stderr, "Error al abrir el archivo de log de aplicacion\n");
-        pthread_mutex_unlock(&mutex_escritura_log);
+        return -1;
+    }
+    *archivo_log_general = fopen(fichero_log_general, "a");
+    if (*archivo_log_general == NULL) {
+        fprintf(stderr, "Error al abrir el archivo de log general\n");
+        fclose(*archivo_log_aplicacion);
+        return -1;
+    }
+    if (binario) {
+        iniciarSesionLogBinario(*archivo_log_aplicacion);
+    }
+    return 0;
+}
+
+// Función que libera al terminar el espacio reservado del log de la aplicación y del siguiente fichero
+// preparado (escritura síncrona). Si otro hilo está escribiendo en el log no se hace nada
+static void finalizarRotacionSincrona() {
+    if (pthread_mutex_trylock(&mutex_escritura_log) != 0) {
         return;
     }
+    FILE *archivo = fopen(rotacion_sincrona.nombre, "a");
+    if (archivo != NULL) {
+        fseek(archivo, 0, SEEK_END);
+        cerrarFicheroLog(archivo);
+    }
+    finalizarRotacionLog(&rotacion_sincrona);
+    pthread_mutex_unlock(&mutex_escritura_log);
+}
 
-    // Obtener el nombre del archivo de log general del fichero de configuración
-    const char *fichero_log_general;
-    fichero_log_general = obtener_valor_configuracion("LOG_FILE", ARCHIVO_LOG);
-    FILE *archivo_log_general = fopen(fichero_log_general, "a");
+// Función que escribe un mensaje abriendo y cerrando los ficheros de log (escritura síncrona)
+static void escribirEntradaSincrona(const EntradaLog *entrada) {
+    // Bloquear el mutex
+    bloquearMutexPerfilado(&perfil_mutex_escritura_log, &mutex_escritura_log, entrada->modulo);
+    FILE *archivo_log_aplicacion, *archivo_log_general;
     //Si hay un error, liberar el mutex para que no se quede estancado el programa
-    if (archivo_log_general == NULL) {
-        fprintf(stderr, "Error al abrir el archivo de log general\n");
-        pthread_mutex_unlock(&mutex_escritura_log);
-        return;
+    if (abrirFicherosLog(&archivo_log_aplicacion, &archivo_log_general, 0) == 0) {
+        escribirEntradaLog(archivo_log_aplicacion, archivo_log_general, entrada, 0);
+        // Rotar LOG_FILE_APP si el hilo escritor no lo tiene abierto
+        if (!__atomic_load_n(&log_asincrono, __ATOMIC_ACQUIRE) || log_binario) {
+            if (!rotacion_sincrona_configurada) {
+                configurarRotacionLog(&rotacion_sincrona, fichero_log_aplicacion);
+                rotacion_sincrona_configurada = 1;
+                if (rotacionLogActiva(&rotacion_sincrona)) {
+                    prepararSiguienteLog(&rotacion_sincrona);
+                    atexit(finalizarRotacionSincrona);
+                }
+            }
+            // Igual que en el hilo escritor: sin esperar a gzip y con el siguiente fichero ya preparado
+            if (rotacionLogActiva(&rotacion_sincrona) && necesitaRotacionLog(&rotacion_sincrona, archivo_log_aplicacion)) {
+                archivo_log_aplicacion = rotarLog(&rotacion_sincrona, archivo_log_aplicacion, "a");
+                if (archivo_log_aplicacion != NULL) {
+                    empezarFicheroLog(&rotacion_sincrona, archivo_log_aplicacion);
+                }
+                prepararSiguienteLog(&rotacion_sincrona);
+            }
+        }
+        // Cerrar los 2 ficheros log
+        fclose(archivo_log_general);
+        if (archivo_log_aplicacion != NULL) {
+            fclose(archivo_log_aplicacion);
+        }
     }
+    // Desbloquear el mutex
+    desbloquearMutexPerfilado(&perfil_mutex_escritura_log, &mutex_escritura_log);
+}
 
-    // Obtener fecha y hora actual
-    char fechaHora[20];
-    obtenerFechaHora(fechaHora);
-    char fechaHora2[20];
-    obtenerFechaHora2(fechaHora2);
+// Función que devuelve el anillo del hilo que llama, creándolo la primera vez (NULL si no quedan anillos)
+static AnilloLog *obtenerAnilloHilo() {
+    if (anillo_hilo != NULL || anillo_hilo_imposible) {
+        return anillo_hilo;
+    }
+    pthread_mutex_lock(&mutex_anillos_log);
+    if (num_anillos_log < MAX_ANILLOS_LOG) {
+        AnilloLog *anillo = calloc(1, sizeof(AnilloLog));
+        anillo->capacidad = capacidad_anillos;
+        anillo->entradas = calloc(capacidad_anillos, sizeof(EntradaLog));
+        anillos_log[num_anillos_log] = anillo;
+        __atomic_store_n(&num_anillos_log, num_anillos_log + 1, __ATOMIC_RELEASE);
+        anillo_hilo = anillo;
+    } else {
+        anillo_hilo_imposible = 1;
+    }
+    pthread_mutex_unlock(&mutex_anillos_log);
+    return anillo_hilo;
+}
 
-    // Obtener cadena de nivel de depuración de manera más estética
-    const char *cadenaDepuracion;
-    switch (nivelLog) {
-        case LOG_DEBUG:
-            cadenaDepuracion = "DEBUG   ";
-            break;
-        case LOG_INFO:
-            cadenaDepuracion = "INFO    ";
-            break;
-        case LOG_WARNING:
-            cadenaDepuracion = "WARNING ";
-            break;
-        case LOG_ERROR:
-            cadenaDepuracion = "ERROR   ";
+// Función que despierta al hilo escritor si está esperando mensajes
+static void despertarEscritorLog() {
+    if (__atomic_load_n(&escritor_dormido, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_lock(&mutex_escritor_log);
+        pthread_cond_signal(&condicion_escritor_log);
+        pthread_mutex_unlock(&mutex_escritor_log);
+    }
+}
+
+// Función que reserva la siguiente posición del anillo del hilo
+// Devuelve 0 y la entrada reservada (que hay que publicar con publicarEntradaLog), 1 si el mensaje se ha
+// descartado por anillo lleno o -1 si hay que escribirlo de forma síncrona
+static int reservarEntradaLog(AnilloLog **anillo_reservado, EntradaLog **entrada) {
+    AnilloLog *anillo = obtenerAnilloHilo();
+    if (anillo == NULL || anillo->ocupado) {
+        return -1;
+    }
+    anillo->ocupado = 1;
+    unsigned long cola = anillo->cola;
+    while (cola - __atomic_load_n(&anillo->cabeza, __ATOMIC_ACQUIRE) >= anillo->capacidad) {
+        // Anillo lleno
+        if (!bloquear_lleno || !__atomic_load_n(&log_asincrono, __ATOMIC_ACQUIRE)) {
+            __atomic_add_fetch(&anillo->descartados, 1, __ATOMIC_RELAXED);
+            anillo->ocupado = 0;
+            return 1;
+        }
+        despertarEscritorLog();
+        struct timespec espera = {0, 100000};
+        nanosleep(&espera, NULL);
+    }
+    *anillo_reservado = anillo;
+    *entrada = &anillo->entradas[cola & (anillo->capacidad - 1)];
+    (*entrada)->secuencia = __atomic_fetch_add(&secuencia_log, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+// Función que deja visible para el escritor la entrada reservada con reservarEntradaLog
+static void publicarEntradaLog(AnilloLog *anillo) {
+    __atomic_store_n(&anillo->cola, anillo->cola + 1, __ATOMIC_RELEASE);
+    anillo->ocupado = 0;
+    despertarEscritorLog();
+}
+
+// Función que devuelve el formato registrado para una pareja de literales formato/módulo, registrándolo la
+// primera vez. Devuelve NULL si ya no caben más formatos
+static FormatoLog *obtenerFormatoLog(const char *formato, const char *modulo) {
+    uintptr_t clave = (uintptr_t)formato ^ ((uintptr_t)modulo * 31);
+    unsigned long posicion = (unsigned long)((clave >> 3) * 2654435761u) & (TAMANO_TABLA_FORMATOS_LOG - 1);
+    while (1) {
+        FormatoLog *registrado = __atomic_load_n(&tabla_formatos_log[posicion], __ATOMIC_ACQUIRE);
+        if (registrado == NULL) {
             break;
-        case LOG_GENERAL:
-            cadenaDepuracion = "GENERAL ";
+        }
+        if (registrado->formato == formato && registrado->modulo == modulo) {
+            return registrado;
+        }
+        posicion = (posicion + 1) & (TAMANO_TABLA_FORMATOS_LOG - 1);
+    }
+
+    // Registrar el formato (otro hilo puede haberlo registrado o haber ocupado la posición)
+    pthread_mutex_lock(&mutex_formatos_log);
+    FormatoLog *registrado;
+    while ((registrado = tabla_formatos_log[posicion]) != NULL) {
+        if (registrado->formato == formato && registrado->modulo == modulo) {
+            pthread_mutex_unlock(&mutex_formatos_log);
+            return registrado;
+        }
+        posicion = (posicion + 1) & (TAMANO_TABLA_FORMATOS_LOG - 1);
+    }
+    if (num_formatos_log == MAX_FORMATOS_LOG) {
+        pthread_mutex_unlock(&mutex_formatos_log);
+        return NULL;
+    }
+    FormatoLog *nuevo = malloc(sizeof(FormatoLog));
+    nuevo->formato = formato;
+    nuevo->modulo = modulo;
+    nuevo->id = num_formatos_log;
+    nuevo->num_conversiones = analizarFormatoLog(formato, nuevo->conversiones, MAX_CONVERSIONES_FORMATO_LOG);
+    formatos_log[num_formatos_log++] = nuevo;
+    __atomic_store_n(&tabla_formatos_log[posicion], nuevo, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&mutex_formatos_log);
+    return nuevo;
+}
+
+// Función que copia los argumentos del mensaje sin formatear en la entrada (log binario)
+// Devuelve 0 o -1 si el formato no se puede codificar o los argumentos no caben en la entrada
+static int codificarArgumentosLog(EntradaLog *entrada, const char *modulo, const char *formato, va_list args) {
+    FormatoLog *registrado = obtenerFormatoLog(formato, modulo);
+    if (registrado == NULL || registrado->num_conversiones < 0) {
+        return -1;
+    }
+    char *destino = entrada->mensaje;
+    char *fin = entrada->mensaje + sizeof(entrada->mensaje);
+    for (int i = 0; i < registrado->num_conversiones; i++) {
+        const ConversionFormatoLog *conversion = &registrado->conversiones[i];
+        if (conversion->tipo == ARGUMENTO_LOG_NINGUNO) {
+            continue;
+        }
+        // Anchura y precisión con '*' (la precisión es la última)
+        int precision = conversion->precision;
+        for (int j = 0; j < conversion->asteriscos; j++) {
+            int32_t valor = va_arg(args, int);
+            if (fin - destino < (long)sizeof(valor)) {
+                return -1;
+            }
+            memcpy(destino, &valor, sizeof(valor));
+            destino += sizeof(valor);
+            precision = valor;
+        }
+        switch (conversion->tipo) {
+            case ARGUMENTO_LOG_ENTERO: {
+                int32_t valor = va_arg(args, int);
+                if (fin - destino < (long)sizeof(valor)) {
+                    return -1;
+                }
+                memcpy(destino, &valor, sizeof(valor));
+                destino += sizeof(valor);
+                break;
+            }
+            case ARGUMENTO_LOG_ENTERO_64:
+            case ARGUMENTO_LOG_PUNTERO: {
+                // long, long long, size_t y punteros ocupan 64 bits en las máquinas en las que se ejecuta
+                int64_t valor = conversion->tipo == ARGUMENTO_LOG_PUNTERO ? (int64_t)(intptr_t)va_arg(args, void *) : va_arg(args, long long);
+                if (fin - destino < (long)sizeof(valor)) {
+                    return -1;
+                }
+                memcpy(destino, &valor, sizeof(valor));
+                destino += sizeof(valor);
+                break;
+            }
+            case ARGUMENTO_LOG_REAL: {
+                double valor = va_arg(args, double);
+                if (fin - destino < (long)sizeof(valor)) {
+                    return -1;
+                }
+                memcpy(destino, &valor, sizeof(valor));
+                destino += sizeof(valor);
+                break;
+            }
+            case ARGUMENTO_LOG_CADENA: {
+                const char *valor = va_arg(args, const char *);
+                size_t longitud = 0;
+                if (valor != NULL) {
+                    // Con precisión la cadena puede no terminar en '\0'
+                    while ((precision < 0 || longitud < (size_t)precision) && valor[longitud] != '\0') {
+                        longitud++;
+                        if (longitud > sizeof(entrada->mensaje)) {
+                            return -1;
+                        }
+                    }
+                }
+                uint16_t longitud_codificada = valor != NULL ? (uint16_t)longitud : LONGITUD_CADENA_NULA;
+                if (fin - destino < (long)(sizeof(longitud_codificada) + longitud)) {
+                    return -1;
+                }
+                memcpy(destino, &longitud_codificada, sizeof(longitud_codificada));
+                destino += sizeof(longitud_codificada);
+                memcpy(destino, valor, longitud);
+                destino += longitud;
+                break;
+            }
+        }
+    }
+    entrada->id_formato = registrado->id;
+    entrada->longitud = (int)(destino - entrada->mensaje);
+    return 0;
+}
+
+// Función que escribe todos los mensajes pendientes de los anillos en orden de llegada
+// Devuelve el número de mensajes escritos
+static int vaciarAnillosLog(FILE *archivo_log_aplicacion, FILE *archivo_log_general) {
+    int escritos = 0;
+    int num_anillos = __atomic_load_n(&num_anillos_log, __ATOMIC_ACQUIRE);
+    while (1) {
+        // Mensaje más antiguo entre las cabezas de los anillos
+        AnilloLog *siguiente = NULL;
+        unsigned long long menor = 0;
+        for (int i = 0; i < num_anillos; i++) {
+            AnilloLog *anillo = anillos_log[i];
+            unsigned long cabeza = anillo->cabeza;
+            if (cabeza != __atomic_load_n(&anillo->cola, __ATOMIC_ACQUIRE)) {
+                unsigned long long secuencia = anillo->entradas[cabeza & (anillo->capacidad - 1)].secuencia;
+                if (siguiente == NULL || secuencia < menor) {
+                    siguiente = anillo;
+                    menor = secuencia;
+                }
+            }
+        }
+        if (siguiente == NULL) {
             break;
-        default:
-            cadenaDepuracion = "UNKNOWN ";
+        }
+        escribirEntradaLog(archivo_log_aplicacion, archivo_log_general, &siguiente->entradas[siguiente->cabeza & (siguiente->capacidad - 1)], log_binario);
+        __atomic_store_n(&siguiente->cabeza, siguiente->cabeza + 1, __ATOMIC_RELEASE);
+        escritos++;
+    }
+
+    // Informar de los mensajes descartados desde la última vez
+    unsigned long descartados = 0;
+    for (int i = 0; i < num_anillos; i++) {
+        descartados += __atomic_load_n(&anillos_log[i]->descartados, __ATOMIC_RELAXED);
+    }
+    if (descartados != descartados_informados) {
+        struct timespec ahora;
+        clock_gettime(CLOCK_REALTIME, &ahora);
+        EntradaLog aviso = {0, ahora.tv_sec * 1000000000LL + ahora.tv_nsec, LOG_WARNING, -1, 0, "log_files", ""};
+        snprintf(aviso.mensaje, sizeof(aviso.mensaje), "%lu mensajes de log descartados por anillo lleno (%lu en total)\n",
+            descartados - descartados_informados, descartados);
+        escribirEntradaLog(archivo_log_aplicacion, archivo_log_general, &aviso, log_binario);
+        descartados_informados = descartados;
+    }
+    return escritos;
+}
+
+// Hilo que escribe los mensajes de los anillos en los ficheros de log, que mantiene abiertos
+static void *escritorLog(void *arg) {
+    (void)arg;
+    FILE *archivo_log_aplicacion, *archivo_log_general;
+    if (abrirFicherosLog(&archivo_log_aplicacion, &archivo_log_general, log_binario) != 0) {
+        // Sin ficheros de log se vuelve a la escritura síncrona (que también informará del error)
+        __atomic_store_n(&log_asincrono, 0, __ATOMIC_RELEASE);
+        return NULL;
+    }
+    configurarRotacionLog(&rotacion_escritor, log_binario ? fichero_log_binario : fichero_log_aplicacion);
+    int rotar = rotacionLogActiva(&rotacion_escritor);
+    if (rotar) {
+        empezarFicheroLog(&rotacion_escritor, archivo_log_aplicacion);
+        prepararSiguienteLog(&rotacion_escritor);
+    }
+    while (1) {
+        int terminar = __atomic_load_n(&terminar_escritor, __ATOMIC_ACQUIRE);
+        int escritos = vaciarAnillosLog(archivo_log_aplicacion, archivo_log_general);
+        if (escritos > 0) {
+            fflush(archivo_log_aplicacion);
+            fflush(archivo_log_general);
+        }
+        if (rotar && necesitaRotacionLog(&rotacion_escritor, archivo_log_aplicacion)) {
+            FILE *nuevo = rotarLog(&rotacion_escritor, archivo_log_aplicacion, log_binario ? "ab" : "a");
+            if (nuevo == NULL) {
+                // Sin fichero de log se vuelve a la escritura síncrona (que también informará del error)
+                fprintf(stderr, "Error al abrir el archivo de log de aplicacion tras la rotación\n");
+                __atomic_store_n(&log_asincrono, 0, __ATOMIC_RELEASE);
+                fclose(archivo_log_general);
+                finalizarRotacionLog(&rotacion_escritor);
+                return NULL;
+            }
+            archivo_log_aplicacion = nuevo;
+            if (log_binario) {
+                iniciarSesionLogBinario(archivo_log_aplicacion);
+            }
+            empezarFicheroLog(&rotacion_escritor, archivo_log_aplicacion);
+            prepararSiguienteLog(&rotacion_escritor);
+        }
+        if (escritos > 0) {
+            continue;
+        }
+        if (terminar) {
             break;
+        }
+        // Esperar mensajes nuevos (como mucho 50 ms, por si un aviso llega justo antes de dormir)
+        pthread_mutex_lock(&mutex_escritor_log);
+        __atomic_store_n(&escritor_dormido, 1, __ATOMIC_RELEASE);
+        struct timespec limite;
+        clock_gettime(CLOCK_REALTIME, &limite);
+        limite.tv_nsec += 50000000;
+        if (limite.tv_nsec >= 1000000000) {
+            limite.tv_sec++;
+            limite.tv_nsec -= 1000000000;
+        }
+        if (!__atomic_load_n(&terminar_escritor, __ATOMIC_ACQUIRE)) {
+            pthread_cond_timedwait(&condicion_escritor_log, &mutex_escritor_log, &limite);
+        }
+        __atomic_store_n(&escritor_dormido, 0, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&mutex_escritor_log);
+    }
+    fclose(archivo_log_general);
+    if (rotar) {
+        cerrarFicheroLog(archivo_log_aplicacion);
+        finalizarRotacionLog(&rotacion_escritor);
+    } else {
+        fclose(archivo_log_aplicacion);
     }
+    fflush(stdout);
+    return NULL;
+}
 
-    
-    // Escribir entrada de registro en el log de aplicación LOG_FILE_APP
-    fprintf(archivo_log_aplicacion, "%s - [%s] - %s: ", fechaHora, cadenaDepuracion, modulo);
-    //Todavía no hemos metido salto de línea
+// Función que termina la escritura asíncrona: escribe los mensajes pendientes y cierra los ficheros
+// Se registra con atexit, así que se ejecuta al terminar el proceso con exit
+void finalizarLog() {
+    if (!__atomic_exchange_n(&log_asincrono, 0, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+    // Sin coger mutex_escritor_log: finalizarLog se puede llamar desde un manejador de señal (el escritor
+    // vuelve a mirar terminar_escritor como mucho a los 50 ms aunque no reciba el aviso)
+    __atomic_store_n(&terminar_escritor, 1, __ATOMIC_RELEASE);
+    pthread_cond_signal(&condicion_escritor_log);
+    if (!pthread_equal(pthread_self(), hilo_escritor_log)) {
+        pthread_join(hilo_escritor_log, NULL);
+    }
+}
 
-    // Si hay argumentos adicionales, escribirlos en una variable y en el fichero
-    //Este snippet lo hemos buscado en internet y lo hemos entendido 
-    char mensaje[255] = "";
+// Función que toma los nombres de los ficheros de log y pone en marcha la escritura asíncrona si LOG_ASYNC=1
+// (se ejecuta una vez, con el primer mensaje)
+static void inicializarLog() {
+    const ParametrosConfiguracion *parametros = obtenerParametrosIniciales();
+    fichero_log_general = parametros->fichero_log;
+    fichero_log_aplicacion = parametros->fichero_log_aplicacion;
+    fichero_log_binario = parametros->fichero_log_binario;
+    if (!parametros->log_asincrono) {
+        return;
+    }
+    capacidad_anillos = 16;
+    while ((long)capacidad_anillos < parametros->capacidad_log_asincrono && capacidad_anillos < 65536) {
+        capacidad_anillos *= 2;
+    }
+    bloquear_lleno = strcmp(parametros->politica_log_lleno, "BLOQUEAR") == 0;
+    log_binario = strcmp(parametros->formato_log, "BINARIO") == 0;
+    __atomic_store_n(&log_asincrono, 1, __ATOMIC_RELEASE);
+    // El escritor se crea con todas las señales bloqueadas para que los manejadores (que escriben en el log
+    // y terminan con exit) se ejecuten siempre en otro hilo
+    sigset_t todas, anteriores;
+    sigfillset(&todas);
+    pthread_sigmask(SIG_SETMASK, &todas, &anteriores);
+    int error = pthread_create(&hilo_escritor_log, NULL, escritorLog, NULL);
+    pthread_sigmask(SIG_SETMASK, &anteriores, NULL);
+    if (error != 0) {
+        __atomic_store_n(&log_asincrono, 0, __ATOMIC_RELEASE);
+        fprintf(stderr, "Error al crear el hilo escritor de log, se escribe de forma síncrona\n");
+        return;
+    }
+    atexit(finalizarLog);
+}
+
+// Función que guarda un mensaje escrito durante la lectura inicial de la configuración
+// Si ya no caben más se escribe en stderr
+static void guardarMensajePendienteLog(NivelLog nivelLog, const char *modulo, const char *formato, va_list args) {
+    int num_pendientes = __atomic_load_n(&num_mensajes_pendientes_log, __ATOMIC_RELAXED);
+    if (num_pendientes == MAX_MENSAJES_PENDIENTES_LOG) {
+        if (formato != NULL) {
+            fprintf(stderr, "%s: ", modulo);
+            vfprintf(stderr, formato, args);
+        }
+        return;
+    }
+    EntradaLog *entrada = &mensajes_pendientes_log[num_pendientes];
+    entrada->nivel = nivelLog;
+    entrada->id_formato = -1;
+    snprintf(entrada->modulo, sizeof(entrada->modulo), "%s", modulo);
+    entrada->mensaje[0] = '\0';
     if (formato != NULL) {
-        //va_lists almacenará los parámetros adicionales
+        vsnprintf(entrada->mensaje, sizeof(entrada->mensaje), formato, args);
+    }
+    __atomic_store_n(&num_mensajes_pendientes_log, num_pendientes + 1, __ATOMIC_RELEASE);
+}
+
+// Función que escribe los mensajes guardados durante la lectura inicial de la configuración (sólo uno de los
+// hilos que la llamen a la vez los escribe)
+static void escribirMensajesPendientesLog() {
+    int num_pendientes = __atomic_exchange_n(&num_mensajes_pendientes_log, 0, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < num_pendientes; i++) {
+        const EntradaLog *entrada = &mensajes_pendientes_log[i];
+        if (nivelLogHabilitado(entrada->nivel)) {
+            escribirMensajeLog(entrada->nivel, 0, entrada->modulo, "%s", entrada->mensaje);
+        }
+    }
+}
+
+
+// Nivel de log solicitado en el fichero de configuración (NIVEL_LOG_POR_LEER hasta que se lee)
+int nivel_log_solicitado = NIVEL_LOG_POR_LEER;
+static pthread_mutex_t mutex_nivel_log = PTHREAD_MUTEX_INITIALIZER;
+
+// Función que calcula el nivel de log (según typedef) a partir de la cadena de LOG_LEVEL
+static int nivelLogDeCadena(const char *log_level_configuracion) {
+    if (strcmp(log_level_configuracion, "DEBUG") == 0) {
+        return LOG_DEBUG;
+    } else if (strcmp(log_level_configuracion, "GENERAL") == 0) {
+        return LOG_GENERAL;
+    } else if (strcmp(log_level_configuracion, "INFO") == 0) {
+        return LOG_INFO;
+    } else if (strcmp(log_level_configuracion, "WARNING") == 0) {
+        return LOG_WARNING;
+    } else if (strcmp(log_level_configuracion, "ERROR") == 0) {
+        return LOG_ERROR;
+    }
+    // En caso de error ponemos LOG_DEBUG
+    return LOG_DEBUG;
+}
+
+// Filtro de los mensajes de detalle en vigor (NULL hasta que se lee la configuración)
+static const FiltroLogDetalle *filtro_log_detalle = NULL;
+
+// Función que publica LOG_LEVEL y el filtro de los mensajes de detalle de unos parámetros (con mutex_nivel_log cogido)
+// El filtro anterior se retira igual que los parámetros, y se libera cuando ningún hilo lo puede estar usando
+static void publicarParametrosLog(const ParametrosConfiguracion *parametros) {
+    __atomic_store_n(&nivel_log_solicitado, nivelLogDeCadena(parametros->nivel_log), __ATOMIC_RELAXED);
+    FiltroLogDetalle *filtro = calloc(1, sizeof(FiltroLogDetalle));
+    if (filtro == NULL) {
+        return;
+    }
+    snprintf(filtro->usuario, sizeof(filtro->usuario), "%s", parametros->filtro_log_usuario);
+    snprintf(filtro->sucursal, sizeof(filtro->sucursal), "%s", parametros->filtro_log_sucursal);
+    filtro->muestreo = parametros->muestreo_log;
+    filtro->limite_por_segundo = parametros->limite_log_por_segundo;
+    const FiltroLogDetalle *anterior = __atomic_exchange_n(&filtro_log_detalle, filtro, __ATOMIC_ACQ_REL);
+    if (anterior != NULL) {
+        retirar_configuracion((void *)anterior, free);
+    }
+}
+
+// Función que lee LOG_LEVEL (y el filtro de los mensajes de detalle) de la lectura inicial de la configuración
+// y lo deja en nivel_log_solicitado. Después sólo cambian al recargar (aplicarParametrosLog)
+// Devuelve el nivel en vigor
+int leerNivelLog() {
+    if (leyendoParametrosIniciales()) {
+        // Mensajes de la propia lectura: se guardan todos y se filtran al escribirlos (ver escribirMensajesPendientesLog)
+        return LOG_DEBUG;
+    }
+    const ParametrosConfiguracion *parametros = obtenerParametrosIniciales();
+    pthread_mutex_lock(&mutex_nivel_log);
+    // Otro hilo (o una recarga) puede haberlo dejado ya mientras se esperaba el mutex
+    if (__atomic_load_n(&nivel_log_solicitado, __ATOMIC_RELAXED) == NIVEL_LOG_POR_LEER) {
+        publicarParametrosLog(parametros);
+    }
+    int nivel = __atomic_load_n(&nivel_log_solicitado, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&mutex_nivel_log);
+    return nivel;
+}
+
+// Función que aplica LOG_LEVEL y el filtro de los mensajes de detalle de los parámetros recargados
+// La llama recargarParametros al publicar los parámetros nuevos, así que el log usa siempre los parámetros en vigor
+void aplicarParametrosLog(const ParametrosConfiguracion *parametros) {
+    pthread_mutex_lock(&mutex_nivel_log);
+    publicarParametrosLog(parametros);
+    pthread_mutex_unlock(&mutex_nivel_log);
+}
+
+/*
+    Función que decide si se escribe un mensaje de detalle (ver escribirEnLogDetalle)
+    Se llama antes de evaluar los argumentos del mensaje, así que sólo hace comparaciones y operaciones atómicas.
+    Cuando empieza un segundo nuevo se avisa de los mensajes que el límite suprimió en el punto de llamada
+    Devuelve 1 si hay que escribir el mensaje o 0 si no
+*/
+int admitirLogDetalle(ControlLogDetalle *control, NivelLog nivelLog, const char *modulo, const char *usuario, const char *sucursal) {
+    const FiltroLogDetalle *filtro = __atomic_load_n(&filtro_log_detalle, __ATOMIC_ACQUIRE);
+    if (filtro == NULL) {
+        return 1;
+    }
+    if (filtro->usuario[0] != '\0' && (usuario == NULL || strcmp(usuario, filtro->usuario) != 0)) {
+        return 0;
+    }
+    if (filtro->sucursal[0] != '\0' && (sucursal == NULL || strcmp(sucursal, filtro->sucursal) != 0)) {
+        return 0;
+    }
+    if (filtro->muestreo > 1 && __atomic_fetch_add(&control->llamadas, 1, __ATOMIC_RELAXED) % (unsigned long)filtro->muestreo != 0) {
+        return 0;
+    }
+    if (filtro->limite_por_segundo > 0) {
+        long long segundo = (long long)time(NULL);
+        long long anterior = __atomic_load_n(&control->segundo, __ATOMIC_RELAXED);
+        // Sólo el hilo que cambia el segundo reinicia la cuenta y avisa de los suprimidos
+        if (segundo != anterior && __atomic_compare_exchange_n(&control->segundo, &anterior, segundo, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&control->escritos, 0, __ATOMIC_RELAXED);
+            unsigned long suprimidos = __atomic_exchange_n(&control->suprimidos, 0, __ATOMIC_RELAXED);
+            if (suprimidos > 0) {
+                escribirEnLog(nivelLog, modulo, "%lu mensajes suprimidos por LOG_RATE_LIMIT_PER_SECOND=%d\n",
+                    suprimidos, filtro->limite_por_segundo);
+            }
+        }
+        if (__atomic_fetch_add(&control->escritos, 1, __ATOMIC_RELAXED) >= filtro->limite_por_segundo) {
+            __atomic_fetch_add(&control->suprimidos, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+/*
+    Función de escritura en fichero de log segura para hilos
+    No se llama directamente sino con la macro escribirEnLog, que comprueba antes el nivel de log
+        Formato_constante indica que formato y módulo son literales (necesario para el log binario)
+        NivelLog es el nivel de log para ese mensaje
+        Módulo es una cadena que describe la parte del programa que ha generado el mensaje de log; ejemplo: hilopatronfraude
+        Formato es cadena de formato C que aplicaremos para formatear los parametros del mensaje
+    ... Número variable de parametro que compondrán el mensaje de log; ejemplo: numHilo, numRegistrosProcesados, etc
+    
+    Ejemplo de como llamar a la función: 
+        escribirEnLog(LOG_INFO, "hilo_patron_fraude_2", "Hilo %02d: Registro que cumple el patrón Clave: %s, Registros a la vez: %d\n", id_hilo, registro->clave, registro->cantidad);
+*/
+void escribirMensajeLog(NivelLog nivelLog, int formato_constante, const char *modulo, const char *formato, ...) {
+    //Si el programa llega hasta aquí es que hay que escribir
+    if (leyendoParametrosIniciales()) {
+        // Todavía no se sabe en qué ficheros se escribe
         va_list args;
-        //va_start es un "bucle" que incializa los parametros adicionales y comprueba el formato
         va_start(args, formato);
-        //vsnprinft imprimer en la cadena mensaje los argumentos con el formato
-        vsnprintf(mensaje, sizeof(mensaje), formato, args);
-        //Lo escribimos en el fichero
-        fprintf(archivo_log_aplicacion, "%s", mensaje);
-        //Libera args
+        guardarMensajePendienteLog(nivelLog, modulo, formato, args);
         va_end(args);
-    } 
-
+        return;
+    }
+    pthread_once(&inicializacion_log, inicializarLog);
+    if (__atomic_load_n(&num_mensajes_pendientes_log, __ATOMIC_ACQUIRE) > 0) {
+        escribirMensajesPendientesLog();
+    }
+    struct timespec ahora;
+    clock_gettime(CLOCK_REALTIME, &ahora);
 
-    // En caso de mensaje con nivel de depuración LOG_GENERAL
-    // escribir entrada en log general y en pantalla
-    // Formato fichero log aplicación: FECHA:::HORA:::NoPROCESO:::INICIO:::FIN:::NOMBRE_FICHERO:::NoOperacionesConsolidadas
-    if (nivelLog == LOG_GENERAL) {
-        // Formato fichero log aplicación: FECHA:::HORA:::
-        /// Escribir en fichero de log general
-        fprintf(archivo_log_general, "%s:::%s", fechaHora2, mensaje);
-        // Escribir por pantalla
-        printf("%s:::%s", fechaHora2, mensaje);
+    // Escritura asíncrona: el mensaje queda en el anillo del hilo
+    AnilloLog *anillo;
+    EntradaLog *entrada;
+    int reserva = -1;
+    if (__atomic_load_n(&log_asincrono, __ATOMIC_ACQUIRE)) {
+        reserva = reservarEntradaLog(&anillo, &entrada);
     }
+    if (reserva == 1) {
+        // Descartado por anillo lleno
+        return;
+    }
+    EntradaLog entrada_sincrona;
+    if (reserva == -1) {
+        entrada = &entrada_sincrona;
+    }
+    entrada->instante_ns = ahora.tv_sec * 1000000000LL + ahora.tv_nsec;
+    entrada->nivel = nivelLog;
 
-    // Cerrar los 2 ficheros log
-    fclose(archivo_log_general);
-    fclose(archivo_log_aplicacion);
+    // Si hay argumentos adicionales, escribirlos en una variable
+    //Este snippet lo hemos buscado en internet y lo hemos entendido 
+    //va_lists almacenará los parámetros adicionales
+    va_list args;
+    //va_start es un "bucle" que incializa los parametros adicionales y comprueba el formato
+    va_start(args, formato);
+    int codificado = 0;
+    if (reserva == 0 && log_binario && formato_constante && nivelLog != LOG_GENERAL && formato != NULL) {
+        // Log binario: sólo los argumentos, sin formatear (si no se puede, se formatea como siempre)
+        va_list copia;
+        va_copy(copia, args);
+        codificado = codificarArgumentosLog(entrada, modulo, formato, copia) == 0;
+        va_end(copia);
+    }
+    if (!codificado) {
+        entrada->id_formato = -1;
+        snprintf(entrada->modulo, sizeof(entrada->modulo), "%s", modulo);
+        entrada->mensaje[0] = '\0';
+        if (formato != NULL) {
+            //vsnprinft imprimer en la cadena mensaje los argumentos con el formato
+            vsnprintf(entrada->mensaje, sizeof(entrada->mensaje), formato, args);
+        }
+    }
+    //Libera args
+    va_end(args);
 
-    // Desbloquear el mutex
-    pthread_mutex_unlock(&mutex_escritura_log);
+    if (reserva == 0) {
+        publicarEntradaLog(anillo);
+    } else {
+        // Escritura síncrona
+        escribirEntradaSincrona(entrada);
+    }
 }
 #pragma endregion FicherosLog
@@ -0,0 +1,37 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdint.h>         // Enteros de tamaño fijo de la página de métricas
+
+#include "metricas_compartidas.h"   // Formato de la página de métricas
+#pragma endregion Librerias
+
+
+// Contadores e histogramas de las series de la página de un proceso
+typedef struct DEFINICION_METRICAS {
+    const char *proceso;
+    int num_contadores;
+    const char *nombres_contadores[MAX_CONTADORES_METRICAS];
+    TipoContadorMetricas tipos_contadores[MAX_CONTADORES_METRICAS];
+    int num_histogramas;
+    const char *nombres_histogramas[MAX_HISTOGRAMAS_METRICAS];
+} DefinicionMetricas;
+
+
+int iniciarMetricasCompartidas(const char *nombre, const DefinicionMetricas *definicion);
+
+void terminarMetricasCompartidas();
+
+SerieMetricas *obtenerSerieMetricas(const char *nombre);
+
+void sumarMetrica(SerieMetricas *serie, int contador, uint64_t valor);
+
+void fijarMetrica(SerieMetricas *serie, int contador, uint64_t valor);
+
+void registrarDuracionHistograma(HistogramaMetricas *histograma, long long nanosegundos);
+
+void registrarDuracionMetrica(SerieMetricas *serie, int histograma, long long nanosegundos);
@@ -0,0 +1,191 @@
+// ------------------------------------------------------------------
+// PARÁMETROS DE CONFIGURACIÓN CON TIPO
+// ------------------------------------------------------------------
+
+#include "parametros_configuracion.h"
+#include "log_files.h"
+#include "metricas_compartidas.h"
+
+#include <limits.h>         // INT_MAX
+
+#pragma region ParametrosConfiguracion
+/*
+    fp.conf se lee al arrancar (y al recargar) y se convierte en una estructura ParametrosConfiguracion: los enteros y
+    booleanos ya están convertidos y validados, y el código lee los campos directamente en lugar de buscar
+    la clave y convertir el valor en cada llamada.
+    Al leerlo se avisa en el log de las claves desconocidas y de los valores no válidos.
+
+    Los parámetros del log (LOG_*) los lee log_files.c de la lectura inicial (obtenerParametrosIniciales), sin
+    registrar como lector a cada hilo que escribe en el log; el nivel y el filtro se le pasan al recargar
+*/
+
+#define ENTERO(clave, defecto, campo, minimo, maximo) \
+    {clave, PARAMETRO_ENTERO, defecto, offsetof(ParametrosConfiguracion, campo), minimo, maximo, NULL}
+#define BOOLEANO(clave, defecto, campo) \
+    {clave, PARAMETRO_BOOLEANO, defecto, offsetof(ParametrosConfiguracion, campo), 0, 0, NULL}
+#define CADENA(clave, defecto, campo, opciones) \
+    {clave, PARAMETRO_CADENA, defecto, offsetof(ParametrosConfiguracion, campo), 0, 0, opciones}
+
+static const DefinicionParametro definiciones_parametros[] = {
+    ENTERO("NUM_PROCESOS", "5", num_procesos, 1, MAX_HILOS_OBSERVACION),
+    ENTERO("SIMULATE_SLEEP_MIN", "1", retardo_minimo, 0, 3600),
+    ENTERO("SIMULATE_SLEEP_MAX", "2", retardo_maximo, 0, 3600),
+    CADENA("PATH_FILES", "../Datos", carpeta_datos, NULL),
+    CADENA("PATH_SUCURSALES", "files_data", carpeta_sucursales, NULL),
+    CADENA("NOMBRE_DIRECTORIO_SUCURSAL", "Sucursal", nombre_directorio_sucursal, NULL),
+    CADENA("PREFIJO_CARPETAS_PROCESO", "procesados", prefijo_carpetas_proceso, NULL),
+    CADENA("PREFIJO_FICHEROS", "SU", prefijo_ficheros, NULL),
+    CADENA("INVENTORY_FILE", "consolidado.csv", fichero_consolidado, NULL),
+    CADENA("SEGMENT_PARTITIONING", "NINGUNO", particionado_segmentos, "NINGUNO|DIA|HORA"),
+    CADENA("SEGMENT_DIRECTORY", "segmentos", carpeta_segmentos, NULL),
+    BOOLEANO("COLUMNAR_STORE", "0", almacen_columnar),
+    CADENA("COLUMNAR_FILE", "consolidado.col", fichero_columnar, NULL),
+    ENTERO("COLUMNAR_ROW_GROUP", "4096", filas_grupo_columnar, 1, INT_MAX),
+    BOOLEANO("PARTIAL_AGGREGATES", "0", agregados_parciales),
+    CADENA("PARTIAL_FILE", "agregados_parciales.csv", fichero_agregados, NULL),
+    BOOLEANO("BATCH_SUMMARIES", "0", resumenes_lotes),
+    CADENA("SUMMARY_FILE", "resumenes_lotes.csv", fichero_resumenes, NULL),
+    ENTERO("SUMMARY_BLOOM_BITS", "512", bits_bloom_resumen, 0, INT_MAX),
+    BOOLEANO("MONITOR_ACTIVO", "NO", monitor_activo),
+    CADENA("PIPE_NAME", "/tmp/pipeAudita", nombre_pipe, NULL),
+    CADENA("SEMAPHORE_NAME", "/semaforo", nombre_semaforo, NULL),
+    BOOLEANO("SNAPSHOT_READS", "0", lectura_instantanea),
+    CADENA("COMMIT_WATERMARK_NAME", "/marca_confirmacion", nombre_marca_confirmacion, NULL),
+    BOOLEANO("USE_SHARED_MEMORY", "0", usar_memoria_compartida),
+    ENTERO("SHARED_MEMORY_INITIAL_SIZE", "1024", tamano_memoria_compartida, 1, INT_MAX),
+    CADENA("SHARED_MEMORY_NAME", "/my_shared_memory", nombre_memoria_compartida, NULL),
+    BOOLEANO("SHARED_METRICS", "0", metricas_compartidas),
+    CADENA("SHARED_METRICS_NAME", NOMBRE_METRICAS_FILEPROCESSOR, nombre_metricas_compartidas, NULL),
+    BOOLEANO("LOCK_PROFILING", "0", perfil_bloqueos),
+    CADENA("LOCK_PROFILING_FILE", "logs/FileProcessorBloqueos.log", fichero_perfil_bloqueos, NULL),
+
+    CADENA("LOG_LEVEL", "INFO", nivel_log, "GENERAL|DEBUG|INFO|WARNING|ERROR"),
+    CADENA("LOG_DEBUG_FILTER_USER", "", filtro_log_usuario, NULL),
+    CADENA("LOG_DEBUG_FILTER_BRANCH", "", filtro_log_sucursal, NULL),
+    ENTERO("LOG_SAMPLE_EVERY", "1", muestreo_log, 0, INT_MAX),
+    ENTERO("LOG_RATE_LIMIT_PER_SECOND", "0", limite_log_por_segundo, 0, INT_MAX),
+    CADENA("LOG_FILE", ARCHIVO_LOG, fichero_log, NULL),
+    CADENA("LOG_FILE_APP", ARCHIVO_LOG_APP, fichero_log_aplicacion, NULL),
+    ENTERO("LOG_ASYNC", "0", log_asincrono, 0, 1),
+    ENTERO("LOG_ASYNC_BUFFER", "1024", capacidad_log_asincrono, 1, 1048576),
+    CADENA("LOG_ASYNC_FULL_POLICY", "DESCARTAR", politica_log_lleno, "DESCARTAR|BLOQUEAR"),
+    CADENA("LOG_FORMAT", "TEXTO", formato_log, "TEXTO|BINARIO"),
+    CADENA("LOG_FILE_BIN", ARCHIVO_LOG_BIN, fichero_log_binario, NULL),
+    ENTERO("LOG_ROTATE_SIZE_MB", "0", rotacion_log_mb, 0, 1048576),
+    ENTERO("LOG_ROTATE_INTERVAL_SECONDS", "0", rotacion_log_segundos, 0, INT_MAX),
+    ENTERO("LOG_ROTATE_KEEP", "5", rotacion_log_conservar, 0, 1000),
+    ENTERO("LOG_ROTATE_PREALLOCATE", "1", rotacion_log_preasignar, 0, 1),
+    ENTERO("LOG_ROTATE_COMPRESS", "0", rotacion_log_comprimir, 0, 1),
+};
+
+#define NUM_DEFINICIONES_PARAMETROS ((int)(sizeof(definiciones_parametros) / sizeof(definiciones_parametros[0])))
+
+/*
+    Recarga con SIGHUP: se lee fp.conf en una estructura nueva que sustituye a la actual de forma atómica;
+    los hilos siguen leyendo sin bloqueos y la anterior se libera cuando ya no la usa nadie
+    (ver LectoresConfiguracion en config_files.c).
+    Sólo se aplican en caliente los parámetros de PARAMETROS_RECARGABLES; el resto se avisa en el log y se
+    mantiene el valor con el que arrancó el proceso
+*/
+#define PARAMETROS_RECARGABLES "NUM_PROCESOS|SIMULATE_SLEEP_MIN|SIMULATE_SLEEP_MAX|MONITOR_ACTIVO|SHARED_MEMORY_INITIAL_SIZE|" \
+    "LOG_LEVEL|LOG_DEBUG_FILTER_USER|LOG_DEBUG_FILTER_BRANCH|LOG_SAMPLE_EVERY|LOG_RATE_LIMIT_PER_SECOND"
+
+// Parámetros de la lectura inicial (no se liberan nunca) y parámetros en vigor
+static ParametrosConfiguracion parametros_iniciales;
+static ParametrosConfiguracion *parametros_actuales = NULL;
+static pthread_once_t parametros_leidos = PTHREAD_ONCE_INIT;
+// El hilo que hace la lectura inicial: sus mensajes de log no pueden esperar a que termine
+static __thread int lectura_inicial_en_curso = 0;
+// Sólo se recarga desde un hilo a la vez
+static pthread_mutex_t mutex_recarga_parametros = PTHREAD_MUTEX_INITIALIZER;
+
+// Función que lee fp.conf y lo convierte en "parametros"
+// Devuelve el número de errores o -1 si no se ha podido abrir el fichero
+static int leerParametros(ParametrosConfiguracion *parametros) {
+    parametros->num_entradas = leer_entradas_configuracion(FICHERO_CONFIGURACION, parametros->entradas, MAX_ENTRADAS_CONFIG);
+    if (parametros->num_entradas == -1) {
+        return -1;
+    }
+    int errores = cargar_parametros_configuracion(parametros->entradas, parametros->num_entradas,
+        definiciones_parametros, NUM_DEFINICIONES_PARAMETROS, parametros);
+    if (parametros->retardo_maximo < parametros->retardo_minimo) {
+        escribirEnLog(LOG_WARNING, "parametros_configuracion", "SIMULATE_SLEEP_MAX=%d menor que SIMULATE_SLEEP_MIN=%d, se utiliza %d\n",
+            parametros->retardo_maximo, parametros->retardo_minimo, parametros->retardo_minimo);
+        parametros->retardo_maximo = parametros->retardo_minimo;
+        errores++;
+    }
+    if (errores > 0) {
+        escribirEnLog(LOG_WARNING, "parametros_configuracion", "%d errores en %s\n", errores, FICHERO_CONFIGURACION);
+    }
+    return errores;
+}
+
+// Función que hace la lectura inicial de fp.conf
+static void leerParametrosIniciales() {
+    lectura_inicial_en_curso = 1;
+    int errores = leerParametros(&parametros_iniciales);
+    lectura_inicial_en_curso = 0;
+    if (errores == -1) {
+        perror("Error al abrir el archivo de configuración");
+        exit(1);
+    }
+    __atomic_store_n(&parametros_actuales, &parametros_iniciales, __ATOMIC_RELEASE);
+}
+
+// Función que devuelve los parámetros de configuración en vigor (la primera vez lee el fichero)
+// El hilo no debe guardar el puntero más allá de su próximo estado_quiescente_configuracion
+const ParametrosConfiguracion *obtenerParametros() {
+    registrar_lector_configuracion();
+    ParametrosConfiguracion *parametros = __atomic_load_n(&parametros_actuales, __ATOMIC_ACQUIRE);
+    if (parametros == NULL) {
+        pthread_once(&parametros_leidos, leerParametrosIniciales);
+        parametros = __atomic_load_n(&parametros_actuales, __ATOMIC_ACQUIRE);
+    }
+    return parametros;
+}
+
+// Función que devuelve los parámetros de la lectura inicial (la primera vez lee el fichero)
+// No se liberan nunca, así que el hilo no tiene que registrarse como lector; los que no son recargables
+// tienen siempre el valor inicial
+const ParametrosConfiguracion *obtenerParametrosIniciales() {
+    pthread_once(&parametros_leidos, leerParametrosIniciales);
+    return &parametros_iniciales;
+}
+
+// Función que indica si el hilo está haciendo la lectura inicial del fichero (escribe en el log los errores
+// que encuentra antes de que estén leídos los parámetros del log)
+int leyendoParametrosIniciales() {
+    return lectura_inicial_en_curso;
+}
+
+// Función que vuelve a leer fp.conf y publica los parámetros nuevos (también el nivel y el filtro del log)
+// Devuelve EXIT_SUCCESS o -1 si no se ha podido leer (siguen en vigor los anteriores)
+int recargarParametros() {
+    // La lectura inicial tiene que estar hecha para comparar con ella
+    obtenerParametros();
+    ParametrosConfiguracion *nuevos = malloc(sizeof(ParametrosConfiguracion));
+    if (nuevos == NULL) {
+        escribirEnLog(LOG_ERROR, "parametros_configuracion", "Sin memoria para recargar %s\n", FICHERO_CONFIGURACION);
+        return -1;
+    }
+    pthread_mutex_lock(&mutex_recarga_parametros);
+    if (leerParametros(nuevos) == -1) {
+        pthread_mutex_unlock(&mutex_recarga_parametros);
+        escribirEnLog(LOG_ERROR, "parametros_configuracion", "Error al abrir %s, se mantienen los parámetros en vigor\n", FICHERO_CONFIGURACION);
+        free(nuevos);
+        return -1;
+    }
+    conservar_parametros_no_recargables(definiciones_parametros, NUM_DEFINICIONES_PARAMETROS, PARAMETROS_RECARGABLES,
+        parametros_iniciales.entradas, parametros_iniciales.num_entradas, &parametros_iniciales,
+        nuevos->entradas, nuevos->num_entradas, nuevos);
+    escribirEnLog(LOG_INFO, "parametros_configuracion", "Parámetros de %s recargados: NUM_PROCESOS=%d, SIMULATE_SLEEP=%d-%d\n",
+        FICHERO_CONFIGURACION, nuevos->num_procesos, nuevos->retardo_minimo, nuevos->retardo_maximo);
+    ParametrosConfiguracion *retirados = __atomic_exchange_n(&parametros_actuales, nuevos, __ATOMIC_SEQ_CST);
+    aplicarParametrosLog(nuevos);
+    pthread_mutex_unlock(&mutex_recarga_parametros);
+    if (retirados != &parametros_iniciales) {
+        retirar_configuracion(retirados, free);
+    }
+    return EXIT_SUCCESS;
+}
+#pragma endregion ParametrosConfiguracion
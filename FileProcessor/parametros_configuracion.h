@@ -0,0 +1,94 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <pthread.h>        // Tratamiento de hilos y mutex
+
+#include "config_files.h"   // Lectura del fichero de configuración
+#pragma endregion Librerias
+
+
+// Parámetros de fp.conf ya convertidos y validados (ver parametros_configuracion.c)
+// Las cadenas apuntan a las entradas de la propia estructura (o a las de la lectura inicial en los
+// parámetros que sólo se aplican al reiniciar)
+typedef struct PARAMETROS_CONFIGURACION {
+    struct EntradaConfiguracion entradas[MAX_ENTRADAS_CONFIG];
+    int num_entradas;
+
+    // Hilos y retardo simulado
+    int num_procesos;                       // NUM_PROCESOS
+    int retardo_minimo;                     // SIMULATE_SLEEP_MIN (segundos)
+    int retardo_maximo;                     // SIMULATE_SLEEP_MAX
+
+    // Carpetas y ficheros
+    const char *carpeta_datos;              // PATH_FILES
+    const char *carpeta_sucursales;         // PATH_SUCURSALES
+    const char *nombre_directorio_sucursal; // NOMBRE_DIRECTORIO_SUCURSAL
+    const char *prefijo_carpetas_proceso;   // PREFIJO_CARPETAS_PROCESO
+    const char *prefijo_ficheros;           // PREFIJO_FICHEROS
+    const char *fichero_consolidado;        // INVENTORY_FILE
+
+    // Segmentos, almacén columnar, agregados parciales y resúmenes de lotes
+    const char *particionado_segmentos;     // SEGMENT_PARTITIONING (NINGUNO/DIA/HORA)
+    const char *carpeta_segmentos;          // SEGMENT_DIRECTORY
+    int almacen_columnar;                   // COLUMNAR_STORE
+    const char *fichero_columnar;           // COLUMNAR_FILE
+    int filas_grupo_columnar;               // COLUMNAR_ROW_GROUP
+    int agregados_parciales;                // PARTIAL_AGGREGATES
+    const char *fichero_agregados;          // PARTIAL_FILE
+    int resumenes_lotes;                    // BATCH_SUMMARIES
+    const char *fichero_resumenes;          // SUMMARY_FILE
+    int bits_bloom_resumen;                 // SUMMARY_BLOOM_BITS
+
+    // Comunicación con Monitor
+    int monitor_activo;                     // MONITOR_ACTIVO
+    const char *nombre_pipe;                // PIPE_NAME
+    const char *nombre_semaforo;            // SEMAPHORE_NAME
+    int lectura_instantanea;                // SNAPSHOT_READS
+    const char *nombre_marca_confirmacion;  // COMMIT_WATERMARK_NAME
+
+    // Memoria compartida
+    int usar_memoria_compartida;            // USE_SHARED_MEMORY
+    int tamano_memoria_compartida;          // SHARED_MEMORY_INITIAL_SIZE
+    const char *nombre_memoria_compartida;  // SHARED_MEMORY_NAME
+
+    // Métricas en memoria compartida para fpstat
+    int metricas_compartidas;               // SHARED_METRICS
+    const char *nombre_metricas_compartidas; // SHARED_METRICS_NAME
+
+    // Perfil de contención de los bloqueos
+    int perfil_bloqueos;                    // LOCK_PROFILING
+    const char *fichero_perfil_bloqueos;    // LOCK_PROFILING_FILE
+
+    // Ficheros de log (ver log_files.c y rotacion_log.c)
+    const char *nivel_log;                  // LOG_LEVEL
+    const char *filtro_log_usuario;         // LOG_DEBUG_FILTER_USER
+    const char *filtro_log_sucursal;        // LOG_DEBUG_FILTER_BRANCH
+    int muestreo_log;                       // LOG_SAMPLE_EVERY
+    int limite_log_por_segundo;             // LOG_RATE_LIMIT_PER_SECOND
+    const char *fichero_log;                // LOG_FILE
+    const char *fichero_log_aplicacion;     // LOG_FILE_APP
+    int log_asincrono;                      // LOG_ASYNC
+    int capacidad_log_asincrono;            // LOG_ASYNC_BUFFER
+    const char *politica_log_lleno;         // LOG_ASYNC_FULL_POLICY (DESCARTAR/BLOQUEAR)
+    const char *formato_log;                // LOG_FORMAT (TEXTO/BINARIO)
+    const char *fichero_log_binario;        // LOG_FILE_BIN
+    int rotacion_log_mb;                    // LOG_ROTATE_SIZE_MB
+    int rotacion_log_segundos;              // LOG_ROTATE_INTERVAL_SECONDS
+    int rotacion_log_conservar;             // LOG_ROTATE_KEEP
+    int rotacion_log_preasignar;            // LOG_ROTATE_PREALLOCATE
+    int rotacion_log_comprimir;             // LOG_ROTATE_COMPRESS
+} ParametrosConfiguracion;
+
+
+const ParametrosConfiguracion *obtenerParametros();
+
+const ParametrosConfiguracion *obtenerParametrosIniciales();
+
+int leyendoParametrosIniciales();
+
+int recargarParametros();
@@ -0,0 +1,46 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <pthread.h>        // Tratamiento de hilos y mutex
+#include <semaphore.h>      // Tratamiento de semáforos
+#include <stdint.h>         // Enteros de tamaño fijo de los contadores
+
+#include "metricas_compartidas.h"   // Histogramas de duración
+#pragma endregion Librerias
+
+// Entradas del perfil (una por bloqueo, sitio y hilo) y titulares que se distinguen en cada entrada
+#define MAX_ENTRADAS_PERFIL_BLOQUEOS 4096
+#define MAX_ENTRADAS_HILO_PERFIL_BLOQUEOS 128
+#define MAX_TITULARES_PERFIL_BLOQUEOS 8
+#define LONGITUD_SITIO_PERFIL_BLOQUEOS 64
+#define LONGITUD_HILO_PERFIL_BLOQUEOS 32
+
+// Titular que no es un hilo de este proceso: otro proceso (semáforo) o el bloqueo se acababa de liberar
+#define TITULAR_PERFIL_DESCONOCIDO -1
+
+// Mutex o semáforo instrumentado (uno por cada bloqueo, se declara con BLOQUEO_PERFILADO("nombre"))
+typedef struct BLOQUEO_PERFILADO {
+    const char *nombre;
+    int titular;                // Entrada del perfil del hilo que lo tiene (TITULAR_PERFIL_DESCONOCIDO: ninguno)
+    long long adquirido_ns;     // Instante en que lo obtuvo el titular
+} BloqueoPerfilado;
+
+#define BLOQUEO_PERFILADO(nombre) { nombre, TITULAR_PERFIL_DESCONOCIDO, 0 }
+
+
+void iniciarPerfilBloqueos(int activo, const char *fichero_informe, const char *proceso);
+
+void nombrarHiloPerfilBloqueos(const char *nombre);
+
+void bloquearMutexPerfilado(BloqueoPerfilado *bloqueo, pthread_mutex_t *mutex, const char *sitio);
+
+void desbloquearMutexPerfilado(BloqueoPerfilado *bloqueo, pthread_mutex_t *mutex);
+
+void esperarSemaforoPerfilado(BloqueoPerfilado *bloqueo, sem_t *semaforo, const char *sitio);
+
+void liberarSemaforoPerfilado(BloqueoPerfilado *bloqueo, sem_t *semaforo);
+
+int escribirInformePerfilBloqueos(const char *motivo);
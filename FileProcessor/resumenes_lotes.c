@@ -0,0 +1,216 @@
+// ------------------------------------------------------------------
+// RESÚMENES DE LOS LOTES CONSOLIDADOS
+// ------------------------------------------------------------------
+
+#include "resumenes_lotes.h"
+#include "log_files.h"
+#include "config_files.h"
+#include "utilidades.h"
+
+#pragma region ResumenesLotes
+/*
+    Con BATCH_SUMMARIES=1, al consolidar cada fichero de sucursal FileProcessor añade al fichero SUMMARY_FILE
+    un resumen del lote (ver formato_resumenes.h): importes mínimo y máximo, registros con error, tipos de
+    operación presentes, rango de fechas y, si SUMMARY_BLOOM_BITS es mayor que 0, un filtro de Bloom de los
+    usuarios. Monitor se salta sin leerlos los lotes en los que un patrón o una regla no pueden cumplirse.
+
+    Los registros llegan de la misma pasada que los copia al consolidado (iniciarLoteResumen,
+    anadirRegistroResumen y terminarLoteResumen), sin volver a leer el fichero de sucursal.
+    Los resúmenes se escriben con el acceso exclusivo al consolidado cogido y antes de publicar la marca de
+    confirmación. Si FileProcessor se para a mitad de una línea, al arrancar se recorta la línea incompleta.
+    Cada resumen lleva la identidad de los datos consolidados del lote: si al arrancar el consolidado es
+    otro (o se ha recortado), los resúmenes ya no sirven y se vacía el fichero.
+*/
+
+// Estado del fichero de resúmenes
+static pthread_mutex_t mutex_resumenes = PTHREAD_MUTEX_INITIALIZER;
+static char fichero_resumenes[PATH_MAX];
+static int resumenes_activos = 0;
+static int bits_bloom_resumen = 0;
+
+// Resumen de un lote mientras se consolidan sus registros
+struct LOTE_RESUMEN {
+    int registros;
+    int importe_minimo;
+    int importe_maximo;
+    int errores;
+    uint32_t tipos;
+    long long instante_minimo;
+    long long instante_maximo;
+    unsigned char *bloom;
+};
+
+// Función que lee el principio R;... de una línea de resumen: posiciones finales e identidad de los datos
+// Devuelve 0 o -1 si la línea no tiene el formato de formato_resumenes.h
+static int leerPosicionesResumen(const char *linea, PosicionesConsolidado *hasta) {
+    int leidos = sscanf(linea, "R;%*[-0-9];%lld;%*[-0-9];%lld;%*[-0-9];%lld;%llu:%llu;%llu:%llu;%llu:%llu;",
+        &hasta->fichero, &hasta->memoria, &hasta->columnar,
+        &hasta->identidad_fichero.dispositivo, &hasta->identidad_fichero.inodo,
+        &hasta->identidad_memoria.dispositivo, &hasta->identidad_memoria.inodo,
+        &hasta->identidad_columnar.dispositivo, &hasta->identidad_columnar.inodo);
+    return leidos == 9 ? 0 : -1;
+}
+
+// Función que prepara el fichero de resúmenes y recorta una línea incompleta al final
+// actuales son las posiciones e identidad de los datos consolidados al arrancar: si los resúmenes son de otros
+// datos, el fichero se vacía
+// bits_bloom se redondea a un múltiplo de 8 (0: sin filtro de Bloom)
+// Devuelve 0 o -1 en caso de error (los resúmenes quedan desactivados)
+int inicializarResumenesLotes(const char *nombre_fichero, int bits_bloom, const PosicionesConsolidado *actuales) {
+    pthread_mutex_lock(&mutex_resumenes);
+    snprintf(fichero_resumenes, sizeof(fichero_resumenes), "%s", nombre_fichero);
+    resumenes_activos = 0;
+    if (bits_bloom < 0 || bits_bloom > MAX_BITS_BLOOM_RESUMEN) {
+        escribirEnLog(LOG_WARNING, "resumenes_lotes", "SUMMARY_BLOOM_BITS=%d fuera de rango (0..%d), se utiliza 512\n", bits_bloom, MAX_BITS_BLOOM_RESUMEN);
+        bits_bloom = 512;
+    }
+    bits_bloom_resumen = (bits_bloom + 7) / 8 * 8;
+
+    FILE *fichero = fopen(nombre_fichero, "a+");
+    if (fichero == NULL) {
+        escribirEnLog(LOG_ERROR, "resumenes_lotes", "No se puede abrir el fichero de resúmenes %s\n", nombre_fichero);
+        pthread_mutex_unlock(&mutex_resumenes);
+        return -1;
+    }
+    rewind(fichero);
+    // Las líneas pueden ser más largas que MAX_LINE_LENGTH (filtro de Bloom), se recorren carácter a carácter
+    // guardando sólo el principio de cada una, que tiene las posiciones y la identidad de los datos
+    char principio[MAX_LINE_LENGTH];
+    size_t largo = 0;
+    long long fin_completo = 0;
+    long long posicion = 0;
+    long lotes = 0;
+    int otros_datos = 0;
+    int caracter;
+    while (!otros_datos && (caracter = fgetc(fichero)) != EOF) {
+        posicion++;
+        if (largo < sizeof(principio) - 1) {
+            principio[largo++] = (char)caracter;
+        }
+        if (caracter == '\n') {
+            principio[largo] = '\0';
+            largo = 0;
+            PosicionesConsolidado hasta;
+            // Un resumen de otro formato o de otros datos consolidados invalida todos los resúmenes
+            otros_datos = leerPosicionesResumen(principio, &hasta) != 0 || !mismosDatosConsolidados(&hasta, actuales);
+            fin_completo = posicion;
+            lotes++;
+        }
+    }
+    int resultado = 0;
+    if (otros_datos) {
+        escribirEnLog(LOG_WARNING, "resumenes_lotes", "Los resúmenes de %s son de otros datos consolidados, se vacía el fichero\n", nombre_fichero);
+        lotes = 0;
+        if (ftruncate(fileno(fichero), 0) != 0) {
+            resultado = -1;
+        }
+    } else if (fin_completo < posicion) {
+        escribirEnLog(LOG_WARNING, "resumenes_lotes", "Recortada una línea incompleta al final de %s (%lld bytes)\n",
+            nombre_fichero, posicion - fin_completo);
+        if (ftruncate(fileno(fichero), fin_completo) != 0) {
+            resultado = -1;
+        }
+    }
+    fclose(fichero);
+    if (resultado == 0) {
+        resumenes_activos = 1;
+        escribirEnLog(LOG_INFO, "resumenes_lotes", "Fichero de resúmenes %s: %ld lotes, filtro de Bloom de %d bits\n",
+            nombre_fichero, lotes, bits_bloom_resumen);
+    }
+    pthread_mutex_unlock(&mutex_resumenes);
+    return resultado;
+}
+
+// Función que empieza el resumen de un fichero de sucursal
+// Devuelve el lote o NULL si los resúmenes no están activados. El fichero queda reservado hasta terminarLoteResumen
+LoteResumen *iniciarLoteResumen() {
+    pthread_mutex_lock(&mutex_resumenes);
+    if (!resumenes_activos) {
+        pthread_mutex_unlock(&mutex_resumenes);
+        return NULL;
+    }
+    LoteResumen *resumen = calloc(1, sizeof(LoteResumen));
+    resumen->instante_minimo = -1;
+    resumen->instante_maximo = -1;
+    resumen->bloom = calloc(bits_bloom_resumen / 8 + 1, 1);
+    return resumen;
+}
+
+// Función que añade al resumen los campos de un registro completo (ver separarCamposRegistro)
+void anadirRegistroResumen(LoteResumen *resumen, char *const campos[NUM_CAMPOS_REGISTRO]) {
+    if (resumen == NULL) {
+        return;
+    }
+    // atoi se detiene en el " €" del importe
+    int importe = atoi(campos[7]);
+    if (resumen->registros == 0 || importe < resumen->importe_minimo) {
+        resumen->importe_minimo = importe;
+    }
+    if (resumen->registros == 0 || importe > resumen->importe_maximo) {
+        resumen->importe_maximo = importe;
+    }
+    resumen->registros++;
+    if (strcmp(campos[8], "Error") == 0) {
+        resumen->errores++;
+    }
+    int tipo = atoi(campos[6]);
+    resumen->tipos |= 1u << (tipo >= 0 && tipo < BIT_TIPOS_RESUMEN_OTROS ? tipo : BIT_TIPOS_RESUMEN_OTROS);
+    long long instante = convertirFechaHora(campos[2]);
+    if (instante >= 0) {
+        if (resumen->instante_minimo < 0 || instante < resumen->instante_minimo) {
+            resumen->instante_minimo = instante;
+        }
+        if (instante > resumen->instante_maximo) {
+            resumen->instante_maximo = instante;
+        }
+    }
+    for (int i = 0; i < HASHES_BLOOM_RESUMEN && bits_bloom_resumen > 0; i++) {
+        uint32_t bit = posicionBloomResumen(campos[4], i, (uint32_t)bits_bloom_resumen);
+        resumen->bloom[bit / 8] |= (unsigned char)(1u << (bit % 8));
+    }
+}
+
+// Función que termina el resumen: lo añade al fichero de resúmenes y lo libera
+// desde y hasta son las posiciones de los datos consolidados antes y después de añadir el fichero
+// Si correcto es 0 (el fichero no se ha podido consolidar) el resumen se descarta sin escribirlo
+// Devuelve el número de registros del lote o -1 en caso de error
+int terminarLoteResumen(int id_hilo, LoteResumen *resumen, const char *archivo_origen, int correcto,
+    const PosicionesConsolidado *desde, const PosicionesConsolidado *hasta) {
+    if (resumen == NULL) {
+        return 0;
+    }
+    int resultado = 0;
+    FILE *fichero = correcto ? fopen(fichero_resumenes, "a") : NULL;
+    if (!correcto) {
+        resumen->registros = 0;
+    } else if (fichero == NULL) {
+        escribirEnLog(LOG_ERROR, "resumenes_lotes", "Hilo %02d: Error al abrir el fichero de resúmenes %s\n", id_hilo, fichero_resumenes);
+        resultado = -1;
+    } else {
+        fprintf(fichero, "R;%lld;%lld;%lld;%lld;%lld;%lld;%llu:%llu;%llu:%llu;%llu:%llu;%d;%d;%d;%d;%u;%lld;%lld;",
+            desde->fichero, hasta->fichero, desde->memoria, hasta->memoria, desde->columnar, hasta->columnar,
+            hasta->identidad_fichero.dispositivo, hasta->identidad_fichero.inodo,
+            hasta->identidad_memoria.dispositivo, hasta->identidad_memoria.inodo,
+            hasta->identidad_columnar.dispositivo, hasta->identidad_columnar.inodo,
+            resumen->registros, resumen->importe_minimo, resumen->importe_maximo, resumen->errores, resumen->tipos,
+            resumen->instante_minimo, resumen->instante_maximo);
+        for (int i = 0; i < bits_bloom_resumen / 8; i++) {
+            fprintf(fichero, "%02x", resumen->bloom[i]);
+        }
+        fputc('\n', fichero);
+        if (fclose(fichero) != 0) {
+            escribirEnLog(LOG_ERROR, "resumenes_lotes", "Hilo %02d: Error al escribir el fichero de resúmenes %s\n", id_hilo, fichero_resumenes);
+            resultado = -1;
+        } else {
+            escribirEnLog(LOG_DEBUG, "resumenes_lotes", "Hilo %02d: resumen de %s: %d registros, importes %d..%d, %d errores, tipos %08x\n",
+                id_hilo, archivo_origen, resumen->registros, resumen->importe_minimo, resumen->importe_maximo, resumen->errores, resumen->tipos);
+        }
+    }
+    int registros = resumen->registros;
+    free(resumen->bloom);
+    free(resumen);
+    pthread_mutex_unlock(&mutex_resumenes);
+    return resultado == 0 ? registros : -1;
+}
+
+#pragma endregion ResumenesLotes
@@ -0,0 +1,31 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <pthread.h>        // Tratamiento de hilos y mutex
+#include <unistd.h>         // Gestión de procesos, acceso a archivos, pipe, control de señales
+#include <linux/limits.h>   // Define varias constantes que representan los límites del sistema en sistemas operativos Linux
+
+#include "constants.h"                  // Constantes de la aplicación
+#include "formato_resumenes.h"          // Formato del fichero de resúmenes de lotes
+#include "confirmacion_consolidado.h"   // Posiciones de los datos consolidados
+#include "utilidades.h"                 // Campos de una línea del consolidado
+#pragma endregion Librerias
+
+// Resumen de un fichero de sucursal mientras se consolidan sus registros (ver resumenes_lotes.c)
+typedef struct LOTE_RESUMEN LoteResumen;
+
+
+int inicializarResumenesLotes(const char *nombre_fichero, int bits_bloom, const PosicionesConsolidado *actuales);
+
+LoteResumen *iniciarLoteResumen();
+
+void anadirRegistroResumen(LoteResumen *resumen, char *const campos[NUM_CAMPOS_REGISTRO]);
+
+int terminarLoteResumen(int id_hilo, LoteResumen *resumen, const char *archivo_origen, int correcto,
+    const PosicionesConsolidado *desde, const PosicionesConsolidado *hasta);
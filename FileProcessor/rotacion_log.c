@@ -0,0 +1,216 @@
+// ------------------------------------------------------------------
+// ROTACIÓN DE LOS FICHEROS DE LOG
+// ------------------------------------------------------------------
+
+// fallocate y FALLOC_FL_KEEP_SIZE son extensiones de Linux
+#define _GNU_SOURCE
+
+#include "rotacion_log.h"
+#include "parametros_configuracion.h"
+
+#include <string.h>         // snprintf
+#include <unistd.h>         // close, link, unlink
+#include <fcntl.h>          // open, fallocate
+#include <errno.h>          // Códigos de error de las llamadas al sistema
+#include <spawn.h>          // posix_spawnp para comprimir en segundo plano
+#include <signal.h>         // Máscara de señales del proceso de compresión
+#include <sys/wait.h>       // waitpid
+
+#pragma region RotacionLog
+/*
+    El fichero de log se rota al llegar a LOG_ROTATE_SIZE_MB o cuando han pasado LOG_ROTATE_INTERVAL_SECONDS
+    desde que se empezó. El fichero actual pasa a ser nombre.1, los anteriores se desplazan (nombre.1 pasa a
+    nombre.2...) y se borran los que pasan de LOG_ROTATE_KEEP.
+
+    Con LOG_ROTATE_PREALLOCATE=1 el siguiente fichero (nombre.siguiente) se prepara por adelantado con el
+    espacio ya reservado con fallocate (sin cambiar su tamaño, así que se sigue escribiendo al final), y el
+    sistema de ficheros no tiene que ir ampliando el fichero mientras se escribe el log.
+    El cambio de fichero no deja ningún momento sin fichero de log: el actual se enlaza como nombre.1 y el
+    siguiente sustituye al actual con rename, que es atómico.
+
+    Con LOG_ROTATE_COMPRESS=1 el fichero rotado se comprime con gzip en otro proceso (nombre.1.gz).
+
+    Con escritura asíncrona la rotación la hace el hilo escritor, así que los hilos que escriben en el log no
+    se bloquean. Con escritura síncrona la hace el hilo que escribe con el mutex del log cogido, así que nunca
+    espera a gzip: mientras la compresión anterior no ha terminado no se rota y se vuelve a intentar con un
+    mensaje posterior. Los errores se escriben en stderr (no se puede escribir en el log que se está rotando).
+*/
+
+// Función que lee la configuración de rotación de un fichero de log
+// LOG_ROTATE_* no se recargan, así que se usan los parámetros de la lectura inicial
+void configurarRotacionLog(RotacionLog *rotacion, const char *nombre) {
+    const ParametrosConfiguracion *parametros = obtenerParametrosIniciales();
+    snprintf(rotacion->nombre, sizeof(rotacion->nombre), "%s", nombre);
+    rotacion->tamano_maximo = (long long)parametros->rotacion_log_mb * 1024 * 1024;
+    rotacion->intervalo = parametros->rotacion_log_segundos;
+    rotacion->conservar = parametros->rotacion_log_conservar;
+    if (rotacion->conservar < 1) {
+        rotacion->conservar = 1;
+    }
+    rotacion->preasignar = parametros->rotacion_log_preasignar;
+    rotacion->comprimir = parametros->rotacion_log_comprimir;
+    rotacion->apertura = time(NULL);
+    rotacion->tamano_inicial = 0;
+    rotacion->siguiente = -1;
+    rotacion->compresion = 0;
+}
+
+// Función que indica si hay que rotar el fichero de log
+int rotacionLogActiva(const RotacionLog *rotacion) {
+    return rotacion->tamano_maximo > 0 || rotacion->intervalo > 0;
+}
+
+// Función que marca el principio del fichero de log actual (después de abrirlo o rotarlo y de escribir su cabecera)
+void empezarFicheroLog(RotacionLog *rotacion, FILE *archivo) {
+    fseek(archivo, 0, SEEK_END);
+    rotacion->tamano_inicial = ftell(archivo);
+}
+
+// Función que comprueba sin esperar si ha terminado la compresión del fichero rotado anterior
+// Devuelve 1 si no hay ninguna compresión en curso
+static int compresionLogTerminada(RotacionLog *rotacion) {
+    if (rotacion->compresion != 0 && waitpid(rotacion->compresion, NULL, WNOHANG) != 0) {
+        rotacion->compresion = 0;
+    }
+    return rotacion->compresion == 0;
+}
+
+// Función que indica si el fichero de log abierto ha llegado al tamaño o al tiempo de rotación
+// Por tiempo no se rota un fichero en el que no se ha escrito nada, y no se rota mientras gzip comprime el anterior
+// (desplazaría el fichero que está comprimiendo)
+int necesitaRotacionLog(RotacionLog *rotacion, FILE *archivo) {
+    if (!compresionLogTerminada(rotacion)) {
+        return 0;
+    }
+    long tamano = ftell(archivo);
+    if (rotacion->tamano_maximo > 0 && tamano >= rotacion->tamano_maximo) {
+        return 1;
+    }
+    return rotacion->intervalo > 0 && time(NULL) - rotacion->apertura >= rotacion->intervalo && tamano > rotacion->tamano_inicial;
+}
+
+// Función que cierra un fichero de log liberando el espacio reservado que no se ha llegado a usar
+void cerrarFicheroLog(FILE *archivo) {
+    fflush(archivo);
+    if (ftruncate(fileno(archivo), ftell(archivo)) == -1) {
+        fprintf(stderr, "No se ha podido liberar el espacio reservado del fichero de log\n");
+    }
+    fclose(archivo);
+}
+
+// Función que prepara el siguiente fichero de log con el espacio reservado (si LOG_ROTATE_PREALLOCATE=1)
+void prepararSiguienteLog(RotacionLog *rotacion) {
+    if (!rotacion->preasignar || rotacion->siguiente != -1) {
+        return;
+    }
+    char nombre_siguiente[PATH_MAX + 16];
+    snprintf(nombre_siguiente, sizeof(nombre_siguiente), "%s.siguiente", rotacion->nombre);
+    int fd = open(nombre_siguiente, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd == -1) {
+        fprintf(stderr, "Error al preparar el siguiente fichero de log %s\n", nombre_siguiente);
+        return;
+    }
+    // Sin tamaño máximo se reservan 4 MB; si el sistema de ficheros no lo admite se usa igualmente
+    off_t reserva = rotacion->tamano_maximo > 0 ? (off_t)rotacion->tamano_maximo : 4 * 1024 * 1024;
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, reserva) == -1 && errno != EOPNOTSUPP) {
+        fprintf(stderr, "No se ha podido reservar espacio para %s\n", nombre_siguiente);
+    }
+    rotacion->siguiente = fd;
+}
+
+// Función que espera a que termine la compresión del fichero rotado anterior
+static void esperarCompresionLog(RotacionLog *rotacion) {
+    if (rotacion->compresion != 0) {
+        waitpid(rotacion->compresion, NULL, 0);
+        rotacion->compresion = 0;
+    }
+}
+
+// Función que comprime un fichero rotado con gzip en otro proceso
+static void comprimirLogRotado(RotacionLog *rotacion, const char *nombre_rotado) {
+    posix_spawnattr_t atributos;
+    posix_spawnattr_init(&atributos);
+    // gzip no hereda la máscara de señales del hilo escritor (las tiene todas bloqueadas)
+    sigset_t ninguna;
+    sigemptyset(&ninguna);
+    posix_spawnattr_setsigmask(&atributos, &ninguna);
+    posix_spawnattr_setflags(&atributos, POSIX_SPAWN_SETSIGMASK);
+    char *argumentos[] = {"gzip", "-f", (char *)nombre_rotado, NULL};
+    extern char **environ;
+    if (posix_spawnp(&rotacion->compresion, "gzip", NULL, &atributos, argumentos, environ) != 0) {
+        fprintf(stderr, "Error al comprimir el fichero de log %s\n", nombre_rotado);
+        rotacion->compresion = 0;
+    }
+    posix_spawnattr_destroy(&atributos);
+}
+
+/*
+    Función que rota el fichero de log: cierra "archivo", desplaza los ficheros rotados y devuelve el
+    fichero nuevo abierto en "modo" (el preparado con prepararSiguienteLog si lo hay)
+    Si no se puede abrir el fichero nuevo devuelve NULL
+*/
+FILE *rotarLog(RotacionLog *rotacion, FILE *archivo, const char *modo) {
+    if (archivo != NULL) {
+        cerrarFicheroLog(archivo);
+    }
+    // Normalmente ya ha terminado (necesitaRotacionLog no pide rotar mientras tanto)
+    esperarCompresionLog(rotacion);
+
+    // Desplazar los ficheros rotados, del más antiguo al más reciente (comprimidos o no)
+    char origen[PATH_MAX + 32];
+    char destino[PATH_MAX + 32];
+    const char *sufijos[] = {"", ".gz"};
+    for (int i = rotacion->conservar; i >= 1; i--) {
+        for (int j = 0; j < 2; j++) {
+            snprintf(origen, sizeof(origen), "%s.%d%s", rotacion->nombre, i, sufijos[j]);
+            if (i == rotacion->conservar) {
+                unlink(origen);
+            } else {
+                snprintf(destino, sizeof(destino), "%s.%d%s", rotacion->nombre, i + 1, sufijos[j]);
+                rename(origen, destino);
+            }
+        }
+    }
+
+    // El fichero actual pasa a ser nombre.1 sin que desaparezca nombre en ningún momento
+    snprintf(destino, sizeof(destino), "%s.1", rotacion->nombre);
+    if (link(rotacion->nombre, destino) == -1 && errno != ENOENT) {
+        fprintf(stderr, "Error al rotar el fichero de log %s\n", rotacion->nombre);
+    }
+    FILE *nuevo = NULL;
+    if (rotacion->siguiente != -1) {
+        char nombre_siguiente[PATH_MAX + 16];
+        snprintf(nombre_siguiente, sizeof(nombre_siguiente), "%s.siguiente", rotacion->nombre);
+        if (rename(nombre_siguiente, rotacion->nombre) == 0) {
+            nuevo = fdopen(rotacion->siguiente, modo);
+        }
+        if (nuevo == NULL) {
+            close(rotacion->siguiente);
+        }
+        rotacion->siguiente = -1;
+    }
+    if (nuevo == NULL) {
+        // Sin fichero preparado se vacía el actual (ya enlazado como nombre.1)
+        unlink(rotacion->nombre);
+        nuevo = fopen(rotacion->nombre, modo);
+    }
+    rotacion->apertura = time(NULL);
+
+    if (rotacion->comprimir) {
+        comprimirLogRotado(rotacion, destino);
+    }
+    return nuevo;
+}
+
+// Función que libera el fichero preparado y espera a la compresión en curso
+void finalizarRotacionLog(RotacionLog *rotacion) {
+    if (rotacion->siguiente != -1) {
+        char nombre_siguiente[PATH_MAX + 16];
+        snprintf(nombre_siguiente, sizeof(nombre_siguiente), "%s.siguiente", rotacion->nombre);
+        close(rotacion->siguiente);
+        unlink(nombre_siguiente);
+        rotacion->siguiente = -1;
+    }
+    esperarCompresionLog(rotacion);
+}
+#pragma endregion RotacionLog
@@ -0,0 +1,375 @@
+// ------------------------------------------------------------------
+// SEGMENTOS DEL CONSOLIDADO PARTICIONADOS POR FECHA
+// ------------------------------------------------------------------
+
+// truncate no se declara con -std=c99
+#define _DEFAULT_SOURCE
+
+#include "segmentos_consolidados.h"
+#include "log_files.h"
+#include "config_files.h"
+#include "utilidades.h"
+
+#pragma region SegmentosConsolidados
+/*
+    Además del fichero consolidado (o la memoria compartida), cada registro se añade al segmento
+    del día (o de la hora) de su fecha de inicio, en la carpeta SEGMENT_DIRECTORY dentro de PATH_FILES:
+        segmentos/consolidado_20240515.csv      (SEGMENT_PARTITIONING=DIA)
+        segmentos/consolidado_20240515_07.csv   (SEGMENT_PARTITIONING=HORA)
+        segmentos/consolidado_sin_fecha.csv     (registros con la fecha de inicio mal formada)
+
+    Los segmentos tienen el mismo formato de línea que el consolidado, así que quien sólo necesita
+    un rango de fechas (detección por día u hora, consultas, borrado de datos antiguos) puede leer
+    únicamente los segmentos de ese rango.
+
+    El manifiesto (segmentos/manifiesto.csv) tiene una línea por segmento:
+        nombre;inicio;fin;registros;bytes;primer_instante;ultimo_instante
+    con los instantes en segundos desde el 01/01/1970. Se reescribe de forma atómica (fichero temporal
+    y rename) después de cada fichero de sucursal. Al arrancar, los segmentos cuyo tamaño no coincide
+    con el del manifiesto (por ejemplo tras una parada a mitad de fichero) se vuelven a contar.
+
+    Los registros llegan de la misma pasada que los copia al consolidado (iniciarLoteSegmentos,
+    anadirRegistroSegmentos y terminarLoteSegmentos). Si el fichero de sucursal no se consolida, los
+    segmentos se recortan al tamaño que tenían al empezar el lote y el manifiesto queda como estaba.
+*/
+
+// Estado de los segmentos: sólo se modifica entre iniciarLoteSegmentos y terminarLoteSegmentos
+static pthread_mutex_t mutex_segmentos = PTHREAD_MUTEX_INITIALIZER;
+static char directorio_segmentos[PATH_MAX];
+static ParticionadoSegmentos particionado_segmentos = PARTICIONADO_NINGUNO;
+static SegmentoConsolidado *segmentos = NULL;
+static int num_segmentos = 0;
+static int capacidad_segmentos = 0;
+
+// Función que obtiene el segmento de un registro a partir de su fecha de inicio (DD/MM/YYYY HH:MM:SS)
+// Rellena el nombre del segmento, el rango de fechas del segmento y el instante del registro.
+// Si la fecha no tiene el formato esperado el registro va al segmento sin fecha (instante -1)
+static void segmentoRegistro(const char *fechaHora, char *nombre, size_t longitud, long long *inicio, long long *fin, long long *instante) {
+    *instante = convertirFechaHora(fechaHora);
+    if (*instante < 0) {
+        snprintf(nombre, longitud, "consolidado_sin_fecha.csv");
+        *inicio = -1;
+        *fin = -1;
+        return;
+    }
+    // La fecha ya está validada: el nombre se compone con sus dígitos (año, mes, día y hora)
+    if (particionado_segmentos == PARTICIONADO_HORA) {
+        snprintf(nombre, longitud, "consolidado_%.4s%.2s%.2s_%.2s.csv", fechaHora + 6, fechaHora + 3, fechaHora, fechaHora + 11);
+        *inicio = *instante - *instante % 3600;
+        *fin = *inicio + 3600;
+    } else {
+        snprintf(nombre, longitud, "consolidado_%.4s%.2s%.2s.csv", fechaHora + 6, fechaHora + 3, fechaHora);
+        *inicio = *instante - *instante % 86400;
+        *fin = *inicio + 86400;
+    }
+}
+
+// Función que devuelve la entrada del manifiesto de un segmento, creándola si no existe
+// Las entradas se mantienen ordenadas por nombre, que con el formato YYYYMMDD es el orden por fecha
+static SegmentoConsolidado *obtenerSegmento(const char *nombre, long long inicio, long long fin) {
+    int posicion = 0;
+    while (posicion < num_segmentos) {
+        int comparacion = strcmp(segmentos[posicion].nombre, nombre);
+        if (comparacion == 0) {
+            return &segmentos[posicion];
+        }
+        if (comparacion > 0) {
+            break;
+        }
+        posicion++;
+    }
+    if (num_segmentos == capacidad_segmentos) {
+        int capacidad = capacidad_segmentos == 0 ? 32 : capacidad_segmentos * 2;
+        SegmentoConsolidado *nuevos = realloc(segmentos, sizeof(SegmentoConsolidado) * capacidad);
+        if (nuevos == NULL) {
+            return NULL;
+        }
+        segmentos = nuevos;
+        capacidad_segmentos = capacidad;
+    }
+    memmove(&segmentos[posicion + 1], &segmentos[posicion], sizeof(SegmentoConsolidado) * (num_segmentos - posicion));
+    num_segmentos++;
+    SegmentoConsolidado *segmento = &segmentos[posicion];
+    memset(segmento, 0, sizeof(*segmento));
+    snprintf(segmento->nombre, sizeof(segmento->nombre), "%s", nombre);
+    segmento->inicio = inicio;
+    segmento->fin = fin;
+    segmento->primer_instante = -1;
+    segmento->ultimo_instante = -1;
+    return segmento;
+}
+
+// Función que anota un registro en la entrada del manifiesto de su segmento
+static void anotarRegistroSegmento(SegmentoConsolidado *segmento, long long instante, size_t bytes) {
+    segmento->registros++;
+    segmento->bytes += bytes;
+    if (instante >= 0 && (segmento->primer_instante < 0 || instante < segmento->primer_instante)) {
+        segmento->primer_instante = instante;
+    }
+    if (instante > segmento->ultimo_instante) {
+        segmento->ultimo_instante = instante;
+    }
+}
+
+// Función que vuelve a contar los registros de un segmento leyendo su fichero
+static int contarSegmento(const char *nombre) {
+    char ruta[PATH_MAX];
+    snprintf(ruta, sizeof(ruta), "%s/%s", directorio_segmentos, nombre);
+    FILE *fichero = fopen(ruta, "r");
+    if (fichero == NULL) {
+        return -1;
+    }
+    char linea[MAX_LINE_LENGTH];
+    char *campos[NUM_CAMPOS_REGISTRO];
+    char nombre_registro[MAX_NOMBRE_SEGMENTO];
+    long long inicio, fin, instante;
+    SegmentoConsolidado *segmento = NULL;
+    while (fgets(linea, sizeof(linea), fichero) != NULL) {
+        size_t bytes = strlen(linea);
+        separarCamposRegistro(linea, campos);
+        segmentoRegistro(campos[2], nombre_registro, sizeof(nombre_registro), &inicio, &fin, &instante);
+        if (segmento == NULL) {
+            // El rango del segmento se toma del primer registro
+            segmento = obtenerSegmento(nombre, inicio, fin);
+            if (segmento == NULL) {
+                fclose(fichero);
+                return -1;
+            }
+            segmento->registros = 0;
+            segmento->bytes = 0;
+        }
+        anotarRegistroSegmento(segmento, instante, bytes);
+    }
+    fclose(fichero);
+    return 0;
+}
+
+// Función que escribe el manifiesto de forma atómica
+static int guardarManifiesto() {
+    char ruta[PATH_MAX];
+    char ruta_temporal[PATH_MAX];
+    snprintf(ruta, sizeof(ruta), "%s/%s", directorio_segmentos, FICHERO_MANIFIESTO_SEGMENTOS);
+    snprintf(ruta_temporal, sizeof(ruta_temporal), "%s/%s.tmp", directorio_segmentos, FICHERO_MANIFIESTO_SEGMENTOS);
+    FILE *fichero = fopen(ruta_temporal, "w");
+    if (fichero == NULL) {
+        escribirEnLog(LOG_ERROR, "segmentos_consolidados", "Error al crear el manifiesto %s\n", ruta_temporal);
+        return -1;
+    }
+    fprintf(fichero, "# nombre;inicio;fin;registros;bytes;primer_instante;ultimo_instante\n");
+    for (int i = 0; i < num_segmentos; i++) {
+        SegmentoConsolidado *segmento = &segmentos[i];
+        fprintf(fichero, "%s;%lld;%lld;%ld;%lld;%lld;%lld\n", segmento->nombre, segmento->inicio, segmento->fin,
+            segmento->registros, segmento->bytes, segmento->primer_instante, segmento->ultimo_instante);
+    }
+    fclose(fichero);
+    if (rename(ruta_temporal, ruta) != 0) {
+        escribirEnLog(LOG_ERROR, "segmentos_consolidados", "Error al sustituir el manifiesto %s\n", ruta);
+        return -1;
+    }
+    return 0;
+}
+
+// Función que lee el manifiesto y comprueba que cada segmento tiene el tamaño anotado
+// Los segmentos que no coinciden o que no están en el manifiesto se vuelven a contar
+static void cargarManifiesto() {
+    char ruta[PATH_MAX];
+    snprintf(ruta, sizeof(ruta), "%s/%s", directorio_segmentos, FICHERO_MANIFIESTO_SEGMENTOS);
+    FILE *fichero = fopen(ruta, "r");
+    if (fichero != NULL) {
+        char linea[MAX_LINE_LENGTH];
+        while (fgets(linea, sizeof(linea), fichero) != NULL) {
+            if (linea[0] == '#') {
+                continue;
+            }
+            SegmentoConsolidado leido;
+            char formato[50];
+            snprintf(formato, sizeof(formato), "%%%d[^;];%%lld;%%lld;%%ld;%%lld;%%lld;%%lld", MAX_NOMBRE_SEGMENTO - 1);
+            if (sscanf(linea, formato, leido.nombre, &leido.inicio, &leido.fin, &leido.registros,
+                &leido.bytes, &leido.primer_instante, &leido.ultimo_instante) != 7) {
+                continue;
+            }
+            SegmentoConsolidado *segmento = obtenerSegmento(leido.nombre, leido.inicio, leido.fin);
+            if (segmento != NULL) {
+                *segmento = leido;
+            }
+        }
+        fclose(fichero);
+    }
+
+    // Comprobar el manifiesto contra los ficheros de segmento que hay en la carpeta
+    int cambios = 0;
+    for (int i = 0; i < num_segmentos; i++) {
+        struct stat info;
+        snprintf(ruta, sizeof(ruta), "%s/%s", directorio_segmentos, segmentos[i].nombre);
+        if (stat(ruta, &info) != 0) {
+            // El segmento ya no existe
+            memmove(&segmentos[i], &segmentos[i + 1], sizeof(SegmentoConsolidado) * (num_segmentos - i - 1));
+            num_segmentos--;
+            i--;
+            cambios++;
+        }
+    }
+    DIR *dir = opendir(directorio_segmentos);
+    if (dir != NULL) {
+        struct dirent *entrada;
+        while ((entrada = readdir(dir)) != NULL) {
+            size_t longitud = strlen(entrada->d_name);
+            if (strncmp(entrada->d_name, "consolidado_", 12) != 0 || longitud < 4
+                || strcmp(entrada->d_name + longitud - 4, ".csv") != 0 || longitud >= MAX_NOMBRE_SEGMENTO) {
+                continue;
+            }
+            struct stat info;
+            snprintf(ruta, sizeof(ruta), "%s/%s", directorio_segmentos, entrada->d_name);
+            if (stat(ruta, &info) != 0) {
+                continue;
+            }
+            SegmentoConsolidado *segmento = NULL;
+            for (int i = 0; i < num_segmentos; i++) {
+                if (strcmp(segmentos[i].nombre, entrada->d_name) == 0) {
+                    segmento = &segmentos[i];
+                }
+            }
+            if (segmento == NULL || segmento->bytes != (long long)info.st_size) {
+                escribirEnLog(LOG_WARNING, "segmentos_consolidados", "El segmento %s no coincide con el manifiesto, se vuelve a contar\n", entrada->d_name);
+                contarSegmento(entrada->d_name);
+                cambios++;
+            }
+        }
+        closedir(dir);
+    }
+    if (cambios > 0) {
+        guardarManifiesto();
+    }
+}
+
+// Función que prepara la carpeta de segmentos y lee el manifiesto
+// Devuelve 0 o -1 si no se puede crear la carpeta
+int inicializarSegmentosConsolidados(const char *directorio, ParticionadoSegmentos particionado) {
+    pthread_mutex_lock(&mutex_segmentos);
+    snprintf(directorio_segmentos, sizeof(directorio_segmentos), "%s", directorio);
+    particionado_segmentos = particionado;
+    if (particionado == PARTICIONADO_NINGUNO) {
+        pthread_mutex_unlock(&mutex_segmentos);
+        return 0;
+    }
+    struct stat st = {0};
+    if (stat(directorio, &st) == -1 && mkdir(directorio, 0700) != 0) {
+        escribirEnLog(LOG_ERROR, "segmentos_consolidados", "No se puede crear la carpeta de segmentos %s\n", directorio);
+        particionado_segmentos = PARTICIONADO_NINGUNO;
+        pthread_mutex_unlock(&mutex_segmentos);
+        return -1;
+    }
+    cargarManifiesto();
+    escribirEnLog(LOG_INFO, "segmentos_consolidados", "Segmentos por %s en %s: %d segmentos en el manifiesto\n",
+        particionado == PARTICIONADO_HORA ? "hora" : "día", directorio, num_segmentos);
+    pthread_mutex_unlock(&mutex_segmentos);
+    return 0;
+}
+
+// Registros de un fichero de sucursal que se están añadiendo a sus segmentos
+// Los registros de un fichero suelen ser del mismo día: se mantiene abierto el último segmento
+struct LOTE_SEGMENTOS {
+    SegmentoConsolidado *anteriores;    // Manifiesto al empezar el lote, para deshacerlo
+    int num_anteriores;
+    FILE *archivo_segmento;
+    SegmentoConsolidado *segmento;
+    char nombre_abierto[MAX_NOMBRE_SEGMENTO];
+    int num_registros;
+    int resultado;                      // -1 si no se ha podido abrir algún segmento
+};
+
+// Función que empieza a añadir los registros de un fichero de sucursal a sus segmentos
+// Devuelve el lote o NULL si no hay segmentos. Los segmentos quedan reservados hasta terminarLoteSegmentos
+LoteSegmentos *iniciarLoteSegmentos() {
+    pthread_mutex_lock(&mutex_segmentos);
+    if (particionado_segmentos == PARTICIONADO_NINGUNO) {
+        pthread_mutex_unlock(&mutex_segmentos);
+        return NULL;
+    }
+    LoteSegmentos *lote = calloc(1, sizeof(LoteSegmentos));
+    lote->anteriores = malloc(sizeof(SegmentoConsolidado) * (num_segmentos > 0 ? num_segmentos : 1));
+    memcpy(lote->anteriores, segmentos, sizeof(SegmentoConsolidado) * num_segmentos);
+    lote->num_anteriores = num_segmentos;
+    return lote;
+}
+
+// Función que añade una línea del consolidado (SUCURSAL;registro) al segmento de su fecha de inicio
+void anadirRegistroSegmentos(LoteSegmentos *lote, int id_hilo, const char *linea, const char *fechaHora) {
+    if (lote == NULL || lote->resultado != 0) {
+        return;
+    }
+    char nombre[MAX_NOMBRE_SEGMENTO];
+    char ruta[PATH_MAX];
+    long long inicio, fin, instante;
+    segmentoRegistro(fechaHora, nombre, sizeof(nombre), &inicio, &fin, &instante);
+
+    if (lote->archivo_segmento == NULL || strcmp(nombre, lote->nombre_abierto) != 0) {
+        if (lote->archivo_segmento != NULL) {
+            fclose(lote->archivo_segmento);
+        }
+        snprintf(ruta, sizeof(ruta), "%s/%s", directorio_segmentos, nombre);
+        lote->archivo_segmento = fopen(ruta, "a");
+        lote->segmento = obtenerSegmento(nombre, inicio, fin);
+        if (lote->archivo_segmento == NULL || lote->segmento == NULL) {
+            escribirEnLog(LOG_ERROR, "segmentos_consolidados", "Hilo %02d: Error al abrir el segmento %s\n", id_hilo, ruta);
+            lote->resultado = -1;
+            return;
+        }
+        snprintf(lote->nombre_abierto, sizeof(lote->nombre_abierto), "%s", nombre);
+    }
+    fputs(linea, lote->archivo_segmento);
+    anotarRegistroSegmento(lote->segmento, instante, strlen(linea));
+    lote->num_registros++;
+}
+
+// Función que deja los segmentos y su manifiesto en memoria como estaban al empezar el lote
+static void deshacerLoteSegmentos(int id_hilo, const LoteSegmentos *lote) {
+    char ruta[PATH_MAX];
+    for (int i = 0; i < num_segmentos; i++) {
+        long long bytes = 0;
+        for (int j = 0; j < lote->num_anteriores; j++) {
+            if (strcmp(lote->anteriores[j].nombre, segmentos[i].nombre) == 0) {
+                bytes = lote->anteriores[j].bytes;
+            }
+        }
+        if (bytes == segmentos[i].bytes) {
+            continue;
+        }
+        snprintf(ruta, sizeof(ruta), "%s/%s", directorio_segmentos, segmentos[i].nombre);
+        if ((bytes == 0 ? remove(ruta) : truncate(ruta, bytes)) != 0) {
+            escribirEnLog(LOG_ERROR, "segmentos_consolidados", "Hilo %02d: Error al recortar el segmento %s a %lld bytes\n", id_hilo, ruta, bytes);
+        }
+    }
+    memcpy(segmentos, lote->anteriores, sizeof(SegmentoConsolidado) * lote->num_anteriores);
+    num_segmentos = lote->num_anteriores;
+}
+
+// Función que termina el lote: cierra el último segmento, actualiza el manifiesto y libera el lote
+// Si correcto es 0 (el fichero no se ha podido consolidar) se deshacen los registros añadidos
+// Devuelve el número de registros añadidos o -1 en caso de error
+int terminarLoteSegmentos(int id_hilo, LoteSegmentos *lote, const char *archivo_origen, int correcto) {
+    if (lote == NULL) {
+        return 0;
+    }
+    if (lote->archivo_segmento != NULL) {
+        fclose(lote->archivo_segmento);
+    }
+    int resultado = lote->resultado;
+    int num_registros = lote->num_registros;
+    if (!correcto) {
+        deshacerLoteSegmentos(id_hilo, lote);
+        num_registros = 0;
+    } else {
+        if (guardarManifiesto() != 0) {
+            resultado = -1;
+        }
+        escribirEnLog(LOG_INFO, "segmentos_consolidados", "Hilo %02d: %d registros de %s añadidos a los segmentos (%d segmentos)\n",
+            id_hilo, num_registros, archivo_origen, num_segmentos);
+    }
+    free(lote->anteriores);
+    free(lote);
+    pthread_mutex_unlock(&mutex_segmentos);
+    return resultado == 0 ? num_registros : -1;
+}
+
+#pragma endregion SegmentosConsolidados
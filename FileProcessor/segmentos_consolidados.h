@@ -0,0 +1,49 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <pthread.h>        // Tratamiento de hilos y mutex
+#include <sys/stat.h>       // Definiciones y estructuras para trabajar con estados de archivos Linux
+#include <dirent.h>         // Definiciones y estructuras necesarias para trabajar con directorios en Linux
+#include <linux/limits.h>   // Define varias constantes que representan los límites del sistema en sistemas operativos Linux
+
+#include "constants.h"      // Constantes de la aplicación
+#include "utilidades.h"     // Campos de una línea del consolidado
+#pragma endregion Librerias
+
+
+// Tamaño de las particiones de los segmentos (SEGMENT_PARTITIONING)
+typedef enum PARTICIONADO_SEGMENTOS {
+    PARTICIONADO_NINGUNO,   // Sólo el fichero consolidado
+    PARTICIONADO_DIA,       // Un segmento por día: consolidado_20240515.csv
+    PARTICIONADO_HORA       // Un segmento por hora: consolidado_20240515_07.csv
+} ParticionadoSegmentos;
+
+// Entrada del manifiesto de un segmento
+// Un segmento contiene los registros cuya fecha de inicio está en [inicio, fin)
+typedef struct SEGMENTO_CONSOLIDADO {
+    char nombre[MAX_NOMBRE_SEGMENTO];
+    long long inicio;               // Segundos desde 01/01/1970 (-1 en el segmento de registros sin fecha)
+    long long fin;
+    long registros;
+    long long bytes;                // El segmento ocupa los bytes [0, bytes) del fichero
+    long long primer_instante;      // Menor y mayor fecha de inicio de los registros del segmento
+    long long ultimo_instante;
+} SegmentoConsolidado;
+
+// Registros de un fichero de sucursal que se están añadiendo a sus segmentos (ver segmentos_consolidados.c)
+typedef struct LOTE_SEGMENTOS LoteSegmentos;
+
+
+int inicializarSegmentosConsolidados(const char *directorio, ParticionadoSegmentos particionado);
+
+LoteSegmentos *iniciarLoteSegmentos();
+
+void anadirRegistroSegmentos(LoteSegmentos *lote, int id_hilo, const char *linea, const char *fechaHora);
+
+int terminarLoteSegmentos(int id_hilo, LoteSegmentos *lote, const char *archivo_origen, int correcto);
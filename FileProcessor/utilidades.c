@@ -2,9 +2,13 @@
 // FUNCIONES UTILES
 // ------------------------------------------------------------------
 
+// localtime_r no se declara con -std=c99
+#define _DEFAULT_SOURCE
+
 #include "utilidades.h"
 #include "log_files.h"
 #include "config_files.h"
+#include "parametros_configuracion.h"
 
 #pragma region Utilidades
 
@@ -20,14 +24,9 @@ void sleep_centiseconds(int n) {
 
 // Función que simula un retardo según los parámetros del fichero de configuración
 void simulaRetardo(const char* mensaje) {
-    int retardoMin;
-    int retardoMax;
-    const char* retardoMinTexto;
-    const char* retardoMaxTexto;
-    retardoMinTexto = obtener_valor_configuracion("SIMULATE_SLEEP_MIN", "1");
-    retardoMaxTexto = obtener_valor_configuracion("SIMULATE_SLEEP_MAX", "2");
-    retardoMin = atoi(retardoMinTexto);
-    retardoMax = atoi(retardoMaxTexto);
+    const ParametrosConfiguracion *parametros = obtenerParametros();
+    int retardoMin = parametros->retardo_minimo;
+    int retardoMax = parametros->retardo_maximo;
     int retardo;
 
     // Inicializamos la semilla para generar números aleatorios
@@ -41,42 +40,121 @@ void simulaRetardo(const char* mensaje) {
 
 }
 
-// Función para obtener la hora actual en formato HH:MM
-char* obtener_hora_actual() {
-    // Variable local para almacenar la hora actual
-    static char hora_actual[10]; // "HH:MM:SS\0"
-
-    // Obtener la hora actual
-    time_t rawtime;
-    struct tm *timeinfo;
-
-    time(&rawtime);
-    timeinfo = localtime(&rawtime);
-
-    // Formatear la hora actual como "HH:MM"
-    strftime(hora_actual, sizeof(hora_actual), "%H:%M:%S", timeinfo);
+// Fecha y hora formateadas del último segundo que ha pedido cada hilo
+// Cada hilo tiene la suya, así que no hace falta mutex y localtime_r (que coge el bloqueo de la zona horaria)
+// se llama como mucho una vez por segundo y por hilo
+static __thread FechaHoraFormateada fecha_hora_hilo = {-1, "", "", ""};
+
+// Función que devuelve la fecha y hora de un segundo formateadas en los formatos de la aplicación
+// El resultado es del hilo que llama y vale hasta que ese hilo pide otro segundo
+const FechaHoraFormateada *obtenerFechaHoraFormateada(time_t segundo) {
+    if (segundo != fecha_hora_hilo.segundo) {
+        struct tm infoTiempo;
+        localtime_r(&segundo, &infoTiempo);
+        strftime(fecha_hora_hilo.fecha_hora, sizeof(fecha_hora_hilo.fecha_hora), "%Y-%m-%d %H:%M:%S", &infoTiempo);
+        strftime(fecha_hora_hilo.fecha_hora2, sizeof(fecha_hora_hilo.fecha_hora2), "%Y-%m-%d:::%H:%M:%S", &infoTiempo);
+        strftime(fecha_hora_hilo.hora, sizeof(fecha_hora_hilo.hora), "%H:%M:%S", &infoTiempo);
+        fecha_hora_hilo.segundo = segundo;
+    }
+    return &fecha_hora_hilo;
+}
 
-    return hora_actual;
+// Función para obtener la hora actual en formato HH:MM:SS
+// hora_actual tiene que tener sitio para 9 caracteres y el '\0'
+void obtener_hora_actual(char *hora_actual) {
+    strcpy(hora_actual, obtenerFechaHoraFormateada(time(NULL))->hora);
 }
 
 // Función para obtener la fecha y hora actual (MODELO ESTÁNDAR)
 void obtenerFechaHora(char *fechaHora) {
-    time_t tiempoActual;
-    struct tm *infoTiempo;
-
-    time(&tiempoActual);
-    infoTiempo = localtime(&tiempoActual);
-    strftime(fechaHora, 20, "%Y-%m-%d %H:%M:%S", infoTiempo);
+    strcpy(fechaHora, obtenerFechaHoraFormateada(time(NULL))->fecha_hora);
 }
 
 // Función para obtener la fecha y hora actual (MODELO PEDIDO POR MARLON)
 void obtenerFechaHora2(char *fechaHora2) {
-    time_t tiempoActual;
-    struct tm *infoTiempo;
+    strcpy(fechaHora2, obtenerFechaHoraFormateada(time(NULL))->fecha_hora2);
+}
+
+// Función para obtener el instante actual en milisegundos según un reloj monotónico
+// No le afectan los cambios de hora del sistema, así que sirve para medir intervalos
+long long obtener_milisegundos_monotonicos() {
+    return obtener_nanosegundos_monotonicos() / 1000000;
+}
+
+// Función para obtener el instante actual en nanosegundos según un reloj monotónico
+long long obtener_nanosegundos_monotonicos() {
+    struct timespec instante;
+    clock_gettime(CLOCK_MONOTONIC, &instante);
+    return (long long)instante.tv_sec * 1000000000LL + instante.tv_nsec;
+}
+
+
+// Función que convierte los dígitos de una cadena en un número (-1 si algún carácter no es un dígito)
+static int convertirDigitos(const char *cadena, int num_digitos) {
+    int valor = 0;
+    for (int i = 0; i < num_digitos; i++) {
+        if (cadena[i] < '0' || cadena[i] > '9') {
+            return -1;
+        }
+        valor = valor * 10 + (cadena[i] - '0');
+    }
+    return valor;
+}
+
+// Función que calcula los días transcurridos desde el 01/01/1970 hasta una fecha del calendario gregoriano
+static long long diasDesdeEpoca(int anio, int mes, int dia) {
+    anio -= mes <= 2;
+    long long era = (anio >= 0 ? anio : anio - 399) / 400;
+    long long anio_era = anio - era * 400;
+    long long dia_anio = (153 * (mes + (mes > 2 ? -3 : 9)) + 2) / 5 + dia - 1;
+    long long dia_era = anio_era * 365 + anio_era / 4 - anio_era / 100 + dia_anio;
+    return era * 146097 + dia_era - 719468;
+}
+
+// Función que convierte una fecha-hora con formato DD/MM/YYYY HH:MM:SS en segundos desde el 01/01/1970
+// La hora se trata como hora local sin zona horaria (igual que en Monitor)
+// Devuelve -1 si la fecha-hora no tiene el formato esperado
+long long convertirFechaHora(const char *fechaHora) {
+    if (fechaHora == NULL || strlen(fechaHora) < 19
+        || fechaHora[2] != '/' || fechaHora[5] != '/' || fechaHora[10] != ' '
+        || fechaHora[13] != ':' || fechaHora[16] != ':') {
+        return -1;
+    }
+    int dia = convertirDigitos(fechaHora, 2);
+    int mes = convertirDigitos(fechaHora + 3, 2);
+    int anio = convertirDigitos(fechaHora + 6, 4);
+    int hora = convertirDigitos(fechaHora + 11, 2);
+    int minuto = convertirDigitos(fechaHora + 14, 2);
+    int segundo = convertirDigitos(fechaHora + 17, 2);
+    if (dia < 1 || mes < 1 || mes > 12 || anio < 0 || hora < 0 || hora > 23 || minuto < 0 || segundo < 0) {
+        return -1;
+    }
+    return diasDesdeEpoca(anio, mes, dia) * 86400 + hora * 3600 + minuto * 60 + segundo;
+}
 
-    time(&tiempoActual);
-    infoTiempo = localtime(&tiempoActual);
-    strftime(fechaHora2, 25, "%Y-%m-%d:::%H:%M:%S", infoTiempo);
+// Función que separa una línea SUCURSAL;OPERACION;FECHA1;FECHA2;USUARIO;TIPO1;TIPO2;IMPORTE;ESTADO en sus campos
+// Modifica la línea: los separadores y el salto de línea final se sustituyen por '\0' y los campos que faltan
+// quedan vacíos. Devuelve 0 o -1 si a la línea le faltan campos (Monitor tampoco la tendría en cuenta)
+int separarCamposRegistro(char *linea, char *campos[NUM_CAMPOS_REGISTRO]) {
+    char *fin = linea + strlen(linea);
+    while (fin > linea && (fin[-1] == '\n' || fin[-1] == '\r')) {
+        *--fin = '\0';
+    }
+    int num_campos = 0;
+    char *inicio = linea;
+    while (num_campos < NUM_CAMPOS_REGISTRO) {
+        campos[num_campos++] = inicio;
+        char *separador = strchr(inicio, ';');
+        if (separador == NULL) {
+            break;
+        }
+        *separador = '\0';
+        inicio = separador + 1;
+    }
+    for (int i = num_campos; i < NUM_CAMPOS_REGISTRO; i++) {
+        campos[i] = fin;
+    }
+    return num_campos == NUM_CAMPOS_REGISTRO ? 0 : -1;
 }
 
 
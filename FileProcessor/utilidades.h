@@ -18,12 +18,33 @@
 #include <linux/limits.h>   // Define varias constantes que representan los límites del sistema en sistemas operativos Linux
 #include <fcntl.h>          // Proporciona funciones y constantes para controlar archivos y descriptores de archivo en Linux
 
+// Campos de una línea del consolidado: SUCURSAL;OPERACION;FECHA1;FECHA2;USUARIO;TIPO1;TIPO2;IMPORTE;ESTADO
+#define NUM_CAMPOS_REGISTRO 9
+
+// Fecha y hora de un segundo ya formateadas (ver obtenerFechaHoraFormateada)
+typedef struct FECHA_HORA_FORMATEADA {
+    time_t segundo;             // Segundo formateado (segundos desde 01/01/1970)
+    char fecha_hora[20];        // "%Y-%m-%d %H:%M:%S"
+    char fecha_hora2[25];       // "%Y-%m-%d:::%H:%M:%S"
+    char hora[10];              // "%H:%M:%S"
+} FechaHoraFormateada;
+
 void sleep_centiseconds(int n);
 
 void simulaRetardo(const char* mensaje);
 
-char* obtener_hora_actual();
+void obtener_hora_actual(char *hora_actual);
+
+const FechaHoraFormateada *obtenerFechaHoraFormateada(time_t segundo);
 
 void obtenerFechaHora(char *fechaHora);
 
 void obtenerFechaHora2(char *fechaHora2);
+
+long long obtener_milisegundos_monotonicos();
+
+long long obtener_nanosegundos_monotonicos();
+
+long long convertirFechaHora(const char *fechaHora);
+
+int separarCamposRegistro(char *linea, char *campos[NUM_CAMPOS_REGISTRO]);
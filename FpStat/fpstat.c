@@ -0,0 +1,315 @@
+/**
+fpstat.c
+
+    Funcionalidad:
+        Muestra las métricas que publican FileProcessor y Monitor en memoria compartida (SHARED_METRICS=1):
+        contadores de cada serie (sucursal o patrón) e histogramas de duración con media y percentiles.
+        Sólo lee las páginas: no bloquea ni ralentiza a los procesos.
+        Sin intervalo muestra los totales desde que arrancó cada proceso; con intervalo muestra cada
+        cierto tiempo el ritmo por segundo de los contadores y los histogramas del intervalo (el máximo
+        de cada histograma es siempre el de todo el tiempo que lleva en marcha el proceso).
+
+    Compilación:
+        make
+
+    Ejecución:
+        ./fpstat
+        ./fpstat -i 5
+        ./fpstat -i 1 -n 10 /metricas_fileprocessor10
+
+    Parámetros:
+        -i segundos: intervalo entre consultas (0: una consulta con los totales)
+        -n veces: número de consultas con intervalo (por defecto, hasta pulsar CTRL-C)
+        Nombres de las páginas (opcional, si no se indican se lee SHARED_METRICS_NAME de
+        conf/fp.conf y conf/mo.conf, o se usan los nombres por defecto)
+*/
+
+// kill, shm_open y getopt no se declaran con -std=c99
+#define _DEFAULT_SOURCE
+
+#include "fpstat.h"         // Declaración de funciones de este módulo
+
+// ------------------------------------------------------------------
+// LECTURA DE LAS PÁGINAS DE MÉTRICAS
+// ------------------------------------------------------------------
+#pragma region LecturaMetricas
+
+// Función que lee SHARED_METRICS_NAME de un fichero de configuración
+// Devuelve el nombre (hay que liberarlo) o una copia de valor_por_defecto si no está
+static char *leerNombrePagina(const char *fichero_configuracion, const char *valor_por_defecto) {
+    const char *clave = "SHARED_METRICS_NAME=";
+    char linea[256];
+    FILE *archivo = fopen(fichero_configuracion, "r");
+    if (archivo != NULL) {
+        while (fgets(linea, sizeof(linea), archivo) != NULL) {
+            if (strncmp(linea, clave, strlen(clave)) == 0) {
+                char *valor = linea + strlen(clave);
+                valor[strcspn(valor, " \t\r\n")] = '\0';
+                fclose(archivo);
+                return strdup(valor);
+            }
+        }
+        fclose(archivo);
+    }
+    return strdup(valor_por_defecto);
+}
+
+// Función que proyecta (sólo lectura) la página de métricas de la consulta
+// Devuelve 0 o -1 si la página no existe o no tiene el formato de este fpstat
+int abrirPaginaMetricas(ConsultaMetricas *consulta) {
+    consulta->pagina = NULL;
+    int fd = shm_open(consulta->nombre, O_RDONLY, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1 || (size_t)info.st_size < sizeof(PaginaMetricas)) {
+        close(fd);
+        return -1;
+    }
+    const PaginaMetricas *pagina = mmap(0, sizeof(PaginaMetricas), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pagina == MAP_FAILED) {
+        return -1;
+    }
+    if (memcmp(pagina->magia, MAGIA_METRICAS, LONGITUD_MAGIA_METRICAS) != 0 || pagina->tamano_serie != sizeof(SerieMetricas)) {
+        munmap((void *)pagina, sizeof(PaginaMetricas));
+        return -1;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    consulta->pagina = pagina;
+    return 0;
+}
+
+// Función que copia una serie de la página (cada contador se lee de forma atómica)
+static void copiarSerie(const SerieMetricas *origen, SerieMetricas *destino) {
+    memcpy(destino->nombre, origen->nombre, sizeof(destino->nombre));
+    destino->nombre[LONGITUD_NOMBRE_METRICA - 1] = '\0';
+    for (int i = 0; i < MAX_CONTADORES_METRICAS; i++) {
+        destino->contadores[i] = __atomic_load_n(&origen->contadores[i], __ATOMIC_RELAXED);
+    }
+    for (int h = 0; h < MAX_HISTOGRAMAS_METRICAS; h++) {
+        for (int c = 0; c < NUM_CUBOS_METRICAS; c++) {
+            destino->histogramas[h].cubos[c] = __atomic_load_n(&origen->histogramas[h].cubos[c], __ATOMIC_RELAXED);
+        }
+        destino->histogramas[h].suma_ns = __atomic_load_n(&origen->histogramas[h].suma_ns, __ATOMIC_RELAXED);
+        destino->histogramas[h].maximo_ns = __atomic_load_n(&origen->histogramas[h].maximo_ns, __ATOMIC_RELAXED);
+    }
+}
+#pragma endregion LecturaMetricas
+
+// ------------------------------------------------------------------
+// PRESENTACIÓN DE LAS MÉTRICAS
+// ------------------------------------------------------------------
+#pragma region PresentacionMetricas
+
+// Función que escribe un texto ajustado a la izquierda en "ancho" caracteres
+// (printf cuenta bytes y los nombres con tildes ocupan más bytes que caracteres en UTF-8)
+static void imprimirColumna(const char *texto, int ancho) {
+    int caracteres = 0;
+    for (const char *c = texto; *c != '\0'; c++) {
+        if (((unsigned char)*c & 0xC0) != 0x80) {
+            caracteres++;
+        }
+    }
+    printf("%s%*s", texto, ancho > caracteres ? ancho - caracteres : 0, "");
+}
+
+// Función que devuelve el número de duraciones de un histograma
+static uint64_t totalHistograma(const HistogramaMetricas *histograma) {
+    uint64_t total = 0;
+    for (int c = 0; c < NUM_CUBOS_METRICAS; c++) {
+        total += histograma->cubos[c];
+    }
+    return total;
+}
+
+// Función que devuelve el percentil (0-100) de un histograma en milisegundos (límite superior del cubo)
+static double percentilHistograma(const HistogramaMetricas *histograma, uint64_t total, int percentil) {
+    uint64_t objetivo = (total * percentil + 99) / 100;
+    uint64_t acumulado = 0;
+    for (int c = 0; c < NUM_CUBOS_METRICAS; c++) {
+        acumulado += histograma->cubos[c];
+        if (acumulado >= objetivo && acumulado > 0) {
+            return limiteCuboMetricas(c) / 1000000.0;
+        }
+    }
+    return 0;
+}
+
+// Función que muestra los contadores y los histogramas de una página
+// Con intervalo los contadores acumulados se muestran por segundo y los histogramas sólo con las
+// duraciones del intervalo (diferencia con la consulta anterior)
+void mostrarPaginaMetricas(ConsultaMetricas *consulta, int intervalo) {
+    const PaginaMetricas *pagina = consulta->pagina;
+    if (pagina == NULL && abrirPaginaMetricas(consulta) != 0) {
+        printf("== %s: no hay métricas (¿proceso parado o SHARED_METRICS=0?) ==\n\n", consulta->nombre);
+        return;
+    }
+    pagina = consulta->pagina;
+
+    char inicio[32];
+    time_t inicio_s = (time_t)pagina->inicio_s;
+    strftime(inicio, sizeof(inicio), "%Y-%m-%d %H:%M:%S", localtime(&inicio_s));
+    int en_marcha = kill((pid_t)pagina->pid, 0) == 0;
+    printf("== %s (%s) pid %lld desde %s%s ==\n", pagina->proceso, consulta->nombre, (long long)pagina->pid, inicio,
+        en_marcha ? "" : " (terminado)");
+
+    uint32_t num_series = __atomic_load_n(&pagina->num_series, __ATOMIC_ACQUIRE);
+    uint32_t num_contadores = pagina->num_contadores < MAX_CONTADORES_METRICAS ? pagina->num_contadores : MAX_CONTADORES_METRICAS;
+    uint32_t num_histogramas = pagina->num_histogramas < MAX_HISTOGRAMAS_METRICAS ? pagina->num_histogramas : MAX_HISTOGRAMAS_METRICAS;
+    if (num_series > MAX_SERIES_METRICAS) {
+        num_series = MAX_SERIES_METRICAS;
+    }
+
+    // Copia de las series y diferencia con la consulta anterior
+    SerieMetricas *actuales = calloc(num_series > 0 ? num_series : 1, sizeof(SerieMetricas));
+    SerieMetricas *diferencias = calloc(num_series > 0 ? num_series : 1, sizeof(SerieMetricas));
+    if (actuales == NULL || diferencias == NULL) {
+        fprintf(stderr, "Sin memoria para copiar las métricas\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t s = 0; s < num_series; s++) {
+        copiarSerie(&pagina->series[s], &actuales[s]);
+        diferencias[s] = actuales[s];
+        if (intervalo > 0) {
+            const SerieMetricas *anterior = &consulta->anteriores[s];
+            for (uint32_t i = 0; i < num_contadores; i++) {
+                if (pagina->tipos_contadores[i] == CONTADOR_ACUMULADO) {
+                    diferencias[s].contadores[i] -= anterior->contadores[i];
+                }
+            }
+            for (uint32_t h = 0; h < num_histogramas; h++) {
+                for (int c = 0; c < NUM_CUBOS_METRICAS; c++) {
+                    diferencias[s].histogramas[h].cubos[c] -= anterior->histogramas[h].cubos[c];
+                }
+                diferencias[s].histogramas[h].suma_ns -= anterior->histogramas[h].suma_ns;
+            }
+        }
+    }
+
+    // Contadores
+    imprimirColumna("serie", 24);
+    for (uint32_t i = 0; i < num_contadores; i++) {
+        char cabecera[LONGITUD_NOMBRE_METRICA + 4];
+        snprintf(cabecera, sizeof(cabecera), "%.*s%s", LONGITUD_NOMBRE_METRICA - 1, pagina->nombres_contadores[i],
+            intervalo > 0 && pagina->tipos_contadores[i] == CONTADOR_ACUMULADO ? "/s" : "");
+        printf(" %14s", cabecera);
+    }
+    printf("\n");
+    double totales[MAX_CONTADORES_METRICAS] = {0};
+    for (uint32_t s = 0; s < num_series; s++) {
+        imprimirColumna(actuales[s].nombre, 24);
+        for (uint32_t i = 0; i < num_contadores; i++) {
+            double valor = (double)diferencias[s].contadores[i];
+            if (intervalo > 0 && pagina->tipos_contadores[i] == CONTADOR_ACUMULADO) {
+                valor /= intervalo;
+            }
+            totales[i] += valor;
+            printf(" %14.*f", intervalo > 0 && pagina->tipos_contadores[i] == CONTADOR_ACUMULADO ? 1 : 0, valor);
+        }
+        printf("\n");
+    }
+    imprimirColumna("total", 24);
+    for (uint32_t i = 0; i < num_contadores; i++) {
+        printf(" %14.*f", intervalo > 0 && pagina->tipos_contadores[i] == CONTADOR_ACUMULADO ? 1 : 0, totales[i]);
+    }
+    printf("\n\n");
+
+    // Histogramas (sólo las series con alguna duración)
+    if (num_histogramas > 0) {
+        printf("%-20s %-24s %10s %12s %12s %12s %13s\n", "histograma", "serie", "n", "media ms", "p50 ms", "p99 ms", "máx ms");
+    }
+    for (uint32_t h = 0; h < num_histogramas; h++) {
+        for (uint32_t s = 0; s < num_series; s++) {
+            const HistogramaMetricas *histograma = &diferencias[s].histogramas[h];
+            uint64_t total = totalHistograma(histograma);
+            if (total == 0) {
+                continue;
+            }
+            imprimirColumna(pagina->nombres_histogramas[h], 21);
+            imprimirColumna(actuales[s].nombre, 24);
+            printf(" %10llu %12.3f %12.3f %12.3f %12.3f\n", (unsigned long long)total, histograma->suma_ns / 1000000.0 / total,
+                percentilHistograma(histograma, total, 50), percentilHistograma(histograma, total, 99),
+                histograma->maximo_ns / 1000000.0);
+        }
+    }
+    printf("\n");
+
+    memcpy(consulta->anteriores, actuales, num_series * sizeof(SerieMetricas));
+    free(actuales);
+    free(diferencias);
+}
+#pragma endregion PresentacionMetricas
+
+
+int main(int argc, char *argv[]) {
+    int intervalo = 0;
+    int veces = -1;
+    int opcion;
+    while ((opcion = getopt(argc, argv, "i:n:")) != -1) {
+        switch (opcion) {
+            case 'i':
+                intervalo = atoi(optarg);
+                break;
+            case 'n':
+                veces = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Uso: %s [-i segundos] [-n veces] [nombre_pagina ...]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    ConsultaMetricas consultas[MAX_PAGINAS_FPSTAT];
+    int num_consultas = 0;
+    if (optind < argc) {
+        for (int i = optind; i < argc && num_consultas < MAX_PAGINAS_FPSTAT; i++) {
+            consultas[num_consultas++].nombre = argv[i];
+        }
+    } else {
+        consultas[num_consultas++].nombre = leerNombrePagina(FICHERO_CONFIGURACION_FP, NOMBRE_METRICAS_FILEPROCESSOR);
+        consultas[num_consultas++].nombre = leerNombrePagina(FICHERO_CONFIGURACION_MO, NOMBRE_METRICAS_MONITOR);
+    }
+    for (int i = 0; i < num_consultas; i++) {
+        consultas[i].pagina = NULL;
+        consultas[i].anteriores = calloc(MAX_SERIES_METRICAS, sizeof(SerieMetricas));
+        if (consultas[i].anteriores == NULL) {
+            fprintf(stderr, "Sin memoria para las métricas\n");
+            return EXIT_FAILURE;
+        }
+        abrirPaginaMetricas(&consultas[i]);
+    }
+
+    if (intervalo <= 0) {
+        for (int i = 0; i < num_consultas; i++) {
+            mostrarPaginaMetricas(&consultas[i], 0);
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // Primera consulta para tener la referencia del intervalo
+    for (int i = 0; i < num_consultas; i++) {
+        if (consultas[i].pagina != NULL) {
+            uint32_t num_series = __atomic_load_n(&consultas[i].pagina->num_series, __ATOMIC_ACQUIRE);
+            for (uint32_t s = 0; s < num_series && s < MAX_SERIES_METRICAS; s++) {
+                copiarSerie(&consultas[i].pagina->series[s], &consultas[i].anteriores[s]);
+            }
+        }
+    }
+    while (veces != 0) {
+        sleep(intervalo);
+        char hora[16];
+        time_t ahora = time(NULL);
+        strftime(hora, sizeof(hora), "%H:%M:%S", localtime(&ahora));
+        printf("---- %s (últimos %d s) ----\n", hora, intervalo);
+        for (int i = 0; i < num_consultas; i++) {
+            mostrarPaginaMetricas(&consultas[i], intervalo);
+        }
+        fflush(stdout);
+        if (veces > 0) {
+            veces--;
+        }
+    }
+    return EXIT_SUCCESS;
+}
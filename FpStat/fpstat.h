@@ -0,0 +1,38 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <time.h>           // Tratamiento de datos temporales
+#include <stdint.h>         // Enteros de tamaño fijo de la página de métricas
+#include <unistd.h>         // sleep, getopt
+#include <signal.h>         // kill para saber si el proceso sigue en marcha
+#include <fcntl.h>          // O_RDONLY
+#include <sys/mman.h>       // shm_open, mmap
+#include <sys/stat.h>       // fstat
+
+#include "metricas_compartidas.h"   // Formato de la página de métricas
+#pragma endregion Librerias
+
+// Máximo de páginas que se consultan a la vez
+#define MAX_PAGINAS_FPSTAT 8
+
+// Ficheros de configuración de los que se leen los nombres de las páginas si no se indican
+#define FICHERO_CONFIGURACION_FP "conf/fp.conf"
+#define FICHERO_CONFIGURACION_MO "conf/mo.conf"
+
+// Página de métricas abierta y copia de sus series en la consulta anterior
+typedef struct CONSULTA_METRICAS {
+    const char *nombre;
+    const PaginaMetricas *pagina;       // NULL si no se ha podido abrir
+    SerieMetricas *anteriores;          // MAX_SERIES_METRICAS series (a cero antes de la primera consulta)
+} ConsultaMetricas;
+
+
+int abrirPaginaMetricas(ConsultaMetricas *consulta);
+
+void mostrarPaginaMetricas(ConsultaMetricas *consulta, int intervalo);
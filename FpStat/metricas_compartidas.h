@@ -0,0 +1,87 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdint.h>         // Enteros de tamaño fijo de la página de métricas
+#pragma endregion Librerias
+
+/*
+    Formato de la página de métricas en memoria compartida (SHARED_METRICS=1)
+    Este fichero tiene que ser igual en FileProcessor, Monitor y FpStat
+
+    Cada proceso crea su página (SHARED_METRICS_NAME) con una cabecera PaginaMetricas y hasta
+    MAX_SERIES_METRICAS series. Una serie es lo que cuenta un hilo (una sucursal en FileProcessor,
+    un patrón en Monitor): sólo la escribe ese hilo, con sumas atómicas relajadas y sin bloqueos, y cada
+    serie ocupa sus propias líneas de caché. fpstat lee la página sin bloquear a los procesos.
+    Todas las series de una página tienen los mismos contadores e histogramas (nombres en la cabecera).
+*/
+
+// Nombres por defecto de las páginas (clave SHARED_METRICS_NAME)
+#define NOMBRE_METRICAS_FILEPROCESSOR "/metricas_fileprocessor"
+#define NOMBRE_METRICAS_MONITOR "/metricas_monitor"
+
+#define MAGIA_METRICAS "FPMET01\n"
+#define LONGITUD_MAGIA_METRICAS 8
+
+#define MAX_SERIES_METRICAS 1024
+#define MAX_CONTADORES_METRICAS 8
+#define MAX_HISTOGRAMAS_METRICAS 2
+#define LONGITUD_NOMBRE_METRICA 32
+
+// Cubos de los histogramas de duración: el cubo i cuenta las duraciones de [2^(i-1), 2^i) microsegundos
+// (el cubo 0 las menores de 1 microsegundo y el último todas las que no caben en los anteriores)
+#define NUM_CUBOS_METRICAS 32
+
+// Tipos de contador
+typedef enum TIPO_CONTADOR_METRICAS {
+    CONTADOR_ACUMULADO = 0,     // Sólo aumenta (fpstat calcula su ritmo por segundo)
+    CONTADOR_VALOR              // Último valor (p.ej. claves de un diccionario)
+} TipoContadorMetricas;
+
+// Histograma de duraciones
+typedef struct HISTOGRAMA_METRICAS {
+    uint64_t cubos[NUM_CUBOS_METRICAS];
+    uint64_t suma_ns;
+    uint64_t maximo_ns;
+} HistogramaMetricas;
+
+// Serie de métricas de un hilo (múltiplo de 64 bytes para no compartir líneas de caché)
+typedef struct SERIE_METRICAS {
+    char nombre[LONGITUD_NOMBRE_METRICA];
+    uint64_t contadores[MAX_CONTADORES_METRICAS];
+    HistogramaMetricas histogramas[MAX_HISTOGRAMAS_METRICAS];
+} __attribute__((aligned(64))) SerieMetricas;
+
+// Cabecera de la página
+typedef struct PAGINA_METRICAS {
+    char magia[LONGITUD_MAGIA_METRICAS];
+    uint32_t tamano_serie;      // sizeof(SerieMetricas), para comprobar que fpstat usa el mismo formato
+    uint32_t num_series;        // Series publicadas (se escribe después de inicializar la serie)
+    int64_t pid;
+    int64_t inicio_s;           // Segundos desde 01/01/1970 al crear la página
+    char proceso[LONGITUD_NOMBRE_METRICA];
+    uint32_t num_contadores;
+    uint32_t num_histogramas;
+    uint8_t tipos_contadores[MAX_CONTADORES_METRICAS];
+    char nombres_contadores[MAX_CONTADORES_METRICAS][LONGITUD_NOMBRE_METRICA];
+    char nombres_histogramas[MAX_HISTOGRAMAS_METRICAS][LONGITUD_NOMBRE_METRICA];
+    SerieMetricas series[MAX_SERIES_METRICAS];
+} PaginaMetricas;
+
+// Función que devuelve el cubo del histograma de una duración
+static inline int cuboMetricas(uint64_t nanosegundos) {
+    uint64_t microsegundos = nanosegundos / 1000;
+    int cubo = 0;
+    while (microsegundos > 0 && cubo < NUM_CUBOS_METRICAS - 1) {
+        microsegundos >>= 1;
+        cubo++;
+    }
+    return cubo;
+}
+
+// Función que devuelve el límite superior (en nanosegundos) de un cubo del histograma
+static inline uint64_t limiteCuboMetricas(int cubo) {
+    return ((uint64_t)1 << cubo) * 1000;
+}
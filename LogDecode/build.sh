@@ -0,0 +1,15 @@
+#!/bin/bash
+
+# Script para hacer build de logdecode
+
+make
+
+# Nombre del ejecutable después de la compilación
+ejecutable="logdecode"
+
+# Verificar si hubo errores durante la compilación
+if [ $? -eq 0 ]; then
+    echo "El programa se ha compilado correctamente en $ejecutable."
+else
+    echo "Hubo errores durante la compilación."
+fi
\ No newline at end of file
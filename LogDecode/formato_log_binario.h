@@ -0,0 +1,178 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdint.h>         // Enteros de tamaño fijo para el formato en disco
+#pragma endregion Librerias
+
+/*
+    Formato del log binario (LOG_FORMAT=BINARIO)
+    Este fichero tiene que ser igual en FileProcessor, Monitor y LogDecode
+
+    El fichero empieza con MAGIA_LOG_BINARIO y después tiene registros, cada uno con una CabeceraRegistroLog
+    seguida de "longitud" bytes (enteros en el orden de bytes de la máquina):
+        - REGISTRO_LOG_SESION: sin datos. Lo escribe cada proceso al abrir el fichero; los identificadores
+          de formato sólo valen dentro de la sesión
+        - REGISTRO_LOG_DEFINICION: uint16 longitud del módulo, módulo, cadena de formato (sin '\0').
+          Se escribe antes del primer mensaje con ese identificador
+        - REGISTRO_LOG_MENSAJE: argumentos del mensaje sin formatear, en el orden de las conversiones
+          del formato (ver analizarFormatoLog):
+              enteros (d, i, u, x, c...) sin modificador o con h/hh: int32
+              con l, ll, j, z o t, punteros (p): 64 bits
+              reales (f, e, g, a): double
+              cadenas (s): uint16 longitud (LONGITUD_CADENA_NULA si es NULL) y los caracteres
+              cada '*' de anchura o precisión: int32 delante del valor
+        - REGISTRO_LOG_TEXTO: uint16 longitud del módulo, módulo, mensaje ya formateado. Se usa para los
+          mensajes LOG_GENERAL, los formatos que no se pueden codificar y los que no son literales
+*/
+
+#define MAGIA_LOG_BINARIO "FPLOG01\n"
+#define LONGITUD_MAGIA_LOG_BINARIO 8
+
+// Tipos de registro del log binario
+typedef enum TIPO_REGISTRO_LOG {
+    REGISTRO_LOG_SESION = 1,
+    REGISTRO_LOG_DEFINICION,
+    REGISTRO_LOG_MENSAJE,
+    REGISTRO_LOG_TEXTO
+} TipoRegistroLog;
+
+// Cabecera de todos los registros (16 bytes, sin relleno)
+typedef struct CABECERA_REGISTRO_LOG {
+    int64_t instante_ns;        // Nanosegundos desde 01/01/1970
+    uint16_t tipo;              // TipoRegistroLog
+    uint16_t id_formato;        // Definición y mensaje
+    uint16_t nivel;             // NivelLog de log_files.h
+    uint16_t longitud;          // Bytes que siguen a la cabecera
+} CabeceraRegistroLog;
+
+#define LONGITUD_CADENA_NULA 0xFFFF
+
+// Tipo del argumento que consume una conversión del formato
+typedef enum TIPO_ARGUMENTO_LOG {
+    ARGUMENTO_LOG_NINGUNO,      // %%
+    ARGUMENTO_LOG_ENTERO,
+    ARGUMENTO_LOG_ENTERO_64,
+    ARGUMENTO_LOG_REAL,
+    ARGUMENTO_LOG_CADENA,
+    ARGUMENTO_LOG_PUNTERO
+} TipoArgumentoLog;
+
+#define MAX_CONVERSIONES_FORMATO_LOG 16
+
+// Conversión de una cadena de formato (desde el '%' hasta la letra de conversión)
+typedef struct CONVERSION_FORMATO_LOG {
+    uint8_t tipo;               // TipoArgumentoLog
+    uint8_t asteriscos;         // Argumentos int de anchura/precisión que van delante del valor (0, 1 o 2)
+    int16_t precision;          // Precisión escrita en el formato, -1 si no hay o es '*'
+    uint16_t inicio;            // Posición del '%' en el formato
+    uint16_t longitud;          // Longitud de la conversión
+} ConversionFormatoLog;
+
+// Nombres de los niveles de log en el orden de NivelLog (log_files.h)
+static inline const char *nombreNivelLog(int nivel) {
+    static const char *const nombres[] = {"GENERAL ", "DEBUG   ", "INFO    ", "WARNING ", "ERROR   "};
+    if (nivel < 0 || nivel >= (int)(sizeof(nombres) / sizeof(nombres[0]))) {
+        return "UNKNOWN ";
+    }
+    return nombres[nivel];
+}
+
+/*
+    Función que analiza una cadena de formato de printf y deja sus conversiones en "conversiones"
+    Devuelve el número de conversiones o -1 si el formato no se puede codificar en binario
+    (demasiadas conversiones, %n, modificador L, caracteres anchos o conversión desconocida)
+*/
+static inline int analizarFormatoLog(const char *formato, ConversionFormatoLog *conversiones, int max_conversiones) {
+    int num = 0;
+    for (const char *p = formato; *p != '\0'; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        if (num == max_conversiones || p - formato > 0xFFFF) {
+            return -1;
+        }
+        ConversionFormatoLog *conversion = &conversiones[num++];
+        conversion->inicio = (uint16_t)(p - formato);
+        conversion->asteriscos = 0;
+        conversion->precision = -1;
+        const char *inicio = p++;
+        // Indicadores
+        while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+            p++;
+        }
+        // Anchura
+        if (*p == '*') {
+            conversion->asteriscos++;
+            p++;
+        } else {
+            while (*p >= '0' && *p <= '9') {
+                p++;
+            }
+        }
+        // Precisión
+        if (*p == '.') {
+            p++;
+            if (*p == '*') {
+                conversion->asteriscos++;
+                p++;
+            } else {
+                int precision = 0;
+                while (*p >= '0' && *p <= '9') {
+                    if (precision < 10000) {
+                        precision = precision * 10 + (*p - '0');
+                    }
+                    p++;
+                }
+                conversion->precision = (int16_t)precision;
+            }
+        }
+        // Modificador de longitud
+        int largo = 0;
+        if (*p == 'h') {
+            p++;
+            if (*p == 'h') {
+                p++;
+            }
+        } else if (*p == 'l' || *p == 'j' || *p == 'z' || *p == 't') {
+            largo = 1;
+            if (*p == 'l' && p[1] == 'l') {
+                p++;
+            }
+            p++;
+        }
+        // Conversión
+        switch (*p) {
+            case '%':
+                conversion->tipo = ARGUMENTO_LOG_NINGUNO;
+                break;
+            case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+                conversion->tipo = largo ? ARGUMENTO_LOG_ENTERO_64 : ARGUMENTO_LOG_ENTERO;
+                break;
+            case 'c':
+                if (largo) {
+                    return -1;
+                }
+                conversion->tipo = ARGUMENTO_LOG_ENTERO;
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                conversion->tipo = ARGUMENTO_LOG_REAL;
+                break;
+            case 's':
+                if (largo) {
+                    return -1;
+                }
+                conversion->tipo = ARGUMENTO_LOG_CADENA;
+                break;
+            case 'p':
+                conversion->tipo = ARGUMENTO_LOG_PUNTERO;
+                break;
+            default:
+                return -1;
+        }
+        conversion->longitud = (uint16_t)(p - inicio + 1);
+    }
+    return num;
+}
@@ -0,0 +1,295 @@
+/**
+logdecode.c
+
+    Funcionalidad:
+        Convierte un fichero de log binario de FileProcessor o Monitor (LOG_FORMAT=BINARIO, clave LOG_FILE_BIN)
+        en el mismo texto que se escribe en LOG_FILE_APP con el log de texto:
+            FECHA HORA - [NIVEL] - MODULO: MENSAJE
+
+    Compilación:
+        make
+
+    Ejecución:
+        ./logdecode logs/MonitorApp.bin [logs/MonitorApp.log]
+
+    Parámetros:
+        Fichero de log binario
+        Fichero de salida (opcional, si no se indica se escribe por pantalla)
+*/
+
+// localtime_r no se declara con -std=c99
+#define _DEFAULT_SOURCE
+
+#include "logdecode.h"      // Declaración de funciones de este módulo
+
+// ------------------------------------------------------------------
+// DECODIFICACIÓN DEL LOG BINARIO
+// ------------------------------------------------------------------
+#pragma region DecodificacionLogBinario
+
+// Formatos definidos en la sesión actual (por identificador)
+static DefinicionFormatoLog definiciones[65536];
+
+// Función que olvida los formatos definidos (empieza una sesión nueva)
+static void liberarDefiniciones() {
+    for (int i = 0; i < 65536; i++) {
+        free(definiciones[i].modulo);
+        free(definiciones[i].formato);
+        definiciones[i].modulo = NULL;
+        definiciones[i].formato = NULL;
+    }
+}
+
+// Función que copia n bytes de los datos del registro y avanza
+// Devuelve 0 o -1 si el registro no tiene suficientes bytes
+static int leerDatos(const unsigned char **datos, const unsigned char *fin, void *destino, size_t n) {
+    if ((size_t)(fin - *datos) < n) {
+        return -1;
+    }
+    memcpy(destino, *datos, n);
+    *datos += n;
+    return 0;
+}
+
+// Función que lee el módulo (uint16 longitud y caracteres) del principio de los datos de un registro
+// Devuelve el módulo (hay que liberarlo) o NULL si el registro está mal formado
+static char *leerModulo(const unsigned char **datos, const unsigned char *fin) {
+    uint16_t longitud;
+    if (leerDatos(datos, fin, &longitud, sizeof(longitud)) != 0 || (size_t)(fin - *datos) < longitud) {
+        return NULL;
+    }
+    char *modulo = malloc(longitud + 1);
+    leerDatos(datos, fin, modulo, longitud);
+    modulo[longitud] = '\0';
+    return modulo;
+}
+
+// Función que añade un texto al mensaje que se está formando, sin pasarse del tamaño
+static void anadirTexto(char *mensaje, size_t tamano, size_t *usado, const char *texto, size_t longitud) {
+    if (*usado + longitud >= tamano) {
+        longitud = tamano - 1 - *usado;
+    }
+    memcpy(mensaje + *usado, texto, longitud);
+    *usado += longitud;
+    mensaje[*usado] = '\0';
+}
+
+// Formatea un valor con la conversión y los argumentos '*' que la preceden
+#define FORMATEAR_VALOR(trozo, conversion, asteriscos, valor) \
+    ((asteriscos) == 0 ? snprintf((trozo), sizeof(trozo), (conversion), (valor)) \
+        : (asteriscos) == 1 ? snprintf((trozo), sizeof(trozo), (conversion), (int)asteriscos_leidos[0], (valor)) \
+        : snprintf((trozo), sizeof(trozo), (conversion), (int)asteriscos_leidos[0], (int)asteriscos_leidos[1], (valor)))
+
+/*
+    Función que vuelve a formar el texto de un mensaje a partir de su formato y sus argumentos sin formatear
+    El texto se corta en LONGITUD_MAXIMA_MENSAJE_LOG - 1 caracteres, igual que con el log de texto
+    Devuelve 0 o -1 si los argumentos no corresponden al formato
+*/
+static int formarMensaje(const DefinicionFormatoLog *definicion, const unsigned char *datos, const unsigned char *fin, char *mensaje) {
+    char texto[8192] = "";
+    size_t usado = 0;
+    size_t posicion = 0;
+    for (int i = 0; i < definicion->num_conversiones; i++) {
+        const ConversionFormatoLog *conversion = &definicion->conversiones[i];
+        // Texto del formato hasta la conversión
+        anadirTexto(texto, sizeof(texto), &usado, definicion->formato + posicion, conversion->inicio - posicion);
+        posicion = conversion->inicio + conversion->longitud;
+
+        char especificacion[64];
+        if (conversion->longitud >= sizeof(especificacion)) {
+            return -1;
+        }
+        memcpy(especificacion, definicion->formato + conversion->inicio, conversion->longitud);
+        especificacion[conversion->longitud] = '\0';
+
+        int32_t asteriscos_leidos[2] = {0, 0};
+        if (conversion->tipo != ARGUMENTO_LOG_NINGUNO) {
+            for (int j = 0; j < conversion->asteriscos; j++) {
+                if (leerDatos(&datos, fin, &asteriscos_leidos[j], sizeof(int32_t)) != 0) {
+                    return -1;
+                }
+            }
+        }
+        char trozo[1024] = "";
+        switch (conversion->tipo) {
+            case ARGUMENTO_LOG_NINGUNO:
+                snprintf(trozo, sizeof(trozo), "%%");
+                break;
+            case ARGUMENTO_LOG_ENTERO: {
+                int32_t valor;
+                if (leerDatos(&datos, fin, &valor, sizeof(valor)) != 0) {
+                    return -1;
+                }
+                FORMATEAR_VALOR(trozo, especificacion, conversion->asteriscos, (int)valor);
+                break;
+            }
+            case ARGUMENTO_LOG_ENTERO_64: {
+                int64_t valor;
+                if (leerDatos(&datos, fin, &valor, sizeof(valor)) != 0) {
+                    return -1;
+                }
+                FORMATEAR_VALOR(trozo, especificacion, conversion->asteriscos, (long long)valor);
+                break;
+            }
+            case ARGUMENTO_LOG_PUNTERO: {
+                int64_t valor;
+                if (leerDatos(&datos, fin, &valor, sizeof(valor)) != 0) {
+                    return -1;
+                }
+                FORMATEAR_VALOR(trozo, especificacion, conversion->asteriscos, (void *)(intptr_t)valor);
+                break;
+            }
+            case ARGUMENTO_LOG_REAL: {
+                double valor;
+                if (leerDatos(&datos, fin, &valor, sizeof(valor)) != 0) {
+                    return -1;
+                }
+                FORMATEAR_VALOR(trozo, especificacion, conversion->asteriscos, valor);
+                break;
+            }
+            case ARGUMENTO_LOG_CADENA: {
+                uint16_t longitud;
+                if (leerDatos(&datos, fin, &longitud, sizeof(longitud)) != 0) {
+                    return -1;
+                }
+                if (longitud == LONGITUD_CADENA_NULA) {
+                    FORMATEAR_VALOR(trozo, especificacion, conversion->asteriscos, (const char *)NULL);
+                    break;
+                }
+                char cadena[LONGITUD_MAXIMA_MENSAJE_LOG + 1];
+                if (longitud > LONGITUD_MAXIMA_MENSAJE_LOG || leerDatos(&datos, fin, cadena, longitud) != 0) {
+                    return -1;
+                }
+                cadena[longitud] = '\0';
+                FORMATEAR_VALOR(trozo, especificacion, conversion->asteriscos, cadena);
+                break;
+            }
+            default:
+                return -1;
+        }
+        anadirTexto(texto, sizeof(texto), &usado, trozo, strlen(trozo));
+    }
+    // Resto del formato
+    anadirTexto(texto, sizeof(texto), &usado, definicion->formato + posicion, strlen(definicion->formato + posicion));
+    snprintf(mensaje, LONGITUD_MAXIMA_MENSAJE_LOG, "%s", texto);
+    return 0;
+}
+
+// Función que escribe una línea con el formato del log de aplicación
+// Formato: FECHA HORA - [NIVEL] - MODULO: MENSAJE
+static void escribirLinea(FILE *salida, int64_t instante_ns, int nivel, const char *modulo, const char *mensaje) {
+    time_t instante = (time_t)(instante_ns / 1000000000LL);
+    struct tm infoTiempo;
+    localtime_r(&instante, &infoTiempo);
+    char fechaHora[20];
+    strftime(fechaHora, sizeof(fechaHora), "%Y-%m-%d %H:%M:%S", &infoTiempo);
+    fprintf(salida, "%s - [%s] - %s: %s", fechaHora, nombreNivelLog(nivel), modulo, mensaje);
+}
+
+/*
+    Función que convierte un log binario en texto
+    Devuelve el número de mensajes escritos o -1 si el fichero no es un log binario o está mal formado
+    (en ese caso los mensajes anteriores al error ya se han escrito)
+*/
+int decodificarLogBinario(FILE *entrada, FILE *salida) {
+    char magia[LONGITUD_MAGIA_LOG_BINARIO];
+    if (fread(magia, 1, sizeof(magia), entrada) != sizeof(magia) || memcmp(magia, MAGIA_LOG_BINARIO, sizeof(magia)) != 0) {
+        fprintf(stderr, "El fichero no es un log binario\n");
+        return -1;
+    }
+    liberarDefiniciones();
+    int mensajes = 0;
+    long registro = 0;
+    CabeceraRegistroLog cabecera;
+    unsigned char datos[65536];
+    while (fread(&cabecera, sizeof(cabecera), 1, entrada) == 1) {
+        registro++;
+        if (fread(datos, 1, cabecera.longitud, entrada) != cabecera.longitud) {
+            // Registro incompleto al final (el proceso puede seguir escribiendo)
+            fprintf(stderr, "Registro %ld incompleto al final del fichero\n", registro);
+            break;
+        }
+        const unsigned char *p = datos;
+        const unsigned char *fin = datos + cabecera.longitud;
+        switch (cabecera.tipo) {
+            case REGISTRO_LOG_SESION:
+                liberarDefiniciones();
+                break;
+            case REGISTRO_LOG_DEFINICION: {
+                DefinicionFormatoLog *definicion = &definiciones[cabecera.id_formato];
+                free(definicion->modulo);
+                free(definicion->formato);
+                definicion->modulo = leerModulo(&p, fin);
+                if (definicion->modulo == NULL) {
+                    fprintf(stderr, "Registro %ld: definición mal formada\n", registro);
+                    return -1;
+                }
+                definicion->formato = malloc(fin - p + 1);
+                memcpy(definicion->formato, p, fin - p);
+                definicion->formato[fin - p] = '\0';
+                definicion->num_conversiones = analizarFormatoLog(definicion->formato, definicion->conversiones, MAX_CONVERSIONES_FORMATO_LOG);
+                break;
+            }
+            case REGISTRO_LOG_MENSAJE: {
+                DefinicionFormatoLog *definicion = &definiciones[cabecera.id_formato];
+                char mensaje[LONGITUD_MAXIMA_MENSAJE_LOG];
+                if (definicion->formato == NULL || definicion->num_conversiones < 0
+                        || formarMensaje(definicion, p, fin, mensaje) != 0) {
+                    fprintf(stderr, "Registro %ld: mensaje con formato %d sin definir o mal formado\n", registro, cabecera.id_formato);
+                    return -1;
+                }
+                escribirLinea(salida, cabecera.instante_ns, cabecera.nivel, definicion->modulo, mensaje);
+                mensajes++;
+                break;
+            }
+            case REGISTRO_LOG_TEXTO: {
+                char *modulo = leerModulo(&p, fin);
+                if (modulo == NULL) {
+                    fprintf(stderr, "Registro %ld: texto mal formado\n", registro);
+                    return -1;
+                }
+                char mensaje[LONGITUD_MAXIMA_MENSAJE_LOG];
+                snprintf(mensaje, sizeof(mensaje), "%.*s", (int)(fin - p), (const char *)p);
+                escribirLinea(salida, cabecera.instante_ns, cabecera.nivel, modulo, mensaje);
+                free(modulo);
+                mensajes++;
+                break;
+            }
+            default:
+                fprintf(stderr, "Registro %ld: tipo %d desconocido\n", registro, cabecera.tipo);
+                return -1;
+        }
+    }
+    liberarDefiniciones();
+    return mensajes;
+}
+#pragma endregion DecodificacionLogBinario
+
+
+// Función main
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Uso: %s fichero_log_binario [fichero_salida]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    FILE *entrada = fopen(argv[1], "rb");
+    if (entrada == NULL) {
+        perror("Error al abrir el log binario");
+        return EXIT_FAILURE;
+    }
+    FILE *salida = stdout;
+    if (argc == 3) {
+        salida = fopen(argv[2], "w");
+        if (salida == NULL) {
+            perror("Error al abrir el fichero de salida");
+            fclose(entrada);
+            return EXIT_FAILURE;
+        }
+    }
+    int mensajes = decodificarLogBinario(entrada, salida);
+    fclose(entrada);
+    if (salida != stdout) {
+        fclose(salida);
+    }
+    return mensajes == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
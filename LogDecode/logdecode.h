@@ -0,0 +1,28 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <time.h>           // Tratamiento de datos temporales
+#include <stdint.h>         // Enteros de tamaño fijo del log binario
+
+#include "formato_log_binario.h"    // Formato en disco del log binario
+#pragma endregion Librerias
+
+// Longitud máxima de un mensaje (la misma que en log_files.c)
+#define LONGITUD_MAXIMA_MENSAJE_LOG 255
+
+// Formato definido en la sesión actual del fichero
+typedef struct DEFINICION_FORMATO_LOG {
+    char *modulo;                   // NULL si el identificador no está definido
+    char *formato;
+    int num_conversiones;
+    ConversionFormatoLog conversiones[MAX_CONVERSIONES_FORMATO_LOG];
+} DefinicionFormatoLog;
+
+
+int decodificarLogBinario(FILE *entrada, FILE *salida);
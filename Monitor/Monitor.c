@@ -36,16 +36,69 @@ sem_t *semaforo_consolidar_ficheros_entrada;
 // Este es el nombre del semáforo
 const char *semName;
 
-// Variables para memoria compartida
-int shared_mem_fd;
-void *shared_mem_addr;
-size_t shared_mem_current_size = 0;
-size_t shared_mem_used_space = 0;
-const char * shared_mem_name;
-int shared_mem_size;
+// Con SNAPSHOT_READS=1 los hilos leen los datos consolidados hasta la marca de confirmación que publica
+// FileProcessor y no cogen el semáforo, así que la detección no para la consolidación (ver datos_consolidados.c)
+int lectura_instantanea = 0;
+
+// Perfil de contención del semáforo (LOCK_PROFILING=1)
+static BloqueoPerfilado perfil_semaforo_consolidar = BLOQUEO_PERFILADO("semaforo_consolidar_ficheros_entrada");
+
+// Función que obtiene el acceso a los datos consolidados para una ronda de detección
+// La espera se apunta en la serie de métricas del hilo; devuelve el instante en que se obtiene el acceso
+// Con SNAPSHOT_READS=1 no hay semáforo que pedir: se lee hasta la marca de confirmación de FileProcessor
+long long solicitarAccesoConsolidado(SerieMetricas *serie, const char *modulo, int id_hilo) {
+    long long inicio_ns = obtener_nanosegundos_monotonicos();
+    if (!lectura_instantanea) {
+        escribirEnLog(LOG_INFO, modulo, "Hilo %02d: solicitando acceso al semáforo\n", id_hilo);
+        esperarSemaforoPerfilado(&perfil_semaforo_consolidar, semaforo_consolidar_ficheros_entrada, __func__);
+    }
+    long long acceso_ns = obtener_nanosegundos_monotonicos();
+    registrarDuracionMetrica(serie, HISTOGRAMA_ESPERA_ACCESO, acceso_ns - inicio_ns);
+    return acceso_ns;
+}
+
+// Función que apunta en la serie de métricas de un hilo de detección una ronda terminada
+void registrarRondaMetricas(SerieMetricas *serie, long long acceso_ns, int registros_nuevos, uint64_t claves, uint64_t alertas) {
+    sumarMetrica(serie, METRICA_RONDAS, 1);
+    sumarMetrica(serie, METRICA_REGISTROS, registros_nuevos);
+    fijarMetrica(serie, METRICA_CLAVES, claves);
+    sumarMetrica(serie, METRICA_ALERTAS, alertas);
+    registrarDuracionMetrica(serie, HISTOGRAMA_DURACION_RONDA, obtener_nanosegundos_monotonicos() - acceso_ns);
+}
+
+// Contadores e histogramas de las series de métricas de los hilos de detección (una serie por hilo)
+const DefinicionMetricas definicion_metricas = {
+    "Monitor",
+    4, {"rondas", "registros", "claves", "alertas"}, {CONTADOR_ACUMULADO, CONTADOR_ACUMULADO, CONTADOR_VALOR, CONTADOR_ACUMULADO},
+    2, {"espera acceso", "duración ronda"}
+};
+
+// Función que libera el acceso a los datos consolidados al terminar una ronda de detección
+void liberarAccesoConsolidado(const char *modulo, int id_hilo) {
+    if (!lectura_instantanea) {
+        liberarSemaforoPerfilado(&perfil_semaforo_consolidar, semaforo_consolidar_ficheros_entrada);
+        escribirEnLog(LOG_INFO, modulo, "Hilo %02d: liberado semáforo.\n", id_hilo);
+    }
+}
+
+// En esta matriz guardamos los contadores de generaciones que utilizaremos para bloquear los hilos
+// hasta que se recibe una notificación del pipe (ver activacion_hilos.c)
+// La última posición corresponde al hilo de las reglas del fichero de reglas
+ActivacionHilo activaciones_patrones[NUM_HILOS_DETECCION];
+
+// Parámetros de los patrones de fraude (PATRON_n_* en mo.conf)
+// Se pueden volver a leer con SIGHUP, por eso los hilos los copian al principio de cada ronda
+ParametrosPatron parametros_patrones[NUM_PATRONES_FRAUDE];
+pthread_mutex_t mutex_parametros_patrones = PTHREAD_MUTEX_INITIALIZER;
+
+// Reglas compiladas pendientes de que las recoja el hilo de reglas (ver reglas_fraude.c)
+// main deja aquí las reglas al arrancar y al recibir SIGHUP
+ConjuntoReglas *reglas_pendientes = NULL;
+pthread_mutex_t mutex_reglas_pendientes = PTHREAD_MUTEX_INITIALIZER;
 
-// En esta matriz guardamos los mutex que utilizaremos para bloquear los hilos hasta que se recibe una notificación del pipe
-pthread_mutex_t mutex_array[NUM_PATRONES_FRAUDE];
+// Informe de usuarios con más actividad por ventana (NULL si TOPK_REPORT no vale 1)
+// Lo crea main antes de los hilos; el hilo del informe lo actualiza y el temporizador de métricas lee sus primeras posiciones
+TopUsuarios *top_usuarios = NULL;
 
 // Tamaño de los mensajes que se reciben a través del named pipe desde FileProcessor
 #define MESSAGE_SIZE 100
@@ -53,68 +106,131 @@ pthread_mutex_t mutex_array[NUM_PATRONES_FRAUDE];
 // Pipe por el que recibiremos datos desde FileProcessor
 int pipefd;
 
-// Diccionario para patron_fraude_1
-typedef struct REGISTRO_PATRON {
-    char* clave;
-    int cantidad;
-    int operacion1Presente;
-    int operacion2Presente;
-    int operacion3Presente;
-    int operacion4Presente;
-} RegistroPatron;
-
-void free_registroPatronF1(gpointer data) {
-    RegistroPatron* registro = (RegistroPatron*)data;
-    //g_free(registro->usuario);
-    g_free(registro);
-}
 
-// Función para eliminar los últimos caracteres de una cadena
-char *eliminarUltimosCaracteres(char *cadena, int n) {
-    // La podemos utilizar para eliminar el :MM:DD de una fecha-hora de tipo YYYY-MM-DD HH:MM:SS (llamando con n=5)
-    // La utilizamos para quitar el " €" en los importes": 120 €" (llamando con n=5)
-    int longitud = strlen(cadena);
-    if (longitud >= n) {
-        cadena[longitud - n] = '\0';
-    }
-    return cadena;
+// Función para indicar a un hilo de patrón de fraude que hay datos nuevos que revisar
+void activarHiloPatronFraude(int numPatron) {
+    // Publicar una nueva generación: si el hilo está esperando se despierta, y si está ocupado
+    // hará otra ronda en cuanto termine la actual
+    publicarActivacionHilo(&activaciones_patrones[numPatron - 1]);
+    escribirEnLog(LOG_DEBUG, "Monitor: activarHiloPatronFraude", "Hilo %02d activado\n", numPatron);
 }
 
-// Función para concatenar 2 cadenas
-char* concatenar_cadenas(char cadena1[30], char cadena2[30], char cadena3[30]) {
-    static char resultado[100]; // Almacenará el resultado de la concatenación
-    strcpy(resultado, cadena1); // Copia la primera cadena en resultado
-    
-    // Concatena la segunda cadena a resultado
-    strcat(resultado, cadena2);
+// Función que mantiene bloqueado un hilo de patrón de fraude hasta que haya datos posteriores
+// a la última generación que ha revisado
+// Mientras espera, el hilo no cuenta como lector de los parámetros de configuración (no retrasa su liberación al recargar)
+unsigned long esperarActivacionHiloPatronFraude(int numPatron, unsigned long generacion_vista) {
+    pausar_lector_configuracion();
+    ActivacionRonda ronda = esperarActivacionHilo(&activaciones_patrones[numPatron - 1], generacion_vista);
+    reanudar_lector_configuracion();
+    escribirEnLog(LOG_INFO, "Monitor: esperarActivacionHiloPatronFraude", "Hilo %02d: generación %lu, generaciones pendientes %lu, latencia de activación %.3f ms\n",
+        numPatron, ronda.generacion, ronda.pendientes, ronda.latencia_ns / 1000000.0);
+    return ronda.generacion;
+}
 
-    // Concatena la tercera cadena a resultado
-    strcat(resultado, cadena3);
+// Función que escribe en el log las métricas de activación acumuladas de todos los hilos de patrones de fraude
+void escribirMetricasActivacionPatrones() {
+    for (int i = 1; i <= NUM_HILOS_DETECCION; i++) {
+        MetricasActivacion metricas = obtenerMetricasActivacionHilo(&activaciones_patrones[i - 1]);
+        double latencia_media_ms = 0;
+        if (metricas.rondas > 0) {
+            latencia_media_ms = metricas.latencia_total_ns / 1000000.0 / metricas.rondas;
+        }
+        escribirEnLog(LOG_INFO, "Monitor: metricas_activacion", "Hilo %02d: rondas %lu, generaciones atendidas %lu, máximo pendientes %lu, latencia media %.3f ms, latencia máxima %.3f ms\n",
+            i, metricas.rondas, metricas.generaciones_atendidas, metricas.pendientes_maximo,
+            latencia_media_ms, metricas.latencia_maxima_ns / 1000000.0);
+    }
+}
 
-    return resultado; // Devuelve la cadena concatenada
+// Función que lee los parámetros de los patrones de fraude de las entradas de la configuración en vigor
+// Se llama al arrancar y al recibir SIGHUP (después de recargarParametros). Los hilos siguen trabajando
+// con los parámetros anteriores hasta que se sustituyen
+int cargarConfiguracionPatrones() {
+    const ParametrosConfiguracion *parametros = obtenerParametros();
+    ParametrosPatron nuevos[NUM_PATRONES_FRAUDE];
+    cargarParametrosPatrones(parametros->entradas, parametros->num_entradas, nuevos);
+
+    pthread_mutex_lock(&mutex_parametros_patrones);
+    memcpy(parametros_patrones, nuevos, sizeof(parametros_patrones));
+    pthread_mutex_unlock(&mutex_parametros_patrones);
+
+    for (int i = 0; i < NUM_PATRONES_FRAUDE; i++) {
+        escribirEnLog(LOG_INFO, "Monitor: cargarConfiguracionPatrones", "Patrón %02d: activo %s, umbral %d, ventana %d x %s\n",
+            i + 1, nuevos[i].activo ? "SI" : "NO", nuevos[i].umbral, nuevos[i].longitud_ventana, nombreGranularidad(nuevos[i].granularidad));
+    }
+    return EXIT_SUCCESS;
 }
 
+// Texto del fichero de reglas compilado por última vez (NULL si no existía)
+// Compilar las reglas descarta lo que llevan acumulado, así que con SIGHUP sólo se compilan si el fichero ha cambiado
+static char *texto_reglas_cargadas = NULL;
+static int reglas_cargadas = 0;
+
+// Función que lee el contenido completo de un fichero de texto
+// Devuelve el texto (lo libera el llamante) o NULL si no se puede leer
+static char *leerContenidoFichero(const char *nombre_fichero) {
+    FILE *fichero = fopen(nombre_fichero, "r");
+    if (fichero == NULL) {
+        return NULL;
+    }
+    size_t capacidad = 4096, longitud = 0, leidos;
+    char *texto = malloc(capacidad);
+    while (texto != NULL && (leidos = fread(texto + longitud, 1, capacidad - longitud - 1, fichero)) > 0) {
+        longitud += leidos;
+        if (longitud + 1 == capacidad) {
+            capacidad *= 2;
+            char *ampliado = realloc(texto, capacidad);
+            if (ampliado == NULL) {
+                free(texto);
+            }
+            texto = ampliado;
+        }
+    }
+    fclose(fichero);
+    if (texto != NULL) {
+        texto[longitud] = '\0';
+    }
+    return texto;
+}
 
-// Función para indicar a un hilo de patrón de fraude que se active (1) o desactive (0)
-void activarHiloPatronFraude(int numPatron, int estado) {
-    // La utilizamos para mantener los hilos bloqueados, hasta que se recibe una notificación en el pipe
-    if (estado) {
-        // Bloquear el mutex --> de esta forma bloquea la activación del hilo
-        pthread_mutex_lock(&mutex_array[numPatron - 1]);
-        escribirEnLog(LOG_DEBUG, "Monitor: activarHiloPatronFraude", "Hilo %02d activado en estado %01d\n", numPatron, estado);
-    } else {
-        // Desbloquear el mutex --> permite activar el hilo
-        pthread_mutex_unlock(&mutex_array[numPatron - 1]);
-        escribirEnLog(LOG_DEBUG, "Monitor: activarHiloPatronFraude", "Hilo %02d desactivado en estado %01d\n", numPatron, estado);
+// Función que compila las reglas del fichero de reglas (RULES_FILE) y las deja pendientes para el hilo de reglas
+// Si el fichero no ha cambiado desde la última compilación, las reglas en uso se conservan
+int cargarReglasFraude() {
+    const char *fichero_reglas = obtenerParametros()->fichero_reglas;
+    char *texto = leerContenidoFichero(fichero_reglas);
+    int sin_cambios = texto == NULL ? texto_reglas_cargadas == NULL : texto_reglas_cargadas != NULL && strcmp(texto, texto_reglas_cargadas) == 0;
+    if (reglas_cargadas && sin_cambios) {
+        escribirEnLog(LOG_INFO, "Monitor: cargarReglasFraude", "El fichero de reglas %s no ha cambiado, se conservan las reglas en uso\n", fichero_reglas);
+        free(texto);
+        return EXIT_SUCCESS;
     }
+    free(texto_reglas_cargadas);
+    texto_reglas_cargadas = texto;
+    reglas_cargadas = 1;
+
+    ConjuntoReglas *conjunto = cargarFicheroReglas(fichero_reglas, NUM_PATRONES_FRAUDE + 1);
+    escribirEnLog(LOG_INFO, "Monitor: cargarReglasFraude", "%d reglas cargadas de %s\n", conjunto->num_reglas, fichero_reglas);
+
+    pthread_mutex_lock(&mutex_reglas_pendientes);
+    // Si el hilo no había recogido todavía las reglas anteriores, se sustituyen
+    destruirConjuntoReglas(reglas_pendientes);
+    reglas_pendientes = conjunto;
+    pthread_mutex_unlock(&mutex_reglas_pendientes);
+    return EXIT_SUCCESS;
+}
+
+// Función que devuelve una copia de los parámetros en vigor de un patrón de fraude
+ParametrosPatron obtenerParametrosPatron(int numPatron) {
+    pthread_mutex_lock(&mutex_parametros_patrones);
+    ParametrosPatron parametros = parametros_patrones[numPatron - 1];
+    pthread_mutex_unlock(&mutex_parametros_patrones);
+    return parametros;
 }
 
 // Función para escribir el resultado de los registros que cumplen con el patrón de fraude en un fichero
 void escribirResultadoPatron(int patron, const char* mensaje) {
-    const char *carpeta_datos;
-    carpeta_datos = obtener_valor_configuracion("PATH_FILES", "../datos");
-    const char *raiz_fichero_resultado;
-    raiz_fichero_resultado = obtener_valor_configuracion("RESULTS_FILE", "resultado_patron_");
+    const ParametrosConfiguracion *parametros = obtenerParametros();
+    const char *carpeta_datos = parametros->carpeta_datos;
+    const char *raiz_fichero_resultado = parametros->fichero_resultado;
     char nombre_completo_fichero_resultado[PATH_MAX];
     sprintf(nombre_completo_fichero_resultado, "%s/%s%02d.csv", carpeta_datos, raiz_fichero_resultado, patron);
 
@@ -133,10 +249,9 @@ void escribirResultadoPatron(int patron, const char* mensaje) {
 
 // Función para eliminar el fichero resultado
 void eliminarFicheroResultado(int patron) {
-    const char *carpeta_datos;
-    carpeta_datos = obtener_valor_configuracion("PATH_FILES", "../datos");
-    const char *raiz_fichero_resultado;
-    raiz_fichero_resultado = obtener_valor_configuracion("RESULTS_FILE", "resultado_patron_");
+    const ParametrosConfiguracion *parametros = obtenerParametros();
+    const char *carpeta_datos = parametros->carpeta_datos;
+    const char *raiz_fichero_resultado = parametros->fichero_resultado;
     char nombre_completo_fichero_resultado[PATH_MAX];
     sprintf(nombre_completo_fichero_resultado, "%s/%s%02d.csv", carpeta_datos, raiz_fichero_resultado, patron);
     remove(nombre_completo_fichero_resultado);
@@ -144,1338 +259,363 @@ void eliminarFicheroResultado(int patron) {
 }
 
 
-// Detección de patrón de fraude de tipo 1
-// Más de 5 transacciones por usuario en una hora
-void *hilo_patron_fraude_1(void *arg) {
-    
-    int id_hilo = *((int *)arg);
+// Datos que necesita la evaluación de cada clave de un patrón
+typedef struct EVALUACION_PATRON {
+    int id_hilo;
+    const DefinicionPatron *definicion;
+    int umbral;
+    uint64_t alertas;           // Claves que cumplen el patrón
+} EvaluacionPatron;
 
-    // Obtener parámetro para ver si hay que copiar los registros en fichero CSV o en memoria compartida
-    const char * char_use_shared_memory;
-    char_use_shared_memory = obtener_valor_configuracion("USE_SHARED_MEMORY", "0");
-    int use_shared_memory = atoi(char_use_shared_memory);
-
-    char clave[100];
-    char separador1[30] = "@";
-    char separador2[30] = ":00";
-    int cantidad;
+// Función que escribe una clave en el log y, si cumple el patrón, en el fichero de resultado
+static void evaluarRegistroPatron(const RegistroPatron *registro, void *contexto) {
+    EvaluacionPatron *evaluacion = (EvaluacionPatron *)contexto;
     char mensaje[150];
+    escribirEnLogDetalle(LOG_DEBUG, "Monitor: hilo_patron_fraude", registro->usuario, NULL,
+        "Hilo %02d: Diccionario del patrón Clave: %s, Número Registros: %d, Op1: %d, Op2: %d, Op3: %d, Op4: %d\n",
+        evaluacion->id_hilo, registro->clave, registro->cantidad,
+        registro->operacion1Presente, registro->operacion2Presente, registro->operacion3Presente, registro->operacion4Presente);
+    if (evaluacion->definicion->cumple(registro, evaluacion->umbral)) {
+        // Componer el mensaje para el log y monitor
+        evaluacion->definicion->formatear(mensaje, sizeof(mensaje), registro);
+        escribirEnLog(LOG_GENERAL, "Monitor: hilo_patron_fraude", mensaje);
+        // Escribir en fichero resultado patron
+        escribirResultadoPatron(evaluacion->id_hilo, mensaje);
+        evaluacion->alertas++;
+    }
+}
 
-    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_1", "Hilo %02d: activado\n", id_hilo);
-    // Bucle infinito para observar la carpeta
-    while (1) {
-        // Esperar a que el hilo se active
-        activarHiloPatronFraude(id_hilo, 1);
-        
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_1", "Hilo %02d: se ha activado\n", id_hilo);
-        // Obtener acceso exclusivo al fichero consolidado
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_1", "Hilo %02d: solicitando acceso al semáforo\n", id_hilo);
-        sem_wait(semaforo_consolidar_ficheros_entrada);
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_1", "Hilo %02d: comenzando comprobación patrón fraude 1\n", id_hilo);
-
-        // Lectura de los datos de consolidado en el diccionario de datos
-        GHashTable *usuariosPF1 = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_registroPatronF1);
-        if (use_shared_memory == 0 ) {
-            // No hay que utilizar  memoria compartida, hay que leer desde fichero consolidado
-            const char *carpeta_datos;
-            carpeta_datos = obtener_valor_configuracion("PATH_FILES", "../datos");
-            const char *fichero_datos;
-            fichero_datos = obtener_valor_configuracion("INVENTORY_FILE", "file.csv");
-            char nombre_completo_fichero_datos[PATH_MAX];
-            sprintf(nombre_completo_fichero_datos, "%s/%s", carpeta_datos, fichero_datos);
-            escribirEnLog(LOG_INFO, "Monitor: LeerFicheroConsolidadoEnMatriz", "Comenzando lectura del archivo\n");
-            FILE *archivo_consolidado = fopen(nombre_completo_fichero_datos, "r");
-            if (archivo_consolidado == NULL) {
-                    // No se ha conseguido abrir el fichero
-                escribirEnLog(LOG_ERROR, "hilo_patron_fraude", "Hilo %02d: error al abrir el archivo en patrón fraude 1 en fichero %s\n", id_hilo, nombre_completo_fichero_datos);
-
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_1: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            }
-            char line[MAX_LINE_LENGTH];
-            while (fgets(line, sizeof(line), archivo_consolidado)) {
-                // Formato: SUC001;OPE0001;12/03/2024 09:47:00;12/03/2024 10:14:00;USER144;COMPRA01;1;73 €;Finalizado
-                char *sucursal = strtok(line, ";");
-                char *operacion = strtok(NULL, ";");
-                char *fechaHora1 = strtok(NULL, ";");
-                char *fechaHora2 = strtok(NULL, ";");
-                char *usuario = strtok(NULL, ";");
-                char *tipoOperacion1 = strtok(NULL, ";");
-                char *tipoOperacion2 = strtok(NULL, ";");
-                char *importeTexto = strtok(NULL, ";");
-                char *estado = strtok(NULL, ";");
-                escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_1", "Hilo %02d: datos de registro %s;%s;%s;%s;%s;%s;%s;%s;%s;\n", id_hilo, sucursal, operacion, fechaHora1, fechaHora2, usuario, tipoOperacion1, tipoOperacion2, importeTexto, estado);
-
-                // Para este patrón la clave del diccionario va a ser usuario+fecha+hora comienzo
-                if (usuario) {
-                    strncpy(clave, usuario, sizeof(clave)-1);
-                    strncat(clave, separador1, sizeof(clave)-1);
-                    strncat(clave, eliminarUltimosCaracteres(fechaHora1, 6), sizeof(clave)-1);
-                    strncat(clave, separador2, sizeof(clave)-1);
-                    cantidad = 1;
-                    RegistroPatron *registro = g_hash_table_lookup(usuariosPF1, clave);
-                    if (registro == NULL) {
-                        registro = g_new(RegistroPatron, 1);
-                        registro->clave = g_strdup(clave);
-                        registro->cantidad = cantidad;
-                        g_hash_table_insert(usuariosPF1, registro->clave, registro);
-                    } else {
-                        registro->cantidad += cantidad;
-                    }
-                }
-            }
-            fclose(archivo_consolidado);
-            escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_1", "Terminada lectura del archivo consolidado en matriz\n");
-        } else {
-            // Hay que utilizar  memoria compartida
-            escribirEnLog(LOG_INFO, "hilo_patron_fraude_1", "Comenzando lectura de memoria compartida\n");
-
-            // Obtener acceso a la memoria compartida
-            // Obtener los valores de la memoria compartida del fichero de configuración
-            shared_mem_name = obtener_valor_configuracion("SHARED_MEMORY_NAME", "/my_shared_memory");;
-            int size = atoi(obtener_valor_configuracion("SHARED_MEMORY_INITIAL_SIZE", "1024"));
-            shared_mem_size = size;
-            // Al abrir la memoria compartida...
-            // Cambiamos el umask antes de crear el pipe para que se asignen correctamente
-            // los permisos de grupo
-            // ver: https://stackoverflow.com/questions/11909505/posix-shared-memory-and-semaphores-permissions-set-incorrectly-by-open-calls
-            mode_t old_umask = umask(0);
-            shared_mem_fd = shm_open(shared_mem_name, O_RDONLY, 0660);
-            umask(old_umask);
-
-            if (shared_mem_fd == -1) {
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al acceder a la memoria compartida\n");
-                perror("Error al crear la memoria compartida");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_1: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Obtenido acceso a la memoria compartida nombre %s fd %i\n", shared_mem_name, shared_mem_fd);
-            }
-
-            shared_mem_addr = mmap(0, shared_mem_size, PROT_READ, MAP_SHARED, shared_mem_fd, 0);
-            if (shared_mem_addr == MAP_FAILED) {
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al mapear la memoria compartida\n");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_1: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Mapeada memoria compartida dirección %p tamaño %i\n", shared_mem_addr, shared_mem_size);
-            }
-
-            char caracter;
-            char cadena[MAX_LINE_LENGTH];
-            char line[MAX_LINE_LENGTH];
-            int posicion = 0;
-            for (int i = 0; i < shared_mem_size; i++) {
-                caracter = *(char *)(shared_mem_addr + i);
-                if (caracter != '\n') {
-                    if (caracter != '\0') {
-                        cadena[posicion] = caracter;
-                        posicion++;
-                    }
-                } else {
-                    cadena[posicion] = '\0';
-                    posicion = 0;
-                    // Procesar la linea
-                    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_1", "Vamos a procesar: cadena %s\n", cadena);
-                    strcpy(line, cadena);
-                    // Formato: SUC001;OPE0001;12/03/2024 09:47:00;12/03/2024 10:14:00;USER144;COMPRA01;1;73 €;Finalizado
-                    char *sucursal = strtok(line, ";");
-                    char *operacion = strtok(NULL, ";");
-                    char *fechaHora1 = strtok(NULL, ";");
-                    char *fechaHora2 = strtok(NULL, ";");
-                    char *usuario = strtok(NULL, ";");
-                    char *tipoOperacion1 = strtok(NULL, ";");
-                    char *tipoOperacion2 = strtok(NULL, ";");
-                    char *importeTexto = strtok(NULL, ";");
-                    char *estado = strtok(NULL, ";");
-                    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_1", "Hilo %02d: datos de registro %s;%s;%s;%s;%s;%s;%s;%s;%s;\n", id_hilo, sucursal, operacion, fechaHora1, fechaHora2, usuario, tipoOperacion1, tipoOperacion2, importeTexto, estado);
-
-                    // Para este patrón la clave del diccionario va a ser usuario+fecha+hora comienzo
-                    if (usuario) {
-                        strncpy(clave, usuario, sizeof(clave)-1);
-                        strncat(clave, separador1, sizeof(clave)-1);
-                        strncat(clave, eliminarUltimosCaracteres(fechaHora1, 6), sizeof(clave)-1);
-                        strncat(clave, separador2, sizeof(clave)-1);
-                        cantidad = 1;
-                        RegistroPatron *registro = g_hash_table_lookup(usuariosPF1, clave);
-                        if (registro == NULL) {
-                            registro = g_new(RegistroPatron, 1);
-                            registro->clave = g_strdup(clave);
-                            registro->cantidad = cantidad;
-                            g_hash_table_insert(usuariosPF1, registro->clave, registro);
-                        } else {
-                            registro->cantidad += cantidad;
-                        }
-                    }
-                }
-            }
-            if (munmap(shared_mem_addr, shared_mem_size) == -1) {
-                perror("Error al desmapear la memoria compartida");
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al desmapear la memoria compartida\n");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_1: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Desmapeada memoria compartida\n");
-            }
-            if (close(shared_mem_fd) == -1) {
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al cerrar el descriptor de archivo de la memoria compartida\n");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_1: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Cerrado el descriptor de archivo memoria compartida\n");
-            }
-            escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_1", "Terminada lectura de memoria compartida a diccionario\n");
-        }
-
-
-        // Imprimir resultados del diccionario en el log
-        escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_1", "Hilo %02d: Diccionario del patrón\n", id_hilo);
-        GHashTableIter iter;
-        gpointer clave, valor;
-        g_hash_table_iter_init(&iter, usuariosPF1);
-        while (g_hash_table_iter_next(&iter, &clave, &valor)) {
-            RegistroPatron *registro = (RegistroPatron *)valor;
-            escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_1", "Hilo %02d: Diccionario del patrón Clave: %s, Número Registros: %d\n", id_hilo, registro->clave, registro->cantidad);
-        }
-        escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_1", "Hilo %02d: Terminado diccionario del patrón\n", id_hilo);
-
-        // Eliminar fichero resultado
-        eliminarFicheroResultado(id_hilo);
-        
-        // Revisar resultados que cumplen el patrón
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_1", "Hilo %02d: Registros que cumplen el patrón\n", id_hilo);
-        g_hash_table_iter_init(&iter, usuariosPF1);
-        while (g_hash_table_iter_next(&iter, &clave, &valor)) {
-            RegistroPatron *registro = (RegistroPatron *)valor;
-            // Más de 5 movimientos en una hora
-            if (registro->cantidad > 5) {
-                escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_1", "Hilo %02d: Registro que cumple el patrón Clave: %s, Registros en la Misma Hora: %d\n", id_hilo, registro->clave, registro->cantidad);
-                // Componer el mensaje para el log y monitor
-                snprintf(mensaje, sizeof(mensaje), "%02d:::Registro fraude patrón 1:::Clave=%s:::Registros en la Misma Hora=%d\n", id_hilo, registro->clave, registro->cantidad);
-                escribirEnLog(LOG_GENERAL, "Monitor: hilo_patron_fraude_1", mensaje);
-                // Escribir en fichero resultado patron 1
-                escribirResultadoPatron(id_hilo, mensaje);
-            }
-        }
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_1", "Hilo %02d: Terminados registros que cumplen el patrón\n", id_hilo);
+// Hilo de detección de un patrón de fraude (ver la tabla de patrones en patrones_fraude.c)
+// El diccionario del patrón se conserva entre rondas: en cada ronda sólo se leen los registros
+// consolidados nuevos y se vuelven a evaluar las ventanas con los parámetros en vigor
+void *hilo_patron_fraude(void *arg) {
 
-        // Liberar memoria
-        g_hash_table_destroy(usuariosPF1);
+    int id_hilo = *((int *)arg);
 
-        // Una vez terminado, dejamos el estado del hilo en bloqueado, así nos aseguramos de que no se vuelva a ejecutar hasta
-        // que llegue un aviso a través del pipe
+    char mensaje[150];
+    // Última generación de datos revisada por este hilo
+    unsigned long generacion_vista = 0;
 
-        //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-        snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_1: Hilo %02d: ", id_hilo);
-        simulaRetardo(mensaje);
-
-        // Liberar acceso exclusivo al fichero consolidado
-        sem_post(semaforo_consolidar_ficheros_entrada);
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_1", "Hilo %02d: liberado semáforo.\n", id_hilo);
+    ParametrosPatron parametros = obtenerParametrosPatron(id_hilo);
+    EstadoPatron estado;
+    inicializarEstadoPatron(&estado, id_hilo, &parametros);
 
+    // Modo aproximado: conteo con sketch Count-Min de memoria fija por patrón
+    const ParametrosConfiguracion *parametros_configuracion = obtenerParametros();
+    if (parametros_configuracion->conteo_aproximado) {
+        activarModoAproximadoPatron(&estado, parametros_configuracion->memoria_aproximada, parametros_configuracion->profundidad_aproximada);
     }
 
-    return EXIT_SUCCESS;
-}
-
-// Detección de patrón de fraude de tipo 2
-// Un usuario realiza más de 3 retiros a la vez
-// Entendemos que quiere decir que el usuario realiza tres retiros en la misma hora:minuto:segundo
-void *hilo_patron_fraude_2(void *arg) {
-    int id_hilo = *((int *)arg);
-
-    // Obtener parámetro para ver si hay que copiar los registros en fichero CSV o en memoria compartida
-    const char * char_use_shared_memory;
-    char_use_shared_memory = obtener_valor_configuracion("USE_SHARED_MEMORY", "0");
-    int use_shared_memory = atoi(char_use_shared_memory);
+    // Volcado a disco del diccionario cuando ocupa más de SPILL_MEMORY_BYTES (0: sólo en memoria)
+    if (parametros_configuracion->memoria_volcado > 0) {
+        activarVolcadoPatron(&estado, parametros_configuracion->carpeta_volcado, parametros_configuracion->particiones_volcado,
+            parametros_configuracion->memoria_volcado);
+    }
 
-    char clave[100];
-    char separador1[30] = "@";
-    //char separador2[30] = ":00";
-    int cantidad;
-    char mensaje[150];
+    // Serie de métricas del patrón (NULL si SHARED_METRICS no vale 1)
+    char nombre_serie[LONGITUD_NOMBRE_METRICA];
+    snprintf(nombre_serie, sizeof(nombre_serie), "Patrón %02d", id_hilo);
+    SerieMetricas *serie_metricas = obtenerSerieMetricas(nombre_serie);
+    nombrarHiloPerfilBloqueos(nombre_serie);
 
-    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_2", "Hilo %02d: activado\n", id_hilo);
+    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude", "Hilo %02d: activado (%s)\n", id_hilo, estado.definicion->descripcion);
     // Bucle infinito para observar la carpeta
     while (1) {
-        // Esperar a que el hilo se active
-        activarHiloPatronFraude(id_hilo, 1);
-        
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_2", "Hilo %02d: se ha activado\n", id_hilo);
-        // Obtener acceso exclusivo al fichero consolidado
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_2", "Hilo %02d: solicitando acceso al semáforo\n", id_hilo);
-        sem_wait(semaforo_consolidar_ficheros_entrada);
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_2", "Hilo %02d: comenzando comprobación patrón fraude 1\n", id_hilo);
-
-        // Lectura de los datos de consolidado en el diccionario de datos
-        GHashTable *usuariosPF1 = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_registroPatronF1);
-        if (use_shared_memory == 0 ) {
-            // No hay que utilizar  memoria compartida, hay que leer desde fichero consolidado
-            const char *carpeta_datos;
-            carpeta_datos = obtener_valor_configuracion("PATH_FILES", "../datos");
-            const char *fichero_datos;
-            fichero_datos = obtener_valor_configuracion("INVENTORY_FILE", "file.csv");
-            char nombre_completo_fichero_datos[PATH_MAX];
-            sprintf(nombre_completo_fichero_datos, "%s/%s", carpeta_datos, fichero_datos);
-            escribirEnLog(LOG_INFO, "Monitor: LeerFicheroConsolidadoEnMatriz", "Comenzando lectura del archivo\n");
-            FILE *archivo_consolidado = fopen(nombre_completo_fichero_datos, "r");
-            if (archivo_consolidado == NULL) {
-                    // No se ha conseguido abrir el fichero
-                escribirEnLog(LOG_ERROR, "hilo_patron_fraude", "Hilo %02d: error al abrir el archivo en patrón fraude 1 en fichero %s\n", id_hilo, nombre_completo_fichero_datos);
-
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_2: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            }
-            char line[MAX_LINE_LENGTH];
-            while (fgets(line, sizeof(line), archivo_consolidado)) {
-                // Formato: SUC001;OPE0001;12/03/2024 09:47:00;12/03/2024 10:14:00;USER144;COMPRA01;1;73 €;Finalizado
-                char *sucursal = strtok(line, ";");
-                char *operacion = strtok(NULL, ";");
-                char *fechaHora1 = strtok(NULL, ";");
-                char *fechaHora2 = strtok(NULL, ";");
-                char *usuario = strtok(NULL, ";");
-                char *tipoOperacion1 = strtok(NULL, ";");
-                char *tipoOperacion2 = strtok(NULL, ";");
-                char *importeTexto = strtok(NULL, ";");
-                char *estado = strtok(NULL, ";");
-                escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_2", "Hilo %02d: datos de registro %s;%s;%s;%s;%s;%s;%s;%s;%s;\n", id_hilo, sucursal, operacion, fechaHora1, fechaHora2, usuario, tipoOperacion1, tipoOperacion2, importeTexto, estado);
-
-                // Para este patrón la clave del diccionario va a ser usuario y fecha-hora completa
-                // Comprobar que es un movimiento de retirar dinero
-                int importe = atoi(importeTexto);
-                if (usuario && (importe < 0)) {
-                    strncpy(clave, usuario, sizeof(clave)-1);
-                    strncat(clave, separador1, sizeof(clave)-1);
-                    strncat(clave, fechaHora1, sizeof(clave)-1);
-                    cantidad = 1;
-                    RegistroPatron *registro = g_hash_table_lookup(usuariosPF1, clave);
-                    if (registro == NULL) {
-                        registro = g_new(RegistroPatron, 1);
-                        registro->clave = g_strdup(clave);
-                        registro->cantidad = cantidad;
-                        g_hash_table_insert(usuariosPF1, registro->clave, registro);
-                    } else {
-                        registro->cantidad += cantidad;
-                    }
-                }
-            }
-            fclose(archivo_consolidado);
-            escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_2", "Terminada lectura del archivo consolidado en matriz\n");
-        } else {
-            // Hay que utilizar  memoria compartida
-            escribirEnLog(LOG_INFO, "hilo_patron_fraude_2", "Comenzando lectura de memoria compartida\n");
-
-            // Obtener acceso a la memoria compartida
-            // Obtener los valores de la memoria compartida del fichero de configuración
-            shared_mem_name = obtener_valor_configuracion("SHARED_MEMORY_NAME", "/my_shared_memory");;
-            int size = atoi(obtener_valor_configuracion("SHARED_MEMORY_INITIAL_SIZE", "1024"));
-            shared_mem_size = size;
-            // Al abrir la memoria compartida...
-            // Cambiamos el umask antes de crear el pipe para que se asignen correctamente
-            // los permisos de grupo
-            // ver: https://stackoverflow.com/questions/11909505/posix-shared-memory-and-semaphores-permissions-set-incorrectly-by-open-calls
-            mode_t old_umask = umask(0);
-            shared_mem_fd = shm_open(shared_mem_name, O_RDONLY, 0660);
-            umask(old_umask);
-            if (shared_mem_fd == -1) {
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al acceder a la memoria compartida\n");
-                perror("Error al crear la memoria compartida");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_2: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Obtenido acceso a la memoria compartida nombre %s fd %i\n", shared_mem_name, shared_mem_fd);
-            }
-
-            shared_mem_addr = mmap(0, shared_mem_size, PROT_READ, MAP_SHARED, shared_mem_fd, 0);
-            if (shared_mem_addr == MAP_FAILED) {
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al mapear la memoria compartida\n");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_2: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Mapeada memoria compartida dirección %p tamaño %i\n", shared_mem_addr, shared_mem_size);
-            }
-
-            char caracter;
-            char cadena[MAX_LINE_LENGTH];
-            char line[MAX_LINE_LENGTH];
-            int posicion = 0;
-            for (int i = 0; i < shared_mem_size; i++) {
-                caracter = *(char *)(shared_mem_addr + i);
-                if (caracter != '\n') {
-                    if (caracter != '\0') {
-                        cadena[posicion] = caracter;
-                        posicion++;
-                    }
-                } else {
-                    cadena[posicion] = '\0';
-                    posicion = 0;
-                    // Procesar la linea
-                    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_2", "Vamos a procesar: cadena %s\n", cadena);
-                    strcpy(line, cadena);
-                    // Formato: SUC001;OPE0001;12/03/2024 09:47:00;12/03/2024 10:14:00;USER144;COMPRA01;1;73 €;Finalizado
-                    char *sucursal = strtok(line, ";");
-                    char *operacion = strtok(NULL, ";");
-                    char *fechaHora1 = strtok(NULL, ";");
-                    char *fechaHora2 = strtok(NULL, ";");
-                    char *usuario = strtok(NULL, ";");
-                    char *tipoOperacion1 = strtok(NULL, ";");
-                    char *tipoOperacion2 = strtok(NULL, ";");
-                    char *importeTexto = strtok(NULL, ";");
-                    char *estado = strtok(NULL, ";");
-                    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_2", "Hilo %02d: datos de registro %s;%s;%s;%s;%s;%s;%s;%s;%s;\n", id_hilo, sucursal, operacion, fechaHora1, fechaHora2, usuario, tipoOperacion1, tipoOperacion2, importeTexto, estado);
-
-                    // Para este patrón la clave del diccionario va a ser usuario y fecha-hora completa
-                    // Comprobar que es un movimiento de retirar dinero
-                    int importe = atoi(importeTexto);
-                    if (usuario && (importe < 0)) {
-                        strncpy(clave, usuario, sizeof(clave)-1);
-                        strncat(clave, separador1, sizeof(clave)-1);
-                        strncat(clave, fechaHora1, sizeof(clave)-1);
-                        cantidad = 1;
-                        RegistroPatron *registro = g_hash_table_lookup(usuariosPF1, clave);
-                        if (registro == NULL) {
-                            registro = g_new(RegistroPatron, 1);
-                            registro->clave = g_strdup(clave);
-                            registro->cantidad = cantidad;
-                            g_hash_table_insert(usuariosPF1, registro->clave, registro);
-                        } else {
-                            registro->cantidad += cantidad;
-                        }
-                    }
-                }
-            }
-            if (munmap(shared_mem_addr, shared_mem_size) == -1) {
-                perror("Error al desmapear la memoria compartida");
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al desmapear la memoria compartida\n");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_2: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Desmapeada memoria compartida\n");
-            }
-            if (close(shared_mem_fd) == -1) {
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al cerrar el descriptor de archivo de la memoria compartida\n");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_2: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Cerrado el descriptor de archivo memoria compartida\n");
-            }
-            escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_2", "Terminada lectura de memoria compartida a diccionario\n");
+        // Esperar a que haya datos nuevos desde la última generación revisada
+        generacion_vista = esperarActivacionHiloPatronFraude(id_hilo, generacion_vista);
+
+        // Parámetros en vigor para esta ronda
+        parametros = obtenerParametrosPatron(id_hilo);
+        if (!parametros.activo) {
+            // Patrón desactivado: no se leen datos y no se deja un resultado antiguo
+            escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude", "Hilo %02d: patrón desactivado\n", id_hilo);
+            eliminarFicheroResultado(id_hilo);
+            continue;
         }
 
-        // Imprimir resultados del diccionario en el log
-        escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_2", "Hilo %02d: Diccionario del patrón\n", id_hilo);
-        GHashTableIter iter;
-        gpointer clave, valor;
-        g_hash_table_iter_init(&iter, usuariosPF1);
-        while (g_hash_table_iter_next(&iter, &clave, &valor)) {
-            RegistroPatron *registro = (RegistroPatron *)valor;
-            escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_2", "Hilo %02d: Diccionario del patrón Clave: %s, Número Registros: %d\n", id_hilo, registro->clave, registro->cantidad);
+        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude", "Hilo %02d: se ha activado\n", id_hilo);
+        // Obtener acceso exclusivo al fichero consolidado
+        long long acceso_ns = solicitarAccesoConsolidado(serie_metricas, "Monitor: hilo_patron_fraude", id_hilo);
+        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude", "Hilo %02d: comenzando comprobación patrón fraude %d\n", id_hilo, id_hilo);
+
+        // Adaptar lo acumulado si ha cambiado la ventana y leer los registros nuevos
+        aplicarParametrosPatron(&estado, &parametros);
+        int registros_nuevos = actualizarEstadoPatron(&estado);
+        if (registros_nuevos == -1) {
+            escribirEnLog(LOG_ERROR, "hilo_patron_fraude", "Hilo %02d: error al leer los datos consolidados en patrón fraude %d\n", id_hilo, id_hilo);
+
+            // Simular retardo
+            //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
+            snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude: Hilo %02d: ", id_hilo);
+            simulaRetardo(mensaje);
+            //Liberar semáforo y continuar
+            liberarAccesoConsolidado("Monitor: hilo_patron_fraude", id_hilo);
+            continue;
         }
-        escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_2", "Hilo %02d: Terminado diccionario del patrón\n", id_hilo);
+        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude", "Hilo %02d: %d registros nuevos, %u claves en el diccionario\n",
+            id_hilo, registros_nuevos, g_hash_table_size(estado.registros));
 
         // Eliminar fichero resultado
         eliminarFicheroResultado(id_hilo);
 
-        // Revisar resultados que cumplen el patrón
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_2", "Hilo %02d: Registros que cumplen el patrón\n", id_hilo);
-        g_hash_table_iter_init(&iter, usuariosPF1);
-        while (g_hash_table_iter_next(&iter, &clave, &valor)) {
-            RegistroPatron *registro = (RegistroPatron *)valor;
-            // Más de 3 retiros a la vez
-            if (registro->cantidad > 3) {
-                escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_2", "Hilo %02d: Registro que cumple el patrón Clave: %s, Registros a la vez: %d\n", id_hilo, registro->clave, registro->cantidad);
-                // Componer el mensaje para el log y monitor
-                snprintf(mensaje, sizeof(mensaje), "%02d:::Registro fraude patrón 2:::Clave=%s:::Registros a la vez=%d\n", id_hilo, registro->clave, registro->cantidad);
-                escribirEnLog(LOG_GENERAL, "Monitor: hilo_patron_fraude_2", mensaje);
-
-                // Escribir en fichero resultado patron
-                escribirResultadoPatron(id_hilo, mensaje);
-            }
+        // Revisar resultados que cumplen el patrón (con los volcados a disco fusionados, si los hay)
+        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude", "Hilo %02d: Registros que cumplen el patrón\n", id_hilo);
+        EvaluacionPatron evaluacion = {id_hilo, estado.definicion, parametros.umbral, 0};
+        if (recorrerRegistrosPatron(&estado, evaluarRegistroPatron, &evaluacion) != 0) {
+            // Faltan las claves de algún volcado: el resultado estaría incompleto, se borra y se vuelve a leer en la ronda siguiente
+            escribirEnLog(LOG_ERROR, "hilo_patron_fraude", "Hilo %02d: error al fusionar los volcados a disco del patrón fraude %d\n", id_hilo, id_hilo);
+            eliminarFicheroResultado(id_hilo);
+            evaluacion.alertas = 0;
         }
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_2", "Hilo %02d: Terminados registros que cumplen el patrón\n", id_hilo);
-
-        // Liberar memoria
-        g_hash_table_destroy(usuariosPF1);
+        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude", "Hilo %02d: Terminados registros que cumplen el patrón\n", id_hilo);
+        registrarRondaMetricas(serie_metricas, acceso_ns, registros_nuevos, g_hash_table_size(estado.registros), evaluacion.alertas);
 
-        // Una vez terminado, dejamos el estado del hilo en bloqueado, así nos aseguramos de que no se vuelva a ejecutar hasta
-        // que llegue un aviso a través del pipe
+        // Una vez terminado, el hilo vuelve a esperar a la siguiente generación, así nos aseguramos de que no se vuelva
+        // a ejecutar hasta que llegue un aviso a través del pipe
 
         //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-        snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_2: Hilo %02d: ", id_hilo);
+        snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude: Hilo %02d: ", id_hilo);
         simulaRetardo(mensaje);
 
         // Liberar acceso exclusivo al fichero consolidado
-        sem_post(semaforo_consolidar_ficheros_entrada);
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_2", "Hilo %02d: liberado semáforo.\n", id_hilo);
+        liberarAccesoConsolidado("Monitor: hilo_patron_fraude", id_hilo);
     }
 
     return NULL;
 }
 
-// Detección de patrón de fraude de tipo 3
-// Un usuario comete más de 3 errores durante 1 día
-void *hilo_patron_fraude_3(void *arg) {
 
-   int id_hilo = *((int *)arg);
+// Hilo de detección de las reglas definidas en el fichero de reglas
+// Todas las reglas se evalúan en una única lectura de los datos consolidados
+void *hilo_reglas_fraude(void *arg) {
 
-    // Obtener parámetro para ver si hay que copiar los registros en fichero CSV o en memoria compartida
-    const char * char_use_shared_memory;
-    char_use_shared_memory = obtener_valor_configuracion("USE_SHARED_MEMORY", "0");
-    int use_shared_memory = atoi(char_use_shared_memory);
-
-    char clave[100];
-    char separador1[30] = "@";
-    //char separador2[30] = ":00";
-    int cantidad;
-    char mensaje[150];
+    int id_hilo = *((int *)arg);
 
-    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_3", "Hilo %02d: activado\n", id_hilo);
-    // Bucle infinito para observar la carpeta
-    while (1) {
-        // Esperar a que el hilo se active
-        activarHiloPatronFraude(id_hilo, 1);
-        
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_3", "Hilo %02d: se ha activado\n", id_hilo);
-        // Obtener acceso exclusivo al fichero consolidado
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_3", "Hilo %02d: solicitando acceso al semáforo\n", id_hilo);
-        sem_wait(semaforo_consolidar_ficheros_entrada);
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_3", "Hilo %02d: comenzando comprobación patrón fraude 1\n", id_hilo);
-
-        // Lectura de los datos de consolidado en el diccionario de datos
-        GHashTable *usuariosPF1 = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_registroPatronF1);
-        if (use_shared_memory == 0 ) {
-            // No hay que utilizar  memoria compartida, hay que leer desde fichero consolidado
-            const char *carpeta_datos;
-            carpeta_datos = obtener_valor_configuracion("PATH_FILES", "../datos");
-            const char *fichero_datos;
-            fichero_datos = obtener_valor_configuracion("INVENTORY_FILE", "file.csv");
-            char nombre_completo_fichero_datos[PATH_MAX];
-            sprintf(nombre_completo_fichero_datos, "%s/%s", carpeta_datos, fichero_datos);
-            escribirEnLog(LOG_INFO, "Monitor: LeerFicheroConsolidadoEnMatriz", "Comenzando lectura del archivo\n");
-            FILE *archivo_consolidado = fopen(nombre_completo_fichero_datos, "r");
-            if (archivo_consolidado == NULL) {
-                    // No se ha conseguido abrir el fichero
-                escribirEnLog(LOG_ERROR, "hilo_patron_fraude", "Hilo %02d: error al abrir el archivo en patrón fraude 1 en fichero %s\n", id_hilo, nombre_completo_fichero_datos);
-
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_3: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            }
-            char line[MAX_LINE_LENGTH];
-            while (fgets(line, sizeof(line), archivo_consolidado)) {
-                // Formato: SUC001;OPE0001;12/03/2024 09:47:00;12/03/2024 10:14:00;USER144;COMPRA01;1;73 €;Finalizado
-                char *sucursal = strtok(line, ";");
-                char *operacion = strtok(NULL, ";");
-                char *fechaHora1 = strtok(NULL, ";");
-                char *fechaHora2 = strtok(NULL, ";");
-                char *usuario = strtok(NULL, ";");
-                char *tipoOperacion1 = strtok(NULL, ";");
-                char *tipoOperacion2 = strtok(NULL, ";");
-                char *importeTexto = strtok(NULL, ";");
-                char *estado = strtok(NULL, ";");
-                escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_3", "Hilo %02d: datos de registro %s;%s;%s;%s;%s;%s;%s;%s;%s;\n", id_hilo, sucursal, operacion, fechaHora1, fechaHora2, usuario, tipoOperacion1, tipoOperacion2, importeTexto, estado);
-
-                // Para este patrón la clave del diccionario va a ser usuario y el día del mes
-                // Comprobar que es un movimiento de error
-                if (usuario && (strcmp(estado, "Error"))) {
-                    strncpy(clave, usuario, sizeof(clave)-1);
-                    strncat(clave, separador1, sizeof(clave)-1);
-                    strncat(clave, eliminarUltimosCaracteres(fechaHora1, 9), sizeof(clave)-1);
-                    cantidad = 1;
-                    RegistroPatron *registro = g_hash_table_lookup(usuariosPF1, clave);
-                    if (registro == NULL) {
-                        registro = g_new(RegistroPatron, 1);
-                        registro->clave = g_strdup(clave);
-                        registro->cantidad = cantidad;
-                        g_hash_table_insert(usuariosPF1, registro->clave, registro);
-                    } else {
-                        registro->cantidad += cantidad;
-                    }
-                }
-            }
-            fclose(archivo_consolidado);
-            escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_3", "Terminada lectura del archivo consolidado en matriz\n");
-        } else {
-            // Hay que utilizar  memoria compartida
-            escribirEnLog(LOG_INFO, "hilo_patron_fraude_1", "Comenzando lectura de memoria compartida\n");
-
-            // Obtener acceso a la memoria compartida
-            // Obtener los valores de la memoria compartida del fichero de configuración
-            shared_mem_name = obtener_valor_configuracion("SHARED_MEMORY_NAME", "/my_shared_memory");;
-            int size = atoi(obtener_valor_configuracion("SHARED_MEMORY_INITIAL_SIZE", "1024"));
-            shared_mem_size = size;
-            // Al abrir la memoria compartida...
-            // Cambiamos el umask antes de crear el pipe para que se asignen correctamente
-            // los permisos de grupo
-            // ver: https://stackoverflow.com/questions/11909505/posix-shared-memory-and-semaphores-permissions-set-incorrectly-by-open-calls
-            mode_t old_umask = umask(0);
-            shared_mem_fd = shm_open(shared_mem_name, O_RDONLY, 0660);
-            umask(old_umask);
-            if (shared_mem_fd == -1) {
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al acceder a la memoria compartida\n");
-                perror("Error al crear la memoria compartida");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_3: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Obtenido acceso a la memoria compartida nombre %s fd %i\n", shared_mem_name, shared_mem_fd);
-            }
+    char mensaje[200];
+    // Última generación de datos revisada por este hilo
+    unsigned long generacion_vista = 0;
+    ConjuntoReglas *conjunto = NULL;
 
-            shared_mem_addr = mmap(0, shared_mem_size, PROT_READ, MAP_SHARED, shared_mem_fd, 0);
-            if (shared_mem_addr == MAP_FAILED) {
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al mapear la memoria compartida\n");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_3: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Mapeada memoria compartida dirección %p tamaño %i\n", shared_mem_addr, shared_mem_size);
-            }
+    SerieMetricas *serie_metricas = obtenerSerieMetricas("Reglas");
+    nombrarHiloPerfilBloqueos("Reglas");
 
-            char caracter;
-            char cadena[MAX_LINE_LENGTH];
-            char line[MAX_LINE_LENGTH];
-            int posicion = 0;
-            for (int i = 0; i < shared_mem_size; i++) {
-                caracter = *(char *)(shared_mem_addr + i);
-                if (caracter != '\n') {
-                    if (caracter != '\0') {
-                        cadena[posicion] = caracter;
-                        posicion++;
-                    }
-                } else {
-                    cadena[posicion] = '\0';
-                    posicion = 0;
-                    // Procesar la linea
-                    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_3", "Vamos a procesar: cadena %s\n", cadena);
-                    strcpy(line, cadena);
-                    // Formato: SUC001;OPE0001;12/03/2024 09:47:00;12/03/2024 10:14:00;USER144;COMPRA01;1;73 €;Finalizado
-                    char *sucursal = strtok(line, ";");
-                    char *operacion = strtok(NULL, ";");
-                    char *fechaHora1 = strtok(NULL, ";");
-                    char *fechaHora2 = strtok(NULL, ";");
-                    char *usuario = strtok(NULL, ";");
-                    char *tipoOperacion1 = strtok(NULL, ";");
-                    char *tipoOperacion2 = strtok(NULL, ";");
-                    char *importeTexto = strtok(NULL, ";");
-                    char *estado = strtok(NULL, ";");
-                    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_3", "Hilo %02d: datos de registro %s;%s;%s;%s;%s;%s;%s;%s;%s;\n", id_hilo, sucursal, operacion, fechaHora1, fechaHora2, usuario, tipoOperacion1, tipoOperacion2, importeTexto, estado);
-
-                    // Para este patrón la clave del diccionario va a ser usuario y el día del mes
-                    // Comprobar que es un movimiento de error
-                    if (usuario && (strcmp(estado, "Error")==0)) {
-                        strncpy(clave, usuario, sizeof(clave)-1);
-                        strncat(clave, separador1, sizeof(clave)-1);
-                        strncat(clave, eliminarUltimosCaracteres(fechaHora1, 9), sizeof(clave)-1);
-                        cantidad = 1;
-                        RegistroPatron *registro = g_hash_table_lookup(usuariosPF1, clave);
-                        if (registro == NULL) {
-                            registro = g_new(RegistroPatron, 1);
-                            registro->clave = g_strdup(clave);
-                            registro->cantidad = cantidad;
-                            g_hash_table_insert(usuariosPF1, registro->clave, registro);
-                        } else {
-                            registro->cantidad += cantidad;
-                        }
-                    }
+    escribirEnLog(LOG_DEBUG, "Monitor: hilo_reglas_fraude", "Hilo %02d: activado\n", id_hilo);
+    while (1) {
+        // Esperar a que haya datos nuevos desde la última generación revisada
+        generacion_vista = esperarActivacionHiloPatronFraude(id_hilo, generacion_vista);
+
+        // Recoger las reglas nuevas si main ha vuelto a leer el fichero de reglas
+        pthread_mutex_lock(&mutex_reglas_pendientes);
+        ConjuntoReglas *nuevas = reglas_pendientes;
+        reglas_pendientes = NULL;
+        pthread_mutex_unlock(&mutex_reglas_pendientes);
+        if (nuevas != NULL) {
+            // Las reglas nuevas empiezan a leer los datos desde el principio
+            if (conjunto != NULL) {
+                for (int i = 0; i < conjunto->num_reglas; i++) {
+                    eliminarFicheroResultado(conjunto->reglas[i].numero);
                 }
             }
-            if (munmap(shared_mem_addr, shared_mem_size) == -1) {
-                perror("Error al desmapear la memoria compartida");
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al desmapear la memoria compartida\n");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_3: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Desmapeada memoria compartida\n");
-            }
-            if (close(shared_mem_fd) == -1) {
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al cerrar el descriptor de archivo de la memoria compartida\n");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_3: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Cerrado el descriptor de archivo memoria compartida\n");
-            }
-            escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_3", "Terminada lectura de memoria compartida a diccionario\n");
+            destruirConjuntoReglas(conjunto);
+            conjunto = nuevas;
+            escribirEnLog(LOG_INFO, "Monitor: hilo_reglas_fraude", "Hilo %02d: %d reglas en uso\n", id_hilo, conjunto->num_reglas);
         }
-
-        // Imprimir resultados del diccionario en el log
-        escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_3", "Hilo %02d: Diccionario del patrón\n", id_hilo);
-        GHashTableIter iter;
-        gpointer clave, valor;
-        g_hash_table_iter_init(&iter, usuariosPF1);
-        while (g_hash_table_iter_next(&iter, &clave, &valor)) {
-            RegistroPatron *registro = (RegistroPatron *)valor;
-            escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_3", "Hilo %02d: Diccionario del patrón Clave: %s, Número Registros: %d\n", id_hilo, registro->clave, registro->cantidad);
+        if (conjunto == NULL || conjunto->num_reglas == 0) {
+            continue;
         }
-        escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_3", "Hilo %02d: Terminado diccionario del patrón\n", id_hilo);
 
-        // Eliminar fichero resultado
-        eliminarFicheroResultado(id_hilo);
+        // Obtener acceso exclusivo al fichero consolidado
+        long long acceso_ns = solicitarAccesoConsolidado(serie_metricas, "Monitor: hilo_reglas_fraude", id_hilo);
+        escribirEnLog(LOG_INFO, "Monitor: hilo_reglas_fraude", "Hilo %02d: comenzando comprobación de %d reglas\n", id_hilo, conjunto->num_reglas);
+
+        int registros_nuevos = actualizarConjuntoReglas(conjunto);
+        if (registros_nuevos == -1) {
+            escribirEnLog(LOG_ERROR, "hilo_reglas_fraude", "Hilo %02d: error al leer los datos consolidados en las reglas de fraude\n", id_hilo);
+
+            // Simular retardo
+            //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
+            snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_reglas_fraude: Hilo %02d: ", id_hilo);
+            simulaRetardo(mensaje);
+            //Liberar semáforo y continuar
+            liberarAccesoConsolidado("Monitor: hilo_reglas_fraude", id_hilo);
+            continue;
+        }
 
-        // Revisar resultados que cumplen el patrón
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_3", "Hilo %02d: Registros que cumplen el patrón\n", id_hilo);
-        g_hash_table_iter_init(&iter, usuariosPF1);
-        while (g_hash_table_iter_next(&iter, &clave, &valor)) {
-            RegistroPatron *registro = (RegistroPatron *)valor;
-            // Más de tres errores en un día
-            if (registro->cantidad > 3) {
-                escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_3", "Hilo %02d: Registro que cumple el patrón Clave: %s, Registros con Error: %d\n", id_hilo, registro->clave, registro->cantidad);
-                // Componer el mensaje para el log y monitor
-                snprintf(mensaje, sizeof(mensaje), "%02d:::Registro fraude patrón 3:::Clave=%s:::Registros con Error=%d\n", id_hilo, registro->clave, registro->cantidad);
-                escribirEnLog(LOG_GENERAL, "Monitor: hilo_patron_fraude_3", mensaje);
-
-                // Escribir en fichero resultado patron
-                escribirResultadoPatron(id_hilo, mensaje);
+        // Revisar resultados que cumplen cada regla
+        uint64_t claves = 0, alertas = 0;
+        for (int i = 0; i < conjunto->num_reglas; i++) {
+            ReglaFraude *regla = &conjunto->reglas[i];
+            eliminarFicheroResultado(regla->numero);
+            claves += g_hash_table_size(regla->registros);
+            GHashTableIter iter;
+            gpointer clave, valor;
+            g_hash_table_iter_init(&iter, regla->registros);
+            while (g_hash_table_iter_next(&iter, &clave, &valor)) {
+                RegistroPatron *registro = (RegistroPatron *)valor;
+                if (cumpleReglaFraude(regla, registro)) {
+                    // Componer el mensaje para el log y monitor
+                    formatearResultadoRegla(mensaje, sizeof(mensaje), regla, registro);
+                    escribirEnLog(LOG_GENERAL, "Monitor: hilo_reglas_fraude", mensaje);
+                    // Escribir en fichero resultado de la regla
+                    escribirResultadoPatron(regla->numero, mensaje);
+                    alertas++;
+                }
             }
         }
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_3", "Hilo %02d: Terminados registros que cumplen el patrón\n", id_hilo);
-
-        // Liberar memoria
-        g_hash_table_destroy(usuariosPF1);
-
-        // Una vez terminado, dejamos el estado del hilo en bloqueado, así nos aseguramos de que no se vuelva a ejecutar hasta
-        // que llegue un aviso a través del pipe
+        escribirEnLog(LOG_INFO, "Monitor: hilo_reglas_fraude", "Hilo %02d: Terminadas reglas de fraude (%d registros nuevos)\n", id_hilo, registros_nuevos);
+        registrarRondaMetricas(serie_metricas, acceso_ns, registros_nuevos, claves, alertas);
 
         //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-        snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_3: Hilo %02d: ", id_hilo);
+        snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_reglas_fraude: Hilo %02d: ", id_hilo);
         simulaRetardo(mensaje);
 
         // Liberar acceso exclusivo al fichero consolidado
-        sem_post(semaforo_consolidar_ficheros_entrada);
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_3", "Hilo %02d: liberado semáforo.\n", id_hilo);
+        liberarAccesoConsolidado("Monitor: hilo_reglas_fraude", id_hilo);
     }
-    
+
     return NULL;
 }
 
-// Detección de patrón de fraude de tipo 4
-// Un usuario realiza una operación por cada tipo de operaciones durante el mismo día
-// Suponemos que este patrón de fraude se da cuando en el mismo día hay 1 registro de cada
-// uno de estos tipos de operaciones: 1, 2, 3, 4
-void *hilo_patron_fraude_4(void *arg) {
 
-    int id_hilo = *((int *)arg);
+// Función que añade los solapes nuevos al fichero de resultado de la actividad simultánea
+void escribirResultadoActividad(const ActividadSimultanea *actividad, int eliminar) {
+    char nombre_fichero[PATH_MAX];
+    const ParametrosConfiguracion *parametros = obtenerParametros();
+    snprintf(nombre_fichero, sizeof(nombre_fichero), "%s/%s", parametros->carpeta_datos, parametros->fichero_actividad);
+    if (eliminar) {
+        remove(nombre_fichero);
+    }
+    if (actividad == NULL || actividad->solapes_nuevos->len == 0) {
+        return;
+    }
+    FILE *fichero_resultado = fopen(nombre_fichero, "a");
+    if (fichero_resultado == NULL) {
+        escribirEnLog(LOG_ERROR, "Monitor: escribirResultadoActividad", "Error al escribir en fichero resultado %s\n", nombre_fichero);
+        return;
+    }
+    for (guint i = 0; i < actividad->solapes_nuevos->len; i++) {
+        const char *mensaje = g_ptr_array_index(actividad->solapes_nuevos, i);
+        escribirEnLog(LOG_GENERAL, "Monitor: hilo_actividad_simultanea", mensaje);
+        fprintf(fichero_resultado, "%s", mensaje);
+    }
+    fclose(fichero_resultado);
+}
 
-    // Obtener parámetro para ver si hay que copiar los registros en fichero CSV o en memoria compartida
-    const char * char_use_shared_memory;
-    char_use_shared_memory = obtener_valor_configuracion("USE_SHARED_MEMORY", "0");
-    int use_shared_memory = atoi(char_use_shared_memory);
+// Hilo de detección de la actividad simultánea de un usuario en varias sucursales (ver actividad_simultanea.c)
+// Los índices de intervalos se conservan entre rondas: en cada ronda sólo se buscan los registros nuevos
+// y al fichero de resultado sólo se añaden los solapes nuevos
+void *hilo_actividad_simultanea(void *arg) {
 
-    char clave[100];
-    char separador1[30] = "@";
-    //char separador2[30] = ":00";
-    //int cantidad;
-    char mensaje[150];
+    int id_hilo = *((int *)arg);
 
-    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_4", "Hilo %02d: activado\n", id_hilo);
-    // Bucle infinito para observar la carpeta
-    while (1) {
-        // Esperar a que el hilo se active
-        activarHiloPatronFraude(id_hilo, 1);
-        
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_4", "Hilo %02d: se ha activado\n", id_hilo);
-        // Obtener acceso exclusivo al fichero consolidado
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_4", "Hilo %02d: solicitando acceso al semáforo\n", id_hilo);
-        sem_wait(semaforo_consolidar_ficheros_entrada);
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_4", "Hilo %02d: comenzando comprobación patrón fraude 1\n", id_hilo);
-
-        // Lectura de los datos de consolidado en el diccionario de datos
-        GHashTable *usuariosPF1 = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_registroPatronF1);
-        int numTipoOperacion2, operacion1, operacion2, operacion3, operacion4;
-        if (use_shared_memory == 0 ) {
-            // No hay que utilizar  memoria compartida, hay que leer desde fichero consolidado
-            const char *carpeta_datos;
-            carpeta_datos = obtener_valor_configuracion("PATH_FILES", "../datos");
-            const char *fichero_datos;
-            fichero_datos = obtener_valor_configuracion("INVENTORY_FILE", "file.csv");
-            char nombre_completo_fichero_datos[PATH_MAX];
-            sprintf(nombre_completo_fichero_datos, "%s/%s", carpeta_datos, fichero_datos);
-            escribirEnLog(LOG_INFO, "Monitor: LeerFicheroConsolidadoEnMatriz", "Comenzando lectura del archivo\n");
-            FILE *archivo_consolidado = fopen(nombre_completo_fichero_datos, "r");
-            if (archivo_consolidado == NULL) {
-                    // No se ha conseguido abrir el fichero
-                escribirEnLog(LOG_ERROR, "hilo_patron_fraude", "Hilo %02d: error al abrir el archivo en patrón fraude 1 en fichero %s\n", id_hilo, nombre_completo_fichero_datos);
-
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_4: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            }
-            char line[MAX_LINE_LENGTH];
-            while (fgets(line, sizeof(line), archivo_consolidado)) {
-                // Formato: SUC001;OPE0001;12/03/2024 09:47:00;12/03/2024 10:14:00;USER144;COMPRA01;1;73 €;Finalizado
-                char *sucursal = strtok(line, ";");
-                char *operacion = strtok(NULL, ";");
-                char *fechaHora1 = strtok(NULL, ";");
-                char *fechaHora2 = strtok(NULL, ";");
-                char *usuario = strtok(NULL, ";");
-                char *tipoOperacion1 = strtok(NULL, ";");
-                char *tipoOperacion2 = strtok(NULL, ";");
-                numTipoOperacion2 = atoi(tipoOperacion2);
-                char *importeTexto = strtok(NULL, ";");
-                char *estado = strtok(NULL, ";");
-                escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_4", "Hilo %02d: datos de registro %s;%s;%s;%s;%s;%s;%s;%s;%s;\n", id_hilo, sucursal, operacion, fechaHora1, fechaHora2, usuario, tipoOperacion1, tipoOperacion2, importeTexto, estado);
-
-                //Comprobar el tipo de operación
-                if (numTipoOperacion2 == 1) {operacion1 = 1;} else {operacion1 = 0;}
-                if (numTipoOperacion2 == 2) {operacion2 = 1;} else {operacion2 = 0;}
-                if (numTipoOperacion2 == 3) {operacion3 = 1;} else {operacion3 = 0;}
-                if (numTipoOperacion2 == 4) {operacion4 = 1;} else {operacion4 = 0;}
-                
-                // Para este patrón la clave del diccionario va a ser usuario y el día del mes
-                // Tenemos que ir acumulando los tipos de operación
-                if (usuario) {
-                    strncpy(clave, usuario, sizeof(clave)-1);
-                    strncat(clave, separador1, sizeof(clave)-1);
-                    strncat(clave, eliminarUltimosCaracteres(fechaHora1, 9), sizeof(clave)-1);
-                    
-                    RegistroPatron *registro = g_hash_table_lookup(usuariosPF1, clave);
-                    if (registro == NULL) {
-                        registro = g_new(RegistroPatron, 1);
-                        registro->clave = g_strdup(clave);
-                        registro->cantidad = 0;
-                        registro->operacion1Presente = operacion1;
-                        registro->operacion2Presente = operacion2;
-                        registro->operacion3Presente = operacion3;
-                        registro->operacion4Presente = operacion4;
-                        g_hash_table_insert(usuariosPF1, registro->clave, registro);
-                    } else {
-                        registro->operacion1Presente = registro->operacion1Presente + operacion1;
-                        registro->operacion2Presente = registro->operacion2Presente + operacion2;
-                        registro->operacion3Presente = registro->operacion3Presente + operacion3;
-                        registro->operacion4Presente = registro->operacion4Presente + operacion4;
-                    }
-                }
-            }
-            fclose(archivo_consolidado);
-            escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_4", "Terminada lectura del archivo consolidado en matriz\n");
-        } else {
-            // Hay que utilizar  memoria compartida
-            escribirEnLog(LOG_INFO, "hilo_patron_fraude_4", "Comenzando lectura de memoria compartida\n");
-
-            // Obtener acceso a la memoria compartida
-            // Obtener los valores de la memoria compartida del fichero de configuración
-            shared_mem_name = obtener_valor_configuracion("SHARED_MEMORY_NAME", "/my_shared_memory");;
-            int size = atoi(obtener_valor_configuracion("SHARED_MEMORY_INITIAL_SIZE", "1024"));
-            shared_mem_size = size;
-            // Al abrir la memoria compartida...
-            // Cambiamos el umask antes de crear el pipe para que se asignen correctamente
-            // los permisos de grupo
-            // ver: https://stackoverflow.com/questions/11909505/posix-shared-memory-and-semaphores-permissions-set-incorrectly-by-open-calls
-            mode_t old_umask = umask(0);
-            shared_mem_fd = shm_open(shared_mem_name, O_RDONLY, 0660);
-            umask(old_umask);
-            if (shared_mem_fd == -1) {
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al acceder a la memoria compartida\n");
-                perror("Error al crear la memoria compartida");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_4: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Obtenido acceso a la memoria compartida nombre %s fd %i\n", shared_mem_name, shared_mem_fd);
-            }
+    char mensaje[150];
+    // Última generación de datos revisada por este hilo
+    unsigned long generacion_vista = 0;
+    ActividadSimultanea *actividad = NULL;
 
-            shared_mem_addr = mmap(0, shared_mem_size, PROT_READ, MAP_SHARED, shared_mem_fd, 0);
-            if (shared_mem_addr == MAP_FAILED) {
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al mapear la memoria compartida\n");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_4: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Mapeada memoria compartida dirección %p tamaño %i\n", shared_mem_addr, shared_mem_size);
-            }
+    SerieMetricas *serie_metricas = obtenerSerieMetricas("Actividad simultánea");
+    nombrarHiloPerfilBloqueos("Actividad simultánea");
 
-            
-            char caracter;
-            char cadena[MAX_LINE_LENGTH];
-            char line[MAX_LINE_LENGTH];
-            int posicion = 0;
-            for (int i = 0; i < shared_mem_size; i++) {
-                caracter = *(char *)(shared_mem_addr + i);
-                if (caracter != '\n') {
-                    if (caracter != '\0') {
-                        cadena[posicion] = caracter;
-                        posicion++;
-                    }
-                } else {
-                    cadena[posicion] = '\0';
-                    posicion = 0;
-                    // Procesar la linea
-                    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_4", "Vamos a procesar: cadena %s\n", cadena);
-                    strcpy(line, cadena);
-                    // Formato: SUC001;OPE0001;12/03/2024 09:47:00;12/03/2024 10:14:00;USER144;COMPRA01;1;73 €;Finalizado
-                    char *sucursal = strtok(line, ";");
-                    char *operacion = strtok(NULL, ";");
-                    char *fechaHora1 = strtok(NULL, ";");
-                    char *fechaHora2 = strtok(NULL, ";");
-                    char *usuario = strtok(NULL, ";");
-                    char *tipoOperacion1 = strtok(NULL, ";");
-                    char *tipoOperacion2 = strtok(NULL, ";");
-                    numTipoOperacion2 = atoi(tipoOperacion2);
-                    char *importeTexto = strtok(NULL, ";");
-                    char *estado = strtok(NULL, ";");
-                    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_4", "Hilo %02d: datos de registro %s;%s;%s;%s;%s;%s;%s;%s;%s;\n", id_hilo, sucursal, operacion, fechaHora1, fechaHora2, usuario, tipoOperacion1, tipoOperacion2, importeTexto, estado);
-
-                    //Comprobar el tipo de operación
-                    if (numTipoOperacion2 == 1) {operacion1 = 1;} else {operacion1 = 0;}
-                    if (numTipoOperacion2 == 2) {operacion2 = 1;} else {operacion2 = 0;}
-                    if (numTipoOperacion2 == 3) {operacion3 = 1;} else {operacion3 = 0;}
-                    if (numTipoOperacion2 == 4) {operacion4 = 1;} else {operacion4 = 0;}
-                    
-                    // Para este patrón la clave del diccionario va a ser usuario y el día del mes
-                    // Tenemos que ir acumulando los tipos de operación
-                    if (usuario) {
-                        strncpy(clave, usuario, sizeof(clave)-1);
-                        strncat(clave, separador1, sizeof(clave)-1);
-                        strncat(clave, eliminarUltimosCaracteres(fechaHora1, 9), sizeof(clave)-1);
-                        
-                        RegistroPatron *registro = g_hash_table_lookup(usuariosPF1, clave);
-                        if (registro == NULL) {
-                            registro = g_new(RegistroPatron, 1);
-                            registro->clave = g_strdup(clave);
-                            registro->cantidad = 0;
-                            registro->operacion1Presente = operacion1;
-                            registro->operacion2Presente = operacion2;
-                            registro->operacion3Presente = operacion3;
-                            registro->operacion4Presente = operacion4;
-                            g_hash_table_insert(usuariosPF1, registro->clave, registro);
-                        } else {
-                            registro->operacion1Presente = registro->operacion1Presente + operacion1;
-                            registro->operacion2Presente = registro->operacion2Presente + operacion2;
-                            registro->operacion3Presente = registro->operacion3Presente + operacion3;
-                            registro->operacion4Presente = registro->operacion4Presente + operacion4;
-                        }
-                    }
-                }
-            }
-            if (munmap(shared_mem_addr, shared_mem_size) == -1) {
-                perror("Error al desmapear la memoria compartida");
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al desmapear la memoria compartida\n");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_4: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Desmapeada memoria compartida\n");
-            }
-            if (close(shared_mem_fd) == -1) {
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al cerrar el descriptor de archivo de la memoria compartida\n");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_4: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Cerrado el descriptor de archivo memoria compartida\n");
+    escribirEnLog(LOG_DEBUG, "Monitor: hilo_actividad_simultanea", "Hilo %02d: activado\n", id_hilo);
+    while (1) {
+        // Esperar a que haya datos nuevos desde la última generación revisada
+        generacion_vista = esperarActivacionHiloPatronFraude(id_hilo, generacion_vista);
+
+        if (!obtenerParametros()->actividad_simultanea) {
+            // Patrón desactivado: se descarta lo acumulado y no se deja un resultado antiguo
+            if (actividad != NULL) {
+                destruirActividadSimultanea(actividad);
+                actividad = NULL;
+                escribirResultadoActividad(NULL, 1);
             }
-            escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_4", "Terminada lectura de memoria compartida a diccionario\n");
+            continue;
         }
-
-
-        // Imprimir resultados del diccionario en el log
-        escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_4", "Hilo %02d: Diccionario del patrón\n", id_hilo);
-        GHashTableIter iter;
-        gpointer clave, valor;
-        g_hash_table_iter_init(&iter, usuariosPF1);
-        while (g_hash_table_iter_next(&iter, &clave, &valor)) {
-            RegistroPatron *registro = (RegistroPatron *)valor;
-            escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_4", 
-                "Hilo %02d: Diccionario del patrón Clave: %s, Número Registros: %d, Op1: %d, Op2: %d, Op3: %d, Op4: %d\n", 
-                id_hilo, registro->clave, registro->cantidad, 
-                registro->operacion1Presente, registro->operacion2Presente, registro->operacion3Presente, registro->operacion4Presente);
+        if (actividad == NULL) {
+            // Se empieza a leer los datos desde el principio
+            actividad = crearActividadSimultanea(obtenerParametros()->retencion_actividad);
+            escribirResultadoActividad(NULL, 1);
         }
-        escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_4", "Hilo %02d: Terminado diccionario del patrón\n", id_hilo);
 
-        // Eliminar fichero resultado
-        eliminarFicheroResultado(id_hilo);
+        // Obtener acceso exclusivo al fichero consolidado
+        long long acceso_ns = solicitarAccesoConsolidado(serie_metricas, "Monitor: hilo_actividad_simultanea", id_hilo);
+        escribirEnLog(LOG_INFO, "Monitor: hilo_actividad_simultanea", "Hilo %02d: comenzando comprobación de actividad simultánea\n", id_hilo);
 
-        // Revisar resultados que cumplen el patrón
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_4", "Hilo %02d: Registros que cumplen el patrón\n", id_hilo);
-        g_hash_table_iter_init(&iter, usuariosPF1);
-        while (g_hash_table_iter_next(&iter, &clave, &valor)) {
-            RegistroPatron *registro = (RegistroPatron *)valor;
-            // Todos los tipos de operación presentes
-            if (registro->operacion1Presente > 0 && registro->operacion2Presente > 0 && registro->operacion3Presente > 0 && registro->operacion4Presente > 0 ) {
-                escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_4", "Hilo %02d: Registro que cumple el patrón Clave: %s, Registros con Todos los Tipos de Operaciones\n", id_hilo, registro->clave);
-                // Componer el mensaje para el log y monitor
-                snprintf(mensaje, sizeof(mensaje), "%02d:::Registro fraude patrón 4:::Clave=%s:::Registros con Todos los Tipos de Operaciones\n", id_hilo, registro->clave);
-                escribirEnLog(LOG_GENERAL, "Monitor: hilo_patron_fraude_4", mensaje);
-
-                // Escribir en fichero resultado patron
-                escribirResultadoPatron(id_hilo, mensaje);
-            }
+        int registros_nuevos = actualizarActividadSimultanea(actividad);
+        if (registros_nuevos == -1) {
+            escribirEnLog(LOG_ERROR, "hilo_actividad_simultanea", "Hilo %02d: error al leer los datos consolidados en la actividad simultánea\n", id_hilo);
+        } else {
+            // Si los datos se han vuelto a leer desde el principio, el resultado se vuelve a escribir entero
+            escribirResultadoActividad(actividad, actividad->reiniciado);
+            escribirEnLog(LOG_INFO, "Monitor: hilo_actividad_simultanea", "Hilo %02d: Terminada actividad simultánea (%d registros nuevos, %lld solapes en total)\n",
+                id_hilo, registros_nuevos, actividad->solapes_totales);
+            registrarRondaMetricas(serie_metricas, acceso_ns, registros_nuevos, 0, actividad->solapes_nuevos->len);
         }
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_4", "Hilo %02d: Terminados registros que cumplen el patrón\n", id_hilo);
-
-        // Liberar memoria
-        g_hash_table_destroy(usuariosPF1);
-
-        // Una vez terminado, dejamos el estado del hilo en bloqueado, así nos aseguramos de que no se vuelva a ejecutar hasta
-        // que llegue un aviso a través del pipe
 
         //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-        snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_4: Hilo %02d: ", id_hilo);
+        snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_actividad_simultanea: Hilo %02d: ", id_hilo);
         simulaRetardo(mensaje);
 
         // Liberar acceso exclusivo al fichero consolidado
-        sem_post(semaforo_consolidar_ficheros_entrada);
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_4", "Hilo %02d: liberado semáforo.\n", id_hilo);
+        liberarAccesoConsolidado("Monitor: hilo_actividad_simultanea", id_hilo);
     }
-    
+
     return NULL;
 }
 
-// Detección de patrón de fraude de tipo 5
-// La cantidad de dinero retirado (-) es mayor que la cantidad de dinero ingresado (+) por un usuario en 1 día
-void *hilo_patron_fraude_5(void *arg) {
 
-   int id_hilo = *((int *)arg);
+// Hilo del informe de usuarios con más actividad por ventana (ver top_usuarios.c)
+// Los resúmenes se conservan entre rondas: en cada ronda sólo se leen los registros nuevos y se vuelve a escribir el informe
+void *hilo_top_usuarios(void *arg) {
 
-    // Obtener parámetro para ver si hay que copiar los registros en fichero CSV o en memoria compartida
-    const char * char_use_shared_memory;
-    char_use_shared_memory = obtener_valor_configuracion("USE_SHARED_MEMORY", "0");
-    int use_shared_memory = atoi(char_use_shared_memory);
+    int id_hilo = *((int *)arg);
 
-    char clave[100];
-    char separador1[30] = "@";
-    //char separador2[30] = ":00";
-    int cantidad;
     char mensaje[150];
+    // Última generación de datos revisada por este hilo
+    unsigned long generacion_vista = 0;
+    char fichero_informe[PATH_MAX];
+    snprintf(fichero_informe, sizeof(fichero_informe), "%s/%s", obtenerParametros()->carpeta_datos, obtenerParametros()->fichero_informe_top);
 
-    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_5", "Hilo %02d: activado\n", id_hilo);
-    // Bucle infinito para observar la carpeta
-    while (1) {
-        // Esperar a que el hilo se active
-        activarHiloPatronFraude(id_hilo, 1);
-        
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_5", "Hilo %02d: se ha activado\n", id_hilo);
-        // Obtener acceso exclusivo al fichero consolidado
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_5", "Hilo %02d: solicitando acceso al semáforo\n", id_hilo);
-        sem_wait(semaforo_consolidar_ficheros_entrada);
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_5", "Hilo %02d: comenzando comprobación patrón fraude 1\n", id_hilo);
-
-        // Lectura de los datos de consolidado en el diccionario de datos
-        GHashTable *usuariosPF1 = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_registroPatronF1);
-        if (use_shared_memory == 0 ) {
-            // No hay que utilizar  memoria compartida, hay que leer desde fichero consolidado
-            const char *carpeta_datos;
-            carpeta_datos = obtener_valor_configuracion("PATH_FILES", "../datos");
-            const char *fichero_datos;
-            fichero_datos = obtener_valor_configuracion("INVENTORY_FILE", "file.csv");
-            char nombre_completo_fichero_datos[PATH_MAX];
-            sprintf(nombre_completo_fichero_datos, "%s/%s", carpeta_datos, fichero_datos);
-            escribirEnLog(LOG_INFO, "Monitor: LeerFicheroConsolidadoEnMatriz", "Comenzando lectura del archivo\n");
-            FILE *archivo_consolidado = fopen(nombre_completo_fichero_datos, "r");
-            if (archivo_consolidado == NULL) {
-                    // No se ha conseguido abrir el fichero
-                escribirEnLog(LOG_ERROR, "hilo_patron_fraude", "Hilo %02d: error al abrir el archivo en patrón fraude 1 en fichero %s\n", id_hilo, nombre_completo_fichero_datos);
-
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_5: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            }
-            char line[MAX_LINE_LENGTH];
-            while (fgets(line, sizeof(line), archivo_consolidado)) {
-                // Formato: SUC001;OPE0001;12/03/2024 09:47:00;12/03/2024 10:14:00;USER144;COMPRA01;1;73 €;Finalizado
-                char *sucursal = strtok(line, ";");
-                char *operacion = strtok(NULL, ";");
-                char *fechaHora1 = strtok(NULL, ";");
-                char *fechaHora2 = strtok(NULL, ";");
-                char *usuario = strtok(NULL, ";");
-                char *tipoOperacion1 = strtok(NULL, ";");
-                char *tipoOperacion2 = strtok(NULL, ";");
-                char *importeTexto = strtok(NULL, ";");
-                char *estado = strtok(NULL, ";");
-                escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_5", "Hilo %02d: datos de registro %s;%s;%s;%s;%s;%s;%s;%s;%s;\n", id_hilo, sucursal, operacion, fechaHora1, fechaHora2, usuario, tipoOperacion1, tipoOperacion2, importeTexto, estado);
-
-                // Para este patrón la clave del diccionario va a ser usuario y fecha completa
-                int importe = atoi(importeTexto);
-                if (usuario) {
-                    strncpy(clave, usuario, sizeof(clave)-1);
-                    strncat(clave, separador1, sizeof(clave)-1);
-                    strncat(clave, eliminarUltimosCaracteres(fechaHora1, 9), sizeof(clave)-1);;
-                    cantidad = importe;
-                    RegistroPatron *registro = g_hash_table_lookup(usuariosPF1, clave);
-                    if (registro == NULL) {
-                        registro = g_new(RegistroPatron, 1);
-                        registro->clave = g_strdup(clave);
-                        registro->cantidad = cantidad;
-                        g_hash_table_insert(usuariosPF1, registro->clave, registro);
-                    } else {
-                        registro->cantidad += cantidad;
-                    }
-                }
-            }
-            fclose(archivo_consolidado);
-            escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_5", "Terminada lectura del archivo consolidado en matriz\n");
-        } else {
-            // Hay que utilizar  memoria compartida
-            escribirEnLog(LOG_INFO, "hilo_patron_fraude_5", "Comenzando lectura de memoria compartida\n");
-
-            // Obtener acceso a la memoria compartida
-            // Obtener los valores de la memoria compartida del fichero de configuración
-            shared_mem_name = obtener_valor_configuracion("SHARED_MEMORY_NAME", "/my_shared_memory");;
-            int size = atoi(obtener_valor_configuracion("SHARED_MEMORY_INITIAL_SIZE", "1024"));
-            shared_mem_size = size;
-            // Al abrir la memoria compartida...
-            // Cambiamos el umask antes de crear el pipe para que se asignen correctamente
-            // los permisos de grupo
-            // ver: https://stackoverflow.com/questions/11909505/posix-shared-memory-and-semaphores-permissions-set-incorrectly-by-open-calls
-            mode_t old_umask = umask(0);
-            shared_mem_fd = shm_open(shared_mem_name, O_RDONLY, 0660);
-            umask(old_umask);
-            if (shared_mem_fd == -1) {
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al acceder a la memoria compartida\n");
-                perror("Error al crear la memoria compartida");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_5: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Obtenido acceso a la memoria compartida nombre %s fd %i\n", shared_mem_name, shared_mem_fd);
-            }
-
-            shared_mem_addr = mmap(0, shared_mem_size, PROT_READ, MAP_SHARED, shared_mem_fd, 0);
-            if (shared_mem_addr == MAP_FAILED) {
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al mapear la memoria compartida\n");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_5: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Mapeada memoria compartida dirección %p tamaño %i\n", shared_mem_addr, shared_mem_size);
-            }
-
-            char caracter;
-            char cadena[MAX_LINE_LENGTH];
-            char line[MAX_LINE_LENGTH];
-            int posicion = 0;
-            for (int i = 0; i < shared_mem_size; i++) {
-                caracter = *(char *)(shared_mem_addr + i);
-                if (caracter != '\n') {
-                    if (caracter != '\0') {
-                        cadena[posicion] = caracter;
-                        posicion++;
-                    }
-                } else {
-                    cadena[posicion] = '\0';
-                    posicion = 0;
-                    // Procesar la linea
-                    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_5", "Vamos a procesar: cadena %s\n", cadena);
-                    strcpy(line, cadena);
-                    // Formato: SUC001;OPE0001;12/03/2024 09:47:00;12/03/2024 10:14:00;USER144;COMPRA01;1;73 €;Finalizado
-                    char *sucursal = strtok(line, ";");
-                    char *operacion = strtok(NULL, ";");
-                    char *fechaHora1 = strtok(NULL, ";");
-                    char *fechaHora2 = strtok(NULL, ";");
-                    char *usuario = strtok(NULL, ";");
-                    char *tipoOperacion1 = strtok(NULL, ";");
-                    char *tipoOperacion2 = strtok(NULL, ";");
-                    char *importeTexto = strtok(NULL, ";");
-                    char *estado = strtok(NULL, ";");
-                    escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_5", "Hilo %02d: datos de registro %s;%s;%s;%s;%s;%s;%s;%s;%s;\n", id_hilo, sucursal, operacion, fechaHora1, fechaHora2, usuario, tipoOperacion1, tipoOperacion2, importeTexto, estado);
-
-                    // Para este patrón la clave del diccionario va a ser usuario y fecha completa
-                    int importe = atoi(importeTexto);
-                    if (usuario) {
-                        strncpy(clave, usuario, sizeof(clave)-1);
-                        strncat(clave, separador1, sizeof(clave)-1);
-                        strncat(clave, eliminarUltimosCaracteres(fechaHora1, 9), sizeof(clave)-1);;
-                        cantidad = importe;
-                        RegistroPatron *registro = g_hash_table_lookup(usuariosPF1, clave);
-                        if (registro == NULL) {
-                            registro = g_new(RegistroPatron, 1);
-                            registro->clave = g_strdup(clave);
-                            registro->cantidad = cantidad;
-                            g_hash_table_insert(usuariosPF1, registro->clave, registro);
-                        } else {
-                            registro->cantidad += cantidad;
-                        }
-                    }
-                }
-            }
-            if (munmap(shared_mem_addr, shared_mem_size) == -1) {
-                perror("Error al desmapear la memoria compartida");
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al desmapear la memoria compartida\n");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_5: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Desmapeada memoria compartida\n");
-            }
-            if (close(shared_mem_fd) == -1) {
-                escribirEnLog(LOG_ERROR, "shared_memory", "Error al cerrar el descriptor de archivo de la memoria compartida\n");
-                // Simular retardo
-                //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-                snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_5: Hilo %02d: ", id_hilo);
-                simulaRetardo(mensaje);
-                //Liberar semáforo y continuar
-                sem_post(semaforo_consolidar_ficheros_entrada);
-                continue;
-            } else {
-                escribirEnLog(LOG_INFO, "shared_memory", "Cerrado el descriptor de archivo memoria compartida\n");
-            }
-            escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_5", "Terminada lectura de memoria compartida a diccionario\n");
-        }
+    SerieMetricas *serie_metricas = obtenerSerieMetricas("Top usuarios");
+    nombrarHiloPerfilBloqueos("Top usuarios");
 
-        // Imprimir resultados del diccionario en el log
-        escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_5", "Hilo %02d: Diccionario del patrón\n", id_hilo);
-        GHashTableIter iter;
-        gpointer clave, valor;
-        g_hash_table_iter_init(&iter, usuariosPF1);
-        while (g_hash_table_iter_next(&iter, &clave, &valor)) {
-            RegistroPatron *registro = (RegistroPatron *)valor;
-            escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_5", "Hilo %02d: Diccionario del patrón Clave: %s, Número Registros: %d\n", id_hilo, registro->clave, registro->cantidad);
+    escribirEnLog(LOG_DEBUG, "Monitor: hilo_top_usuarios", "Hilo %02d: activado\n", id_hilo);
+    while (1) {
+        // Esperar a que haya datos nuevos desde la última generación revisada
+        generacion_vista = esperarActivacionHiloPatronFraude(id_hilo, generacion_vista);
+        if (top_usuarios == NULL) {
+            continue;
         }
-        escribirEnLog(LOG_DEBUG, "Monitor: hilo_patron_fraude_5", "Hilo %02d: Terminado diccionario del patrón\n", id_hilo);
 
-        // Eliminar fichero resultado
-        eliminarFicheroResultado(id_hilo);
+        // Obtener acceso exclusivo al fichero consolidado
+        long long acceso_ns = solicitarAccesoConsolidado(serie_metricas, "Monitor: hilo_top_usuarios", id_hilo);
+        escribirEnLog(LOG_INFO, "Monitor: hilo_top_usuarios", "Hilo %02d: comenzando informe de usuarios con más actividad\n", id_hilo);
 
-        // Revisar resultados que cumplen el patrón
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_5", "Hilo %02d: Registros que cumplen el patrón\n", id_hilo);
-        g_hash_table_iter_init(&iter, usuariosPF1);
-        while (g_hash_table_iter_next(&iter, &clave, &valor)) {
-            RegistroPatron *registro = (RegistroPatron *)valor;
-            // Suma de dinero ingresado y retirado es negativa
-            if (registro->cantidad < 0) {
-                escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_5", "Hilo %02d: Registro que cumple el patrón Clave: %s, Número Registros: %d\n", id_hilo, registro->clave, registro->cantidad);
-                // Componer el mensaje para el log y monitor
-                snprintf(mensaje, sizeof(mensaje), "%02d:::Registro fraude patrón 5:::Clave=%s:::Saldo negativo=%d\n", id_hilo, registro->clave, registro->cantidad);
-                escribirEnLog(LOG_GENERAL, "Monitor: hilo_patron_fraude_5", mensaje);
-                
-                // Escribir en fichero resultado patron
-                escribirResultadoPatron(id_hilo, mensaje);
-            }
+        int registros_nuevos = actualizarTopUsuarios(top_usuarios);
+        if (registros_nuevos == -1) {
+            escribirEnLog(LOG_ERROR, "hilo_top_usuarios", "Hilo %02d: error al leer los datos consolidados en el informe de usuarios\n", id_hilo);
+        } else {
+            escribirInformeTopUsuarios(top_usuarios, fichero_informe);
+            escribirEnLog(LOG_INFO, "Monitor: hilo_top_usuarios", "Hilo %02d: Terminado informe de usuarios (%d registros nuevos)\n", id_hilo, registros_nuevos);
+            registrarRondaMetricas(serie_metricas, acceso_ns, registros_nuevos, 0, 0);
         }
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_5", "Hilo %02d: Terminados registros que cumplen el patrón\n", id_hilo);
-
-        // Liberar memoria
-        g_hash_table_destroy(usuariosPF1);
-
-        // Una vez terminado, dejamos el estado del hilo en bloqueado, así nos aseguramos de que no se vuelva a ejecutar hasta
-        // que llegue un aviso a través del pipe
 
         //Cada proceso simulará un retardo aleatorio entre SIMULATE_SLEEP_MAX y SIMULATE_SLEEP_MIN
-        snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_patron_fraude_5: Hilo %02d: ", id_hilo);
+        snprintf(mensaje, sizeof(mensaje), "Monitor: hilo_top_usuarios: Hilo %02d: ", id_hilo);
         simulaRetardo(mensaje);
 
         // Liberar acceso exclusivo al fichero consolidado
-        sem_post(semaforo_consolidar_ficheros_entrada);
-        escribirEnLog(LOG_INFO, "Monitor: hilo_patron_fraude_5", "Hilo %02d: liberado semáforo.\n", id_hilo);
+        liberarAccesoConsolidado("Monitor: hilo_top_usuarios", id_hilo);
     }
 
     return NULL;
 }
 
 
-
 // Función que crea los hilos de detección de los patrones de fraude
 int crear_hilos_patrones_fraude() {
     // Obtener el número de hilos a crear
     int num_hilos; 
-    num_hilos = NUM_PATRONES_FRAUDE; // 1 hilo por cada patrón de fraude
+    num_hilos = NUM_HILOS_DETECCION; // 1 hilo por cada patrón de fraude, 1 hilo para las reglas, 1 para la actividad simultánea y 1 para el informe de usuarios
     escribirEnLog(LOG_INFO, "Monitor: crea_hilos_patrones_fraude", "Necesario crear %02d hilos de patrones de fraude\n", num_hilos);
 
     // Dimensionar pool de hilos observadores
@@ -1483,31 +623,25 @@ int crear_hilos_patrones_fraude() {
     int id[num_hilos];
 
     // Crear los hilos de detección de patrones de fraude
-    // Esta variable servirá para apuntar a la función de implementación del hilo
-    void *(*ptr_hilo_patron_fraude)(void *);
+    // Todos los hilos de patrones ejecutan la misma función; el patrón que revisa cada uno depende de su número
     for (int i = 0; i < num_hilos; i++) {
         id[i] = i + 1; //id[i] tiene el número de hilo
         int* a = malloc(sizeof(int));
         *a=i+1;
 
-        // Ponemos el procesado de este hilo a 1: de momento está bloqueado el mutex
-        activarHiloPatronFraude(id[i], 1);
-
-        // Identificar la función para la creación del hilo según sea el valor de i
-        if (id[i]==1) {
-            ptr_hilo_patron_fraude = &hilo_patron_fraude_1;
-        } else if (id[i]==2) {
-            ptr_hilo_patron_fraude = &hilo_patron_fraude_2;
-        } else if (id[i]==3) {
-            ptr_hilo_patron_fraude = &hilo_patron_fraude_3;
-        } else if (id[i]==4) {
-            ptr_hilo_patron_fraude = &hilo_patron_fraude_4;
-        } else if (id[i]==5) {
-            ptr_hilo_patron_fraude = &hilo_patron_fraude_5;
-        }    
-
-        // Crear el hilo que apunta a la función identificada anteriormente
+        // Inicializar el contador de generaciones del hilo: queda bloqueado hasta la primera notificación
+        inicializarActivacionHilo(&activaciones_patrones[i]);
+
+        // Crear el hilo
         escribirEnLog(LOG_INFO, "Monitor: crea_hilos_patrones_fraude", "Creado hilo de detección de patrón de fraude %02d\n", id[i]);
+        void *(*ptr_hilo_patron_fraude)(void *) = &hilo_patron_fraude;
+        if (id[i] == HILO_REGLAS_FRAUDE) {
+            ptr_hilo_patron_fraude = &hilo_reglas_fraude;
+        } else if (id[i] == HILO_ACTIVIDAD_SIMULTANEA) {
+            ptr_hilo_patron_fraude = &hilo_actividad_simultanea;
+        } else if (id[i] == HILO_TOP_USUARIOS) {
+            ptr_hilo_patron_fraude = &hilo_top_usuarios;
+        }
         if (pthread_create(&tid[i], NULL, ptr_hilo_patron_fraude, a) != 0) {
             escribirEnLog(LOG_ERROR, "Monitor: crea_hilos_patrones_fraude", "Error al crear el hilo de de detección de patrón de fraude %02d\n", id[i]);
             exit(EXIT_FAILURE);
@@ -1551,26 +685,119 @@ int procesarParametrosLlamada(int argc, char *argv[]) {
     return EXIT_SUCCESS;
 }
 
-// Función de manejador de señal CTRL-C
-void ctrlc_handler(int sig) {
-    printf("Monitor: Se ha presionado CTRL-C. Terminando la ejecución.\n");
-    escribirEnLog(LOG_INFO, "Monitor: ctrlc_handler", "Interrupción %2d. Se ha pulsado CTRL-C\n", sig);
+// Función que termina el Monitor de forma ordenada al recibir SIGINT (CTRL-C) o SIGTERM
+// Ya no es un manejador de señal: se llama desde el bucle de eventos al leer la señal del signalfd,
+// así que puede escribir en el log y liberar los recursos con seguridad
+void finalizarMonitor(int sig) {
+    if (sig == SIGINT) {
+        printf("Monitor: Se ha presionado CTRL-C. Terminando la ejecución.\n");
+        escribirEnLog(LOG_INFO, "Monitor: finalizarMonitor", "Interrupción %2d. Se ha pulsado CTRL-C\n", sig);
+    } else {
+        printf("Monitor: Recibida señal de terminación. Terminando la ejecución.\n");
+        escribirEnLog(LOG_INFO, "Monitor: finalizarMonitor", "Interrupción %2d. Recibida señal de terminación\n", sig);
+    }
+
+    // Métricas de planificación de los hilos de patrones de fraude y primeras posiciones del informe de usuarios
+    escribirMetricasActivacionPatrones();
+    escribirMetricasTopUsuarios(top_usuarios);
 
     // Acciones que hay que realizar al terminar el programa
     // Cerrar el semáforo
     sem_close(semaforo_consolidar_ficheros_entrada);
     // Borrar el semáforo
     sem_unlink(semName);
+    // Borrar la página de métricas
+    terminarMetricasCompartidas();
+    // Último informe del perfil de bloqueos (LOCK_PROFILING=1)
+    escribirInformePerfilBloqueos("fin de la ejecución");
 
-    escribirEnLog(LOG_INFO, "Monitor: ctrlc_handler", "Semáforo semaforo_consolidar_ficheros_entrada cerrado\n");
+    escribirEnLog(LOG_INFO, "Monitor: finalizarMonitor", "Semáforo semaforo_consolidar_ficheros_entrada cerrado\n");
     close(pipefd);
-    escribirEnLog(LOG_INFO, "Monitor: ctrlc_handler", "pipe cerrado\n");
-    escribirEnLog(LOG_INFO, "Monitor: ctrlc_handler", "Proceso terminado\n");
+    escribirEnLog(LOG_INFO, "Monitor: finalizarMonitor", "pipe cerrado\n");
+    escribirEnLog(LOG_INFO, "Monitor: finalizarMonitor", "Proceso terminado\n");
 
     // Fin del programa
     exit(EXIT_SUCCESS);
 }
 
+// Mensaje que se está recibiendo por el pipe (puede llegar partido en varias lecturas)
+char mensaje_pipe[MESSAGE_SIZE];
+int longitud_mensaje_pipe = 0;
+
+// Función que procesa los bytes leídos del pipe y devuelve el número de notificaciones completas
+// FileProcessor termina cada mensaje con '\0', así que en una misma lectura pueden llegar varios
+// mensajes seguidos o sólo una parte de un mensaje
+int procesarBytesPipe(const char *datos, int num_bytes) {
+    int num_mensajes = 0;
+    for (int i = 0; i < num_bytes; i++) {
+        if (datos[i] != '\0') {
+            // Si el mensaje es más largo que el buffer, se trunca
+            if (longitud_mensaje_pipe < MESSAGE_SIZE - 1) {
+                mensaje_pipe[longitud_mensaje_pipe] = datos[i];
+                longitud_mensaje_pipe++;
+            }
+        } else {
+            // Mensaje completo
+            mensaje_pipe[longitud_mensaje_pipe] = '\0';
+            longitud_mensaje_pipe = 0;
+            escribirEnLog(LOG_INFO, "Monitor: main", "Recibido %s\n", mensaje_pipe);
+            escribirEnLog(LOG_GENERAL, "Monitor: main", "%s\n", mensaje_pipe);
+            num_mensajes++;
+        }
+    }
+    return num_mensajes;
+}
+
+// Función que crea un temporizador (timerfd) para el bucle de eventos
+int crearTemporizador() {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd == -1) {
+        escribirEnLog(LOG_ERROR, "Monitor: crearTemporizador", "Error al crear el temporizador\n");
+        perror("timerfd_create");
+        exit(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+// Función que programa un temporizador para que venza dentro de milisegundos ms
+// Si periodico es 1 vuelve a vencer cada milisegundos ms; con milisegundos 0 se desactiva
+void programarTemporizador(int fd, int milisegundos, int periodico) {
+    struct itimerspec programacion;
+    memset(&programacion, 0, sizeof(programacion));
+    programacion.it_value.tv_sec = milisegundos / 1000;
+    programacion.it_value.tv_nsec = (long)(milisegundos % 1000) * 1000000;
+    if (periodico) {
+        programacion.it_interval = programacion.it_value;
+    }
+    timerfd_settime(fd, 0, &programacion, NULL);
+}
+
+// Función que añade un descriptor al conjunto de descriptores observados por epoll
+void observarDescriptor(int epollfd, int fd) {
+    struct epoll_event evento;
+    memset(&evento, 0, sizeof(evento));
+    evento.events = EPOLLIN;
+    evento.data.fd = fd;
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &evento) == -1) {
+        escribirEnLog(LOG_ERROR, "Monitor: observarDescriptor", "Error al añadir el descriptor %d a epoll\n", fd);
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Función que lanza una ronda de detección para el lote de notificaciones acumulado
+// Las notificaciones que llegan en ráfaga se agrupan en un único lote, que se despacha cuando
+// vence el retardo máximo DEBOUNCE_MAX_DELAY_MS o se alcanzan DEBOUNCE_MAX_BATCH notificaciones.
+// Así una ráfaga de ficheros consolidados provoca una sola ronda y la latencia queda acotada
+void despacharLoteNotificaciones(int num_notificaciones, long long instante_primera) {
+    escribirEnLog(LOG_INFO, "Monitor: despacharLoteNotificaciones", "Lote de %d notificaciones agrupadas en %lld ms\n",
+        num_notificaciones, obtener_milisegundos_monotonicos() - instante_primera);
+    // Desbloquear los hilos de detección de patrón de fraude una sola vez por lote
+    for (int i = 1; i <= NUM_HILOS_DETECCION; i++) {
+        activarHiloPatronFraude(i);
+    }
+}
+
 // Función main que se activa al llamar desde línea de comandos
 int main(int argc, char *argv[]) {
     // Parámetros: argc es el contador de parámetros y argv es el valor de estos parámetros
@@ -1584,11 +811,18 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    // Leer y validar el fichero de configuración (avisa en el log de las claves desconocidas y los valores no válidos)
+    const ParametrosConfiguracion *parametros = obtenerParametros();
+
+    // Perfil de contención de los bloqueos (antes de crear los hilos)
+    iniciarPerfilBloqueos(parametros->perfil_bloqueos, parametros->fichero_perfil_bloqueos, "Monitor");
+    nombrarHiloPerfilBloqueos("main");
+
     // Vamos a crear un semáforo con un nombre común para file procesor y monitor de forma que podamos utilizarlo
     // para asegurar el acceso a recursos comunes desde ambos procesos. 
     // Creamos un semáforo de 1 recursos con nombre definido en SEMAPHORE_NAME y permisos de lectura y escritura
     // Ponemos los permisos 0660 para que el semáforo pueda ser utilizado por 2 usuarios del mismo grupo
-    semName = obtener_valor_configuracion("SEMAPHORE_NAME", "/semaforo");
+    semName = parametros->nombre_semaforo;
     // Temporalmente cambiamos a umask(0) para que se establezcan correctamente los permisos de grupo
     // ver: https://stackoverflow.com/questions/11909505/posix-shared-memory-and-semaphores-permissions-set-incorrectly-by-open-calls
     mode_t old_umask = umask(0);
@@ -1601,16 +835,31 @@ int main(int argc, char *argv[]) {
     }
     escribirEnLog(LOG_INFO, "Monitor: main", "Semáforo %s creado\n", semName);
     escribirEnLog(LOG_INFO, "Monitor:main", "Semáforo semaforo_consolidar_ficheros_entrada creado\n");
+    lectura_instantanea = parametros->lectura_instantanea;
+    if (lectura_instantanea) {
+        escribirEnLog(LOG_INFO, "Monitor: main", "Lectura hasta la marca de confirmación de FileProcessor, sin semáforo\n");
+    }
 
-    // Registra el manejador de señal para SIGINT para CTRL-C
-    if (signal(SIGINT, ctrlc_handler) == SIG_ERR) {
+    // Bloquear SIGINT (CTRL-C), SIGTERM, SIGHUP y SIGUSR1 antes de crear los hilos (que heredan la máscara)
+    // Estas señales no interrumpen a ningún hilo: se leen como eventos desde un signalfd en el bucle principal
+    sigset_t senales;
+    sigemptyset(&senales);
+    sigaddset(&senales, SIGINT);
+    sigaddset(&senales, SIGTERM);
+    sigaddset(&senales, SIGHUP);
+    sigaddset(&senales, SIGUSR1);
+    if (pthread_sigmask(SIG_BLOCK, &senales, NULL) != 0) {
+        escribirEnLog(LOG_ERROR, "Monitor: main", "No se pudo bloquear SIGINT/SIGTERM/SIGHUP/SIGUSR1\n");
+        return EXIT_FAILURE;
+    }
+    int signalfd_monitor = signalfd(-1, &senales, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signalfd_monitor == -1) {
         escribirEnLog(LOG_ERROR, "Monitor: main", "No se pudo capturar SIGINT\n");
         return EXIT_FAILURE;
     }
     
     // Crear el named pipe
-    const char * pipeName;
-    pipeName = obtener_valor_configuracion("PIPE_NAME", "/tmp/pipeAudita");
+    const char *pipeName = parametros->nombre_pipe;
     escribirEnLog(LOG_INFO, "Monitor: main", "Creando pipe %s\n", pipeName);
     // Cambiamos el umask antes de crear el pipe para que se asignen correctamente
     // los permisos de grupo
@@ -1619,36 +868,163 @@ int main(int argc, char *argv[]) {
     mkfifo(pipeName, 0666);
     umask(old_umask);
 
-    // Variables de lectura del pipe
-    char buffer[MESSAGE_SIZE];
-    int bytes_read;
+    // Parámetros de agrupación de las notificaciones del pipe
+    int max_retardo_ms = parametros->retardo_maximo_agrupacion_ms;
+    int max_lote = parametros->max_lote_agrupacion;
+    if (max_retardo_ms < 1) {
+        max_retardo_ms = 1;
+    }
+    // Intervalo de escritura de las métricas en el log (0 = desactivado)
+    int intervalo_metricas_ms = parametros->intervalo_metricas_ms;
+
+    // Parámetros de los patrones de fraude (antes de crear los hilos, que los copian al arrancar)
+    cargarConfiguracionPatrones();
+    cargarReglasFraude();
+
+    // Informe de usuarios con más actividad por ventana (TOPK_REPORT=1)
+    if (parametros->informe_top) {
+        top_usuarios = crearTopUsuarios(parametros->tamano_top, parametros->ventanas_top, parametros->cubos_top);
+    }
+
+    // Página de métricas para fpstat (antes de crear los hilos, que dan de alta su serie al arrancar)
+    if (parametros->metricas_compartidas) {
+        iniciarMetricasCompartidas(parametros->nombre_metricas_compartidas, &definicion_metricas);
+    }
 
     //Creación de los hilos de observación de ficheros de las sucursales
     crear_hilos_patrones_fraude();
 
     // Abrir el pipe
+    // Lo abrimos en lectura y escritura: así el propio Monitor mantiene abierto un extremo de escritura,
+    // el pipe no llega a fin de fichero cada vez que FileProcessor lo cierra y epoll se queda
+    // bloqueado sin consumir CPU hasta que llega una notificación
     escribirEnLog(LOG_INFO, "Monitor: main", "Abriendo pipe %s\n", pipeName);
-    pipefd = open(pipeName, O_RDONLY);
+    pipefd = open(pipeName, O_RDWR | O_NONBLOCK);
+    if (pipefd == -1) {
+        escribirEnLog(LOG_ERROR, "Monitor: main", "Error al abrir el pipe %s\n", pipeName);
+        perror("pipe PIPE_NAME");
+        exit(EXIT_FAILURE);
+    }
+
+    // Bucle de eventos: un único epoll observa el pipe, las señales y los temporizadores
+    //    - pipe: notificaciones de FileProcessor
+    //    - signalfd: SIGINT/SIGTERM (terminación ordenada), SIGHUP y SIGUSR1 (informe del perfil de bloqueos)
+    //    - temporizador_lote: vence cuando se cumple el retardo máximo del lote de notificaciones
+    //    - temporizador_metricas: escritura periódica de las métricas en el log
+    int epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollfd == -1) {
+        escribirEnLog(LOG_ERROR, "Monitor: main", "Error al crear epoll\n");
+        perror("epoll_create1");
+        exit(EXIT_FAILURE);
+    }
+    int temporizador_lote = crearTemporizador();
+    int temporizador_metricas = crearTemporizador();
+    observarDescriptor(epollfd, pipefd);
+    observarDescriptor(epollfd, signalfd_monitor);
+    observarDescriptor(epollfd, temporizador_lote);
+    observarDescriptor(epollfd, temporizador_metricas);
+    if (intervalo_metricas_ms > 0) {
+        programarTemporizador(temporizador_metricas, intervalo_metricas_ms, 1);
+    }
+
+    // Estado del lote de notificaciones en curso
+    int notificaciones_lote = 0;
+    long long instante_primera_notificacion = 0;
+
     escribirEnLog(LOG_INFO, "Monitor: main", "Entrando en ejecucion indefinida\n");
-    
 
+    struct epoll_event eventos[4];
     while (1) {
-        bytes_read = read(pipefd, buffer, sizeof(buffer));
-        if (bytes_read > 0) {
-            // Recibido mensaje en el pipe
-            escribirEnLog(LOG_INFO, "Monitor: main", "Recibido %s\n", buffer);    
-            escribirEnLog(LOG_GENERAL, "Monitor: main", "%s\n", buffer);    
-
-            // Desbloquear los hilos de detección de patrón de fraude
-            for (int i = 1; i <= NUM_PATRONES_FRAUDE; i++) {
-                activarHiloPatronFraude(i, 0);
+        // main no guarda punteros a los parámetros de configuración entre vueltas del bucle
+        estado_quiescente_configuracion();
+        int num_eventos = epoll_wait(epollfd, eventos, 4, -1);
+        if (num_eventos == -1) {
+            if (errno == EINTR) {
+                continue;
             }
+            escribirEnLog(LOG_ERROR, "Monitor: main", "Error en epoll_wait\n");
+            exit(EXIT_FAILURE);
+        }
+
+        for (int e = 0; e < num_eventos; e++) {
+            int fd = eventos[e].data.fd;
+
+            if (fd == pipefd) {
+                // Leer todo lo disponible en el pipe (no bloqueante)
+                char buffer[MESSAGE_SIZE];
+                int bytes_read;
+                while ((bytes_read = read(pipefd, buffer, sizeof(buffer))) > 0) {
+                    int nuevas = procesarBytesPipe(buffer, bytes_read);
+                    if (nuevas > 0 && notificaciones_lote == 0) {
+                        // Primera notificación del lote: arrancar el retardo máximo
+                        instante_primera_notificacion = obtener_milisegundos_monotonicos();
+                        programarTemporizador(temporizador_lote, max_retardo_ms, 0);
+                    }
+                    notificaciones_lote += nuevas;
+                }
+                if (notificaciones_lote >= max_lote) {
+                    // Lote completo: despachar sin esperar al temporizador
+                    programarTemporizador(temporizador_lote, 0, 0);
+                    despacharLoteNotificaciones(notificaciones_lote, instante_primera_notificacion);
+                    notificaciones_lote = 0;
+                }
+
+            } else if (fd == temporizador_lote) {
+                uint64_t vencimientos;
+                if (read(temporizador_lote, &vencimientos, sizeof(vencimientos)) > 0 && notificaciones_lote > 0) {
+                    despacharLoteNotificaciones(notificaciones_lote, instante_primera_notificacion);
+                    notificaciones_lote = 0;
+                }
+
+            } else if (fd == temporizador_metricas) {
+                uint64_t vencimientos;
+                if (read(temporizador_metricas, &vencimientos, sizeof(vencimientos)) > 0) {
+                    escribirMetricasActivacionPatrones();
+                    escribirMetricasTopUsuarios(top_usuarios);
+                }
 
-            //printf("%s\n", buffer);
-            memset(buffer, 0, sizeof(buffer));
+            } else if (fd == signalfd_monitor) {
+                struct signalfd_siginfo info;
+                while (read(signalfd_monitor, &info, sizeof(info)) == sizeof(info)) {
+                    if (info.ssi_signo == SIGHUP) {
+                        // Volver a leer mo.conf (nivel de log, agrupación de notificaciones, métricas, lectura y parámetros
+                        // de los patrones de fraude) sin descartar lo acumulado, volver a compilar el fichero de reglas
+                        // y lanzar una ronda para que los resultados reflejen los parámetros nuevos
+                        escribirEnLog(LOG_INFO, "Monitor: main", "Recibida señal SIGHUP\n");
+                        escribirMetricasActivacionPatrones();
+                        if (recargarParametros() == EXIT_SUCCESS) {
+                            const ParametrosConfiguracion *recargados = obtenerParametros();
+                            max_retardo_ms = recargados->retardo_maximo_agrupacion_ms;
+                            max_lote = recargados->max_lote_agrupacion;
+                            if (max_retardo_ms < 1) {
+                                max_retardo_ms = 1;
+                            }
+                            if (recargados->intervalo_metricas_ms != intervalo_metricas_ms) {
+                                // Con 0 el temporizador queda desactivado
+                                intervalo_metricas_ms = recargados->intervalo_metricas_ms;
+                                programarTemporizador(temporizador_metricas, intervalo_metricas_ms, 1);
+                            }
+                        }
+                        cargarReglasFraude();
+                        if (cargarConfiguracionPatrones() == EXIT_SUCCESS) {
+                            for (int i = 1; i <= NUM_HILOS_DETECCION; i++) {
+                                activarHiloPatronFraude(i);
+                            }
+                        }
+                    } else if (info.ssi_signo == SIGUSR1) {
+                        // Añadir el informe del perfil de bloqueos a LOCK_PROFILING_FILE
+                        if (escribirInformePerfilBloqueos("SIGUSR1") == EXIT_SUCCESS) {
+                            escribirEnLog(LOG_INFO, "Monitor: main", "Informe del perfil de bloqueos añadido a %s\n", parametros->fichero_perfil_bloqueos);
+                        } else {
+                            escribirEnLog(LOG_WARNING, "Monitor: main", "SIGUSR1: no hay informe del perfil de bloqueos (LOCK_PROFILING=%d)\n", parametros->perfil_bloqueos);
+                        }
+                    } else {
+                        // SIGINT o SIGTERM: terminar sin esperar al lote pendiente
+                        finalizarMonitor(info.ssi_signo);
+                    }
+                }
+            }
         }
-        // Ponemos 1 centésima de segundo para evitar el consumo excesivo de la CPU
-        sleep_centiseconds(1);
     }
 
     // Código inaccesible, el programa lo acabará le usuario con CTRL+C 
@@ -20,6 +20,11 @@
 #include <signal.h>         // Manejo de la señal CTRL-C
 #include <glib.h>           // Manejo de diccionarios GLib utilizado para la detección de patrones de fraude
 #include <sys/mman.h>       // Memoria compartida
+#include <stdint.h>         // Tipos enteros de tamaño fijo (uint64_t de los temporizadores)
+#include <sys/epoll.h>      // Bucle de eventos del Monitor
+#include <sys/signalfd.h>   // Lectura de señales como eventos del bucle
+#include <sys/timerfd.h>    // Temporizadores del bucle de eventos
+#include <errno.h>          // Códigos de error de las llamadas al sistema
 
 
 
@@ -27,4 +32,16 @@
 #include "config_files.h"   // Funciones para generación de logs
 #include "utilidades.h"     // Funciones para generación de logs
 #include "constants.h"      // Constantes de la aplicación
+#include "activacion_hilos.h" // Activación de los hilos de patrones de fraude por generaciones
+#include "patrones_fraude.h" // Definición y acumulación de los patrones de fraude
+#include "reglas_fraude.h"   // Reglas de fraude definidas por el usuario
+#include "actividad_simultanea.h" // Actividad simultánea de un usuario en varias sucursales
+#include "top_usuarios.h"     // Usuarios con más actividad por ventana de tiempo
+#include "parametros_configuracion.h" // Parámetros de mo.conf con tipo
+#include "metricas_proceso.h"      // Métricas en memoria compartida para fpstat
+#include "perfil_bloqueos.h"       // Perfil de contención de los bloqueos (LOCK_PROFILING)
+
+// Contadores e histogramas de las series de métricas de los hilos de detección (ver definicion_metricas)
+enum { METRICA_RONDAS, METRICA_REGISTROS, METRICA_CLAVES, METRICA_ALERTAS };
+enum { HISTOGRAMA_ESPERA_ACCESO, HISTOGRAMA_DURACION_RONDA };
 
@@ -0,0 +1,85 @@
+// ------------------------------------------------------------------
+// FUNCIONES DE ACTIVACIÓN DE HILOS POR GENERACIONES (EVENTCOUNT)
+// ------------------------------------------------------------------
+
+#include "activacion_hilos.h"
+#include "utilidades.h"
+
+#include <string.h>         // memset
+
+#pragma region ActivacionHilos
+/*
+    Sustituye al antiguo mecanismo de bloquear un mutex desde el propio hilo y desbloquearlo desde main
+    (desbloquear un mutex desde un hilo distinto del que lo bloqueó tiene comportamiento indefinido,
+    y si llegaban varias notificaciones mientras el hilo estaba ocupado se perdían activaciones).
+
+    Funcionamiento:
+        - main llama a publicarActivacionHilo: incrementa la generación y despierta al hilo
+        - el hilo llama a esperarActivacionHilo con la última generación que ha revisado
+          y se bloquea únicamente si no hay ninguna generación posterior
+        - si se publican varias generaciones mientras el hilo está ocupado, en la siguiente espera
+          no se bloquea y las atiende todas en una sola ronda (pendientes > 1)
+*/
+
+// Función que inicializa el contador de generaciones de un hilo
+void inicializarActivacionHilo(ActivacionHilo *activacion) {
+    pthread_mutex_init(&activacion->mutex, NULL);
+    pthread_cond_init(&activacion->condicion, NULL);
+    activacion->generacion = 0;
+    activacion->instante_publicacion_ns = 0;
+    memset(&activacion->metricas, 0, sizeof(activacion->metricas));
+}
+
+// Función que publica una nueva generación de datos y despierta al hilo si está esperando
+void publicarActivacionHilo(ActivacionHilo *activacion) {
+    pthread_mutex_lock(&activacion->mutex);
+    activacion->generacion++;
+    // La latencia se mide desde la primera generación que el hilo todavía no ha atendido
+    if (activacion->instante_publicacion_ns == 0) {
+        activacion->instante_publicacion_ns = obtener_nanosegundos_monotonicos();
+    }
+    pthread_cond_signal(&activacion->condicion);
+    pthread_mutex_unlock(&activacion->mutex);
+}
+
+// Función que bloquea al hilo hasta que haya una generación posterior a generacion_vista
+// Devuelve la generación que se atiende y las métricas de la activación
+ActivacionRonda esperarActivacionHilo(ActivacionHilo *activacion, unsigned long generacion_vista) {
+    ActivacionRonda ronda;
+
+    pthread_mutex_lock(&activacion->mutex);
+    // El bucle protege frente a despertares espurios de la variable de condición
+    while (activacion->generacion == generacion_vista) {
+        pthread_cond_wait(&activacion->condicion, &activacion->mutex);
+    }
+
+    ronda.generacion = activacion->generacion;
+    ronda.pendientes = activacion->generacion - generacion_vista;
+    ronda.latencia_ns = obtener_nanosegundos_monotonicos() - activacion->instante_publicacion_ns;
+    activacion->instante_publicacion_ns = 0;
+
+    // Actualizar las métricas acumuladas
+    MetricasActivacion *metricas = &activacion->metricas;
+    metricas->rondas++;
+    metricas->generaciones_atendidas += ronda.pendientes;
+    if (ronda.pendientes > metricas->pendientes_maximo) {
+        metricas->pendientes_maximo = ronda.pendientes;
+    }
+    metricas->latencia_total_ns += ronda.latencia_ns;
+    if (ronda.latencia_ns > metricas->latencia_maxima_ns) {
+        metricas->latencia_maxima_ns = ronda.latencia_ns;
+    }
+    pthread_mutex_unlock(&activacion->mutex);
+
+    return ronda;
+}
+
+// Función que devuelve una copia consistente de las métricas de activación de un hilo
+MetricasActivacion obtenerMetricasActivacionHilo(ActivacionHilo *activacion) {
+    pthread_mutex_lock(&activacion->mutex);
+    MetricasActivacion copia = activacion->metricas;
+    pthread_mutex_unlock(&activacion->mutex);
+    return copia;
+}
+
+#pragma endregion ActivacionHilos
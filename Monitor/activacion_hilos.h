@@ -0,0 +1,47 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <pthread.h>        // Tratamiento de hilos, mutex y variables de condición
+#pragma endregion Librerias
+
+
+// Métricas de planificación acumuladas de un hilo
+typedef struct METRICAS_ACTIVACION {
+    unsigned long rondas;                   // Rondas ejecutadas por el hilo
+    unsigned long generaciones_atendidas;   // Generaciones atendidas (>= rondas)
+    unsigned long pendientes_maximo;        // Máximo de generaciones atendidas en una misma ronda
+    long long latencia_total_ns;            // Suma de latencias de activación
+    long long latencia_maxima_ns;           // Latencia de activación máxima
+} MetricasActivacion;
+
+// Contador de generaciones (eventcount) para activar un hilo cuando hay datos nuevos
+// El hilo que publica incrementa la generación; el hilo que espera recuerda la última generación
+// que ha revisado y sólo se bloquea mientras no haya una generación posterior. De esta forma
+// ninguna notificación se pierde aunque llegue mientras el hilo está ocupado, y varias
+// notificaciones pendientes se atienden en una única ronda
+typedef struct ACTIVACION_HILO {
+    pthread_mutex_t mutex;
+    pthread_cond_t condicion;
+    unsigned long generacion;               // Última generación publicada
+    long long instante_publicacion_ns;      // Instante de la primera generación pendiente (0 si no hay pendientes)
+    MetricasActivacion metricas;
+} ActivacionHilo;
+
+// Métricas de la última activación que devuelve esperarActivacionHilo
+typedef struct ACTIVACION_RONDA {
+    unsigned long generacion;               // Generación que se atiende en esta ronda
+    unsigned long pendientes;               // Generaciones publicadas desde la ronda anterior
+    long long latencia_ns;                  // Tiempo desde la primera publicación pendiente hasta la activación
+} ActivacionRonda;
+
+void inicializarActivacionHilo(ActivacionHilo *activacion);
+
+void publicarActivacionHilo(ActivacionHilo *activacion);
+
+ActivacionRonda esperarActivacionHilo(ActivacionHilo *activacion, unsigned long generacion_vista);
+
+MetricasActivacion obtenerMetricasActivacionHilo(ActivacionHilo *activacion);
@@ -0,0 +1,152 @@
+// ------------------------------------------------------------------
+// PATRÓN DE ACTIVIDAD SIMULTÁNEA DE UN USUARIO EN VARIAS SUCURSALES
+// ------------------------------------------------------------------
+
+#include "actividad_simultanea.h"
+#include "log_files.h"
+
+#pragma region ActividadSimultanea
+/*
+    Detecta un mismo usuario con operaciones en sucursales distintas cuyos intervalos fechaHora1-fechaHora2
+    se solapan. Cada usuario tiene un índice de intervalos (ver indice_intervalos.c) con sus operaciones:
+        - cada registro nuevo se busca en el índice de su usuario; cada operación de otra sucursal que se
+          solapa con él es un solape nuevo, y después el registro se añade al índice
+        - así cada pareja de operaciones se encuentra una sola vez, cuando llega la segunda, y el detector
+          trabaja de forma incremental con los registros que añade cada fichero consolidado
+        - al final de cada ronda se eliminan las operaciones que terminaron más de CONCURRENT_RETENTION_SECONDS
+          antes de la operación más reciente, para que el índice no crezca sin límite; un registro que llega
+          con más retraso que ese ya no se compara con las operaciones eliminadas
+    Los registros sin fechas válidas o que terminan antes de empezar no se tienen en cuenta.
+*/
+
+// Columnas que utiliza el detector
+#define COLUMNAS_ACTIVIDAD (MASCARA_COLUMNA(COLUMNA_SUCURSAL) | MASCARA_COLUMNA(COLUMNA_OPERACION) | MASCARA_COLUMNA(COLUMNA_USUARIO) \
+    | MASCARA_COLUMNA(COLUMNA_FECHA_INICIO) | MASCARA_COLUMNA(COLUMNA_FECHA_FIN))
+
+static void liberarIndiceUsuario(gpointer datos) {
+    destruirIndiceIntervalos((IndiceIntervalos *)datos);
+}
+
+// Función que crea el detector sin operaciones
+ActividadSimultanea *crearActividadSimultanea(long long retencion) {
+    ActividadSimultanea *actividad = g_new0(ActividadSimultanea, 1);
+    actividad->usuarios = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, liberarIndiceUsuario);
+    inicializarCursorConsolidado(&actividad->cursor);
+    actividad->cursor.columnas = COLUMNAS_ACTIVIDAD;
+    actividad->retencion = retencion;
+    actividad->instante_maximo = -1;
+    actividad->solapes_nuevos = g_ptr_array_new_with_free_func(g_free);
+    actividad->semilla = 2463534242u;
+    return actividad;
+}
+
+void destruirActividadSimultanea(ActividadSimultanea *actividad) {
+    if (actividad == NULL) {
+        return;
+    }
+    g_hash_table_destroy(actividad->usuarios);
+    g_ptr_array_free(actividad->solapes_nuevos, TRUE);
+    g_free(actividad);
+}
+
+// Registro que se está buscando en el índice de su usuario
+typedef struct BUSQUEDA_SOLAPE {
+    ActividadSimultanea *actividad;
+    const RegistroConsolidado *registro;
+} BusquedaSolape;
+
+// Función que anota un solape si la operación del índice es de otra sucursal
+static void anotarSolape(const NodoIntervalo *intervalo, void *contexto) {
+    BusquedaSolape *busqueda = (BusquedaSolape *)contexto;
+    const RegistroConsolidado *registro = busqueda->registro;
+    if (strcmp(intervalo->sucursal, registro->sucursal) == 0) {
+        return;
+    }
+    long long desde = intervalo->inicio > registro->instante1 ? intervalo->inicio : registro->instante1;
+    long long hasta = intervalo->fin < registro->instante2 ? intervalo->fin : registro->instante2;
+    char mensaje[250];
+    snprintf(mensaje, sizeof(mensaje), "AS:::Actividad simultánea en varias sucursales:::Usuario=%s:::%s/%s y %s/%s:::Segundos solapados=%lld\n",
+        registro->usuario, intervalo->sucursal, intervalo->operacion, registro->sucursal, registro->operacion, hasta - desde);
+    g_ptr_array_add(busqueda->actividad->solapes_nuevos, g_strdup(mensaje));
+    busqueda->actividad->solapes_totales++;
+}
+
+// Función que busca los solapes de un registro y lo añade al índice de su usuario
+static void procesarRegistroActividad(RegistroConsolidado *registro, void *contexto) {
+    ActividadSimultanea *actividad = (ActividadSimultanea *)contexto;
+    if (registro->instante1 < 0 || registro->instante2 < registro->instante1) {
+        return;
+    }
+    IndiceIntervalos *indice = g_hash_table_lookup(actividad->usuarios, registro->usuario);
+    if (indice == NULL) {
+        actividad->semilla = actividad->semilla * 1664525u + 1013904223u;
+        indice = crearIndiceIntervalos(actividad->semilla);
+        g_hash_table_insert(actividad->usuarios, g_strdup(registro->usuario), indice);
+    }
+    BusquedaSolape busqueda = {actividad, registro};
+    buscarSolapesIntervalo(indice, registro->instante1, registro->instante2, anotarSolape, &busqueda);
+    insertarIntervalo(indice, registro->instante1, registro->instante2, registro->sucursal, registro->operacion);
+    if (registro->instante2 > actividad->instante_maximo) {
+        actividad->instante_maximo = registro->instante2;
+    }
+}
+
+// Función que descarta las operaciones cuando los datos consolidados se vuelven a leer desde el principio
+static void reiniciarActividadSimultanea(void *contexto) {
+    ActividadSimultanea *actividad = (ActividadSimultanea *)contexto;
+    g_hash_table_remove_all(actividad->usuarios);
+    g_ptr_array_set_size(actividad->solapes_nuevos, 0);
+    actividad->instante_maximo = -1;
+    actividad->solapes_totales = 0;
+    actividad->reiniciado = 1;
+}
+
+// Función que elimina las operaciones terminadas fuera del periodo de retención y los usuarios sin operaciones
+static int eliminarOperacionesAntiguas(ActividadSimultanea *actividad) {
+    if (actividad->instante_maximo < 0) {
+        return 0;
+    }
+    long long limite = actividad->instante_maximo - actividad->retencion;
+    int eliminadas = 0;
+    GHashTableIter iter;
+    gpointer clave, valor;
+    g_hash_table_iter_init(&iter, actividad->usuarios);
+    while (g_hash_table_iter_next(&iter, &clave, &valor)) {
+        IndiceIntervalos *indice = (IndiceIntervalos *)valor;
+        eliminadas += eliminarIntervalosTerminados(indice, limite);
+        if (indice->num_intervalos == 0) {
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+    return eliminadas;
+}
+
+// Función que procesa los registros consolidados añadidos desde la ronda anterior
+// Los solapes nuevos quedan en solapes_nuevos hasta la siguiente ronda
+// Devuelve el número de registros nuevos o -1 si no se han podido leer los datos
+int actualizarActividadSimultanea(ActividadSimultanea *actividad) {
+    g_ptr_array_set_size(actividad->solapes_nuevos, 0);
+    actividad->reiniciado = 0;
+    int leidos = leerNuevosRegistrosConsolidados(&actividad->cursor, procesarRegistroActividad, reiniciarActividadSimultanea, actividad);
+    if (leidos == -1) {
+        return -1;
+    }
+    int eliminadas = eliminarOperacionesAntiguas(actividad);
+    escribirEnLog(LOG_INFO, "actividad_simultanea", "%d registros nuevos, %u solapes nuevos, %d operaciones eliminadas, %d operaciones de %u usuarios en el índice\n",
+        leidos, actividad->solapes_nuevos->len, eliminadas, contarIntervalosActividad(actividad), g_hash_table_size(actividad->usuarios));
+    return leidos;
+}
+
+// Función que devuelve el número de operaciones que hay en los índices de todos los usuarios
+int contarIntervalosActividad(const ActividadSimultanea *actividad) {
+    int total = 0;
+    GHashTableIter iter;
+    gpointer clave, valor;
+    g_hash_table_iter_init(&iter, actividad->usuarios);
+    while (g_hash_table_iter_next(&iter, &clave, &valor)) {
+        total += ((IndiceIntervalos *)valor)->num_intervalos;
+    }
+    return total;
+}
+
+#pragma endregion ActividadSimultanea
@@ -0,0 +1,37 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <glib.h>           // Diccionario de usuarios y lista de solapes
+
+#include "constants.h"          // Constantes de la aplicación
+#include "datos_consolidados.h" // Lectura incremental de los datos consolidados
+#include "indice_intervalos.h"  // Índice de intervalos de cada usuario
+#pragma endregion Librerias
+
+
+// Estado del detector de actividad simultánea en varias sucursales que se mantiene entre rondas
+typedef struct ACTIVIDAD_SIMULTANEA {
+    GHashTable *usuarios;           // Usuario -> IndiceIntervalos con sus operaciones
+    CursorConsolidado cursor;
+    long long retencion;            // Segundos que se conservan las operaciones terminadas antes de la más reciente
+    long long instante_maximo;      // Fin de operación más reciente leído (-1 si no hay ninguno)
+    GPtrArray *solapes_nuevos;      // Mensajes de los solapes encontrados en la última ronda
+    int reiniciado;                 // En la última ronda se han vuelto a leer los datos desde el principio
+    long long solapes_totales;
+    uint32_t semilla;               // Semilla de las prioridades de los índices
+} ActividadSimultanea;
+
+
+ActividadSimultanea *crearActividadSimultanea(long long retencion);
+
+void destruirActividadSimultanea(ActividadSimultanea *actividad);
+
+int actualizarActividadSimultanea(ActividadSimultanea *actividad);
+
+int contarIntervalosActividad(const ActividadSimultanea *actividad);
@@ -0,0 +1,337 @@
+// ------------------------------------------------------------------
+// AGREGACIÓN DE PATRONES CON VOLCADO A DISCO
+// ------------------------------------------------------------------
+
+#include "agregacion_externa.h"
+#include "patrones_fraude.h"
+#include "log_files.h"
+
+#pragma region AgregacionExterna
+/*
+    Permite que el diccionario de un patrón no tenga que caber en memoria (SPILL_MEMORY_BYTES).
+
+    Volcado: cuando el diccionario llega a max_claves, sus registros se reparten por el hash de la clave
+    en num_particiones ficheros, cada uno ordenado por clave, y el diccionario se vacía. Una misma
+    clave puede quedar repartida entre varios volcados y la memoria: su valor es la combinación de todos.
+
+    Recorrido: para cada partición se mezclan sus ficheros ordenados con las claves de la memoria que
+    pertenecen a esa partición, combinando los valores de una misma clave, y cada clave se entrega ya
+    combinada a la función de visita. El recorrido de cada ronda sólo lee: no reescribe los volcados
+    ni vacía la memoria, así que el coste de escritura de una ronda es el de sus volcados nuevos.
+
+    Fusión: cuando se llega a MAX_VOLCADOS_PATRON volcados, la misma mezcla se escribe en un volcado
+    nuevo que sustituye a los anteriores y la memoria se vacía. En memoria sólo hay a la vez una línea
+    de cada fichero y las claves en memoria de una partición.
+
+    Formato de cada línea de un volcado (texto separado por tabuladores):
+        clave usuario inicio_ventana cantidad op1 op2 op3 op4 num_registros
+*/
+
+// Función que compone el nombre del fichero de una partición de un volcado
+static void nombreFicheroVolcado(const AgregacionExterna *agregacion, int volcado, int particion, char *nombre, size_t longitud) {
+    snprintf(nombre, longitud, "%s/monitor_patron%02d_volcado%05d_particion%03d.run",
+        agregacion->directorio, agregacion->numero_patron, volcado, particion);
+}
+
+// Función que borra las primeras num_particiones particiones de un volcado
+static void eliminarFicherosVolcado(const AgregacionExterna *agregacion, int volcado, int num_particiones) {
+    char nombre[PATH_MAX];
+    for (int particion = 0; particion < num_particiones; particion++) {
+        nombreFicheroVolcado(agregacion, volcado, particion, nombre, sizeof(nombre));
+        remove(nombre);
+    }
+}
+
+// Función que devuelve la partición de una clave
+static int particionClave(const AgregacionExterna *agregacion, const char *clave) {
+    return (int)(g_str_hash(clave) % (guint)agregacion->num_particiones);
+}
+
+// Función que inicializa la agregación externa de un patrón
+// Borra los volcados que hubieran quedado de una ejecución anterior
+int inicializarAgregacionExterna(AgregacionExterna *agregacion, int numero_patron, const char *directorio, int num_particiones, long long memoria_bytes) {
+    snprintf(agregacion->directorio, sizeof(agregacion->directorio), "%s", directorio);
+    agregacion->numero_patron = numero_patron;
+    agregacion->num_particiones = num_particiones < 1 ? 1 : num_particiones;
+    long long max_claves = memoria_bytes / BYTES_POR_CLAVE_PATRON;
+    agregacion->max_claves = max_claves < 1 ? 1 : (unsigned int)max_claves;
+    agregacion->num_volcados = 0;
+    agregacion->siguiente_volcado = 0;
+
+    DIR *dir = opendir(directorio);
+    if (dir == NULL) {
+        escribirEnLog(LOG_ERROR, "agregacion_externa", "No se puede abrir el directorio de volcados %s\n", directorio);
+        return -1;
+    }
+    char prefijo[50];
+    snprintf(prefijo, sizeof(prefijo), "monitor_patron%02d_", numero_patron);
+    struct dirent *entrada;
+    char nombre[PATH_MAX];
+    while ((entrada = readdir(dir)) != NULL) {
+        if (strncmp(entrada->d_name, prefijo, strlen(prefijo)) == 0) {
+            snprintf(nombre, sizeof(nombre), "%s/%s", directorio, entrada->d_name);
+            remove(nombre);
+        }
+    }
+    closedir(dir);
+    return 0;
+}
+
+// Función que escribe un registro acumulado en una línea de un volcado
+// Devuelve 0 o -1 si no se ha podido escribir (disco lleno...)
+static int escribirRegistroVolcado(FILE *fichero, const RegistroPatron *registro) {
+    int escritos = fprintf(fichero, "%s\t%s\t%lld\t%d\t%d\t%d\t%d\t%d\t%d\n", registro->clave, registro->usuario, registro->inicio_ventana,
+        registro->cantidad, registro->operacion1Presente, registro->operacion2Presente,
+        registro->operacion3Presente, registro->operacion4Presente, registro->num_registros);
+    return escritos < 0 ? -1 : 0;
+}
+
+// Función que lee la siguiente línea de un volcado
+// Las cadenas del registro apuntan dentro de buffer. Devuelve 0 si ha leído un registro o -1 al final del fichero
+static int leerRegistroVolcado(FILE *fichero, char *buffer, size_t longitud, RegistroPatron *registro) {
+    if (fgets(buffer, (int)longitud, fichero) == NULL) {
+        return -1;
+    }
+    char *campos[9];
+    char *inicio = buffer;
+    for (int i = 0; i < 9; i++) {
+        campos[i] = inicio;
+        char *separador = strpbrk(inicio, "\t\n");
+        if (separador == NULL) {
+            inicio += strlen(inicio);
+        } else {
+            *separador = '\0';
+            inicio = separador + 1;
+        }
+    }
+    memset(registro, 0, sizeof(*registro));
+    registro->clave = campos[0];
+    registro->usuario = campos[1];
+    registro->inicio_ventana = atoll(campos[2]);
+    registro->cantidad = atoi(campos[3]);
+    registro->operacion1Presente = atoi(campos[4]);
+    registro->operacion2Presente = atoi(campos[5]);
+    registro->operacion3Presente = atoi(campos[6]);
+    registro->operacion4Presente = atoi(campos[7]);
+    registro->num_registros = atoi(campos[8]);
+    return 0;
+}
+
+// Función para ordenar registros por clave
+static int compararRegistrosPorClave(const void *a, const void *b) {
+    const RegistroPatron *registro_a = *(RegistroPatron * const *)a;
+    const RegistroPatron *registro_b = *(RegistroPatron * const *)b;
+    return strcmp(registro_a->clave, registro_b->clave);
+}
+
+// Función que obtiene los registros en memoria de una partición ordenados por clave
+static RegistroPatron **registrosParticion(const AgregacionExterna *agregacion, GHashTable *registros, int particion, int *num_registros) {
+    RegistroPatron **lista = malloc(sizeof(RegistroPatron *) * (g_hash_table_size(registros) + 1));
+    int num = 0;
+    GHashTableIter iter;
+    gpointer clave, valor;
+    g_hash_table_iter_init(&iter, registros);
+    while (g_hash_table_iter_next(&iter, &clave, &valor)) {
+        RegistroPatron *registro = (RegistroPatron *)valor;
+        if (particionClave(agregacion, registro->clave) == particion) {
+            lista[num++] = registro;
+        }
+    }
+    qsort(lista, num, sizeof(RegistroPatron *), compararRegistrosPorClave);
+    *num_registros = num;
+    return lista;
+}
+
+// Función que vuelca el diccionario a disco y lo vacía
+// Si ya hay demasiados volcados, los fusiona con el diccionario en uno solo
+// Si no se puede escribir el volcado entero se borra lo escrito y el diccionario queda como estaba
+int volcarRegistrosPatron(AgregacionExterna *agregacion, GHashTable *registros) {
+    if (agregacion->num_volcados >= MAX_VOLCADOS_PATRON) {
+        return fusionarRegistrosPatron(agregacion, registros);
+    }
+
+    int volcado = agregacion->siguiente_volcado++;
+    char nombre[PATH_MAX];
+    for (int particion = 0; particion < agregacion->num_particiones; particion++) {
+        nombreFicheroVolcado(agregacion, volcado, particion, nombre, sizeof(nombre));
+        FILE *fichero = fopen(nombre, "w");
+        if (fichero == NULL) {
+            escribirEnLog(LOG_ERROR, "agregacion_externa", "Error al crear el volcado %s\n", nombre);
+            eliminarFicherosVolcado(agregacion, volcado, particion);
+            return -1;
+        }
+        int num_registros;
+        RegistroPatron **lista = registrosParticion(agregacion, registros, particion, &num_registros);
+        int resultado = 0;
+        for (int i = 0; i < num_registros && resultado == 0; i++) {
+            resultado = escribirRegistroVolcado(fichero, lista[i]);
+        }
+        free(lista);
+        if (fclose(fichero) != 0) {
+            resultado = -1;
+        }
+        if (resultado != 0) {
+            escribirEnLog(LOG_ERROR, "agregacion_externa", "Error al escribir el volcado %s\n", nombre);
+            eliminarFicherosVolcado(agregacion, volcado, particion + 1);
+            return -1;
+        }
+    }
+    escribirEnLog(LOG_INFO, "agregacion_externa", "Patrón %02d: volcadas %u claves a disco (volcado %d)\n",
+        agregacion->numero_patron, g_hash_table_size(registros), volcado);
+    agregacion->volcados[agregacion->num_volcados++] = volcado;
+    g_hash_table_remove_all(registros);
+    return 0;
+}
+
+// Fichero de un volcado que se está mezclando y su registro actual
+typedef struct FUENTE_FUSION {
+    FILE *fichero;
+    char buffer[MAX_LINE_LENGTH];
+    RegistroPatron actual;
+    int activa;
+} FuenteFusion;
+
+// Función que mezcla una partición de todos los volcados con las claves en memoria de esa partición
+// Si volcado_nuevo es -1 sólo se visitan las claves, sin escribir ningún volcado
+// Devuelve -1 si falta o no se puede leer algún volcado (sus claves no estarían contadas) o no se puede escribir el nuevo
+static int fusionarParticion(AgregacionExterna *agregacion, GHashTable *registros, int particion, int volcado_nuevo,
+    CombinarRegistroVolcado combinar, VisitarRegistroPatron visitar, void *contexto) {
+    char nombre[PATH_MAX];
+    int num_fuentes = agregacion->num_volcados;
+    FuenteFusion *fuentes = calloc(num_fuentes > 0 ? num_fuentes : 1, sizeof(FuenteFusion));
+    int resultado = 0;
+    for (int i = 0; i < num_fuentes && resultado == 0; i++) {
+        nombreFicheroVolcado(agregacion, agregacion->volcados[i], particion, nombre, sizeof(nombre));
+        fuentes[i].fichero = fopen(nombre, "r");
+        if (fuentes[i].fichero == NULL) {
+            escribirEnLog(LOG_ERROR, "agregacion_externa", "Error al abrir el volcado %s\n", nombre);
+            resultado = -1;
+            break;
+        }
+        fuentes[i].activa = leerRegistroVolcado(fuentes[i].fichero, fuentes[i].buffer, sizeof(fuentes[i].buffer), &fuentes[i].actual) == 0;
+    }
+    int num_memoria;
+    RegistroPatron **memoria = registrosParticion(agregacion, registros, particion, &num_memoria);
+    int posicion_memoria = 0;
+
+    FILE *salida = NULL;
+    if (resultado == 0 && volcado_nuevo >= 0) {
+        nombreFicheroVolcado(agregacion, volcado_nuevo, particion, nombre, sizeof(nombre));
+        salida = fopen(nombre, "w");
+        if (salida == NULL) {
+            escribirEnLog(LOG_ERROR, "agregacion_externa", "Error al crear el volcado %s\n", nombre);
+            resultado = -1;
+        }
+    }
+
+    char clave[MAX_LINE_LENGTH];
+    char usuario[MAX_LINE_LENGTH];
+    while (resultado == 0) {
+        // Buscar la menor clave entre los ficheros y la memoria
+        const char *menor = NULL;
+        for (int i = 0; i < num_fuentes; i++) {
+            if (fuentes[i].activa && (menor == NULL || strcmp(fuentes[i].actual.clave, menor) < 0)) {
+                menor = fuentes[i].actual.clave;
+            }
+        }
+        if (posicion_memoria < num_memoria && (menor == NULL || strcmp(memoria[posicion_memoria]->clave, menor) < 0)) {
+            menor = memoria[posicion_memoria]->clave;
+        }
+        if (menor == NULL) {
+            break;
+        }
+
+        // Combinar todos los valores de esa clave
+        RegistroPatron total;
+        memset(&total, 0, sizeof(total));
+        snprintf(clave, sizeof(clave), "%s", menor);
+        total.clave = clave;
+        total.usuario = usuario;
+        usuario[0] = '\0';
+        for (int i = 0; i < num_fuentes; i++) {
+            while (fuentes[i].activa && strcmp(fuentes[i].actual.clave, clave) == 0) {
+                snprintf(usuario, sizeof(usuario), "%s", fuentes[i].actual.usuario);
+                total.inicio_ventana = fuentes[i].actual.inicio_ventana;
+                combinar(&total, &fuentes[i].actual);
+                fuentes[i].activa = leerRegistroVolcado(fuentes[i].fichero, fuentes[i].buffer, sizeof(fuentes[i].buffer), &fuentes[i].actual) == 0;
+            }
+        }
+        if (posicion_memoria < num_memoria && strcmp(memoria[posicion_memoria]->clave, clave) == 0) {
+            snprintf(usuario, sizeof(usuario), "%s", memoria[posicion_memoria]->usuario);
+            total.inicio_ventana = memoria[posicion_memoria]->inicio_ventana;
+            combinar(&total, memoria[posicion_memoria]);
+            posicion_memoria++;
+        }
+
+        if (visitar != NULL) {
+            visitar(&total, contexto);
+        }
+        if (salida != NULL && escribirRegistroVolcado(salida, &total) != 0) {
+            escribirEnLog(LOG_ERROR, "agregacion_externa", "Error al escribir el volcado %s\n", nombre);
+            resultado = -1;
+        }
+    }
+
+    if (salida != NULL && fclose(salida) != 0 && resultado == 0) {
+        escribirEnLog(LOG_ERROR, "agregacion_externa", "Error al escribir el volcado %s\n", nombre);
+        resultado = -1;
+    }
+    for (int i = 0; i < num_fuentes; i++) {
+        if (fuentes[i].fichero != NULL) {
+            if (ferror(fuentes[i].fichero) && resultado == 0) {
+                escribirEnLog(LOG_ERROR, "agregacion_externa", "Patrón %02d: error al leer el volcado %d\n",
+                    agregacion->numero_patron, agregacion->volcados[i]);
+                resultado = -1;
+            }
+            fclose(fuentes[i].fichero);
+        }
+    }
+    free(fuentes);
+    free(memoria);
+    return resultado;
+}
+
+// Función que llama a visitar con el valor final de cada clave de los volcados y de la memoria
+// Sólo lee: los volcados y el diccionario quedan como estaban
+int recorrerVolcadosPatron(AgregacionExterna *agregacion, GHashTable *registros, CombinarRegistroVolcado combinar, VisitarRegistroPatron visitar, void *contexto) {
+    for (int particion = 0; particion < agregacion->num_particiones; particion++) {
+        if (fusionarParticion(agregacion, registros, particion, -1, combinar, visitar, contexto) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Función que fusiona todos los volcados y las claves en memoria en un único volcado
+// Al terminar el diccionario queda vacío. Si falla se borra el volcado nuevo y quedan los anteriores y el diccionario
+int fusionarRegistrosPatron(AgregacionExterna *agregacion, GHashTable *registros) {
+    CombinarRegistroVolcado combinar = obtenerDefinicionPatron(agregacion->numero_patron)->combinar;
+    int volcado_nuevo = agregacion->siguiente_volcado++;
+    for (int particion = 0; particion < agregacion->num_particiones; particion++) {
+        if (fusionarParticion(agregacion, registros, particion, volcado_nuevo, combinar, NULL, NULL) != 0) {
+            eliminarFicherosVolcado(agregacion, volcado_nuevo, particion + 1);
+            return -1;
+        }
+    }
+
+    // Sustituir los volcados anteriores por el nuevo
+    for (int i = 0; i < agregacion->num_volcados; i++) {
+        eliminarFicherosVolcado(agregacion, agregacion->volcados[i], agregacion->num_particiones);
+    }
+    escribirEnLog(LOG_INFO, "agregacion_externa", "Patrón %02d: fusionados %d volcados y %u claves en memoria en el volcado %d\n",
+        agregacion->numero_patron, agregacion->num_volcados, g_hash_table_size(registros), volcado_nuevo);
+    agregacion->volcados[0] = volcado_nuevo;
+    agregacion->num_volcados = 1;
+    g_hash_table_remove_all(registros);
+    return 0;
+}
+
+// Función que borra todos los volcados del patrón
+void eliminarVolcadosPatron(AgregacionExterna *agregacion) {
+    for (int i = 0; i < agregacion->num_volcados; i++) {
+        eliminarFicherosVolcado(agregacion, agregacion->volcados[i], agregacion->num_particiones);
+    }
+    agregacion->num_volcados = 0;
+}
+
+#pragma endregion AgregacionExterna
@@ -0,0 +1,49 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <dirent.h>         // Definiciones y estructuras necesarias para trabajar con directorios en Linux
+#include <linux/limits.h>   // Define varias constantes que representan los límites del sistema en sistemas operativos Linux
+#include <glib.h>           // Manejo de diccionarios GLib utilizado para la detección de patrones de fraude
+
+#include "constants.h"      // Constantes de la aplicación
+#pragma endregion Librerias
+
+// Se declara aquí para no depender de patrones_fraude.h (que incluye este fichero)
+struct REGISTRO_PATRON;
+
+// Función que combina dos valores acumulados de la misma clave
+typedef void (*CombinarRegistroVolcado)(struct REGISTRO_PATRON *destino, const struct REGISTRO_PATRON *origen);
+
+// Función a la que se llama con el valor final de cada clave al fusionar
+typedef void (*VisitarRegistroPatron)(const struct REGISTRO_PATRON *registro, void *contexto);
+
+// Agregación con volcado a disco de un patrón
+// Cuando el diccionario supera max_claves se vuelca en un conjunto de ficheros ordenados (un volcado),
+// repartido en num_particiones ficheros según el hash de la clave. Al recorrer o fusionar se mezclan
+// en cada partición sus volcados ordenados con las claves que quedan en memoria
+typedef struct AGREGACION_EXTERNA {
+    char directorio[PATH_MAX];
+    int numero_patron;
+    int num_particiones;
+    unsigned int max_claves;                // Claves en memoria antes de volcar
+    int volcados[MAX_VOLCADOS_PATRON];      // Identificadores de los volcados en disco
+    int num_volcados;
+    int siguiente_volcado;
+} AgregacionExterna;
+
+
+int inicializarAgregacionExterna(AgregacionExterna *agregacion, int numero_patron, const char *directorio, int num_particiones, long long memoria_bytes);
+
+int volcarRegistrosPatron(AgregacionExterna *agregacion, GHashTable *registros);
+
+int recorrerVolcadosPatron(AgregacionExterna *agregacion, GHashTable *registros, CombinarRegistroVolcado combinar, VisitarRegistroPatron visitar, void *contexto);
+
+int fusionarRegistrosPatron(AgregacionExterna *agregacion, GHashTable *registros);
+
+void eliminarVolcadosPatron(AgregacionExterna *agregacion);
@@ -0,0 +1,146 @@
+// ------------------------------------------------------------------
+// LECTURA DE LOS AGREGADOS PARCIALES DE FILEPROCESSOR
+// ------------------------------------------------------------------
+
+#include "agregados_parciales.h"
+#include "log_files.h"
+#include "config_files.h"
+#include "parametros_configuracion.h"
+
+#pragma region AgregadosParciales
+/*
+    Con PARTIAL_AGGREGATES=1 FileProcessor añade al fichero PARTIAL_FILE un lote de agregados por cada
+    fichero de sucursal que consolida (ver formato_agregados.h). Un lote indica qué bytes de los datos
+    consolidados resume, así que un patrón puede combinar el lote en lugar de leer esos registros cuando
+    el lote empieza exactamente donde está su cursor:
+        - el lote empieza en la posición del cursor: se combina y el cursor pasa al final del lote
+        - el lote termina antes de la posición del cursor: sus registros ya se han leído, se salta
+        - el lote es de otros datos consolidados (otra identidad): se salta
+        - en cualquier otro caso (o si el lote pasa de la marca de confirmación) se deja de leer lotes
+          y los registros que falten se leen de los datos consolidados
+    Hasta que el cursor no ha leído una vez los datos no se conoce su identidad, así que los lotes sólo
+    se utilizan a partir de la segunda lectura.
+*/
+
+// Función que separa una línea en campos separados por ;
+// Devuelve el número de campos (como máximo max_campos)
+static int separarCamposAgregado(char *linea, char **campos, int max_campos) {
+    int num_campos = 0;
+    char *inicio = linea;
+    while (num_campos < max_campos) {
+        campos[num_campos++] = inicio;
+        char *separador = strchr(inicio, ';');
+        if (separador == NULL) {
+            break;
+        }
+        *separador = '\0';
+        inicio = separador + 1;
+    }
+    return num_campos;
+}
+
+// Función que lee una línea completa (terminada en \n) del tipo indicado y la separa en campos
+// Devuelve 0 o -1 si la línea no está completa o no es del tipo indicado
+static int leerLineaLote(FILE *fichero, char *linea, size_t longitud, char tipo, char **campos, int num_campos) {
+    if (fgets(linea, (int)longitud, fichero) == NULL) {
+        return -1;
+    }
+    size_t largo = strlen(linea);
+    if (largo < 2 || linea[0] != tipo || linea[1] != ';' || linea[largo - 1] != '\n') {
+        return -1;
+    }
+    linea[largo - 1] = '\0';
+    return separarCamposAgregado(linea + 2, campos, num_campos) == num_campos ? 0 : -1;
+}
+
+// Función que libera los agregados leídos de un lote
+static void liberarAgregadosLote(AgregadoParcial *agregados, int num_agregados) {
+    for (int i = 0; i < num_agregados; i++) {
+        free(agregados[i].usuario);
+    }
+    free(agregados);
+}
+
+// Función que combina los lotes de agregados que empiezan en la posición del cursor
+// posicion_lotes guarda entre rondas hasta dónde se ha leído el fichero de agregados
+// Devuelve el número de registros que resumen los lotes combinados (el cursor avanza hasta el final de esos registros)
+int leerLotesAgregados(long long *posicion_lotes, CursorConsolidado *cursor, int numero_patron, CombinarLoteAgregados combinar, void *contexto) {
+    if (cursor->inodo == 0 && cursor->dispositivo == 0) {
+        return 0;
+    }
+    char nombre_fichero[PATH_MAX];
+    snprintf(nombre_fichero, sizeof(nombre_fichero), "%s/%s", obtenerParametros()->carpeta_datos, obtenerParametros()->fichero_agregados);
+    FILE *fichero = fopen(nombre_fichero, "r");
+    if (fichero == NULL) {
+        return 0;
+    }
+    OrigenDatosConsolidados origen = obtenerOrigenDatosConsolidados();
+    long long limite = obtenerLimiteLecturaConsolidado(cursor, origen);
+
+    char linea[MAX_LINE_LENGTH];
+    char *campos[11];
+    int num_registros = 0;
+    int num_lotes = 0;
+    while (fseek(fichero, *posicion_lotes, SEEK_SET) == 0 && leerLineaLote(fichero, linea, sizeof(linea), 'L', campos, 11) == 0) {
+        int filas = atoi(campos[0]);
+        int registros = atoi(campos[1]);
+        // Los rangos y las identidades de la cabecera están en el orden de OrigenDatosConsolidados: fichero, memoria, columnar
+        long long desde = atoll(campos[2 + 2 * origen]);
+        long long hasta = atoll(campos[3 + 2 * origen]);
+        unsigned long long dispositivo, inodo;
+        int mismos_datos = sscanf(campos[8 + origen], "%llu:%llu", &dispositivo, &inodo) == 2 &&
+            dispositivo == (unsigned long long)cursor->dispositivo && inodo == (unsigned long long)cursor->inodo;
+
+        // Leer los agregados del patrón (el lote tiene que estar completo)
+        AgregadoParcial *agregados = malloc(sizeof(AgregadoParcial) * (filas > 0 ? filas : 1));
+        int num_agregados = 0;
+        int completo = 1;
+        for (int i = 0; i < filas && completo; i++) {
+            if (leerLineaLote(fichero, linea, sizeof(linea), 'A', campos, 9) != 0) {
+                completo = 0;
+            } else if (atoi(campos[0]) == numero_patron) {
+                AgregadoParcial *agregado = &agregados[num_agregados++];
+                agregado->ancho = atoll(campos[1]);
+                agregado->usuario = malloc(strlen(campos[2]) + 1);
+                strcpy(agregado->usuario, campos[2]);
+                agregado->inicio = atoll(campos[3]);
+                agregado->cantidad = atoll(campos[4]);
+                for (int t = 0; t < 4; t++) {
+                    agregado->operaciones[t] = atoi(campos[5 + t]);
+                }
+            }
+        }
+        long long fin_lote = ftell(fichero);
+
+        int seguir = 1;
+        if (!completo) {
+            // Lote a medio escribir: se verá en la siguiente ronda
+            seguir = 0;
+        } else if (!mismos_datos) {
+            // Lote de un consolidado anterior (o de otro que ya no se lee): se salta
+        } else if (desde == cursor->posicion) {
+            if ((limite >= 0 && hasta > limite) || combinar(agregados, num_agregados, contexto) != 0) {
+                seguir = 0;
+            } else {
+                cursor->posicion = hasta;
+                num_registros += registros;
+                num_lotes++;
+            }
+        } else if (hasta > cursor->posicion) {
+            // El lote no empieza donde está el cursor: los registros se leen de los datos consolidados
+            seguir = 0;
+        }
+        liberarAgregadosLote(agregados, num_agregados);
+        if (!seguir) {
+            break;
+        }
+        *posicion_lotes = fin_lote;
+    }
+    fclose(fichero);
+    if (num_lotes > 0) {
+        escribirEnLog(LOG_INFO, "agregados_parciales", "Patrón %02d: %d lotes de agregados combinados (%d registros)\n", numero_patron, num_lotes, num_registros);
+    }
+    return num_registros;
+}
+
+#pragma endregion AgregadosParciales
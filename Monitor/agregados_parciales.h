@@ -0,0 +1,32 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <linux/limits.h>   // Define varias constantes que representan los límites del sistema en sistemas operativos Linux
+
+#include "constants.h"          // Constantes de la aplicación
+#include "formato_agregados.h"  // Formato del fichero de agregados parciales
+#include "datos_consolidados.h" // Cursor y límite de lectura de los datos consolidados
+#pragma endregion Librerias
+
+
+// Valor acumulado por FileProcessor para un usuario en un cubo de tiempo de un patrón
+typedef struct AGREGADO_PARCIAL {
+    long long ancho;        // Ancho del cubo en segundos
+    char *usuario;
+    long long inicio;       // Inicio del cubo en segundos desde 01/01/1970
+    long long cantidad;
+    int operaciones[4];     // Registros de cada tipo de operación
+} AgregadoParcial;
+
+// Función a la que se llama con los agregados de un patrón de un lote
+// Devuelve 0 si los ha combinado o -1 si no se pueden combinar (hay que leer los registros)
+typedef int (*CombinarLoteAgregados)(const AgregadoParcial *agregados, int num_agregados, void *contexto);
+
+
+int leerLotesAgregados(long long *posicion_lotes, CursorConsolidado *cursor, int numero_patron, CombinarLoteAgregados combinar, void *contexto);
@@ -4,6 +4,11 @@
 #pragma region FicheroConfiguracion
 
 #include "config_files.h"
+#include "log_files.h"
+
+#include <errno.h>          // Errores de conversión de los parámetros numéricos
+#include <stdint.h>         // intptr_t para guardar el lector en la clave del hilo
+#include <limits.h>         // ULONG_MAX
 
 // Estructura para guardar el fichero de configuración en memoria y no tener que acceder a el muchas veces en el programa ppal.
 struct EntradaConfiguracion configuracion[MAX_ENTRADAS_CONFIG];
@@ -17,16 +22,43 @@ void leer_archivo_configuracion(const char *nombre_archivo) {
     // Como este fichero únicamente se lee al inicio del programa antes de crear los threads
     // no es necesario hacerlo thread safe
     
-    FILE *archivo = fopen(nombre_archivo, "r");
-    if (archivo == NULL) {
+    int leidas = leer_entradas_configuracion(nombre_archivo, configuracion, MAX_ENTRADAS_CONFIG);
+    if (leidas == -1) {
         //perror muestra un mensaje de error en caso de error al abrir el fichero
         perror("Error al abrir el archivo de configuración");
         exit(1);
     }
+    num_entradas = leidas;
+
+    // Con esto ya hemos leido el fichero de configuración
+    ficheroConfiguracionLeido = 1;
+}
+
+// Función que lee un fichero de configuración en una tabla de entradas indicada por el llamante
+// Se utiliza para la lectura inicial y para volver a leer el fichero sin tocar la configuración en uso
+// Devuelve el número de entradas leídas o -1 si no se ha podido abrir el fichero
+int leer_entradas_configuracion(const char *nombre_archivo, struct EntradaConfiguracion *entradas, int max_entradas) {
+    
+    FILE *archivo = fopen(nombre_archivo, "r");
+    if (archivo == NULL) {
+        return -1;
+    }
+    int num_leidas = 0;
 
     char linea[MAX_LONGITUD_LINEA];
     //Vamos metiendo cada línea del fichero
     while (fgets(linea, sizeof(linea), archivo)) {
+        // Las líneas más largas que el buffer (normalmente comentarios) se descartan enteras, para que
+        // el resto de la línea no se lea como si fuera otra
+        if (strchr(linea, '\n') == NULL && !feof(archivo)) {
+            int caracter;
+            while ((caracter = fgetc(archivo)) != '\n' && caracter != EOF) {
+            }
+            if (linea[0] != '#' && linea[0] != ';') {
+                fprintf(stderr, "Línea demasiado larga en %s: %.20s...\n", nombre_archivo, linea);
+            }
+            continue;
+        }
         // No leer las líneas vacías y comentarios (controlamos # para linux y ; para los archivos .ini de Windows)
         if (linea[0] == '\n' || linea[0] == '#' || linea[0] == ';')
             continue;
@@ -51,13 +83,14 @@ void leer_archivo_configuracion(const char *nombre_archivo) {
         if (*posicion_valor == ' ') {
             posicion_valor++;
         }
-        //Leo el valor
+        //Leo el valor (puede estar vacío, y entonces sscanf no escribe nada)
+        valor[0] = '\0';
         sscanf(posicion_valor, "%[^\n]", valor);
         //Añadp clave y valor en la estructura
-        if (num_entradas < MAX_ENTRADAS_CONFIG) {
-            strcpy(configuracion[num_entradas].clave, clave);
-            strcpy(configuracion[num_entradas].valor, valor);
-            num_entradas++;
+        if (num_leidas < max_entradas) {
+            strcpy(entradas[num_leidas].clave, clave);
+            strcpy(entradas[num_leidas].valor, valor);
+            num_leidas++;
         } else {
             printf("Se alcanzó el máximo de entradas\n");
             break;
@@ -65,10 +98,9 @@ void leer_archivo_configuracion(const char *nombre_archivo) {
 
     }
 
-    // Con esto ya hemos leido el fichero de configuración
-    ficheroConfiguracionLeido = 1;
     //Cerramos archivo 
     fclose(archivo);
+    return num_leidas;
 }
 
 //Funcion para acceder a los valores de el archivo .conf por Clave y poder usarlos en el resto del programa fácilmente
@@ -79,12 +111,318 @@ const char *obtener_valor_configuracion(const char *clave, const char *valor_por
     if (ficheroConfiguracionLeido == 0) {
         leer_archivo_configuracion(FICHERO_CONFIGURACION);
     }
-    for (int i = 0; i < num_entradas; i++) {
-        if (strcmp(configuracion[i].clave, clave) == 0) {
-            return configuracion[i].valor;
+    return buscar_valor_configuracion(configuracion, num_entradas, clave, valor_por_defecto);
+}
+
+// Devuelve el valor de la clave en una tabla de entradas leída con leer_entradas_configuracion
+// o un valor por defecto
+const char *buscar_valor_configuracion(const struct EntradaConfiguracion *entradas, int num, const char *clave, const char *valor_por_defecto) {
+    for (int i = 0; i < num; i++) {
+        if (strcmp(entradas[i].clave, clave) == 0) {
+            return entradas[i].valor;
         }
     }
     //Si no he encontrado la clave en el .conf devulevo el valor por defecto
     return valor_por_defecto;
 }
+
+// Función que comprueba si un valor es una de las opciones de una lista separada por '|'
+static int valorEnOpciones(const char *valor, const char *opciones) {
+    size_t longitud = strlen(valor);
+    const char *opcion = opciones;
+    while (1) {
+        const char *fin = strchr(opcion, '|');
+        size_t longitud_opcion = fin != NULL ? (size_t)(fin - opcion) : strlen(opcion);
+        if (longitud_opcion == longitud && strncmp(opcion, valor, longitud) == 0) {
+            return 1;
+        }
+        if (fin == NULL) {
+            return 0;
+        }
+        opcion = fin + 1;
+    }
+}
+
+// Función que convierte el valor de un parámetro según su tipo y lo guarda en su campo (si tiene)
+// Devuelve 0 o -1 si el valor no es válido
+static int convertirParametro(const DefinicionParametro *definicion, const char *valor, void *parametros) {
+    char *campo = definicion->desplazamiento == SIN_CAMPO ? NULL : (char *)parametros + definicion->desplazamiento;
+    switch (definicion->tipo) {
+        case PARAMETRO_ENTERO:
+        case PARAMETRO_TAMANO: {
+            char *fin;
+            errno = 0;
+            long long numero = strtoll(valor, &fin, 10);
+            while (*fin == ' ' || *fin == '\t' || *fin == '\r') {
+                fin++;
+            }
+            if (fin == valor || *fin != '\0' || errno != 0 || numero < definicion->minimo || numero > definicion->maximo) {
+                return -1;
+            }
+            if (campo != NULL && definicion->tipo == PARAMETRO_ENTERO) {
+                *(int *)campo = (int)numero;
+            } else if (campo != NULL) {
+                *(long long *)campo = numero;
+            }
+            return 0;
+        }
+        case PARAMETRO_BOOLEANO: {
+            int booleano;
+            if (strcmp(valor, "1") == 0 || strcmp(valor, "SI") == 0) {
+                booleano = 1;
+            } else if (strcmp(valor, "0") == 0 || strcmp(valor, "NO") == 0) {
+                booleano = 0;
+            } else {
+                return -1;
+            }
+            if (campo != NULL) {
+                *(int *)campo = booleano;
+            }
+            return 0;
+        }
+        case PARAMETRO_CADENA:
+            if (definicion->opciones != NULL && !valorEnOpciones(valor, definicion->opciones)) {
+                return -1;
+            }
+            if (campo != NULL) {
+                *(const char **)campo = valor;
+            }
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+// Función que busca la definición de una clave del fichero de configuración (NULL si es desconocida)
+static const DefinicionParametro *buscarDefinicionParametro(const DefinicionParametro *definiciones, int num_definiciones, const char *clave) {
+    for (int i = 0; i < num_definiciones; i++) {
+        if (definiciones[i].tipo == PARAMETRO_PREFIJO
+            ? strncmp(clave, definiciones[i].clave, strlen(definiciones[i].clave)) == 0
+            : strcmp(clave, definiciones[i].clave) == 0) {
+            return &definiciones[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+    Función que convierte las entradas de un fichero de configuración en una estructura de parámetros con tipo
+    Primero pone en cada campo su valor por defecto y después el del fichero, comprobando que es válido.
+    Escribe en el log las claves desconocidas o repetidas y los valores no válidos (se queda el valor por
+    defecto); si una clave está repetida vale la primera, igual que en buscar_valor_configuracion.
+    Las cadenas apuntan a las entradas, que tienen que existir mientras se usen los parámetros
+    Devuelve el número de errores encontrados
+*/
+int cargar_parametros_configuracion(const struct EntradaConfiguracion *entradas, int num_entradas,
+    const DefinicionParametro *definiciones, int num_definiciones, void *parametros) {
+    int errores = 0;
+    for (int i = 0; i < num_definiciones; i++) {
+        if (definiciones[i].tipo != PARAMETRO_PREFIJO) {
+            convertirParametro(&definiciones[i], definiciones[i].valor_por_defecto, parametros);
+        }
+    }
+    for (int e = 0; e < num_entradas; e++) {
+        const char *clave = entradas[e].clave;
+        if (buscar_valor_configuracion(entradas, e, clave, NULL) != NULL) {
+            escribirEnLog(LOG_WARNING, "config_files", "Clave %s repetida en el fichero de configuración, se utiliza el primer valor\n", clave);
+            errores++;
+            continue;
+        }
+        const DefinicionParametro *definicion = buscarDefinicionParametro(definiciones, num_definiciones, clave);
+        if (definicion == NULL) {
+            escribirEnLog(LOG_WARNING, "config_files", "Clave desconocida %s en el fichero de configuración\n", clave);
+            errores++;
+        } else if (definicion->tipo != PARAMETRO_PREFIJO && convertirParametro(definicion, entradas[e].valor, parametros) != 0) {
+            escribirEnLog(LOG_WARNING, "config_files", "Valor no válido %s=%s, se utiliza %s\n", clave, entradas[e].valor, definicion->valor_por_defecto);
+            errores++;
+        }
+    }
+    return errores;
+}
+// Función que copia el campo de un parámetro de una estructura de parámetros a otra
+static void copiarCampoParametro(const DefinicionParametro *definicion, const void *origen, void *destino) {
+    const char *campo_origen = (const char *)origen + definicion->desplazamiento;
+    char *campo_destino = (char *)destino + definicion->desplazamiento;
+    switch (definicion->tipo) {
+        case PARAMETRO_TAMANO:
+            *(long long *)campo_destino = *(const long long *)campo_origen;
+            break;
+        case PARAMETRO_CADENA:
+            *(const char **)campo_destino = *(const char *const *)campo_origen;
+            break;
+        default:
+            *(int *)campo_destino = *(const int *)campo_origen;
+            break;
+    }
+}
+
+/*
+    Función que se llama al recargar el fichero de configuración con los parámetros ya convertidos
+    Los parámetros que no están en claves_recargables (separadas por '|') sólo se aplican al reiniciar:
+    si su valor ha cambiado respecto al de la lectura inicial se avisa en el log, y en cualquier caso el campo
+    se deja con el valor inicial. Así las cadenas de esos campos siguen apuntando a las entradas iniciales, que no se liberan,
+    y los hilos que las guardan al arrancar (nombres de semáforo, pipe, memoria compartida...) no se ven afectados.
+    Las claves con prefijo las analiza otro módulo y no se comprueban
+*/
+void conservar_parametros_no_recargables(const DefinicionParametro *definiciones, int num_definiciones, const char *claves_recargables,
+    const struct EntradaConfiguracion *entradas_iniciales, int num_iniciales, const void *parametros_iniciales,
+    const struct EntradaConfiguracion *entradas, int num_entradas, void *parametros) {
+    for (int i = 0; i < num_definiciones; i++) {
+        const DefinicionParametro *definicion = &definiciones[i];
+        if (definicion->tipo == PARAMETRO_PREFIJO || valorEnOpciones(definicion->clave, claves_recargables)) {
+            continue;
+        }
+        const char *inicial = buscar_valor_configuracion(entradas_iniciales, num_iniciales, definicion->clave, definicion->valor_por_defecto);
+        const char *nuevo = buscar_valor_configuracion(entradas, num_entradas, definicion->clave, definicion->valor_por_defecto);
+        if (strcmp(inicial, nuevo) != 0) {
+            escribirEnLog(LOG_WARNING, "config_files", "%s=%s sólo se aplica al reiniciar, se mantiene %s\n", definicion->clave, nuevo, inicial);
+        }
+        // El campo se copia también si el valor no ha cambiado: las cadenas tienen que apuntar a las entradas
+        // iniciales y no a las nuevas, que se liberan cuando esta configuración se retire
+        if (definicion->desplazamiento != SIN_CAMPO) {
+            copiarCampoParametro(definicion, parametros_iniciales, parametros);
+        }
+    }
+}
 #pragma endregion FicheroConfiguracion
+
+// ------------------------------------------------------------------
+// LECTORES DE LOS PARÁMETROS DE CONFIGURACIÓN
+// ------------------------------------------------------------------
+#pragma region LectoresConfiguracion
+/*
+    Los parámetros de configuración se publican como una estructura que no cambia, con un puntero que se
+    sustituye de forma atómica al recargar el fichero. Los hilos leen el puntero sin bloqueos y la estructura
+    anterior no se puede liberar mientras algún hilo pueda estar usándola.
+    Para saberlo se usan estados quiescentes:
+        - cada hilo que lee parámetros tiene un lector con la última generación que ha visto en un punto en el
+          que no guarda punteros a los parámetros (estado_quiescente_configuracion al principio de su bucle)
+        - retirar_configuracion incrementa la generación y deja la estructura en la lista de retiradas
+        - una estructura retirada se libera cuando todos los lectores han visto su generación
+    Un hilo que se va a bloquear mucho tiempo se pausa (no cuenta) y al reanudarse ve la generación actual.
+    Los lectores se registran al leer los parámetros por primera vez y se liberan al terminar el hilo
+*/
+
+// Última generación vista por cada lector (0: libre o pausado)
+static unsigned long generaciones_lectores[MAX_LECTORES_CONFIGURACION];
+// Generación actual, se incrementa al retirar una estructura
+static unsigned long generacion_configuracion = 1;
+// Lector del hilo (-1 si no está registrado)
+static __thread int lector_configuracion = -1;
+// Clave del hilo para liberar el lector al terminar
+static pthread_key_t clave_lector_configuracion;
+static pthread_once_t clave_lector_creada = PTHREAD_ONCE_INIT;
+
+// Estructura retirada pendiente de liberar
+typedef struct CONFIGURACION_RETIRADA {
+    void *datos;
+    void (*liberar)(void *);
+    unsigned long generacion;
+    struct CONFIGURACION_RETIRADA *siguiente;
+} ConfiguracionRetirada;
+
+static ConfiguracionRetirada *configuraciones_retiradas = NULL;
+static int hay_configuraciones_retiradas = 0;
+static pthread_mutex_t mutex_configuraciones_retiradas = PTHREAD_MUTEX_INITIALIZER;
+
+// Función que se ejecuta al terminar un hilo registrado
+static void liberarLectorConfiguracion(void *valor) {
+    int lector = (int)(intptr_t)valor - 1;
+    __atomic_store_n(&generaciones_lectores[lector], 0, __ATOMIC_SEQ_CST);
+}
+
+static void crearClaveLectorConfiguracion() {
+    pthread_key_create(&clave_lector_configuracion, liberarLectorConfiguracion);
+}
+
+// Función que registra el hilo como lector de los parámetros (si no lo está ya)
+void registrar_lector_configuracion() {
+    if (lector_configuracion != -1) {
+        return;
+    }
+    pthread_once(&clave_lector_creada, crearClaveLectorConfiguracion);
+    unsigned long generacion = __atomic_load_n(&generacion_configuracion, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < MAX_LECTORES_CONFIGURACION; i++) {
+        unsigned long libre = 0;
+        if (__atomic_compare_exchange_n(&generaciones_lectores[i], &libre, generacion, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            lector_configuracion = i;
+            pthread_setspecific(clave_lector_configuracion, (void *)(intptr_t)(i + 1));
+            return;
+        }
+    }
+    escribirEnLog(LOG_ERROR, "config_files", "Más de %d hilos leyendo la configuración\n", MAX_LECTORES_CONFIGURACION);
+    exit(1);
+}
+
+// Función que libera las estructuras retiradas que ya han visto todos los lectores
+static void liberarConfiguracionesRetiradas() {
+    if (pthread_mutex_trylock(&mutex_configuraciones_retiradas) != 0) {
+        return;
+    }
+    unsigned long minima = ULONG_MAX;
+    for (int i = 0; i < MAX_LECTORES_CONFIGURACION; i++) {
+        unsigned long generacion = __atomic_load_n(&generaciones_lectores[i], __ATOMIC_SEQ_CST);
+        if (generacion != 0 && generacion < minima) {
+            minima = generacion;
+        }
+    }
+    ConfiguracionRetirada **anterior = &configuraciones_retiradas;
+    while (*anterior != NULL) {
+        ConfiguracionRetirada *retirada = *anterior;
+        if (retirada->generacion <= minima) {
+            *anterior = retirada->siguiente;
+            retirada->liberar(retirada->datos);
+            free(retirada);
+        } else {
+            anterior = &retirada->siguiente;
+        }
+    }
+    __atomic_store_n(&hay_configuraciones_retiradas, configuraciones_retiradas != NULL, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&mutex_configuraciones_retiradas);
+}
+
+// Función que indica que el hilo no guarda punteros a los parámetros (se llama al principio de su bucle)
+void estado_quiescente_configuracion() {
+    if (lector_configuracion == -1) {
+        return;
+    }
+    __atomic_store_n(&generaciones_lectores[lector_configuracion], __atomic_load_n(&generacion_configuracion, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&hay_configuraciones_retiradas, __ATOMIC_ACQUIRE)) {
+        liberarConfiguracionesRetiradas();
+    }
+}
+
+// Función que se llama antes de que el hilo se bloquee sin usar los parámetros
+void pausar_lector_configuracion() {
+    if (lector_configuracion != -1) {
+        __atomic_store_n(&generaciones_lectores[lector_configuracion], 0, __ATOMIC_SEQ_CST);
+    }
+}
+
+// Función que se llama al volver del bloqueo (antes de volver a leer los parámetros)
+void reanudar_lector_configuracion() {
+    if (lector_configuracion != -1) {
+        __atomic_store_n(&generaciones_lectores[lector_configuracion], __atomic_load_n(&generacion_configuracion, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+    }
+}
+
+// Función que retira una estructura de parámetros ya sustituida por otra
+// Se libera con "liberar" cuando ningún hilo la pueda estar usando
+void retirar_configuracion(void *datos, void (*liberar)(void *)) {
+    ConfiguracionRetirada *retirada = malloc(sizeof(ConfiguracionRetirada));
+    if (retirada == NULL) {
+        escribirEnLog(LOG_ERROR, "config_files", "Sin memoria para retirar la configuración anterior\n");
+        return;
+    }
+    retirada->datos = datos;
+    retirada->liberar = liberar;
+    retirada->generacion = __atomic_add_fetch(&generacion_configuracion, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&mutex_configuraciones_retiradas);
+    retirada->siguiente = configuraciones_retiradas;
+    configuraciones_retiradas = retirada;
+    __atomic_store_n(&hay_configuraciones_retiradas, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&mutex_configuraciones_retiradas);
+    // El hilo que retira también es lector: ya no usa la estructura anterior
+    estado_quiescente_configuracion();
+}
+#pragma endregion LectoresConfiguracion
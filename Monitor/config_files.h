@@ -1,3 +1,5 @@
+#pragma once
+
 // ------------------------------------------------------------------
 // Librerías necesarias y explicación
 // ------------------------------------------------------------------
@@ -15,6 +17,7 @@
 #include <dirent.h>         // Definiciones y estructuras necesarias para trabajar con directorios en Linux
 #include <linux/limits.h>   // Define varias constantes que representan los límites del sistema en sistemas operativos Linux
 #include <fcntl.h>          // Proporciona funciones y constantes para controlar archivos y descriptores de archivo en Linux
+#include <stddef.h>         // offsetof de las definiciones de parámetros
 
 #include "constants.h"      // Constantes de la aplicación
 
@@ -29,3 +32,51 @@ struct EntradaConfiguracion {
 void leer_archivo_configuracion(const char *nombre_archivo);
 
 const char *obtener_valor_configuracion(const char *clave, const char *valor_por_defecto);
+
+int leer_entradas_configuracion(const char *nombre_archivo, struct EntradaConfiguracion *entradas, int max_entradas);
+
+const char *buscar_valor_configuracion(const struct EntradaConfiguracion *entradas, int num, const char *clave, const char *valor_por_defecto);
+
+// Tipos de los parámetros de configuración con tipo (ver cargar_parametros_configuracion)
+typedef enum TIPO_PARAMETRO {
+    PARAMETRO_ENTERO,       // int
+    PARAMETRO_TAMANO,       // long long (bytes, segundos...)
+    PARAMETRO_BOOLEANO,     // int 0/1; se escribe 0/1 o SI/NO
+    PARAMETRO_CADENA,       // const char * (rutas, nombres, opciones)
+    PARAMETRO_PREFIJO       // Claves que empiezan por la clave indicada; las analiza otro módulo
+} TipoParametro;
+
+// Desplazamiento de los parámetros que se validan pero no se guardan en la estructura
+// (p.ej. claves que sólo usa el otro proceso pero que también aparecen en el fichero)
+#define SIN_CAMPO ((size_t)-1)
+
+// Definición de un parámetro del fichero de configuración
+typedef struct DEFINICION_PARAMETRO {
+    const char *clave;
+    TipoParametro tipo;
+    const char *valor_por_defecto;
+    size_t desplazamiento;      // offsetof del campo en la estructura de parámetros o SIN_CAMPO
+    long long minimo;           // Enteros y tamaños: valores admitidos
+    long long maximo;
+    const char *opciones;       // Cadenas: valores admitidos separados por '|' (NULL: cualquiera)
+} DefinicionParametro;
+
+int cargar_parametros_configuracion(const struct EntradaConfiguracion *entradas, int num_entradas,
+    const DefinicionParametro *definiciones, int num_definiciones, void *parametros);
+
+void conservar_parametros_no_recargables(const DefinicionParametro *definiciones, int num_definiciones, const char *claves_recargables,
+    const struct EntradaConfiguracion *entradas_iniciales, int num_iniciales, const void *parametros_iniciales,
+    const struct EntradaConfiguracion *entradas, int num_entradas, void *parametros);
+
+// Máximo de hilos que leen a la vez los parámetros de configuración (ver registrar_lector_configuracion)
+#define MAX_LECTORES_CONFIGURACION 1024
+
+void registrar_lector_configuracion();
+
+void estado_quiescente_configuracion();
+
+void pausar_lector_configuracion();
+
+void reanudar_lector_configuracion();
+
+void retirar_configuracion(void *datos, void (*liberar)(void *));
@@ -8,6 +8,28 @@
 // Número de patrones de fraude implementados
 #define NUM_PATRONES_FRAUDE 5
 
+// Hilo que evalúa las reglas del fichero de reglas (RULES_FILE), hilo del patrón de actividad simultánea
+// en varias sucursales (CONCURRENT_ACTIVITY), hilo del informe de usuarios con más actividad (TOPK_REPORT)
+// y número total de hilos de detección
+#define HILO_REGLAS_FRAUDE (NUM_PATRONES_FRAUDE + 1)
+#define HILO_ACTIVIDAD_SIMULTANEA (NUM_PATRONES_FRAUDE + 2)
+#define HILO_TOP_USUARIOS (NUM_PATRONES_FRAUDE + 3)
+#define NUM_HILOS_DETECCION (NUM_PATRONES_FRAUDE + 3)
+
+// Límites del fichero de reglas
+#define MAX_REGLAS_FRAUDE 20
+#define MAX_CONDICIONES_REGLA 8
+#define MAX_LONGITUD_REGLA 512
+
+// Agregación con volcado a disco: número máximo de volcados de un patrón antes de fusionarlos
+// y memoria estimada por cada clave de un diccionario de patrón
+#define MAX_VOLCADOS_PATRON 32
+#define BYTES_POR_CLAVE_PATRON 160
+
+// Informe de usuarios con más actividad: número máximo de ventanas y de cubos por ventana
+#define MAX_VENTANAS_TOP 4
+#define MAX_CUBOS_VENTANA_TOP 60
+
 // Segundos que debe dormir el hilo cuando no está activo
 #define SEGUNDOS_HILO_DORMIDO 5
 
@@ -0,0 +1,746 @@
+// ------------------------------------------------------------------
+// FUNCIONES DE LECTURA DE LOS DATOS CONSOLIDADOS
+// ------------------------------------------------------------------
+
+// madvise no se declara con -std=c99 sin esta macro
+#define _DEFAULT_SOURCE
+
+#include "datos_consolidados.h"
+#include "log_files.h"
+#include "config_files.h"
+#include "parametros_configuracion.h"
+
+#pragma region DatosConsolidados
+/*
+    Los datos consolidados por FileProcessor pueden estar en el fichero consolidado (USE_SHARED_MEMORY=0)
+    o en memoria compartida (USE_SHARED_MEMORY=1). En ambos casos FileProcessor sólo añade registros
+    al final, así que cada hilo guarda en un CursorConsolidado hasta dónde ha leído y en la siguiente
+    ronda procesa únicamente los registros nuevos.
+
+    Si el fichero o la memoria compartida se sustituyen (cambia el inodo) o pasan a ser más pequeños
+    que la posición guardada, se avisa al llamante para que descarte lo acumulado y se vuelve a leer
+    desde el principio.
+
+    En modo fichero el consolidado se mapea en memoria con lectura secuencial (MADV_SEQUENTIAL). Cuando los
+    datos nuevos ocupan al menos SCAN_PARALLEL_MIN_BYTES y el llamante admite agregados parciales
+    (AgregacionParalela), se cortan en tramos de SCAN_CHUNK_BYTES terminados en \n que procesan
+    SCAN_THREADS hilos, cada uno en su propio agregado parcial; al final los parciales se fusionan.
+
+    Con COLUMNAR_STORE=1 los registros se leen del almacén columnar (COLUMNAR_FILE, ver formato_columnar.h)
+    en lugar del consolidado. El cursor avanza por grupos de filas completos y de cada grupo sólo se leen
+    las columnas indicadas en cursor->columnas; los campos de las columnas que no se leen quedan vacíos
+    (cadenas "", enteros 0 e instantes -1). En el almacén las fechas están como instantes, así que
+    fechaHora1 y fechaHora2 quedan siempre vacías.
+
+    Con SNAPSHOT_READS=1 los hilos no cogen el semáforo: al empezar cada lectura se toma la marca de
+    confirmación que publica FileProcessor (COMMIT_WATERMARK_NAME, ver marca_confirmacion.h) y sólo se
+    leen los datos anteriores a la marca, aunque FileProcessor siga añadiendo datos detrás. Si la marca
+    no existe (FileProcessor no está en marcha) se leen los datos completos.
+*/
+
+// Función que convierte los dígitos de una cadena en un número (-1 si algún carácter no es un dígito)
+static int convertirDigitos(const char *cadena, int num_digitos) {
+    int valor = 0;
+    for (int i = 0; i < num_digitos; i++) {
+        if (cadena[i] < '0' || cadena[i] > '9') {
+            return -1;
+        }
+        valor = valor * 10 + (cadena[i] - '0');
+    }
+    return valor;
+}
+
+// Función que calcula los días transcurridos desde el 01/01/1970 hasta una fecha del calendario gregoriano
+static long long diasDesdeEpoca(int anio, int mes, int dia) {
+    anio -= mes <= 2;
+    long long era = (anio >= 0 ? anio : anio - 399) / 400;
+    long long anio_era = anio - era * 400;
+    long long dia_anio = (153 * (mes + (mes > 2 ? -3 : 9)) + 2) / 5 + dia - 1;
+    long long dia_era = anio_era * 365 + anio_era / 4 - anio_era / 100 + dia_anio;
+    return era * 146097 + dia_era - 719468;
+}
+
+// Función que convierte una fecha-hora con formato DD/MM/YYYY HH:MM:SS en segundos desde el 01/01/1970
+// La hora se trata como hora local sin zona horaria (no hay cambios de hora dentro de los datos)
+// Devuelve -1 si la fecha-hora no tiene el formato esperado
+long long convertirFechaHora(const char *fechaHora) {
+    if (fechaHora == NULL || strlen(fechaHora) < 19
+        || fechaHora[2] != '/' || fechaHora[5] != '/' || fechaHora[10] != ' '
+        || fechaHora[13] != ':' || fechaHora[16] != ':') {
+        return -1;
+    }
+    int dia = convertirDigitos(fechaHora, 2);
+    int mes = convertirDigitos(fechaHora + 3, 2);
+    int anio = convertirDigitos(fechaHora + 6, 4);
+    int hora = convertirDigitos(fechaHora + 11, 2);
+    int minuto = convertirDigitos(fechaHora + 14, 2);
+    int segundo = convertirDigitos(fechaHora + 17, 2);
+    if (dia < 1 || mes < 1 || mes > 12 || anio < 0 || hora < 0 || minuto < 0 || segundo < 0) {
+        return -1;
+    }
+    return diasDesdeEpoca(anio, mes, dia) * 86400 + hora * 3600 + minuto * 60 + segundo;
+}
+
+// Función que separa una línea del consolidado en sus campos
+// Modifica la línea (sustituye los ; por \0). No utiliza strtok porque strtok no es seguro
+// cuando varios hilos separan líneas a la vez
+// Devuelve 0 si el registro es correcto o -1 si le faltan campos
+int parsearRegistroConsolidado(char *linea, RegistroConsolidado *registro) {
+    char *campos[9];
+    int num_campos = 0;
+    char *inicio = linea;
+
+    while (num_campos < 9) {
+        campos[num_campos] = inicio;
+        num_campos++;
+        char *separador = strchr(inicio, ';');
+        if (separador == NULL) {
+            break;
+        }
+        *separador = '\0';
+        inicio = separador + 1;
+    }
+    if (num_campos < 9) {
+        return -1;
+    }
+
+    // Quitar el salto de línea del último campo
+    char *fin = campos[8] + strlen(campos[8]);
+    while (fin > campos[8] && (fin[-1] == '\n' || fin[-1] == '\r')) {
+        fin--;
+        *fin = '\0';
+    }
+
+    registro->sucursal = campos[0];
+    registro->operacion = campos[1];
+    registro->fechaHora1 = campos[2];
+    registro->fechaHora2 = campos[3];
+    registro->usuario = campos[4];
+    registro->tipoOperacion1 = campos[5];
+    registro->tipoOperacion2 = atoi(campos[6]);
+    // atoi se detiene en el " €" del importe
+    registro->importe = atoi(campos[7]);
+    registro->estado = campos[8];
+    registro->instante1 = convertirFechaHora(registro->fechaHora1);
+    registro->instante2 = convertirFechaHora(registro->fechaHora2);
+    return 0;
+}
+
+// Función que inicializa un cursor para leer los datos consolidados desde el principio
+void inicializarCursorConsolidado(CursorConsolidado *cursor) {
+    cursor->posicion = 0;
+    cursor->inodo = 0;
+    cursor->dispositivo = 0;
+    cursor->columnas = COLUMNAS_TODAS;
+    cursor->limite = -1;
+}
+
+// Función que lee la marca de confirmación publicada por FileProcessor
+// Devuelve 0 o -1 si la marca no existe
+static int leerMarcaConfirmacion(MarcaConfirmacion *copia) {
+    const char *nombre = obtenerParametros()->nombre_marca_confirmacion;
+    int descriptor = shm_open(nombre, O_RDONLY, 0660);
+    if (descriptor == -1) {
+        return -1;
+    }
+    struct stat info;
+    if (fstat(descriptor, &info) == -1 || info.st_size < (off_t)sizeof(MarcaConfirmacion)) {
+        close(descriptor);
+        return -1;
+    }
+    void *direccion = mmap(0, sizeof(MarcaConfirmacion), PROT_READ, MAP_SHARED, descriptor, 0);
+    close(descriptor);
+    if (direccion == MAP_FAILED) {
+        return -1;
+    }
+    MarcaConfirmacion *marca = (MarcaConfirmacion *)direccion;
+    uint64_t secuencia;
+    do {
+        // Si FileProcessor está escribiendo la marca (secuencia impar) o la cambia mientras se copia, se repite
+        secuencia = __atomic_load_n(&marca->secuencia, __ATOMIC_ACQUIRE);
+        if (secuencia % 2 == 1) {
+            continue;
+        }
+        copia->bytes_fichero = __atomic_load_n(&marca->bytes_fichero, __ATOMIC_RELAXED);
+        copia->bytes_memoria = __atomic_load_n(&marca->bytes_memoria, __ATOMIC_RELAXED);
+        copia->bytes_columnar = __atomic_load_n(&marca->bytes_columnar, __ATOMIC_RELAXED);
+        copia->publicaciones = __atomic_load_n(&marca->publicaciones, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (secuencia % 2 == 1 || __atomic_load_n(&marca->secuencia, __ATOMIC_RELAXED) != secuencia);
+    copia->secuencia = secuencia;
+    munmap(direccion, sizeof(MarcaConfirmacion));
+    return 0;
+}
+
+// Función que devuelve hasta dónde se pueden leer unos datos de tamano bytes (limite -1: sin límite)
+static long long finLectura(long long tamano, long long limite) {
+    return limite >= 0 && limite < tamano ? limite : tamano;
+}
+
+// Función que devuelve de dónde se leen los datos consolidados según la configuración
+OrigenDatosConsolidados obtenerOrigenDatosConsolidados() {
+    const ParametrosConfiguracion *parametros = obtenerParametros();
+    if (parametros->almacen_columnar) {
+        return ORIGEN_COLUMNAR;
+    }
+    // Obtener parámetro para ver si los registros están en fichero CSV o en memoria compartida
+    return parametros->usar_memoria_compartida ? ORIGEN_MEMORIA : ORIGEN_FICHERO;
+}
+
+// Función que devuelve hasta dónde se puede leer en esta ronda: la marca de confirmación y el límite del cursor
+// Devuelve -1 si no hay límite
+long long obtenerLimiteLecturaConsolidado(const CursorConsolidado *cursor, OrigenDatosConsolidados origen) {
+    long long limite = -1;
+    MarcaConfirmacion marca;
+    if (obtenerParametros()->lectura_instantanea) {
+        if (leerMarcaConfirmacion(&marca) == 0) {
+            limite = origen == ORIGEN_COLUMNAR ? marca.bytes_columnar : origen == ORIGEN_FICHERO ? marca.bytes_fichero : marca.bytes_memoria;
+        } else {
+            escribirEnLog(LOG_DEBUG, "datos_consolidados", "No hay marca de confirmación, se leen los datos completos\n");
+        }
+    }
+    if (cursor->limite >= 0) {
+        limite = finLectura(cursor->limite, limite);
+    }
+    return limite;
+}
+
+// Función que comprueba si los datos que se van a leer son los mismos que se leyeron en la ronda anterior
+// Si no lo son, reinicia el cursor y avisa al llamante para que descarte lo acumulado (también si no había leído
+// nada: las posiciones en los ficheros de agregados y de resúmenes eran de los datos anteriores)
+static void comprobarIdentidadDatos(CursorConsolidado *cursor, struct stat *info, long long tamano, ReiniciarLecturaConsolidado reiniciar, void *contexto) {
+    if (cursor->inodo != info->st_ino || cursor->dispositivo != info->st_dev || cursor->posicion > tamano) {
+        if (cursor->posicion > 0) {
+            escribirEnLog(LOG_WARNING, "datos_consolidados", "Los datos consolidados han cambiado, se vuelven a leer desde el principio\n");
+        }
+        if (cursor->posicion > 0 || cursor->inodo != 0 || cursor->dispositivo != 0) {
+            reiniciar(contexto);
+        }
+        cursor->posicion = 0;
+        cursor->inodo = info->st_ino;
+        cursor->dispositivo = info->st_dev;
+    }
+}
+
+// Función que procesa una línea: la separa en campos y llama a la función de proceso
+static int procesarLineaConsolidado(char *linea, ProcesarRegistroConsolidado procesar, void *contexto) {
+    RegistroConsolidado registro;
+    if (parsearRegistroConsolidado(linea, &registro) != 0) {
+        return 0;
+    }
+    procesar(&registro, contexto);
+    return 1;
+}
+
+// Función que procesa las líneas completas de datos[desde, hasta)
+// Las líneas de más de MAX_LINE_LENGTH - 2 caracteres se descartan. Una línea sin \n al final no se procesa:
+// en *fin queda la posición siguiente a la última línea completa
+static int procesarLineasBloque(const char *datos, long long desde, long long hasta, ProcesarRegistroConsolidado procesar, void *contexto, long long *fin) {
+    int num_registros = 0;
+    char line[MAX_LINE_LENGTH];
+    long long posicion = desde;
+    while (posicion < hasta) {
+        const char *inicio_linea = datos + posicion;
+        const char *fin_linea = memchr(inicio_linea, '\n', hasta - posicion);
+        if (fin_linea == NULL) {
+            // Última línea incompleta: se procesará en la siguiente ronda cuando esté completa
+            break;
+        }
+        size_t longitud = fin_linea - inicio_linea + 1;
+        posicion += longitud;
+        if (longitud > sizeof(line) - 1) {
+            // Línea más larga que el buffer: se descarta
+            continue;
+        }
+        memcpy(line, inicio_linea, longitud);
+        line[longitud] = '\0';
+        num_registros += procesarLineaConsolidado(line, procesar, contexto);
+    }
+    *fin = posicion;
+    return num_registros;
+}
+
+// Tramo de los datos que procesa un hilo de la lectura paralela (empieza y termina en un límite de línea)
+typedef struct TRAMO_LECTURA {
+    long long inicio;
+    long long fin;
+} TramoLectura;
+
+// Reparto de los tramos entre los hilos de la lectura paralela
+typedef struct LECTURA_PARALELA {
+    const char *datos;
+    TramoLectura *tramos;
+    int num_tramos;
+    int siguiente_tramo;
+    pthread_mutex_t mutex;
+    const AgregacionParalela *agregacion;
+} LecturaParalela;
+
+// Hilo de la lectura paralela con su agregado parcial
+typedef struct TRABAJADOR_LECTURA {
+    pthread_t hilo;
+    LecturaParalela *lectura;
+    void *parcial;
+    int num_registros;
+} TrabajadorLectura;
+
+// Hilo que procesa tramos hasta que no quedan, acumulando en su propio agregado parcial
+static void *hiloLecturaParalela(void *arg) {
+    TrabajadorLectura *trabajador = (TrabajadorLectura *)arg;
+    LecturaParalela *lectura = trabajador->lectura;
+    while (1) {
+        pthread_mutex_lock(&lectura->mutex);
+        int tramo = lectura->siguiente_tramo < lectura->num_tramos ? lectura->siguiente_tramo++ : -1;
+        pthread_mutex_unlock(&lectura->mutex);
+        if (tramo == -1) {
+            break;
+        }
+        long long fin;
+        trabajador->num_registros += procesarLineasBloque(lectura->datos, lectura->tramos[tramo].inicio, lectura->tramos[tramo].fin,
+            lectura->agregacion->procesar_parcial, trabajador->parcial, &fin);
+    }
+    return NULL;
+}
+
+// Función que procesa en paralelo las líneas completas de datos[desde, hasta)
+// Los datos se cortan en tramos de unos bytes_tramo bytes que terminan en \n y los hilos van cogiendo tramos.
+// Cada hilo acumula en su agregado parcial y al final se fusionan todos en el contexto del llamante
+static int procesarLineasParalelo(const char *datos, long long desde, long long hasta, int num_hilos, long long bytes_tramo,
+    const AgregacionParalela *agregacion, void *contexto, long long *fin) {
+    // Los datos que se reparten terminan en la última línea completa
+    long long limite = hasta;
+    while (limite > desde && datos[limite - 1] != '\n') {
+        limite--;
+    }
+    *fin = limite;
+
+    int capacidad = (int)((limite - desde) / bytes_tramo) + 1;
+    TramoLectura *tramos = malloc(sizeof(TramoLectura) * capacidad);
+    int num_tramos = 0;
+    long long inicio = desde;
+    while (inicio < limite) {
+        long long corte = inicio + bytes_tramo < limite ? inicio + bytes_tramo : limite;
+        const char *salto = corte < limite ? memchr(datos + corte - 1, '\n', limite - corte + 1) : NULL;
+        long long fin_tramo = salto != NULL ? salto - datos + 1 : limite;
+        tramos[num_tramos].inicio = inicio;
+        tramos[num_tramos].fin = fin_tramo;
+        num_tramos++;
+        inicio = fin_tramo;
+    }
+
+    LecturaParalela lectura = {datos, tramos, num_tramos, 0, PTHREAD_MUTEX_INITIALIZER, agregacion};
+    if (num_hilos > num_tramos) {
+        num_hilos = num_tramos;
+    }
+    TrabajadorLectura *trabajadores = calloc(num_hilos > 0 ? num_hilos : 1, sizeof(TrabajadorLectura));
+    int hilos_creados = 0;
+    int sin_hilos = 0;
+    for (int i = 0; i < num_hilos; i++) {
+        trabajadores[i].lectura = &lectura;
+        trabajadores[i].parcial = agregacion->crear_parcial(contexto);
+        if (pthread_create(&trabajadores[i].hilo, NULL, hiloLecturaParalela, &trabajadores[i]) != 0) {
+            // Sin más hilos: los que ya están en marcha procesan todos los tramos
+            agregacion->fusionar_parcial(contexto, trabajadores[i].parcial);
+            break;
+        }
+        hilos_creados++;
+    }
+    if (hilos_creados == 0) {
+        // No se ha podido crear ningún hilo: se procesa todo en este hilo
+        trabajadores[0].parcial = agregacion->crear_parcial(contexto);
+        hiloLecturaParalela(&trabajadores[0]);
+        hilos_creados = 1;
+        sin_hilos = 1;
+    }
+
+    int num_registros = 0;
+    for (int i = 0; i < hilos_creados; i++) {
+        if (!sin_hilos) {
+            pthread_join(trabajadores[i].hilo, NULL);
+        }
+        num_registros += trabajadores[i].num_registros;
+        agregacion->fusionar_parcial(contexto, trabajadores[i].parcial);
+    }
+    escribirEnLog(LOG_INFO, "datos_consolidados", "Lectura paralela: %d tramos en %d hilos\n", num_tramos, hilos_creados);
+    pthread_mutex_destroy(&lectura.mutex);
+    free(trabajadores);
+    free(tramos);
+    return num_registros;
+}
+
+// Función que lee los registros nuevos del fichero consolidado
+// El fichero se mapea en memoria con lectura secuencial. Si hay suficientes datos nuevos y el llamante
+// admite agregados parciales, se procesan en paralelo (SCAN_THREADS, SCAN_CHUNK_BYTES, SCAN_PARALLEL_MIN_BYTES)
+static int leerNuevosRegistrosFichero(CursorConsolidado *cursor, ProcesarRegistroConsolidado procesar, ReiniciarLecturaConsolidado reiniciar, void *contexto,
+    const AgregacionParalela *agregacion, long long limite) {
+    const ParametrosConfiguracion *parametros = obtenerParametros();
+    const char *carpeta_datos = parametros->carpeta_datos;
+    const char *fichero_datos = parametros->fichero_consolidado;
+    char nombre_completo_fichero_datos[PATH_MAX];
+    snprintf(nombre_completo_fichero_datos, sizeof(nombre_completo_fichero_datos), "%s/%s", carpeta_datos, fichero_datos);
+
+    int descriptor = open(nombre_completo_fichero_datos, O_RDONLY);
+    if (descriptor == -1) {
+        // No se ha conseguido abrir el fichero
+        escribirEnLog(LOG_ERROR, "datos_consolidados", "Error al abrir el archivo consolidado %s\n", nombre_completo_fichero_datos);
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(descriptor, &info) == -1) {
+        escribirEnLog(LOG_ERROR, "datos_consolidados", "Error al obtener información del archivo consolidado %s\n", nombre_completo_fichero_datos);
+        close(descriptor);
+        return -1;
+    }
+    comprobarIdentidadDatos(cursor, &info, info.st_size, reiniciar, contexto);
+    long long fin_lectura = finLectura(info.st_size, limite);
+    escribirEnLog(LOG_INFO, "datos_consolidados", "Comenzando lectura del archivo desde la posición %lld hasta %lld\n", cursor->posicion, fin_lectura);
+    if (cursor->posicion >= fin_lectura) {
+        close(descriptor);
+        escribirEnLog(LOG_INFO, "datos_consolidados", "Terminada lectura del archivo consolidado: 0 registros nuevos\n");
+        return 0;
+    }
+
+    // Se mapea desde la página en la que está la posición del cursor
+    long long pagina = sysconf(_SC_PAGESIZE);
+    long long inicio_mapa = cursor->posicion - cursor->posicion % pagina;
+    size_t tamano_mapa = (size_t)(fin_lectura - inicio_mapa);
+    void *mapa = mmap(NULL, tamano_mapa, PROT_READ, MAP_PRIVATE, descriptor, inicio_mapa);
+    close(descriptor);
+    if (mapa == MAP_FAILED) {
+        escribirEnLog(LOG_ERROR, "datos_consolidados", "Error al mapear el archivo consolidado %s\n", nombre_completo_fichero_datos);
+        return -1;
+    }
+    madvise(mapa, tamano_mapa, MADV_SEQUENTIAL);
+    const char *datos = (const char *)mapa - inicio_mapa;
+
+    int num_hilos = parametros->hilos_lectura;
+    long long bytes_tramo = parametros->bytes_tramo_lectura;
+    long long minimo_paralelo = parametros->minimo_lectura_paralela;
+    long long pendientes = fin_lectura - cursor->posicion;
+    int num_registros;
+    long long fin;
+    if (agregacion != NULL && num_hilos > 1 && bytes_tramo > 0 && pendientes >= minimo_paralelo) {
+        num_registros = procesarLineasParalelo(datos, cursor->posicion, fin_lectura, num_hilos, bytes_tramo, agregacion, contexto, &fin);
+    } else {
+        num_registros = procesarLineasBloque(datos, cursor->posicion, fin_lectura, procesar, contexto, &fin);
+    }
+    cursor->posicion = fin;
+
+    munmap(mapa, tamano_mapa);
+    escribirEnLog(LOG_INFO, "datos_consolidados", "Terminada lectura del archivo consolidado: %d registros nuevos\n", num_registros);
+    return num_registros;
+}
+
+// Función que lee los registros nuevos de la memoria compartida
+static int leerNuevosRegistrosMemoria(CursorConsolidado *cursor, ProcesarRegistroConsolidado procesar, ReiniciarLecturaConsolidado reiniciar, void *contexto,
+    long long limite) {
+    // Obtener los valores de la memoria compartida del fichero de configuración
+    const char *shared_mem_name = obtenerParametros()->nombre_memoria_compartida;
+
+    // Al abrir la memoria compartida...
+    // Cambiamos el umask antes de crear el pipe para que se asignen correctamente
+    // los permisos de grupo
+    // ver: https://stackoverflow.com/questions/11909505/posix-shared-memory-and-semaphores-permissions-set-incorrectly-by-open-calls
+    mode_t old_umask = umask(0);
+    int shared_mem_fd = shm_open(shared_mem_name, O_RDONLY, 0660);
+    umask(old_umask);
+    if (shared_mem_fd == -1) {
+        escribirEnLog(LOG_ERROR, "shared_memory", "Error al acceder a la memoria compartida\n");
+        perror("Error al crear la memoria compartida");
+        return -1;
+    }
+    escribirEnLog(LOG_INFO, "shared_memory", "Obtenido acceso a la memoria compartida nombre %s fd %i\n", shared_mem_name, shared_mem_fd);
+
+    struct stat info;
+    if (fstat(shared_mem_fd, &info) == -1) {
+        escribirEnLog(LOG_ERROR, "shared_memory", "Error al obtener información de la memoria compartida\n");
+        close(shared_mem_fd);
+        return -1;
+    }
+    // Se mapea el tamaño real del objeto de memoria compartida: FileProcessor lo amplía si se aumenta
+    // SHARED_MEMORY_INITIAL_SIZE al recargar su configuración
+    long long shared_mem_size = info.st_size;
+    if (shared_mem_size == 0) {
+        close(shared_mem_fd);
+        return 0;
+    }
+
+    void *shared_mem_addr = mmap(0, shared_mem_size, PROT_READ, MAP_SHARED, shared_mem_fd, 0);
+    if (shared_mem_addr == MAP_FAILED) {
+        escribirEnLog(LOG_ERROR, "shared_memory", "Error al mapear la memoria compartida\n");
+        close(shared_mem_fd);
+        return -1;
+    }
+    escribirEnLog(LOG_INFO, "shared_memory", "Mapeada memoria compartida dirección %p tamaño %lld\n", shared_mem_addr, shared_mem_size);
+
+    // Los datos ocupan hasta el primer \0 (el resto de la memoria compartida está a cero)
+    const char *datos = (const char *)shared_mem_addr;
+    const char *fin_datos = memchr(datos, '\0', shared_mem_size);
+    long long tamano_datos = fin_datos ? fin_datos - datos : shared_mem_size;
+    comprobarIdentidadDatos(cursor, &info, tamano_datos, reiniciar, contexto);
+    tamano_datos = finLectura(tamano_datos, limite);
+
+    int num_registros = 0;
+    char line[MAX_LINE_LENGTH];
+    long long posicion = cursor->posicion;
+    while (posicion < tamano_datos) {
+        const char *inicio_linea = datos + posicion;
+        const char *fin_linea = memchr(inicio_linea, '\n', tamano_datos - posicion);
+        if (fin_linea == NULL) {
+            // Última línea incompleta
+            break;
+        }
+        size_t longitud = fin_linea - inicio_linea;
+        if (longitud >= sizeof(line)) {
+            longitud = sizeof(line) - 1;
+        }
+        memcpy(line, inicio_linea, longitud);
+        line[longitud] = '\0';
+        posicion = fin_linea - datos + 1;
+        num_registros += procesarLineaConsolidado(line, procesar, contexto);
+    }
+    cursor->posicion = posicion;
+
+    if (munmap(shared_mem_addr, shared_mem_size) == -1) {
+        perror("Error al desmapear la memoria compartida");
+        escribirEnLog(LOG_ERROR, "shared_memory", "Error al desmapear la memoria compartida\n");
+    }
+    if (close(shared_mem_fd) == -1) {
+        escribirEnLog(LOG_ERROR, "shared_memory", "Error al cerrar el descriptor de archivo de la memoria compartida\n");
+    }
+    escribirEnLog(LOG_INFO, "shared_memory", "Terminada lectura de memoria compartida: %d registros nuevos\n", num_registros);
+    return num_registros;
+}
+
+// Columna de texto de un grupo de filas ya decodificada
+// Los textos se guardan con un byte de longitud delante: al decodificar se desplazan un byte a la izquierda
+// y se termina cada uno con \0, así que caben en el mismo buffer
+typedef struct COLUMNA_DECODIFICADA {
+    unsigned char *datos;
+    const char **textos;        // Diccionario: textos de las entradas. Texto: texto de cada fila
+    int num_textos;
+    int bytes_identificador;    // Diccionario: 1 o 2
+    const unsigned char *identificadores;
+} ColumnaDecodificada;
+
+// Función que convierte una secuencia de textos (longitud + texto) en textos terminados en \0
+// Devuelve el número de bytes que ocupan o -1 si la columna está mal formada
+static long decodificarTextosColumna(unsigned char *datos, size_t tamano, int num_textos, const char **textos) {
+    size_t posicion = 0;
+    for (int i = 0; i < num_textos; i++) {
+        if (posicion >= tamano || posicion + 1 + datos[posicion] > tamano) {
+            return -1;
+        }
+        size_t longitud = datos[posicion];
+        memmove(datos + posicion, datos + posicion + 1, longitud);
+        datos[posicion + longitud] = '\0';
+        textos[i] = (const char *)datos + posicion;
+        posicion += longitud + 1;
+    }
+    return (long)posicion;
+}
+
+// Función que decodifica una columna con diccionario
+static int decodificarDiccionarioColumna(ColumnaDecodificada *columna, size_t tamano, uint32_t num_filas) {
+    uint32_t entradas;
+    if (tamano < sizeof(entradas) + 1) {
+        return -1;
+    }
+    memcpy(&entradas, columna->datos, sizeof(entradas));
+    columna->bytes_identificador = columna->datos[sizeof(entradas)];
+    size_t cabecera = sizeof(entradas) + 1;
+    columna->textos = malloc(sizeof(char *) * (entradas > 0 ? entradas : 1));
+    columna->num_textos = (int)entradas;
+    long bytes_textos = decodificarTextosColumna(columna->datos + cabecera, tamano - cabecera, (int)entradas, columna->textos);
+    if (bytes_textos < 0 || (columna->bytes_identificador != 1 && columna->bytes_identificador != 2)
+        || cabecera + bytes_textos + (size_t)columna->bytes_identificador * num_filas > tamano) {
+        return -1;
+    }
+    columna->identificadores = columna->datos + cabecera + bytes_textos;
+    return 0;
+}
+
+// Función que devuelve el texto de una fila de una columna con diccionario
+static const char *textoDiccionario(const ColumnaDecodificada *columna, uint32_t fila) {
+    uint16_t identificador;
+    if (columna->bytes_identificador == 1) {
+        identificador = columna->identificadores[fila];
+    } else {
+        memcpy(&identificador, columna->identificadores + 2 * fila, sizeof(identificador));
+    }
+    return identificador < columna->num_textos ? columna->textos[identificador] : "";
+}
+
+// Función que lee de un grupo de filas las columnas pedidas y llama a procesar con cada fila
+// El fichero está posicionado justo después de la cabecera del grupo
+static int procesarGrupoFilas(FILE *fichero, const CabeceraGrupoFilas *cabecera, unsigned int columnas, ProcesarRegistroConsolidado procesar, void *contexto) {
+    ColumnaDecodificada decodificadas[NUM_COLUMNAS_ALMACEN];
+    memset(decodificadas, 0, sizeof(decodificadas));
+    uint32_t n = cabecera->num_filas;
+    int resultado = 0;
+
+    for (int c = 0; c < NUM_COLUMNAS_ALMACEN && resultado == 0; c++) {
+        size_t tamano = cabecera->bytes_columnas[c];
+        if (!(columnas & MASCARA_COLUMNA(c))) {
+            // Columna que no se necesita: se salta sin leerla
+            if (fseek(fichero, (long)tamano, SEEK_CUR) != 0) {
+                resultado = -1;
+            }
+            continue;
+        }
+        ColumnaDecodificada *columna = &decodificadas[c];
+        columna->datos = malloc(tamano > 0 ? tamano : 1);
+        if (tamano > 0 && fread(columna->datos, tamano, 1, fichero) != 1) {
+            resultado = -1;
+            break;
+        }
+        switch (c) {
+            case COLUMNA_SUCURSAL:
+            case COLUMNA_USUARIO:
+            case COLUMNA_TIPO_OPERACION1:
+            case COLUMNA_ESTADO:
+                resultado = decodificarDiccionarioColumna(columna, tamano, n);
+                break;
+            case COLUMNA_OPERACION:
+                columna->textos = malloc(sizeof(char *) * (n > 0 ? n : 1));
+                resultado = decodificarTextosColumna(columna->datos, tamano, (int)n, columna->textos) < 0 ? -1 : 0;
+                break;
+            case COLUMNA_FECHA_INICIO:
+            case COLUMNA_FECHA_FIN:
+                resultado = tamano == sizeof(int64_t) * n ? 0 : -1;
+                break;
+            default:
+                resultado = tamano == sizeof(int32_t) * n ? 0 : -1;
+                break;
+        }
+    }
+
+    int num_registros = 0;
+    int64_t instante_inicio = 0;
+    for (uint32_t fila = 0; fila < n && resultado == 0; fila++) {
+        RegistroConsolidado registro;
+        int64_t valor;
+        int32_t entero;
+        registro.sucursal = columnas & MASCARA_COLUMNA(COLUMNA_SUCURSAL) ? (char *)textoDiccionario(&decodificadas[COLUMNA_SUCURSAL], fila) : "";
+        registro.operacion = columnas & MASCARA_COLUMNA(COLUMNA_OPERACION) ? (char *)decodificadas[COLUMNA_OPERACION].textos[fila] : "";
+        registro.fechaHora1 = "";
+        registro.fechaHora2 = "";
+        registro.usuario = columnas & MASCARA_COLUMNA(COLUMNA_USUARIO) ? (char *)textoDiccionario(&decodificadas[COLUMNA_USUARIO], fila) : "";
+        registro.tipoOperacion1 = columnas & MASCARA_COLUMNA(COLUMNA_TIPO_OPERACION1) ? (char *)textoDiccionario(&decodificadas[COLUMNA_TIPO_OPERACION1], fila) : "";
+        registro.estado = columnas & MASCARA_COLUMNA(COLUMNA_ESTADO) ? (char *)textoDiccionario(&decodificadas[COLUMNA_ESTADO], fila) : "";
+        registro.tipoOperacion2 = 0;
+        if (columnas & MASCARA_COLUMNA(COLUMNA_TIPO_OPERACION2)) {
+            memcpy(&entero, decodificadas[COLUMNA_TIPO_OPERACION2].datos + sizeof(int32_t) * fila, sizeof(entero));
+            registro.tipoOperacion2 = entero;
+        }
+        registro.importe = 0;
+        if (columnas & MASCARA_COLUMNA(COLUMNA_IMPORTE)) {
+            // De céntimos a euros truncando, igual que atoi sobre el texto del importe
+            memcpy(&entero, decodificadas[COLUMNA_IMPORTE].datos + sizeof(int32_t) * fila, sizeof(entero));
+            registro.importe = entero / 100;
+        }
+        // La fecha de inicio está como diferencia con la fila anterior y la de fin con la de inicio
+        registro.instante1 = -1;
+        registro.instante2 = -1;
+        if (columnas & (MASCARA_COLUMNA(COLUMNA_FECHA_INICIO) | MASCARA_COLUMNA(COLUMNA_FECHA_FIN))) {
+            if (columnas & MASCARA_COLUMNA(COLUMNA_FECHA_INICIO)) {
+                memcpy(&valor, decodificadas[COLUMNA_FECHA_INICIO].datos + sizeof(int64_t) * fila, sizeof(valor));
+                instante_inicio = fila == 0 ? valor : instante_inicio + valor;
+                registro.instante1 = instante_inicio;
+            }
+            if ((columnas & MASCARA_COLUMNA(COLUMNA_FECHA_FIN)) && (columnas & MASCARA_COLUMNA(COLUMNA_FECHA_INICIO))) {
+                memcpy(&valor, decodificadas[COLUMNA_FECHA_FIN].datos + sizeof(int64_t) * fila, sizeof(valor));
+                registro.instante2 = instante_inicio + valor;
+            }
+        }
+        procesar(&registro, contexto);
+        num_registros++;
+    }
+
+    for (int c = 0; c < NUM_COLUMNAS_ALMACEN; c++) {
+        free(decodificadas[c].datos);
+        free(decodificadas[c].textos);
+    }
+    return resultado == 0 ? num_registros : -1;
+}
+
+// Función que lee los grupos de filas nuevos del almacén columnar
+static int leerNuevosRegistrosColumnar(CursorConsolidado *cursor, ProcesarRegistroConsolidado procesar, ReiniciarLecturaConsolidado reiniciar, void *contexto,
+    long long limite) {
+    char nombre_fichero[PATH_MAX];
+    snprintf(nombre_fichero, sizeof(nombre_fichero), "%s/%s", obtenerParametros()->carpeta_datos, obtenerParametros()->fichero_columnar);
+    FILE *fichero = fopen(nombre_fichero, "rb");
+    if (fichero == NULL) {
+        escribirEnLog(LOG_ERROR, "datos_consolidados", "Error al abrir el almacén columnar %s\n", nombre_fichero);
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fileno(fichero), &info) == -1) {
+        escribirEnLog(LOG_ERROR, "datos_consolidados", "Error al obtener información del almacén columnar %s\n", nombre_fichero);
+        fclose(fichero);
+        return -1;
+    }
+    comprobarIdentidadDatos(cursor, &info, info.st_size, reiniciar, contexto);
+    long long fin_lectura = finLectura(info.st_size, limite);
+    if (cursor->posicion == 0) {
+        char magia[LONGITUD_MAGIA_ALMACEN_COLUMNAR];
+        if (fread(magia, LONGITUD_MAGIA_ALMACEN_COLUMNAR, 1, fichero) != 1
+            || memcmp(magia, MAGIA_ALMACEN_COLUMNAR, LONGITUD_MAGIA_ALMACEN_COLUMNAR) != 0) {
+            escribirEnLog(LOG_ERROR, "datos_consolidados", "%s no es un almacén columnar\n", nombre_fichero);
+            fclose(fichero);
+            return -1;
+        }
+        cursor->posicion = LONGITUD_MAGIA_ALMACEN_COLUMNAR;
+    }
+
+    int num_registros = 0;
+    int num_grupos = 0;
+    CabeceraGrupoFilas cabecera;
+    while (fseek(fichero, cursor->posicion, SEEK_SET) == 0 && fread(&cabecera, sizeof(cabecera), 1, fichero) == 1) {
+        long long bytes = 0;
+        for (int c = 0; c < NUM_COLUMNAS_ALMACEN; c++) {
+            bytes += cabecera.bytes_columnas[c];
+        }
+        if (cabecera.magia != MAGIA_GRUPO_FILAS || cursor->posicion + (long long)sizeof(cabecera) + bytes > fin_lectura) {
+            // Grupo incompleto: se leerá en la siguiente ronda
+            break;
+        }
+        int registros_grupo = procesarGrupoFilas(fichero, &cabecera, cursor->columnas, procesar, contexto);
+        if (registros_grupo < 0) {
+            escribirEnLog(LOG_ERROR, "datos_consolidados", "Grupo de filas mal formado en %s posición %lld\n", nombre_fichero, cursor->posicion);
+            fclose(fichero);
+            return -1;
+        }
+        num_registros += registros_grupo;
+        num_grupos++;
+        cursor->posicion += sizeof(cabecera) + bytes;
+    }
+    fclose(fichero);
+    escribirEnLog(LOG_INFO, "datos_consolidados", "Terminada lectura del almacén columnar: %d registros nuevos en %d grupos\n", num_registros, num_grupos);
+    return num_registros;
+}
+
+// Función que lee los registros añadidos desde la última lectura del cursor
+// Llama a procesar con cada registro nuevo y a reiniciar si hay que descartar lo acumulado
+// Devuelve el número de registros procesados o -1 en caso de error
+int leerNuevosRegistrosConsolidados(CursorConsolidado *cursor, ProcesarRegistroConsolidado procesar, ReiniciarLecturaConsolidado reiniciar, void *contexto) {
+    return leerNuevosRegistrosConsolidadosParalelo(cursor, procesar, reiniciar, contexto, NULL);
+}
+
+// Igual que leerNuevosRegistrosConsolidados, pero si el llamante admite agregados parciales (agregacion no es NULL)
+// la lectura del fichero consolidado se puede repartir entre varios hilos
+int leerNuevosRegistrosConsolidadosParalelo(CursorConsolidado *cursor, ProcesarRegistroConsolidado procesar, ReiniciarLecturaConsolidado reiniciar, void *contexto,
+    const AgregacionParalela *agregacion) {
+    OrigenDatosConsolidados origen = obtenerOrigenDatosConsolidados();
+    long long limite = obtenerLimiteLecturaConsolidado(cursor, origen);
+    if (origen == ORIGEN_COLUMNAR) {
+        return leerNuevosRegistrosColumnar(cursor, procesar, reiniciar, contexto, limite);
+    }
+    if (origen == ORIGEN_FICHERO) {
+        return leerNuevosRegistrosFichero(cursor, procesar, reiniciar, contexto, agregacion, limite);
+    }
+    return leerNuevosRegistrosMemoria(cursor, procesar, reiniciar, contexto, limite);
+}
+
+#pragma endregion DatosConsolidados
@@ -0,0 +1,87 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <unistd.h>         // Gestión de procesos, acceso a archivos, pipe, control de señales
+#include <sys/types.h>      // Definiciones de typos de datos: pid_t, size_t...
+#include <sys/stat.h>       // Definiciones y estructuras para trabajar con estados de archivos Linux
+#include <linux/limits.h>   // Define varias constantes que representan los límites del sistema en sistemas operativos Linux
+#include <fcntl.h>          // Proporciona funciones y constantes para controlar archivos y descriptores de archivo en Linux
+#include <sys/mman.h>       // Memoria compartida
+#include <pthread.h>        // Hilos de la lectura paralela
+
+#include "constants.h"          // Constantes de la aplicación
+#include "formato_columnar.h"   // Formato en disco del almacén columnar
+#include "marca_confirmacion.h" // Marca de confirmación publicada por FileProcessor
+#pragma endregion Librerias
+
+
+// Registro del fichero consolidado ya separado en campos
+// Formato: SUC001;OPE0001;12/03/2024 09:47:00;12/03/2024 10:14:00;USER144;COMPRA01;1;73 €;Finalizado
+// Las cadenas apuntan dentro de la línea leída, sólo son válidas mientras se procesa el registro
+typedef struct REGISTRO_CONSOLIDADO {
+    char *sucursal;
+    char *operacion;
+    char *fechaHora1;
+    char *fechaHora2;
+    char *usuario;
+    char *tipoOperacion1;
+    int tipoOperacion2;
+    int importe;
+    char *estado;
+    long long instante1;    // fechaHora1 en segundos desde 01/01/1970 (-1 si no es válida)
+    long long instante2;    // fechaHora2 en segundos desde 01/01/1970 (-1 si no es válida)
+} RegistroConsolidado;
+
+// Posición de lectura de un hilo en los datos consolidados
+// Permite leer en cada ronda únicamente los registros añadidos desde la ronda anterior
+typedef struct CURSOR_CONSOLIDADO {
+    long long posicion;     // Bytes ya procesados
+    ino_t inodo;            // Identidad del fichero o de la memoria compartida leídos
+    dev_t dispositivo;
+    unsigned int columnas;  // Columnas que se leen del almacén columnar (máscara de ColumnaAlmacen)
+    long long limite;       // Posición hasta la que se lee (-1: hasta el final de los datos confirmados)
+} CursorConsolidado;
+
+// Origen de los datos consolidados según la configuración (COLUMNAR_STORE y USE_SHARED_MEMORY)
+typedef enum ORIGEN_DATOS_CONSOLIDADOS {
+    ORIGEN_FICHERO,
+    ORIGEN_MEMORIA,
+    ORIGEN_COLUMNAR
+} OrigenDatosConsolidados;
+
+// Función a la que se llama con cada registro leído
+typedef void (*ProcesarRegistroConsolidado)(RegistroConsolidado *registro, void *contexto);
+
+// Función a la que se llama cuando los datos consolidados han cambiado de identidad
+// (fichero sustituido o truncado, memoria compartida recreada) y hay que descartar lo acumulado
+typedef void (*ReiniciarLecturaConsolidado)(void *contexto);
+
+// Agregados parciales para la lectura paralela del fichero consolidado
+// Cada hilo de la lectura acumula en su propio parcial (creado con crear_parcial) y al terminar
+// los parciales se fusionan en el contexto del llamante, de uno en uno y desde el hilo llamante
+typedef struct AGREGACION_PARALELA {
+    void *(*crear_parcial)(void *contexto);
+    ProcesarRegistroConsolidado procesar_parcial;       // Se llama con el parcial como contexto
+    void (*fusionar_parcial)(void *contexto, void *parcial);   // Fusiona y libera el parcial
+} AgregacionParalela;
+
+int parsearRegistroConsolidado(char *linea, RegistroConsolidado *registro);
+
+long long convertirFechaHora(const char *fechaHora);
+
+void inicializarCursorConsolidado(CursorConsolidado *cursor);
+
+OrigenDatosConsolidados obtenerOrigenDatosConsolidados();
+
+long long obtenerLimiteLecturaConsolidado(const CursorConsolidado *cursor, OrigenDatosConsolidados origen);
+
+int leerNuevosRegistrosConsolidados(CursorConsolidado *cursor, ProcesarRegistroConsolidado procesar, ReiniciarLecturaConsolidado reiniciar, void *contexto);
+
+int leerNuevosRegistrosConsolidadosParalelo(CursorConsolidado *cursor, ProcesarRegistroConsolidado procesar, ReiniciarLecturaConsolidado reiniciar, void *contexto,
+    const AgregacionParalela *agregacion);
@@ -0,0 +1,23 @@
+#pragma once
+
+/*
+    Formato del fichero de agregados parciales (PARTIAL_AGGREGATES=1)
+    Este fichero tiene que ser igual en FileProcessor y Monitor
+
+    Fichero de texto al que FileProcessor sólo añade lotes, uno por cada fichero de sucursal consolidado.
+    Cada lote empieza con una línea de cabecera y sigue con una línea por cada usuario y cubo de tiempo
+    de cada patrón:
+        L;filas;registros;fichero_desde;fichero_hasta;memoria_desde;memoria_hasta;columnar_desde;columnar_hasta;
+          fichero_identidad;memoria_identidad;columnar_identidad
+        A;patron;ancho;usuario;inicio;cantidad;operacion1;operacion2;operacion3;operacion4
+    Los rangos desde/hasta indican qué bytes del fichero consolidado, de la memoria compartida y del almacén
+    columnar ocupan los registros del lote (la cabecera va en una sola línea). La identidad de cada destino es
+    dispositivo:inodo (0:0 si no se utiliza): un lote sólo vale para los datos consolidados con esa identidad.
+    El inicio del cubo está en segundos desde 01/01/1970 y es múltiplo del ancho. Las líneas A tienen el mismo
+    valor acumulado que calcula Monitor para ese usuario y cubo (ver patrones_fraude.c en Monitor), así que
+    Monitor puede combinarlas en cualquier ventana cuyo ancho sea múltiplo del ancho del cubo.
+*/
+
+// Ancho en segundos de los cubos de cada patrón: la granularidad por defecto de cada patrón
+#define ANCHOS_CUBOS_AGREGADOS {3600, 1, 86400, 86400, 86400}
+#define NUM_PATRONES_AGREGADOS 5
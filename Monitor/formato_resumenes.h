@@ -0,0 +1,44 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdint.h>         // Enteros de tamaño fijo para el hash del filtro de Bloom
+#pragma endregion Librerias
+
+/*
+    Formato del fichero de resúmenes de lotes (BATCH_SUMMARIES=1)
+    Este fichero tiene que ser igual en FileProcessor y Monitor
+
+    Fichero de texto al que FileProcessor sólo añade líneas, una por cada fichero de sucursal consolidado:
+        R;fichero_desde;fichero_hasta;memoria_desde;memoria_hasta;columnar_desde;columnar_hasta;
+          fichero_identidad;memoria_identidad;columnar_identidad;
+          registros;importe_minimo;importe_maximo;errores;tipos;instante_minimo;instante_maximo;bloom
+    (en una sola línea)
+        - los rangos desde/hasta indican qué bytes de los datos consolidados ocupan los registros del lote
+        - la identidad de cada destino es dispositivo:inodo (0:0 si no se utiliza): el resumen sólo vale para
+          los datos consolidados con esa identidad
+        - importe mínimo y máximo en euros, igual que los lee Monitor (atoi)
+        - errores: registros con estado Error
+        - tipos: máscara con el bit t para cada tipo de operación 2 presente (0..30) y el bit 31 para el resto
+        - instante mínimo y máximo de la fecha de inicio en segundos desde 01/01/1970 (-1 si no hay ninguna válida)
+        - bloom: filtro de Bloom de los usuarios en hexadecimal (vacío si SUMMARY_BLOOM_BITS=0), con
+          HASHES_BLOOM_RESUMEN posiciones por usuario calculadas con posicionBloomResumen
+*/
+
+#define HASHES_BLOOM_RESUMEN 3
+#define BIT_TIPOS_RESUMEN_OTROS 31
+#define MAX_BITS_BLOOM_RESUMEN 65536
+#define LONGITUD_MAXIMA_RESUMEN (256 + MAX_BITS_BLOOM_RESUMEN / 4)
+
+// Función que calcula la posición i del filtro de Bloom de n bits para un usuario (doble hash FNV-1a)
+static inline uint32_t posicionBloomResumen(const char *usuario, int i, uint32_t n) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char *c = (const unsigned char *)usuario; *c != '\0'; c++) {
+        hash = (hash ^ *c) * 1099511628211ULL;
+    }
+    uint32_t h1 = (uint32_t)hash;
+    uint32_t h2 = (uint32_t)(hash >> 32) | 1u;
+    return (h1 + (uint32_t)i * h2) % n;
+}
@@ -0,0 +1,188 @@
+// ------------------------------------------------------------------
+// ÍNDICE DE INTERVALOS DE TIEMPO POR USUARIO
+// ------------------------------------------------------------------
+
+#include "indice_intervalos.h"
+
+#pragma region IndiceIntervalos
+/*
+    Treap (árbol binario de búsqueda ordenado por inicio y montículo por una prioridad aleatoria) en el
+    que cada nodo guarda además el mayor y el menor fin de su subárbol:
+        - insertar un intervalo cuesta O(log n) de media
+        - buscar los intervalos que se solapan con [inicio, fin) cuesta O(min(n, k log n)) de media con k
+          solapes: un subárbol cuyo mayor fin no pasa de inicio no tiene ningún solape, y a la derecha de un
+          nodo que empieza en fin o después tampoco. Cada solape puede obligar a bajar por un camino entero
+          (la poda sólo es por el fin máximo), así que no se llega al O(log n + k) de un árbol de intervalos
+          con listas ordenadas por fin en cada nodo
+        - eliminar los intervalos terminados antes de un instante sólo baja por los subárboles cuyo menor
+          fin es anterior a ese instante
+
+    Dos intervalos se solapan si cada uno empieza antes de que termine el otro (inicio1 < fin2 y
+    inicio2 < fin1), así que dos operaciones seguidas en las que una empieza cuando termina la otra no
+    se solapan.
+*/
+
+// Función que genera la prioridad de un nodo nuevo (xorshift32)
+static uint32_t siguientePrioridad(IndiceIntervalos *indice) {
+    uint32_t x = indice->semilla;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    indice->semilla = x;
+    return x;
+}
+
+// Función que recalcula el mayor y el menor fin del subárbol de un nodo
+static void actualizarNodo(NodoIntervalo *nodo) {
+    nodo->fin_maximo = nodo->fin;
+    nodo->fin_minimo = nodo->fin;
+    NodoIntervalo *hijos[2] = {nodo->izquierdo, nodo->derecho};
+    for (int i = 0; i < 2; i++) {
+        if (hijos[i] != NULL) {
+            if (hijos[i]->fin_maximo > nodo->fin_maximo) {
+                nodo->fin_maximo = hijos[i]->fin_maximo;
+            }
+            if (hijos[i]->fin_minimo < nodo->fin_minimo) {
+                nodo->fin_minimo = hijos[i]->fin_minimo;
+            }
+        }
+    }
+}
+
+// Función que separa un subárbol en los nodos con inicio <= inicio (menores) y el resto (mayores)
+static void separarArbol(NodoIntervalo *nodo, long long inicio, NodoIntervalo **menores, NodoIntervalo **mayores) {
+    if (nodo == NULL) {
+        *menores = NULL;
+        *mayores = NULL;
+    } else if (nodo->inicio <= inicio) {
+        separarArbol(nodo->derecho, inicio, &nodo->derecho, mayores);
+        actualizarNodo(nodo);
+        *menores = nodo;
+    } else {
+        separarArbol(nodo->izquierdo, inicio, menores, &nodo->izquierdo);
+        actualizarNodo(nodo);
+        *mayores = nodo;
+    }
+}
+
+// Función que une dos subárboles en los que todos los nodos de menores empiezan antes que los de mayores
+static NodoIntervalo *unirArboles(NodoIntervalo *menores, NodoIntervalo *mayores) {
+    if (menores == NULL) {
+        return mayores;
+    }
+    if (mayores == NULL) {
+        return menores;
+    }
+    if (menores->prioridad > mayores->prioridad) {
+        menores->derecho = unirArboles(menores->derecho, mayores);
+        actualizarNodo(menores);
+        return menores;
+    }
+    mayores->izquierdo = unirArboles(menores, mayores->izquierdo);
+    actualizarNodo(mayores);
+    return mayores;
+}
+
+static void liberarNodo(NodoIntervalo *nodo) {
+    free(nodo->sucursal);
+    free(nodo->operacion);
+    free(nodo);
+}
+
+static void liberarArbol(NodoIntervalo *nodo) {
+    if (nodo != NULL) {
+        liberarArbol(nodo->izquierdo);
+        liberarArbol(nodo->derecho);
+        liberarNodo(nodo);
+    }
+}
+
+// Función que crea un índice vacío
+IndiceIntervalos *crearIndiceIntervalos(uint32_t semilla) {
+    IndiceIntervalos *indice = malloc(sizeof(IndiceIntervalos));
+    indice->raiz = NULL;
+    indice->num_intervalos = 0;
+    indice->semilla = semilla != 0 ? semilla : 2463534242u;
+    return indice;
+}
+
+void destruirIndiceIntervalos(IndiceIntervalos *indice) {
+    if (indice == NULL) {
+        return;
+    }
+    liberarArbol(indice->raiz);
+    free(indice);
+}
+
+// Función que copia una cadena (strdup no está disponible con -std=c99)
+static char *copiarCadena(const char *texto) {
+    char *copia = malloc(strlen(texto) + 1);
+    strcpy(copia, texto);
+    return copia;
+}
+
+// Función que añade el intervalo [inicio, fin) de una operación de una sucursal
+void insertarIntervalo(IndiceIntervalos *indice, long long inicio, long long fin, const char *sucursal, const char *operacion) {
+    NodoIntervalo *nodo = malloc(sizeof(NodoIntervalo));
+    nodo->inicio = inicio;
+    nodo->fin = fin;
+    nodo->prioridad = siguientePrioridad(indice);
+    nodo->sucursal = copiarCadena(sucursal);
+    nodo->operacion = copiarCadena(operacion);
+    nodo->izquierdo = NULL;
+    nodo->derecho = NULL;
+    actualizarNodo(nodo);
+
+    NodoIntervalo *menores, *mayores;
+    separarArbol(indice->raiz, inicio, &menores, &mayores);
+    indice->raiz = unirArboles(unirArboles(menores, nodo), mayores);
+    indice->num_intervalos++;
+}
+
+static int buscarSolapesNodo(const NodoIntervalo *nodo, long long inicio, long long fin, VisitarIntervalo visitar, void *contexto) {
+    if (nodo == NULL || nodo->fin_maximo <= inicio) {
+        return 0;
+    }
+    int solapes = buscarSolapesNodo(nodo->izquierdo, inicio, fin, visitar, contexto);
+    if (nodo->inicio < fin) {
+        if (nodo->fin > inicio) {
+            visitar(nodo, contexto);
+            solapes++;
+        }
+        solapes += buscarSolapesNodo(nodo->derecho, inicio, fin, visitar, contexto);
+    }
+    return solapes;
+}
+
+// Función que llama a visitar con cada intervalo que se solapa con [inicio, fin), en orden de inicio
+// Devuelve el número de intervalos visitados
+int buscarSolapesIntervalo(const IndiceIntervalos *indice, long long inicio, long long fin, VisitarIntervalo visitar, void *contexto) {
+    return buscarSolapesNodo(indice->raiz, inicio, fin, visitar, contexto);
+}
+
+static NodoIntervalo *eliminarTerminadosNodo(NodoIntervalo *nodo, long long limite, int *eliminados) {
+    if (nodo == NULL || nodo->fin_minimo >= limite) {
+        return nodo;
+    }
+    nodo->izquierdo = eliminarTerminadosNodo(nodo->izquierdo, limite, eliminados);
+    nodo->derecho = eliminarTerminadosNodo(nodo->derecho, limite, eliminados);
+    if (nodo->fin < limite) {
+        NodoIntervalo *resto = unirArboles(nodo->izquierdo, nodo->derecho);
+        liberarNodo(nodo);
+        (*eliminados)++;
+        return resto;
+    }
+    actualizarNodo(nodo);
+    return nodo;
+}
+
+// Función que elimina los intervalos que terminan antes de limite
+// Devuelve el número de intervalos eliminados
+int eliminarIntervalosTerminados(IndiceIntervalos *indice, long long limite) {
+    int eliminados = 0;
+    indice->raiz = eliminarTerminadosNodo(indice->raiz, limite, &eliminados);
+    indice->num_intervalos -= eliminados;
+    return eliminados;
+}
+
+#pragma endregion IndiceIntervalos
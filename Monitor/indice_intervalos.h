@@ -0,0 +1,45 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <stdint.h>         // Tipos enteros de tamaño fijo
+#pragma endregion Librerias
+
+
+// Intervalo [inicio, fin) de una operación guardado en el índice
+typedef struct NODO_INTERVALO {
+    long long inicio;               // Segundos desde 01/01/1970
+    long long fin;
+    long long fin_maximo;           // Mayor y menor fin del subárbol
+    long long fin_minimo;
+    uint32_t prioridad;             // Prioridad aleatoria del treap
+    char *sucursal;
+    char *operacion;
+    struct NODO_INTERVALO *izquierdo;
+    struct NODO_INTERVALO *derecho;
+} NodoIntervalo;
+
+// Índice de intervalos: treap ordenado por inicio y aumentado con el mayor y el menor fin de cada subárbol
+typedef struct INDICE_INTERVALOS {
+    NodoIntervalo *raiz;
+    int num_intervalos;
+    uint32_t semilla;               // Estado del generador de prioridades
+} IndiceIntervalos;
+
+// Función a la que se llama con cada intervalo que se solapa con el buscado
+typedef void (*VisitarIntervalo)(const NodoIntervalo *intervalo, void *contexto);
+
+IndiceIntervalos *crearIndiceIntervalos(uint32_t semilla);
+
+void destruirIndiceIntervalos(IndiceIntervalos *indice);
+
+void insertarIntervalo(IndiceIntervalos *indice, long long inicio, long long fin, const char *sucursal, const char *operacion);
+
+int buscarSolapesIntervalo(const IndiceIntervalos *indice, long long inicio, long long fin, VisitarIntervalo visitar, void *contexto);
+
+int eliminarIntervalosTerminados(IndiceIntervalos *indice, long long limite);
@@ -17,9 +17,15 @@
 #include <dirent.h>         // Definiciones y estructuras necesarias para trabajar con directorios en Linux
 #include <linux/limits.h>   // Define varias constantes que representan los límites del sistema en sistemas operativos Linux
 #include <fcntl.h>          // Proporciona funciones y constantes para controlar archivos y descriptores de archivo en Linux
+#include <signal.h>         // Máscara de señales del hilo escritor de log
+#include <stdint.h>         // Enteros de tamaño fijo del log binario
+
+#include "formato_log_binario.h"    // Formato en disco del log binario
+#include "rotacion_log.h"           // Rotación de los ficheros de log
 
 #define ARCHIVO_LOG "file_log.log"
 #define ARCHIVO_LOG_APP "logfile_app.log"
+#define ARCHIVO_LOG_BIN "logfile_app.bin"
 
 
 
@@ -32,4 +38,96 @@ typedef enum LOG_LEVEL_TYPE {
     LOG_ERROR
 } NivelLog;
 
-void escribirEnLog(NivelLog nivelLog, const char *modulo, const char *formato, ...);
+// Nivel mínimo de los mensajes que se compilan (los de LOG_GENERAL siempre se compilan)
+// Se puede cambiar al compilar, p.ej. make LOG_MIN_LEVEL=LOG_WARNING elimina los mensajes DEBUG e INFO
+#ifndef NIVEL_LOG_COMPILADO
+#define NIVEL_LOG_COMPILADO LOG_DEBUG
+#endif
+
+// Valor de nivel_log_solicitado hasta que se lee LOG_LEVEL del fichero de configuración
+#define NIVEL_LOG_POR_LEER -1
+
+// Nivel de log solicitado en LOG_LEVEL, leído una vez y cambiado al recargar la configuración (se accede con __atomic)
+extern int nivel_log_solicitado;
+
+int leerNivelLog();
+
+// Parámetros de configuración del proceso (ver parametros_configuracion.h)
+struct PARAMETROS_CONFIGURACION;
+
+void aplicarParametrosLog(const struct PARAMETROS_CONFIGURACION *parametros);
+
+// Función que indica si hay que escribir un mensaje del nivel indicado según el nivel solicitado
+// Los mensajes LOG_GENERAL siempre se escriben. Con LOG_LEVEL=GENERAL sólo se escriben éstos
+static inline int nivelLogHabilitado(NivelLog nivelLog) {
+    int solicitado = __atomic_load_n(&nivel_log_solicitado, __ATOMIC_RELAXED);
+    if (solicitado == NIVEL_LOG_POR_LEER) {
+        solicitado = leerNivelLog();
+    }
+    return nivelLog == LOG_GENERAL || (solicitado != LOG_GENERAL && (int)nivelLog >= solicitado);
+}
+
+void escribirMensajeLog(NivelLog nivelLog, int formato_constante, const char *modulo, const char *formato, ...);
+
+// Primer argumento de una lista variable (el formato de escribirEnLog)
+#define PRIMER_ARGUMENTO_LOG(...) PRIMER_ARGUMENTO_LOG_(__VA_ARGS__, sobrante)
+#define PRIMER_ARGUMENTO_LOG_(primero, ...) primero
+
+/*
+    Escritura en el log (ver escribirMensajeLog)
+    Es una macro para que los mensajes que no se van a escribir no evalúen sus argumentos: los niveles
+    por debajo de NIVEL_LOG_COMPILADO desaparecen al compilar y el resto sólo consulta nivel_log_solicitado.
+    También indica si el formato y el módulo son literales, que es lo que permite identificarlos por su
+    dirección en el log binario
+*/
+#define escribirEnLog(nivelLog, modulo, ...) \
+    do { \
+        if (((nivelLog) == LOG_GENERAL || (nivelLog) >= NIVEL_LOG_COMPILADO) && nivelLogHabilitado(nivelLog)) { \
+            escribirMensajeLog((nivelLog), __builtin_constant_p(PRIMER_ARGUMENTO_LOG(__VA_ARGS__)) && __builtin_constant_p(modulo), \
+                (modulo), __VA_ARGS__); \
+        } \
+    } while (0)
+
+/*
+    Filtro de los mensajes de detalle (escribirEnLogDetalle), leído junto con LOG_LEVEL
+        LOG_DEBUG_FILTER_USER, LOG_DEBUG_FILTER_BRANCH: sólo se escriben los mensajes de ese usuario o sucursal
+        LOG_SAMPLE_EVERY: se escribe 1 de cada N mensajes de cada punto de llamada
+        LOG_RATE_LIMIT_PER_SECOND: máximo de mensajes por segundo de cada punto de llamada
+    Cada recarga publica un filtro nuevo y el anterior se retira con retirar_configuracion, igual que los
+    parámetros: los hilos que escriben mensajes de detalle son lectores de la configuración (los de lectura
+    paralela terminan dentro de la ronda de su hilo de patrón)
+*/
+typedef struct FILTRO_LOG_DETALLE {
+    char usuario[64];           // Vacío: todos los usuarios
+    char sucursal[64];          // Vacía: todas las sucursales
+    int muestreo;               // 0 o 1: todos los mensajes
+    int limite_por_segundo;     // 0: sin límite
+} FiltroLogDetalle;
+
+// Estado de un punto de llamada de escribirEnLogDetalle (se accede con __atomic)
+typedef struct CONTROL_LOG_DETALLE {
+    unsigned long llamadas;     // Mensajes que han pasado el filtro, para el muestreo
+    long long segundo;          // Segundo en el que se cuentan los mensajes escritos
+    int escritos;               // Mensajes escritos en ese segundo
+    unsigned long suprimidos;   // Mensajes suprimidos por el límite desde el último aviso
+} ControlLogDetalle;
+
+int admitirLogDetalle(ControlLogDetalle *control, NivelLog nivelLog, const char *modulo, const char *usuario, const char *sucursal);
+
+/*
+    Escritura en el log de los mensajes que se generan por cada registro o clave
+    Igual que escribirEnLog, pero cada punto de llamada tiene su ControlLogDetalle y antes de evaluar los
+    argumentos se aplican el filtro de usuario y sucursal, el muestreo y el límite por segundo.
+    usuario y sucursal pueden ser NULL si el mensaje no los tiene (no pasa el filtro correspondiente)
+*/
+#define escribirEnLogDetalle(nivelLog, modulo, usuario, sucursal, ...) \
+    do { \
+        static ControlLogDetalle control_log_detalle; \
+        if (((nivelLog) == LOG_GENERAL || (nivelLog) >= NIVEL_LOG_COMPILADO) && nivelLogHabilitado(nivelLog) \
+            && admitirLogDetalle(&control_log_detalle, (nivelLog), (modulo), (usuario), (sucursal))) { \
+            escribirMensajeLog((nivelLog), __builtin_constant_p(PRIMER_ARGUMENTO_LOG(__VA_ARGS__)) && __builtin_constant_p(modulo), \
+                (modulo), __VA_ARGS__); \
+        } \
+    } while (0)
+
+void finalizarLog();
@@ -0,0 +1,29 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdint.h>         // Enteros de tamaño fijo para la memoria compartida
+#pragma endregion Librerias
+
+/*
+    Marca de confirmación del consolidado (SNAPSHOT_READS=1)
+    Este fichero tiene que ser igual en FileProcessor y Monitor
+
+    FileProcessor sólo añade datos al final del consolidado, de la memoria compartida y del almacén columnar.
+    Después de cada fichero de sucursal publica en la memoria compartida COMMIT_WATERMARK_NAME hasta dónde
+    están completos los datos de cada uno. Monitor lee sin semáforo hasta la marca: lo que hay antes está
+    terminado y lo que FileProcessor siga añadiendo detrás no se ve hasta la siguiente marca.
+
+    La marca se protege con un contador de secuencia: FileProcessor lo pone impar mientras escribe y par
+    al terminar, y el lector repite la lectura si el contador ha cambiado o era impar.
+*/
+
+typedef struct MARCA_CONFIRMACION {
+    uint64_t secuencia;         // Impar mientras FileProcessor está escribiendo la marca
+    int64_t bytes_fichero;      // Bytes completos del fichero consolidado
+    int64_t bytes_memoria;      // Bytes completos de la memoria compartida
+    int64_t bytes_columnar;     // Bytes completos del almacén columnar
+    uint64_t publicaciones;     // Número de veces que se ha publicado la marca
+} MarcaConfirmacion;
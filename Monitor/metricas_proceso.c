@@ -0,0 +1,148 @@
+// ------------------------------------------------------------------
+// MÉTRICAS DEL PROCESO EN MEMORIA COMPARTIDA
+// ------------------------------------------------------------------
+
+// ftruncate no se declara con -std=c99 sin esta macro
+#define _DEFAULT_SOURCE
+
+#include "metricas_proceso.h"
+#include "log_files.h"
+
+#include <stdlib.h>         // EXIT_SUCCESS
+#include <string.h>         // strncpy, strcmp
+#include <pthread.h>        // Mutex del registro de series
+#include <time.h>           // time
+#include <unistd.h>         // getpid, ftruncate, close
+#include <fcntl.h>          // O_CREAT, O_RDWR
+#include <sys/mman.h>       // shm_open, mmap
+#include <sys/stat.h>       // umask
+
+#pragma region MetricasProceso
+/*
+    Página de métricas del proceso (formato en metricas_compartidas.h) para consultarla con fpstat.
+    Los hilos obtienen su serie una vez y después sólo hacen sumas atómicas relajadas sobre ella:
+    no hay bloqueos, ni llamadas al sistema, ni escritura en el log en el camino de los datos.
+    Si SHARED_METRICS no vale 1 no hay página, obtenerSerieMetricas devuelve NULL y el resto de
+    funciones no hacen nada con una serie NULL.
+*/
+
+// Página del proceso (NULL si no hay métricas compartidas) y nombre del objeto de memoria compartida
+static PaginaMetricas *pagina_metricas = NULL;
+static char nombre_pagina_metricas[LONGITUD_NOMBRE_METRICA * 2];
+// Sólo se usa para dar de alta series nuevas
+static pthread_mutex_t mutex_series_metricas = PTHREAD_MUTEX_INITIALIZER;
+
+// Función que crea la página de métricas del proceso con los contadores e histogramas de "definicion"
+// Devuelve EXIT_SUCCESS o -1 si no se ha podido crear (el proceso sigue sin métricas compartidas)
+int iniciarMetricasCompartidas(const char *nombre, const DefinicionMetricas *definicion) {
+    // Cambiamos el umask para que se asignen correctamente los permisos de grupo (fpstat lo puede ejecutar otro usuario del grupo)
+    mode_t old_umask = umask(0);
+    int fd = shm_open(nombre, O_CREAT | O_RDWR, 0660);
+    umask(old_umask);
+    if (fd == -1) {
+        escribirEnLog(LOG_ERROR, "metricas_proceso", "Error al crear la página de métricas %s\n", nombre);
+        return -1;
+    }
+    // Empezar siempre con la página a cero, aunque quedara una de una ejecución anterior
+    if (ftruncate(fd, 0) == -1 || ftruncate(fd, sizeof(PaginaMetricas)) == -1) {
+        escribirEnLog(LOG_ERROR, "metricas_proceso", "Error al establecer el tamaño de la página de métricas %s\n", nombre);
+        close(fd);
+        return -1;
+    }
+    PaginaMetricas *pagina = mmap(0, sizeof(PaginaMetricas), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pagina == MAP_FAILED) {
+        escribirEnLog(LOG_ERROR, "metricas_proceso", "Error al mapear la página de métricas %s\n", nombre);
+        return -1;
+    }
+
+    pagina->tamano_serie = sizeof(SerieMetricas);
+    pagina->pid = getpid();
+    pagina->inicio_s = time(NULL);
+    strncpy(pagina->proceso, definicion->proceso, LONGITUD_NOMBRE_METRICA - 1);
+    pagina->num_contadores = definicion->num_contadores;
+    pagina->num_histogramas = definicion->num_histogramas;
+    for (int i = 0; i < definicion->num_contadores; i++) {
+        pagina->tipos_contadores[i] = (uint8_t)definicion->tipos_contadores[i];
+        strncpy(pagina->nombres_contadores[i], definicion->nombres_contadores[i], LONGITUD_NOMBRE_METRICA - 1);
+    }
+    for (int i = 0; i < definicion->num_histogramas; i++) {
+        strncpy(pagina->nombres_histogramas[i], definicion->nombres_histogramas[i], LONGITUD_NOMBRE_METRICA - 1);
+    }
+    // La magia se escribe la última: fpstat no lee la página hasta que la cabecera está completa
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(pagina->magia, MAGIA_METRICAS, LONGITUD_MAGIA_METRICAS);
+
+    snprintf(nombre_pagina_metricas, sizeof(nombre_pagina_metricas), "%s", nombre);
+    __atomic_store_n(&pagina_metricas, pagina, __ATOMIC_RELEASE);
+    escribirEnLog(LOG_INFO, "metricas_proceso", "Página de métricas %s creada (%zu bytes)\n", nombre, sizeof(PaginaMetricas));
+    return EXIT_SUCCESS;
+}
+
+// Función que elimina la página de métricas al terminar el proceso
+// La proyección se mantiene para que los hilos que siguen en marcha no fallen al sumar
+void terminarMetricasCompartidas() {
+    if (__atomic_load_n(&pagina_metricas, __ATOMIC_ACQUIRE) != NULL) {
+        shm_unlink(nombre_pagina_metricas);
+    }
+}
+
+// Función que devuelve la serie con ese nombre, dándola de alta si no existe (un hilo que vuelve a
+// arrancar sigue con sus contadores). Devuelve NULL si no hay métricas compartidas o no caben más series
+SerieMetricas *obtenerSerieMetricas(const char *nombre) {
+    PaginaMetricas *pagina = __atomic_load_n(&pagina_metricas, __ATOMIC_ACQUIRE);
+    if (pagina == NULL) {
+        return NULL;
+    }
+    SerieMetricas *serie = NULL;
+    pthread_mutex_lock(&mutex_series_metricas);
+    uint32_t num_series = pagina->num_series;
+    for (uint32_t i = 0; i < num_series && serie == NULL; i++) {
+        if (strcmp(pagina->series[i].nombre, nombre) == 0) {
+            serie = &pagina->series[i];
+        }
+    }
+    if (serie == NULL && num_series < MAX_SERIES_METRICAS) {
+        serie = &pagina->series[num_series];
+        strncpy(serie->nombre, nombre, LONGITUD_NOMBRE_METRICA - 1);
+        // Publicar la serie después de escribir su nombre
+        __atomic_store_n(&pagina->num_series, num_series + 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&mutex_series_metricas);
+    if (serie == NULL) {
+        escribirEnLog(LOG_WARNING, "metricas_proceso", "No caben más de %d series en la página de métricas, %s no se publica\n", MAX_SERIES_METRICAS, nombre);
+    }
+    return serie;
+}
+
+// Función que suma un valor a un contador acumulado de la serie
+void sumarMetrica(SerieMetricas *serie, int contador, uint64_t valor) {
+    if (serie != NULL) {
+        __atomic_fetch_add(&serie->contadores[contador], valor, __ATOMIC_RELAXED);
+    }
+}
+
+// Función que pone el último valor de un contador de tipo CONTADOR_VALOR
+void fijarMetrica(SerieMetricas *serie, int contador, uint64_t valor) {
+    if (serie != NULL) {
+        __atomic_store_n(&serie->contadores[contador], valor, __ATOMIC_RELAXED);
+    }
+}
+
+// Función que añade una duración a un histograma (sumas atómicas relajadas, sin bloqueos)
+void registrarDuracionHistograma(HistogramaMetricas *histograma, long long nanosegundos) {
+    uint64_t duracion = nanosegundos > 0 ? (uint64_t)nanosegundos : 0;
+    __atomic_fetch_add(&histograma->cubos[cuboMetricas(duracion)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histograma->suma_ns, duracion, __ATOMIC_RELAXED);
+    uint64_t maximo = __atomic_load_n(&histograma->maximo_ns, __ATOMIC_RELAXED);
+    while (duracion > maximo && !__atomic_compare_exchange_n(&histograma->maximo_ns, &maximo, duracion, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Función que añade una duración al histograma de la serie
+void registrarDuracionMetrica(SerieMetricas *serie, int histograma, long long nanosegundos) {
+    if (serie != NULL) {
+        registrarDuracionHistograma(&serie->histogramas[histograma], nanosegundos);
+    }
+}
+#pragma endregion MetricasProceso
@@ -0,0 +1,214 @@
+// ------------------------------------------------------------------
+// PARÁMETROS DE CONFIGURACIÓN CON TIPO
+// ------------------------------------------------------------------
+
+#include "parametros_configuracion.h"
+#include "log_files.h"
+#include "metricas_compartidas.h"
+
+#include <limits.h>         // INT_MAX, LLONG_MAX
+
+#pragma region ParametrosConfiguracion
+/*
+    mo.conf se lee al arrancar (y al recargar) y se convierte en una estructura ParametrosConfiguracion: los enteros y
+    booleanos ya están convertidos y validados, y el código lee los campos directamente en lugar de buscar
+    la clave y convertir el valor en cada llamada.
+    Al leerlo se avisa en el log de las claves desconocidas y de los valores no válidos.
+
+    Los parámetros del log (LOG_*) los lee log_files.c de la lectura inicial (obtenerParametrosIniciales), sin
+    registrar como lector a cada hilo que escribe en el log; el nivel y el filtro se le pasan al recargar, y los de
+    los patrones (PATRON_n_*) los lee cargarParametrosPatrones, que también se usa al recargar con SIGHUP
+*/
+
+#define ENTERO(clave, defecto, campo, minimo, maximo) \
+    {clave, PARAMETRO_ENTERO, defecto, offsetof(ParametrosConfiguracion, campo), minimo, maximo, NULL}
+#define BOOLEANO(clave, defecto, campo) \
+    {clave, PARAMETRO_BOOLEANO, defecto, offsetof(ParametrosConfiguracion, campo), 0, 0, NULL}
+#define CADENA(clave, defecto, campo, opciones) \
+    {clave, PARAMETRO_CADENA, defecto, offsetof(ParametrosConfiguracion, campo), 0, 0, opciones}
+#define TAMANO(clave, defecto, campo, minimo, maximo) \
+    {clave, PARAMETRO_TAMANO, defecto, offsetof(ParametrosConfiguracion, campo), minimo, maximo, NULL}
+#define ENTERO_SIN_CAMPO(clave, defecto, minimo, maximo) \
+    {clave, PARAMETRO_ENTERO, defecto, SIN_CAMPO, minimo, maximo, NULL}
+#define BOOLEANO_SIN_CAMPO(clave, defecto) \
+    {clave, PARAMETRO_BOOLEANO, defecto, SIN_CAMPO, 0, 0, NULL}
+
+static const DefinicionParametro definiciones_parametros[] = {
+    ENTERO_SIN_CAMPO("NUM_PROCESOS", "5", 1, 999),      // No se usa en Monitor
+    ENTERO("SIMULATE_SLEEP_MIN", "1", retardo_minimo, 0, 3600),
+    ENTERO("SIMULATE_SLEEP_MAX", "2", retardo_maximo, 0, 3600),
+    CADENA("PATH_FILES", "../datos", carpeta_datos, NULL),
+    CADENA("INVENTORY_FILE", "file.csv", fichero_consolidado, NULL),
+    CADENA("RESULTS_FILE", "resultado_patron_", fichero_resultado, NULL),
+    CADENA("RULES_FILE", "conf/reglas.conf", fichero_reglas, NULL),
+    BOOLEANO_SIN_CAMPO("MONITOR_ACTIVO", "SI"),         // No se usa en Monitor
+    CADENA("PIPE_NAME", "/tmp/pipeAudita", nombre_pipe, NULL),
+    ENTERO("DEBOUNCE_MAX_DELAY_MS", "200", retardo_maximo_agrupacion_ms, 0, INT_MAX),
+    ENTERO("DEBOUNCE_MAX_BATCH", "50", max_lote_agrupacion, 1, INT_MAX),
+    ENTERO("METRICS_INTERVAL_MS", "0", intervalo_metricas_ms, 0, INT_MAX),
+    CADENA("SEMAPHORE_NAME", "/semaforo", nombre_semaforo, NULL),
+    BOOLEANO("SNAPSHOT_READS", "0", lectura_instantanea),
+    CADENA("COMMIT_WATERMARK_NAME", "/marca_confirmacion", nombre_marca_confirmacion, NULL),
+    BOOLEANO("USE_SHARED_MEMORY", "0", usar_memoria_compartida),
+    ENTERO_SIN_CAMPO("SHARED_MEMORY_INITIAL_SIZE", "1024", 1, INT_MAX),   // Monitor proyecta el tamaño real
+    CADENA("SHARED_MEMORY_NAME", "/my_shared_memory", nombre_memoria_compartida, NULL),
+    BOOLEANO("SHARED_METRICS", "0", metricas_compartidas),
+    CADENA("SHARED_METRICS_NAME", NOMBRE_METRICAS_MONITOR, nombre_metricas_compartidas, NULL),
+    BOOLEANO("LOCK_PROFILING", "0", perfil_bloqueos),
+    CADENA("LOCK_PROFILING_FILE", "logs/MonitorBloqueos.log", fichero_perfil_bloqueos, NULL),
+    {"PATRON_", PARAMETRO_PREFIJO, NULL, SIN_CAMPO, 0, 0, NULL},            // Los lee cargarParametrosPatrones
+    BOOLEANO("APPROXIMATE_COUNTING", "0", conteo_aproximado),
+    TAMANO("APPROXIMATE_MEMORY_BYTES", "1048576", memoria_aproximada, 1, LLONG_MAX),
+    ENTERO("APPROXIMATE_DEPTH", "4", profundidad_aproximada, 1, 64),
+    TAMANO("SPILL_MEMORY_BYTES", "0", memoria_volcado, 0, LLONG_MAX),
+    CADENA("SPILL_DIRECTORY", "/tmp", carpeta_volcado, NULL),
+    ENTERO("SPILL_PARTITIONS", "8", particiones_volcado, 1, 1024),
+    ENTERO("SCAN_THREADS", "4", hilos_lectura, 0, 256),
+    TAMANO("SCAN_CHUNK_BYTES", "4194304", bytes_tramo_lectura, 0, LLONG_MAX),
+    TAMANO("SCAN_PARALLEL_MIN_BYTES", "8388608", minimo_lectura_paralela, 0, LLONG_MAX),
+    BOOLEANO("COLUMNAR_STORE", "0", almacen_columnar),
+    CADENA("COLUMNAR_FILE", "consolidado.col", fichero_columnar, NULL),
+    BOOLEANO("PARTIAL_AGGREGATES", "0", agregados_parciales),
+    CADENA("PARTIAL_FILE", "agregados_parciales.csv", fichero_agregados, NULL),
+    BOOLEANO("BATCH_SUMMARIES", "0", resumenes_lotes),
+    CADENA("SUMMARY_FILE", "resumenes_lotes.csv", fichero_resumenes, NULL),
+    BOOLEANO("CONCURRENT_ACTIVITY", "0", actividad_simultanea),
+    TAMANO("CONCURRENT_RETENTION_SECONDS", "604800", retencion_actividad, 1, LLONG_MAX),
+    CADENA("CONCURRENT_RESULTS_FILE", "resultado_actividad_simultanea.csv", fichero_actividad, NULL),
+    BOOLEANO("TOPK_REPORT", "0", informe_top),
+    ENTERO("TOPK_SIZE", "100", tamano_top, 1, INT_MAX),
+    CADENA("TOPK_WINDOWS", "3600,86400", ventanas_top, NULL),
+    ENTERO("TOPK_BUCKETS", "12", cubos_top, 1, INT_MAX),
+    CADENA("TOPK_REPORT_FILE", "informe_top_usuarios.csv", fichero_informe_top, NULL),
+
+    CADENA("LOG_LEVEL", "INFO", nivel_log, "GENERAL|DEBUG|INFO|WARNING|ERROR"),
+    CADENA("LOG_DEBUG_FILTER_USER", "", filtro_log_usuario, NULL),
+    CADENA("LOG_DEBUG_FILTER_BRANCH", "", filtro_log_sucursal, NULL),
+    ENTERO("LOG_SAMPLE_EVERY", "1", muestreo_log, 0, INT_MAX),
+    ENTERO("LOG_RATE_LIMIT_PER_SECOND", "0", limite_log_por_segundo, 0, INT_MAX),
+    CADENA("LOG_FILE", ARCHIVO_LOG, fichero_log, NULL),
+    CADENA("LOG_FILE_APP", ARCHIVO_LOG_APP, fichero_log_aplicacion, NULL),
+    ENTERO("LOG_ASYNC", "0", log_asincrono, 0, 1),
+    ENTERO("LOG_ASYNC_BUFFER", "1024", capacidad_log_asincrono, 1, 1048576),
+    CADENA("LOG_ASYNC_FULL_POLICY", "DESCARTAR", politica_log_lleno, "DESCARTAR|BLOQUEAR"),
+    CADENA("LOG_FORMAT", "TEXTO", formato_log, "TEXTO|BINARIO"),
+    CADENA("LOG_FILE_BIN", ARCHIVO_LOG_BIN, fichero_log_binario, NULL),
+    ENTERO("LOG_ROTATE_SIZE_MB", "0", rotacion_log_mb, 0, 1048576),
+    ENTERO("LOG_ROTATE_INTERVAL_SECONDS", "0", rotacion_log_segundos, 0, INT_MAX),
+    ENTERO("LOG_ROTATE_KEEP", "5", rotacion_log_conservar, 0, 1000),
+    ENTERO("LOG_ROTATE_PREALLOCATE", "1", rotacion_log_preasignar, 0, 1),
+    ENTERO("LOG_ROTATE_COMPRESS", "0", rotacion_log_comprimir, 0, 1),
+};
+
+#define NUM_DEFINICIONES_PARAMETROS ((int)(sizeof(definiciones_parametros) / sizeof(definiciones_parametros[0])))
+
+/*
+    Recarga con SIGHUP: se lee mo.conf en una estructura nueva que sustituye a la actual de forma atómica;
+    los hilos siguen leyendo sin bloqueos y la anterior se libera cuando ya no la usa nadie
+    (ver LectoresConfiguracion en config_files.c).
+    Sólo se aplican en caliente los parámetros de PARAMETROS_RECARGABLES; el resto se avisa en el log y se
+    mantiene el valor con el que arrancó el proceso
+*/
+#define PARAMETROS_RECARGABLES "NUM_PROCESOS|MONITOR_ACTIVO|SHARED_MEMORY_INITIAL_SIZE|SIMULATE_SLEEP_MIN|SIMULATE_SLEEP_MAX|RULES_FILE|" \
+    "DEBOUNCE_MAX_DELAY_MS|DEBOUNCE_MAX_BATCH|METRICS_INTERVAL_MS|SCAN_THREADS|SCAN_CHUNK_BYTES|SCAN_PARALLEL_MIN_BYTES|" \
+    "CONCURRENT_ACTIVITY|LOG_LEVEL|LOG_DEBUG_FILTER_USER|LOG_DEBUG_FILTER_BRANCH|LOG_SAMPLE_EVERY|LOG_RATE_LIMIT_PER_SECOND"
+
+// Parámetros de la lectura inicial (no se liberan nunca) y parámetros en vigor
+static ParametrosConfiguracion parametros_iniciales;
+static ParametrosConfiguracion *parametros_actuales = NULL;
+static pthread_once_t parametros_leidos = PTHREAD_ONCE_INIT;
+// El hilo que hace la lectura inicial: sus mensajes de log no pueden esperar a que termine
+static __thread int lectura_inicial_en_curso = 0;
+// Sólo se recarga desde un hilo a la vez
+static pthread_mutex_t mutex_recarga_parametros = PTHREAD_MUTEX_INITIALIZER;
+
+// Función que lee mo.conf y lo convierte en "parametros"
+// Devuelve el número de errores o -1 si no se ha podido abrir el fichero
+static int leerParametros(ParametrosConfiguracion *parametros) {
+    parametros->num_entradas = leer_entradas_configuracion(FICHERO_CONFIGURACION, parametros->entradas, MAX_ENTRADAS_CONFIG);
+    if (parametros->num_entradas == -1) {
+        return -1;
+    }
+    int errores = cargar_parametros_configuracion(parametros->entradas, parametros->num_entradas,
+        definiciones_parametros, NUM_DEFINICIONES_PARAMETROS, parametros);
+    if (parametros->retardo_maximo < parametros->retardo_minimo) {
+        escribirEnLog(LOG_WARNING, "parametros_configuracion", "SIMULATE_SLEEP_MAX=%d menor que SIMULATE_SLEEP_MIN=%d, se utiliza %d\n",
+            parametros->retardo_maximo, parametros->retardo_minimo, parametros->retardo_minimo);
+        parametros->retardo_maximo = parametros->retardo_minimo;
+        errores++;
+    }
+    if (errores > 0) {
+        escribirEnLog(LOG_WARNING, "parametros_configuracion", "%d errores en %s\n", errores, FICHERO_CONFIGURACION);
+    }
+    return errores;
+}
+
+// Función que hace la lectura inicial de mo.conf
+static void leerParametrosIniciales() {
+    lectura_inicial_en_curso = 1;
+    int errores = leerParametros(&parametros_iniciales);
+    lectura_inicial_en_curso = 0;
+    if (errores == -1) {
+        perror("Error al abrir el archivo de configuración");
+        exit(1);
+    }
+    __atomic_store_n(&parametros_actuales, &parametros_iniciales, __ATOMIC_RELEASE);
+}
+
+// Función que devuelve los parámetros de configuración en vigor (la primera vez lee el fichero)
+// El hilo no debe guardar el puntero más allá de su próximo estado_quiescente_configuracion
+const ParametrosConfiguracion *obtenerParametros() {
+    registrar_lector_configuracion();
+    ParametrosConfiguracion *parametros = __atomic_load_n(&parametros_actuales, __ATOMIC_ACQUIRE);
+    if (parametros == NULL) {
+        pthread_once(&parametros_leidos, leerParametrosIniciales);
+        parametros = __atomic_load_n(&parametros_actuales, __ATOMIC_ACQUIRE);
+    }
+    return parametros;
+}
+
+// Función que devuelve los parámetros de la lectura inicial (la primera vez lee el fichero)
+// No se liberan nunca, así que el hilo no tiene que registrarse como lector; los que no son recargables
+// tienen siempre el valor inicial
+const ParametrosConfiguracion *obtenerParametrosIniciales() {
+    pthread_once(&parametros_leidos, leerParametrosIniciales);
+    return &parametros_iniciales;
+}
+
+// Función que indica si el hilo está haciendo la lectura inicial del fichero (escribe en el log los errores
+// que encuentra antes de que estén leídos los parámetros del log)
+int leyendoParametrosIniciales() {
+    return lectura_inicial_en_curso;
+}
+
+// Función que vuelve a leer mo.conf y publica los parámetros nuevos (también el nivel y el filtro del log)
+// Devuelve EXIT_SUCCESS o -1 si no se ha podido leer (siguen en vigor los anteriores)
+int recargarParametros() {
+    // La lectura inicial tiene que estar hecha para comparar con ella
+    obtenerParametros();
+    ParametrosConfiguracion *nuevos = malloc(sizeof(ParametrosConfiguracion));
+    if (nuevos == NULL) {
+        escribirEnLog(LOG_ERROR, "parametros_configuracion", "Sin memoria para recargar %s\n", FICHERO_CONFIGURACION);
+        return -1;
+    }
+    pthread_mutex_lock(&mutex_recarga_parametros);
+    if (leerParametros(nuevos) == -1) {
+        pthread_mutex_unlock(&mutex_recarga_parametros);
+        escribirEnLog(LOG_ERROR, "parametros_configuracion", "Error al abrir %s, se mantienen los parámetros en vigor\n", FICHERO_CONFIGURACION);
+        free(nuevos);
+        return -1;
+    }
+    conservar_parametros_no_recargables(definiciones_parametros, NUM_DEFINICIONES_PARAMETROS, PARAMETROS_RECARGABLES,
+        parametros_iniciales.entradas, parametros_iniciales.num_entradas, &parametros_iniciales,
+        nuevos->entradas, nuevos->num_entradas, nuevos);
+    escribirEnLog(LOG_INFO, "parametros_configuracion", "Parámetros de %s recargados: DEBOUNCE_MAX_DELAY_MS=%d, DEBOUNCE_MAX_BATCH=%d, SCAN_THREADS=%d\n",
+        FICHERO_CONFIGURACION, nuevos->retardo_maximo_agrupacion_ms, nuevos->max_lote_agrupacion, nuevos->hilos_lectura);
+    ParametrosConfiguracion *retirados = __atomic_exchange_n(&parametros_actuales, nuevos, __ATOMIC_SEQ_CST);
+    aplicarParametrosLog(nuevos);
+    pthread_mutex_unlock(&mutex_recarga_parametros);
+    if (retirados != &parametros_iniciales) {
+        retirar_configuracion(retirados, free);
+    }
+    return EXIT_SUCCESS;
+}
+#pragma endregion ParametrosConfiguracion
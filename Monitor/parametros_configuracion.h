@@ -0,0 +1,107 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <pthread.h>        // Tratamiento de hilos y mutex
+
+#include "config_files.h"   // Lectura del fichero de configuración
+#pragma endregion Librerias
+
+
+// Parámetros de mo.conf ya convertidos y validados (ver parametros_configuracion.c)
+// Las cadenas apuntan a las entradas de la propia estructura (o a las de la lectura inicial en los
+// parámetros que sólo se aplican al reiniciar)
+typedef struct PARAMETROS_CONFIGURACION {
+    struct EntradaConfiguracion entradas[MAX_ENTRADAS_CONFIG];
+    int num_entradas;
+
+    // Retardo simulado
+    int retardo_minimo;                     // SIMULATE_SLEEP_MIN (segundos)
+    int retardo_maximo;                     // SIMULATE_SLEEP_MAX
+
+    // Ficheros de datos y de resultados
+    const char *carpeta_datos;              // PATH_FILES
+    const char *fichero_consolidado;        // INVENTORY_FILE
+    const char *fichero_resultado;          // RESULTS_FILE (raíz del nombre)
+    const char *fichero_reglas;             // RULES_FILE
+
+    // Comunicación con FileProcessor
+    const char *nombre_pipe;                // PIPE_NAME
+    int retardo_maximo_agrupacion_ms;       // DEBOUNCE_MAX_DELAY_MS
+    int max_lote_agrupacion;                // DEBOUNCE_MAX_BATCH
+    int intervalo_metricas_ms;              // METRICS_INTERVAL_MS
+    const char *nombre_semaforo;            // SEMAPHORE_NAME
+    int lectura_instantanea;                // SNAPSHOT_READS
+    const char *nombre_marca_confirmacion;  // COMMIT_WATERMARK_NAME
+    int usar_memoria_compartida;            // USE_SHARED_MEMORY
+    const char *nombre_memoria_compartida;  // SHARED_MEMORY_NAME
+
+    // Métricas en memoria compartida para fpstat
+    int metricas_compartidas;               // SHARED_METRICS
+    const char *nombre_metricas_compartidas; // SHARED_METRICS_NAME
+
+    // Perfil de contención de los bloqueos
+    int perfil_bloqueos;                    // LOCK_PROFILING
+    const char *fichero_perfil_bloqueos;    // LOCK_PROFILING_FILE
+
+    // Modo aproximado y volcado a disco de los patrones
+    int conteo_aproximado;                  // APPROXIMATE_COUNTING
+    long long memoria_aproximada;           // APPROXIMATE_MEMORY_BYTES
+    int profundidad_aproximada;             // APPROXIMATE_DEPTH
+    long long memoria_volcado;              // SPILL_MEMORY_BYTES (0: sin volcado)
+    const char *carpeta_volcado;            // SPILL_DIRECTORY
+    int particiones_volcado;                // SPILL_PARTITIONS
+
+    // Lectura de los datos consolidados
+    int hilos_lectura;                      // SCAN_THREADS
+    long long bytes_tramo_lectura;          // SCAN_CHUNK_BYTES
+    long long minimo_lectura_paralela;      // SCAN_PARALLEL_MIN_BYTES
+    int almacen_columnar;                   // COLUMNAR_STORE
+    const char *fichero_columnar;           // COLUMNAR_FILE
+    int agregados_parciales;                // PARTIAL_AGGREGATES
+    const char *fichero_agregados;          // PARTIAL_FILE
+    int resumenes_lotes;                    // BATCH_SUMMARIES
+    const char *fichero_resumenes;          // SUMMARY_FILE
+
+    // Actividad simultánea e informe de usuarios con más actividad
+    int actividad_simultanea;               // CONCURRENT_ACTIVITY
+    long long retencion_actividad;          // CONCURRENT_RETENTION_SECONDS
+    const char *fichero_actividad;          // CONCURRENT_RESULTS_FILE
+    int informe_top;                        // TOPK_REPORT
+    int tamano_top;                         // TOPK_SIZE
+    const char *ventanas_top;               // TOPK_WINDOWS
+    int cubos_top;                          // TOPK_BUCKETS
+    const char *fichero_informe_top;        // TOPK_REPORT_FILE
+
+    // Ficheros de log (ver log_files.c y rotacion_log.c)
+    const char *nivel_log;                  // LOG_LEVEL
+    const char *filtro_log_usuario;         // LOG_DEBUG_FILTER_USER
+    const char *filtro_log_sucursal;        // LOG_DEBUG_FILTER_BRANCH
+    int muestreo_log;                       // LOG_SAMPLE_EVERY
+    int limite_log_por_segundo;             // LOG_RATE_LIMIT_PER_SECOND
+    const char *fichero_log;                // LOG_FILE
+    const char *fichero_log_aplicacion;     // LOG_FILE_APP
+    int log_asincrono;                      // LOG_ASYNC
+    int capacidad_log_asincrono;            // LOG_ASYNC_BUFFER
+    const char *politica_log_lleno;         // LOG_ASYNC_FULL_POLICY (DESCARTAR/BLOQUEAR)
+    const char *formato_log;                // LOG_FORMAT (TEXTO/BINARIO)
+    const char *fichero_log_binario;        // LOG_FILE_BIN
+    int rotacion_log_mb;                    // LOG_ROTATE_SIZE_MB
+    int rotacion_log_segundos;              // LOG_ROTATE_INTERVAL_SECONDS
+    int rotacion_log_conservar;             // LOG_ROTATE_KEEP
+    int rotacion_log_preasignar;            // LOG_ROTATE_PREALLOCATE
+    int rotacion_log_comprimir;             // LOG_ROTATE_COMPRESS
+} ParametrosConfiguracion;
+
+
+const ParametrosConfiguracion *obtenerParametros();
+
+const ParametrosConfiguracion *obtenerParametrosIniciales();
+
+int leyendoParametrosIniciales();
+
+int recargarParametros();
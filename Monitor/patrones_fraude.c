@@ -0,0 +1,702 @@
+// ------------------------------------------------------------------
+// DEFINICIÓN Y ACUMULACIÓN DE LOS PATRONES DE FRAUDE
+// ------------------------------------------------------------------
+
+#include "patrones_fraude.h"
+#include "log_files.h"
+#include "parametros_configuracion.h"
+
+#include <ctype.h>          // isspace
+
+#pragma region PatronesFraude
+/*
+    Cada patrón agrupa los registros por usuario y ventana de tiempo. Una ventana está formada por
+    PATRON_n_VENTANA cubos de tamaño PATRON_n_GRANULARIDAD y empieza en un múltiplo de su ancho
+    contado desde el 01/01/1970, de forma que con los valores por defecto las ventanas coinciden
+    con las horas, segundos y días que utilizaban los patrones originales.
+
+    El diccionario de cada patrón se mantiene entre rondas y se actualiza con los registros nuevos.
+    Si cambian los parámetros:
+        - activo o umbral: no afectan a lo acumulado, sólo a la evaluación
+        - forma de la ventana a una ventana múltiplo de la anterior: se combinan las ventanas existentes
+        - cualquier otro cambio de forma: se descarta lo acumulado y se vuelven a leer los datos
+
+    Modo aproximado (APPROXIMATE_COUNTING=1, sólo patrones que cuentan registros):
+        - cada registro incrementa la clave USUARIO@ventana en un sketch Count-Min de memoria fija
+          en lugar de crear una entrada en el diccionario
+        - cuando la estimación de una clave supera el umbral, la clave se promueve al diccionario
+        - al final de la ronda se cuentan de forma exacta las claves promovidas volviendo a leer los datos,
+          así que el resultado coincide con el modo exacto para todas las claves que superan el umbral
+        - un cambio de umbral o de ventana descarta el sketch y vuelve a leer los datos
+
+    Volcado a disco (SPILL_MEMORY_BYTES > 0, sólo en modo exacto):
+        - cuando el diccionario llega al número de claves que caben en esa memoria se vuelca a disco
+          y se vacía (ver agregacion_externa.c)
+        - la evaluación recorre mezclados los volcados y la memoria sin reescribirlos, así que
+          ve el mismo valor por clave que si todo estuviera en memoria
+        - un cambio de ventana con volcados en disco vuelve a leer los datos en lugar de combinar
+        - los datos se leen con un único hilo: los diccionarios propios de la lectura paralela no
+          respetarían el límite de memoria
+
+    Agregados parciales (PARTIAL_AGGREGATES=1, sólo en modo exacto):
+        - FileProcessor resume cada fichero de sucursal en un lote con el valor de cada usuario en cubos
+          del ancho de la granularidad por defecto del patrón (ver agregados_parciales.c)
+        - antes de leer los registros nuevos se combinan los lotes que empiezan en la posición del cursor,
+          siempre que el ancho de la ventana sea múltiplo del ancho de los cubos; lo que falte se lee
+          de los datos consolidados
+
+    Resúmenes de lotes (BATCH_SUMMARIES=1):
+        - los patrones 2 y 3 sólo tienen en cuenta registros con importe negativo o con error, así que
+          se saltan los lotes cuyo resumen indica que no tienen ninguno (ver resumenes_lotes.c)
+*/
+
+// Patrón 2: más de 3 retiros a la vez (en el mismo segundo)
+static int filtrarPatron2(const RegistroConsolidado *registro) {
+    return registro->importe < 0;
+}
+
+// Patrón 3: más de 3 operaciones con error en un día
+static int filtrarPatron3(const RegistroConsolidado *registro) {
+    return strcmp(registro->estado, "Error") == 0;
+}
+
+// Lotes que pueden tener registros de los patrones 2 y 3
+static int relevantePatron2(const ResumenLote *resumen) {
+    return resumen->importe_minimo < 0;
+}
+
+static int relevantePatron3(const ResumenLote *resumen) {
+    return resumen->errores > 0;
+}
+
+// Patrones 1, 4 y 5: tienen en cuenta todos los registros
+static int filtrarTodos(const RegistroConsolidado *registro) {
+    (void)registro;
+    return 1;
+}
+
+static void acumularCantidad(RegistroPatron *acumulado, const RegistroConsolidado *registro) {
+    (void)registro;
+    acumulado->cantidad++;
+}
+
+static void acumularImporte(RegistroPatron *acumulado, const RegistroConsolidado *registro) {
+    acumulado->cantidad += registro->importe;
+}
+
+static void acumularTiposOperacion(RegistroPatron *acumulado, const RegistroConsolidado *registro) {
+    if (registro->tipoOperacion2 == 1) {acumulado->operacion1Presente++;}
+    if (registro->tipoOperacion2 == 2) {acumulado->operacion2Presente++;}
+    if (registro->tipoOperacion2 == 3) {acumulado->operacion3Presente++;}
+    if (registro->tipoOperacion2 == 4) {acumulado->operacion4Presente++;}
+}
+
+static void combinarRegistros(RegistroPatron *destino, const RegistroPatron *origen) {
+    destino->cantidad += origen->cantidad;
+    destino->operacion1Presente += origen->operacion1Presente;
+    destino->operacion2Presente += origen->operacion2Presente;
+    destino->operacion3Presente += origen->operacion3Presente;
+    destino->operacion4Presente += origen->operacion4Presente;
+    destino->num_registros += origen->num_registros;
+}
+
+static int cumpleCantidadMayor(const RegistroPatron *acumulado, int umbral) {
+    return acumulado->cantidad > umbral;
+}
+
+static int cumpleTiposOperacion(const RegistroPatron *acumulado, int umbral) {
+    int tipos = (acumulado->operacion1Presente > 0) + (acumulado->operacion2Presente > 0)
+              + (acumulado->operacion3Presente > 0) + (acumulado->operacion4Presente > 0);
+    return tipos >= umbral;
+}
+
+static int cumpleCantidadMenor(const RegistroPatron *acumulado, int umbral) {
+    return acumulado->cantidad < umbral;
+}
+
+static void formatearPatron1(char *mensaje, size_t longitud, const RegistroPatron *acumulado) {
+    snprintf(mensaje, longitud, "01:::Registro fraude patrón 1:::Clave=%s:::Registros en la Misma Hora=%d\n", acumulado->clave, acumulado->cantidad);
+}
+
+static void formatearPatron2(char *mensaje, size_t longitud, const RegistroPatron *acumulado) {
+    snprintf(mensaje, longitud, "02:::Registro fraude patrón 2:::Clave=%s:::Registros a la vez=%d\n", acumulado->clave, acumulado->cantidad);
+}
+
+static void formatearPatron3(char *mensaje, size_t longitud, const RegistroPatron *acumulado) {
+    snprintf(mensaje, longitud, "03:::Registro fraude patrón 3:::Clave=%s:::Registros con Error=%d\n", acumulado->clave, acumulado->cantidad);
+}
+
+static void formatearPatron4(char *mensaje, size_t longitud, const RegistroPatron *acumulado) {
+    snprintf(mensaje, longitud, "04:::Registro fraude patrón 4:::Clave=%s:::Registros con Todos los Tipos de Operaciones\n", acumulado->clave);
+}
+
+static void formatearPatron5(char *mensaje, size_t longitud, const RegistroPatron *acumulado) {
+    snprintf(mensaje, longitud, "05:::Registro fraude patrón 5:::Clave=%s:::Saldo negativo=%d\n", acumulado->clave, acumulado->cantidad);
+}
+
+// Columnas que utilizan todos los patrones: usuario y fecha de inicio (clave USUARIO@ventana)
+#define COLUMNAS_PATRON (MASCARA_COLUMNA(COLUMNA_USUARIO) | MASCARA_COLUMNA(COLUMNA_FECHA_INICIO))
+
+// Tabla de patrones de fraude
+// Los parámetros por defecto reproducen el comportamiento original de cada patrón
+static const DefinicionPatron definiciones_patrones[NUM_PATRONES_FRAUDE] = {
+    {1, "Más de 5 transacciones por usuario en una hora", {1, 5, GRANULARIDAD_HORA, 1}, 1, COLUMNAS_PATRON,
+        filtrarTodos, NULL, acumularCantidad, combinarRegistros, cumpleCantidadMayor, formatearPatron1},
+    {2, "Más de 3 retiros a la vez", {1, 3, GRANULARIDAD_SEGUNDO, 1}, 1, COLUMNAS_PATRON | MASCARA_COLUMNA(COLUMNA_IMPORTE),
+        filtrarPatron2, relevantePatron2, acumularCantidad, combinarRegistros, cumpleCantidadMayor, formatearPatron2},
+    {3, "Más de 3 errores por usuario en un día", {1, 3, GRANULARIDAD_DIA, 1}, 1, COLUMNAS_PATRON | MASCARA_COLUMNA(COLUMNA_ESTADO),
+        filtrarPatron3, relevantePatron3, acumularCantidad, combinarRegistros, cumpleCantidadMayor, formatearPatron3},
+    {4, "Todos los tipos de operación por usuario en un día", {1, 4, GRANULARIDAD_DIA, 1}, 0, COLUMNAS_PATRON | MASCARA_COLUMNA(COLUMNA_TIPO_OPERACION2),
+        filtrarTodos, NULL, acumularTiposOperacion, combinarRegistros, cumpleTiposOperacion, formatearPatron4},
+    {5, "Dinero retirado mayor que el ingresado por usuario en un día", {1, 0, GRANULARIDAD_DIA, 1}, 0, COLUMNAS_PATRON | MASCARA_COLUMNA(COLUMNA_IMPORTE),
+        filtrarTodos, NULL, acumularImporte, combinarRegistros, cumpleCantidadMenor, formatearPatron5},
+};
+
+// Función que devuelve la definición de un patrón (1..NUM_PATRONES_FRAUDE)
+const DefinicionPatron *obtenerDefinicionPatron(int numPatron) {
+    return &definiciones_patrones[numPatron - 1];
+}
+
+// Nombres de las granularidades en el fichero de configuración
+static const char *nombres_granularidad[] = {"SEGUNDO", "MINUTO", "HORA", "DIA"};
+
+const char *nombreGranularidad(Granularidad granularidad) {
+    return nombres_granularidad[granularidad];
+}
+
+// Función que convierte un valor de configuración en un entero (-1 si no es un entero)
+static int convertirEnteroParametro(const char *texto, int *valor) {
+    char *fin;
+    long numero = strtol(texto, &fin, 10);
+    while (isspace((unsigned char)*fin)) {
+        fin++;
+    }
+    if (fin == texto || *fin != '\0') {
+        return -1;
+    }
+    *valor = (int)numero;
+    return 0;
+}
+
+// Función que obtiene los parámetros de todos los patrones de una tabla de entradas de configuración
+// Los valores que no son válidos se ignoran (se deja el valor por defecto) y se avisa en el log
+void cargarParametrosPatrones(const struct EntradaConfiguracion *entradas, int num_entradas, ParametrosPatron parametros[NUM_PATRONES_FRAUDE]) {
+    char clave[MAX_LONGITUD_CLAVE];
+    for (int i = 0; i < NUM_PATRONES_FRAUDE; i++) {
+        parametros[i] = definiciones_patrones[i].parametros_por_defecto;
+        int numPatron = i + 1;
+        const char *valor;
+
+        snprintf(clave, sizeof(clave), "PATRON_%d_ACTIVO", numPatron);
+        valor = buscar_valor_configuracion(entradas, num_entradas, clave, "SI");
+        if (strncmp(valor, "SI", 2) == 0) {
+            parametros[i].activo = 1;
+        } else if (strncmp(valor, "NO", 2) == 0) {
+            parametros[i].activo = 0;
+        } else {
+            escribirEnLog(LOG_WARNING, "patrones_fraude", "Valor no válido %s=%s (SI/NO)\n", clave, valor);
+        }
+
+        snprintf(clave, sizeof(clave), "PATRON_%d_UMBRAL", numPatron);
+        valor = buscar_valor_configuracion(entradas, num_entradas, clave, NULL);
+        if (valor != NULL && convertirEnteroParametro(valor, &parametros[i].umbral) != 0) {
+            escribirEnLog(LOG_WARNING, "patrones_fraude", "Valor no válido %s=%s (entero)\n", clave, valor);
+        }
+
+        snprintf(clave, sizeof(clave), "PATRON_%d_GRANULARIDAD", numPatron);
+        valor = buscar_valor_configuracion(entradas, num_entradas, clave, NULL);
+        if (valor != NULL) {
+            int encontrada = 0;
+            for (int g = GRANULARIDAD_SEGUNDO; g <= GRANULARIDAD_DIA; g++) {
+                if (strncmp(valor, nombres_granularidad[g], strlen(nombres_granularidad[g])) == 0) {
+                    parametros[i].granularidad = (Granularidad)g;
+                    encontrada = 1;
+                }
+            }
+            if (!encontrada) {
+                escribirEnLog(LOG_WARNING, "patrones_fraude", "Valor no válido %s=%s (SEGUNDO/MINUTO/HORA/DIA)\n", clave, valor);
+            }
+        }
+
+        snprintf(clave, sizeof(clave), "PATRON_%d_VENTANA", numPatron);
+        valor = buscar_valor_configuracion(entradas, num_entradas, clave, NULL);
+        if (valor != NULL) {
+            int longitud;
+            if (convertirEnteroParametro(valor, &longitud) != 0 || longitud < 1) {
+                escribirEnLog(LOG_WARNING, "patrones_fraude", "Valor no válido %s=%s (entero mayor que 0)\n", clave, valor);
+            } else {
+                parametros[i].longitud_ventana = longitud;
+            }
+        }
+    }
+}
+
+// Función que devuelve el ancho en segundos de la ventana de un patrón
+long long anchoVentanaPatron(const ParametrosPatron *parametros) {
+    static const long long segundos_granularidad[] = {1, 60, 3600, 86400};
+    return segundos_granularidad[parametros->granularidad] * parametros->longitud_ventana;
+}
+
+// Función que calcula la fecha del calendario gregoriano correspondiente a los días desde el 01/01/1970
+static void fechaDesdeDias(long long dias, int *anio, int *mes, int *dia) {
+    dias += 719468;
+    long long era = (dias >= 0 ? dias : dias - 146096) / 146097;
+    long long dia_era = dias - era * 146097;
+    long long anio_era = (dia_era - dia_era / 1460 + dia_era / 36524 - dia_era / 146096) / 365;
+    long long dia_anio = dia_era - (365 * anio_era + anio_era / 4 - anio_era / 100);
+    long long mes_marzo = (5 * dia_anio + 2) / 153;
+    *dia = (int)(dia_anio - (153 * mes_marzo + 2) / 5 + 1);
+    *mes = (int)(mes_marzo < 10 ? mes_marzo + 3 : mes_marzo - 9);
+    *anio = (int)(anio_era + era * 400 + (*mes <= 2));
+}
+
+// Función que compone la clave USUARIO@inicio de la ventana con la precisión de la granularidad
+// Con los valores por defecto da las mismas claves que los patrones originales:
+//    SEGUNDO: USER001@15/05/2024 07:03:00   MINUTO: USER001@15/05/2024 07:03
+//    HORA:    USER001@15/05/2024 07:00      DIA:    USER001@15/05/2024
+static void componerClave(char *clave, size_t longitud, const char *usuario, long long inicio, Granularidad granularidad) {
+    int anio, mes, dia;
+    fechaDesdeDias(inicio / 86400, &anio, &mes, &dia);
+    int segundos_dia = (int)(inicio % 86400);
+    int hora = segundos_dia / 3600;
+    int minuto = (segundos_dia % 3600) / 60;
+    int segundo = segundos_dia % 60;
+    switch (granularidad) {
+        case GRANULARIDAD_SEGUNDO:
+            snprintf(clave, longitud, "%s@%02d/%02d/%04d %02d:%02d:%02d", usuario, dia, mes, anio, hora, minuto, segundo);
+            break;
+        case GRANULARIDAD_MINUTO:
+            snprintf(clave, longitud, "%s@%02d/%02d/%04d %02d:%02d", usuario, dia, mes, anio, hora, minuto);
+            break;
+        case GRANULARIDAD_HORA:
+            snprintf(clave, longitud, "%s@%02d/%02d/%04d %02d:00", usuario, dia, mes, anio, hora);
+            break;
+        default:
+            snprintf(clave, longitud, "%s@%02d/%02d/%04d", usuario, dia, mes, anio);
+            break;
+    }
+}
+
+// Función que libera un registro acumulado al eliminarlo del diccionario
+static void liberarRegistroPatron(gpointer data) {
+    RegistroPatron* registro = (RegistroPatron*)data;
+    g_free(registro->clave);
+    g_free(registro->usuario);
+    g_free(registro);
+}
+
+// Función que crea un diccionario de registros acumulados vacío
+// La clave del diccionario es la propia clave del registro, que se libera con el registro
+GHashTable *crearDiccionarioPatron() {
+    return g_hash_table_new_full(g_str_hash, g_str_equal, NULL, liberarRegistroPatron);
+}
+
+// Función que añade al diccionario un registro acumulado vacío
+static RegistroPatron *insertarRegistroPatron(GHashTable *registros, const char *clave, const char *usuario, long long inicio) {
+    RegistroPatron *registro = g_new0(RegistroPatron, 1);
+    registro->clave = g_strdup(clave);
+    registro->usuario = g_strdup(usuario);
+    registro->inicio_ventana = inicio;
+    g_hash_table_insert(registros, registro->clave, registro);
+    return registro;
+}
+
+// Función que devuelve el registro acumulado de un usuario en una ventana, creándolo si no existe
+RegistroPatron *obtenerRegistroPatron(GHashTable *registros, const char *usuario, long long inicio, Granularidad granularidad) {
+    char clave[100];
+    componerClave(clave, sizeof(clave), usuario, inicio, granularidad);
+    RegistroPatron *registro = g_hash_table_lookup(registros, clave);
+    if (registro == NULL) {
+        registro = insertarRegistroPatron(registros, clave, usuario, inicio);
+    }
+    return registro;
+}
+
+// Función que inicializa un cursor del patrón para leer desde el principio sólo las columnas que utiliza
+static void inicializarCursorPatron(const EstadoPatron *estado, CursorConsolidado *cursor) {
+    inicializarCursorConsolidado(cursor);
+    cursor->columnas = estado->definicion->columnas;
+}
+
+// Función que inicializa el estado de un patrón con un diccionario vacío
+void inicializarEstadoPatron(EstadoPatron *estado, int numPatron, const ParametrosPatron *parametros) {
+    estado->definicion = obtenerDefinicionPatron(numPatron);
+    estado->parametros = *parametros;
+    estado->registros = crearDiccionarioPatron();
+    inicializarCursorPatron(estado, &estado->cursor);
+    estado->sketch = NULL;
+    estado->pendientes_confirmacion = 0;
+    estado->volcado = NULL;
+    estado->volcado_fallido = 0;
+    estado->posicion_agregados = 0;
+    estado->posicion_resumenes = 0;
+}
+
+// Función que pasa el patrón a modo aproximado con un sketch de memoria_bytes
+// Devuelve 0 si el patrón queda en modo aproximado o -1 si sigue en modo exacto
+int activarModoAproximadoPatron(EstadoPatron *estado, long long memoria_bytes, int profundidad) {
+    if (!estado->definicion->admite_aproximado) {
+        escribirEnLog(LOG_INFO, "patrones_fraude", "Patrón %02d: no admite modo aproximado, se utiliza el modo exacto\n", estado->definicion->numero);
+        return -1;
+    }
+    estado->sketch = crearSketchCountMin(memoria_bytes, profundidad);
+    if (estado->sketch == NULL) {
+        escribirEnLog(LOG_ERROR, "patrones_fraude", "Patrón %02d: no se ha podido crear el sketch de %lld bytes, se utiliza el modo exacto\n", estado->definicion->numero, memoria_bytes);
+        return -1;
+    }
+    // Lo acumulado hasta ahora en modo exacto se descarta y se vuelve a leer
+    g_hash_table_remove_all(estado->registros);
+    inicializarCursorPatron(estado, &estado->cursor);
+    escribirEnLog(LOG_INFO, "patrones_fraude", "Patrón %02d: modo aproximado con sketch de %d x %d contadores\n",
+        estado->definicion->numero, estado->sketch->profundidad, estado->sketch->anchura);
+    return 0;
+}
+
+// Función que permite volcar a disco el diccionario del patrón cuando ocupa más de memoria_bytes
+// Devuelve 0 si se ha activado el volcado o -1 si el diccionario se mantiene sólo en memoria
+int activarVolcadoPatron(EstadoPatron *estado, const char *directorio, int num_particiones, long long memoria_bytes) {
+    if (estado->sketch != NULL) {
+        escribirEnLog(LOG_INFO, "patrones_fraude", "Patrón %02d: en modo aproximado no se vuelca a disco\n", estado->definicion->numero);
+        return -1;
+    }
+    AgregacionExterna *volcado = malloc(sizeof(AgregacionExterna));
+    if (volcado == NULL || inicializarAgregacionExterna(volcado, estado->definicion->numero, directorio, num_particiones, memoria_bytes) != 0) {
+        escribirEnLog(LOG_ERROR, "patrones_fraude", "Patrón %02d: no se ha podido activar el volcado a disco en %s\n", estado->definicion->numero, directorio);
+        free(volcado);
+        return -1;
+    }
+    estado->volcado = volcado;
+    escribirEnLog(LOG_INFO, "patrones_fraude", "Patrón %02d: volcado a disco en %s a partir de %u claves (%d particiones)\n",
+        estado->definicion->numero, directorio, volcado->max_claves, volcado->num_particiones);
+    return 0;
+}
+
+// Función que descarta lo acumulado cuando los datos consolidados se vuelven a leer desde el principio
+// Los lotes de agregados y los resúmenes también se vuelven a recorrer desde el principio de sus ficheros
+static void reiniciarEstadoPatron(void *contexto) {
+    EstadoPatron *estado = (EstadoPatron *)contexto;
+    g_hash_table_remove_all(estado->registros);
+    if (estado->sketch != NULL) {
+        vaciarSketchCountMin(estado->sketch);
+    }
+    if (estado->volcado != NULL) {
+        eliminarVolcadosPatron(estado->volcado);
+    }
+    estado->volcado_fallido = 0;
+    estado->pendientes_confirmacion = 0;
+    estado->posicion_agregados = 0;
+    estado->posicion_resumenes = 0;
+}
+
+// Función que descarta todo lo acumulado (diccionario y sketch) para volver a leer los datos desde el principio
+static void descartarEstadoPatron(EstadoPatron *estado) {
+    reiniciarEstadoPatron(estado);
+    inicializarCursorPatron(estado, &estado->cursor);
+}
+
+// Función que adapta lo acumulado a unos parámetros nuevos
+// Sólo se reagrupa cuando cambia la forma de la ventana
+void aplicarParametrosPatron(EstadoPatron *estado, const ParametrosPatron *parametros) {
+    long long ancho_actual = anchoVentanaPatron(&estado->parametros);
+    long long ancho_nuevo = anchoVentanaPatron(parametros);
+    Granularidad granularidad_actual = estado->parametros.granularidad;
+    int umbral_actual = estado->parametros.umbral;
+    estado->parametros = *parametros;
+    int misma_ventana = ancho_nuevo == ancho_actual && parametros->granularidad == granularidad_actual;
+
+    if (estado->sketch != NULL) {
+        // En modo aproximado el diccionario sólo tiene las claves que superaban el umbral anterior
+        // con la ventana anterior: cualquier cambio obliga a volver a leer los datos
+        if (!misma_ventana || parametros->umbral != umbral_actual) {
+            descartarEstadoPatron(estado);
+            escribirEnLog(LOG_INFO, "patrones_fraude", "Patrón %02d: parámetros cambiados en modo aproximado, se vuelven a leer los datos\n",
+                estado->definicion->numero);
+        }
+        return;
+    }
+    if (misma_ventana) {
+        return;
+    }
+
+    // Con volcados en disco no se combinan las ventanas: las claves de los volcados no están en memoria
+    int hay_volcados = estado->volcado != NULL && estado->volcado->num_volcados > 0;
+    if (ancho_nuevo % ancho_actual == 0 && !hay_volcados) {
+        // La ventana nueva está formada por ventanas completas de la anterior: basta con combinarlas
+        GHashTable *nuevos = crearDiccionarioPatron();
+        GHashTableIter iter;
+        gpointer clave, valor;
+        g_hash_table_iter_init(&iter, estado->registros);
+        while (g_hash_table_iter_next(&iter, &clave, &valor)) {
+            RegistroPatron *origen = (RegistroPatron *)valor;
+            long long inicio = origen->inicio_ventana - origen->inicio_ventana % ancho_nuevo;
+            RegistroPatron *destino = obtenerRegistroPatron(nuevos, origen->usuario, inicio, parametros->granularidad);
+            estado->definicion->combinar(destino, origen);
+        }
+        g_hash_table_destroy(estado->registros);
+        estado->registros = nuevos;
+        escribirEnLog(LOG_INFO, "patrones_fraude", "Patrón %02d: ventanas de %lld s reagrupadas en ventanas de %lld s\n",
+            estado->definicion->numero, ancho_actual, ancho_nuevo);
+    } else {
+        // Las ventanas anteriores no caben enteras en las nuevas: hay que volver a leer los datos
+        descartarEstadoPatron(estado);
+        escribirEnLog(LOG_INFO, "patrones_fraude", "Patrón %02d: ventana cambiada de %lld s a %lld s, se vuelven a leer los datos\n",
+            estado->definicion->numero, ancho_actual, ancho_nuevo);
+    }
+}
+
+// Función que obtiene la clave USUARIO@ventana de un registro consolidado y el inicio de su ventana
+// Devuelve 0 o -1 si el patrón no tiene en cuenta el registro
+static int claveRegistroPatron(const EstadoPatron *estado, const RegistroConsolidado *registro, char *clave, size_t longitud, long long *inicio) {
+    if (registro->instante1 < 0 || !estado->definicion->filtrar(registro)) {
+        return -1;
+    }
+    escribirEnLogDetalle(LOG_DEBUG, "patrones_fraude", registro->usuario, registro->sucursal,
+        "Patrón %02d: datos de registro %s;%s;%s;%s;%s;%s;%d;%d;%s;\n", estado->definicion->numero,
+        registro->sucursal, registro->operacion, registro->fechaHora1, registro->fechaHora2, registro->usuario,
+        registro->tipoOperacion1, registro->tipoOperacion2, registro->importe, registro->estado);
+    long long ancho = anchoVentanaPatron(&estado->parametros);
+    *inicio = registro->instante1 - registro->instante1 % ancho;
+    componerClave(clave, longitud, registro->usuario, *inicio, estado->parametros.granularidad);
+    return 0;
+}
+
+// Función que vuelca el diccionario a disco si ha llegado al máximo de claves en memoria
+// Si el volcado falla no se vuelve a intentar en cada clave nueva: el diccionario sigue en memoria
+// (sin perder lo acumulado) y actualizarEstadoPatron termina la ronda con error
+static void volcarLlenoPatron(EstadoPatron *estado) {
+    if (estado->volcado == NULL || estado->volcado_fallido || g_hash_table_size(estado->registros) < estado->volcado->max_claves) {
+        return;
+    }
+    if (volcarRegistrosPatron(estado->volcado, estado->registros) != 0) {
+        escribirEnLog(LOG_ERROR, "patrones_fraude", "Patrón %02d: no se ha podido volcar a disco, el diccionario se queda en memoria\n",
+            estado->definicion->numero);
+        estado->volcado_fallido = 1;
+    }
+}
+
+// Función que acumula un registro consolidado en el diccionario del patrón
+static void procesarRegistroPatron(RegistroConsolidado *registro, void *contexto) {
+    EstadoPatron *estado = (EstadoPatron *)contexto;
+    char clave[100];
+    long long inicio;
+    if (claveRegistroPatron(estado, registro, clave, sizeof(clave), &inicio) != 0) {
+        return;
+    }
+    RegistroPatron *acumulado = g_hash_table_lookup(estado->registros, clave);
+
+    if (acumulado == NULL && estado->sketch != NULL) {
+        // Modo aproximado: la clave sólo entra en el diccionario cuando su estimación supera el umbral
+        uint32_t estimacion = incrementarSketchCountMin(estado->sketch, clave);
+        if ((long long)estimacion <= estado->parametros.umbral) {
+            return;
+        }
+        acumulado = insertarRegistroPatron(estado->registros, clave, registro->usuario, inicio);
+        acumulado->pendiente_confirmacion = 1;
+        estado->pendientes_confirmacion++;
+        return;
+    }
+    if (acumulado == NULL) {
+        volcarLlenoPatron(estado);
+        acumulado = insertarRegistroPatron(estado->registros, clave, registro->usuario, inicio);
+    }
+    estado->definicion->acumular(acumulado, registro);
+}
+
+// Agregado parcial de un hilo de la lectura paralela: diccionario propio con los mismos parámetros que el patrón
+typedef struct PARCIAL_PATRON {
+    const EstadoPatron *estado;
+    GHashTable *registros;
+} ParcialPatron;
+
+static void *crearParcialPatron(void *contexto) {
+    ParcialPatron *parcial = malloc(sizeof(ParcialPatron));
+    parcial->estado = (const EstadoPatron *)contexto;
+    parcial->registros = crearDiccionarioPatron();
+    return parcial;
+}
+
+// Función que acumula un registro consolidado en el diccionario parcial de un hilo
+static void procesarRegistroParcialPatron(RegistroConsolidado *registro, void *contexto) {
+    ParcialPatron *parcial = (ParcialPatron *)contexto;
+    char clave[100];
+    long long inicio;
+    if (claveRegistroPatron(parcial->estado, registro, clave, sizeof(clave), &inicio) != 0) {
+        return;
+    }
+    RegistroPatron *acumulado = g_hash_table_lookup(parcial->registros, clave);
+    if (acumulado == NULL) {
+        acumulado = insertarRegistroPatron(parcial->registros, clave, registro->usuario, inicio);
+    }
+    parcial->estado->definicion->acumular(acumulado, registro);
+}
+
+// Función que combina un valor acumulado en el registro de su clave en el diccionario del patrón
+static void combinarRegistroPatron(EstadoPatron *estado, const char *clave, const char *usuario, long long inicio, const RegistroPatron *origen) {
+    RegistroPatron *destino = g_hash_table_lookup(estado->registros, clave);
+    if (destino == NULL) {
+        volcarLlenoPatron(estado);
+        destino = insertarRegistroPatron(estado->registros, clave, usuario, inicio);
+    }
+    estado->definicion->combinar(destino, origen);
+}
+
+// Función que combina un diccionario parcial en el diccionario del patrón y lo libera
+static void fusionarParcialPatron(void *contexto, void *datos_parcial) {
+    EstadoPatron *estado = (EstadoPatron *)contexto;
+    ParcialPatron *parcial = (ParcialPatron *)datos_parcial;
+    GHashTableIter iter;
+    gpointer clave, valor;
+    g_hash_table_iter_init(&iter, parcial->registros);
+    while (g_hash_table_iter_next(&iter, &clave, &valor)) {
+        RegistroPatron *origen = (RegistroPatron *)valor;
+        combinarRegistroPatron(estado, origen->clave, origen->usuario, origen->inicio_ventana, origen);
+    }
+    g_hash_table_destroy(parcial->registros);
+    free(parcial);
+}
+
+// Función que combina en el diccionario del patrón los agregados de un lote de FileProcessor
+// Devuelve 0 o -1 si algún cubo del lote no cabe entero en las ventanas del patrón
+static int combinarLoteAgregadosPatron(const AgregadoParcial *agregados, int num_agregados, void *contexto) {
+    EstadoPatron *estado = (EstadoPatron *)contexto;
+    long long ancho = anchoVentanaPatron(&estado->parametros);
+    for (int i = 0; i < num_agregados; i++) {
+        if (agregados[i].ancho <= 0 || ancho % agregados[i].ancho != 0) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < num_agregados; i++) {
+        RegistroPatron origen = {0};
+        origen.cantidad = (int)agregados[i].cantidad;
+        origen.operacion1Presente = agregados[i].operaciones[0];
+        origen.operacion2Presente = agregados[i].operaciones[1];
+        origen.operacion3Presente = agregados[i].operaciones[2];
+        origen.operacion4Presente = agregados[i].operaciones[3];
+        long long inicio = agregados[i].inicio - agregados[i].inicio % ancho;
+        char clave[100];
+        componerClave(clave, sizeof(clave), agregados[i].usuario, inicio, estado->parametros.granularidad);
+        combinarRegistroPatron(estado, clave, agregados[i].usuario, inicio, &origen);
+    }
+    return 0;
+}
+
+// Lectura paralela del modo exacto sin volcado a disco (en modo aproximado el sketch se actualiza registro a registro
+// y con volcado cada hilo tendría un diccionario propio sin límite de memoria)
+static const AgregacionParalela agregacion_paralela_patron = {
+    crearParcialPatron, procesarRegistroParcialPatron, fusionarParcialPatron
+};
+
+// Función que cuenta de forma exacta un registro si su clave está pendiente de confirmación
+static void confirmarRegistroPatron(RegistroConsolidado *registro, void *contexto) {
+    EstadoPatron *estado = (EstadoPatron *)contexto;
+    char clave[100];
+    long long inicio;
+    if (claveRegistroPatron(estado, registro, clave, sizeof(clave), &inicio) != 0) {
+        return;
+    }
+    RegistroPatron *acumulado = g_hash_table_lookup(estado->registros, clave);
+    if (acumulado != NULL && acumulado->pendiente_confirmacion) {
+        estado->definicion->acumular(acumulado, registro);
+    }
+}
+
+// Durante la confirmación los datos se leen con un cursor nuevo, no hay nada que descartar
+static void ignorarReinicioPatron(void *contexto) {
+    (void)contexto;
+}
+
+// Función que obtiene el valor exacto de las claves promovidas en esta ronda
+// Se vuelven a leer los datos desde el principio contando sólo los registros de esas claves.
+// La lectura termina donde ha terminado la del patrón, así que los datos son los mismos que se acaban de leer
+// aunque FileProcessor haya añadido datos después (SNAPSHOT_READS=1)
+static int confirmarRegistrosPromovidos(EstadoPatron *estado) {
+    GHashTableIter iter;
+    gpointer clave, valor;
+    // Las claves promovidas pueden haber acumulado registros después de la promoción: se cuentan de nuevo
+    g_hash_table_iter_init(&iter, estado->registros);
+    while (g_hash_table_iter_next(&iter, &clave, &valor)) {
+        RegistroPatron *registro = (RegistroPatron *)valor;
+        if (registro->pendiente_confirmacion) {
+            registro->cantidad = 0;
+            registro->num_registros = 0;
+        }
+    }
+
+    CursorConsolidado cursor;
+    inicializarCursorPatron(estado, &cursor);
+    cursor.limite = estado->cursor.posicion;
+    int leidos = leerNuevosRegistrosConsolidados(&cursor, confirmarRegistroPatron, ignorarReinicioPatron, estado);
+
+    g_hash_table_iter_init(&iter, estado->registros);
+    while (g_hash_table_iter_next(&iter, &clave, &valor)) {
+        ((RegistroPatron *)valor)->pendiente_confirmacion = 0;
+    }
+    escribirEnLog(LOG_INFO, "patrones_fraude", "Patrón %02d: %d claves promovidas confirmadas (%u claves exactas en total)\n",
+        estado->definicion->numero, estado->pendientes_confirmacion, g_hash_table_size(estado->registros));
+    estado->pendientes_confirmacion = 0;
+    return leidos;
+}
+
+// Función que acumula los registros de los datos consolidados desde la posición del cursor hasta su límite
+// Devuelve el número de registros o -1 si no se han podido leer los datos
+static int leerTramoPatron(CursorConsolidado *cursor, void *contexto) {
+    EstadoPatron *estado = (EstadoPatron *)contexto;
+    // Primero se combinan los lotes de agregados parciales que siguen al cursor (sólo en modo exacto)
+    int combinados = 0;
+    if (estado->sketch == NULL && obtenerParametros()->agregados_parciales) {
+        combinados = leerLotesAgregados(&estado->posicion_agregados, cursor, estado->definicion->numero,
+            combinarLoteAgregadosPatron, estado);
+    }
+    int leidos = leerNuevosRegistrosConsolidadosParalelo(cursor, procesarRegistroPatron, reiniciarEstadoPatron, estado,
+        estado->sketch == NULL && estado->volcado == NULL ? &agregacion_paralela_patron : NULL);
+    return leidos == -1 ? -1 : leidos + combinados;
+}
+
+static int relevanteLotePatron(const ResumenLote *resumen, void *contexto) {
+    return ((EstadoPatron *)contexto)->definicion->relevante(resumen);
+}
+
+// Función que acumula los registros consolidados añadidos desde la ronda anterior
+// Devuelve el número de registros nuevos o -1 si no se han podido leer los datos
+int actualizarEstadoPatron(EstadoPatron *estado) {
+    int volcado_fallido = estado->volcado_fallido;
+    int leidos;
+    if (estado->definicion->relevante != NULL) {
+        char nombre[20];
+        snprintf(nombre, sizeof(nombre), "Patrón %02d", estado->definicion->numero);
+        leidos = leerLotesRelevantes(&estado->posicion_resumenes, &estado->cursor, relevanteLotePatron, leerTramoPatron, estado, nombre);
+    } else {
+        leidos = leerTramoPatron(&estado->cursor, estado);
+    }
+    if (leidos != -1 && estado->pendientes_confirmacion > 0 && confirmarRegistrosPromovidos(estado) == -1) {
+        return -1;
+    }
+    // Un volcado fallido en esta ronda se informa como error; lo leído sigue acumulado en memoria
+    if (!volcado_fallido && estado->volcado_fallido) {
+        return -1;
+    }
+    return leidos;
+}
+
+// Función que llama a visitar con el valor acumulado de cada clave del patrón
+// Si hay volcados en disco se recorren mezclados con el diccionario, sin reescribirlos
+// Devuelve 0 o -1 si no se han podido leer los volcados: en ese caso lo acumulado no está completo,
+// se descarta y la ronda siguiente vuelve a leer los datos desde el principio
+int recorrerRegistrosPatron(EstadoPatron *estado, VisitarRegistroPatron visitar, void *contexto) {
+    if (estado->volcado != NULL && estado->volcado->num_volcados > 0) {
+        if (recorrerVolcadosPatron(estado->volcado, estado->registros, estado->definicion->combinar, visitar, contexto) != 0) {
+            descartarEstadoPatron(estado);
+            return -1;
+        }
+        return 0;
+    }
+    GHashTableIter iter;
+    gpointer clave, valor;
+    g_hash_table_iter_init(&iter, estado->registros);
+    while (g_hash_table_iter_next(&iter, &clave, &valor)) {
+        visitar((RegistroPatron *)valor, contexto);
+    }
+    return 0;
+}
+
+#pragma endregion PatronesFraude
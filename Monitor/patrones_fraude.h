@@ -0,0 +1,110 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <glib.h>           // Manejo de diccionarios GLib utilizado para la detección de patrones de fraude
+
+#include "constants.h"          // Constantes de la aplicación
+#include "config_files.h"       // Lectura de los parámetros de los patrones
+#include "datos_consolidados.h" // Lectura incremental de los datos consolidados
+#include "sketch_count_min.h"   // Conteo aproximado con memoria fija
+#include "agregacion_externa.h" // Volcado a disco del diccionario
+#include "agregados_parciales.h" // Agregados parciales calculados por FileProcessor
+#include "resumenes_lotes.h"    // Resúmenes de los lotes para saltar los irrelevantes
+#pragma endregion Librerias
+
+
+// Tamaño de los cubos en los que se agrupan los registros para formar las ventanas de un patrón
+typedef enum GRANULARIDAD {
+    GRANULARIDAD_SEGUNDO,
+    GRANULARIDAD_MINUTO,
+    GRANULARIDAD_HORA,
+    GRANULARIDAD_DIA
+} Granularidad;
+
+// Parámetros de un patrón de fraude que se pueden cambiar en mo.conf
+//    PATRON_n_ACTIVO=SI/NO
+//    PATRON_n_UMBRAL=entero
+//    PATRON_n_GRANULARIDAD=SEGUNDO/MINUTO/HORA/DIA
+//    PATRON_n_VENTANA=número de cubos de la ventana
+typedef struct PARAMETROS_PATRON {
+    int activo;
+    int umbral;
+    Granularidad granularidad;
+    int longitud_ventana;
+} ParametrosPatron;
+
+// Valor acumulado de un usuario en una ventana
+typedef struct REGISTRO_PATRON {
+    char* clave;                // USUARIO@inicio de la ventana
+    char* usuario;
+    long long inicio_ventana;   // Segundos desde 01/01/1970
+    int cantidad;
+    int operacion1Presente;
+    int operacion2Presente;
+    int operacion3Presente;
+    int operacion4Presente;
+    int num_registros;          // Registros acumulados (lo utilizan las reglas para min y max)
+    int pendiente_confirmacion; // Modo aproximado: promovido en esta ronda, falta el conteo exacto
+} RegistroPatron;
+
+// Definición de un patrón de fraude: qué registros tiene en cuenta, cómo los acumula
+// y cuándo una ventana cumple el patrón
+typedef struct DEFINICION_PATRON {
+    int numero;
+    const char *descripcion;
+    ParametrosPatron parametros_por_defecto;
+    int admite_aproximado;      // Cuenta registros y se cumple al superar el umbral (admite Count-Min)
+    unsigned int columnas;      // Columnas del almacén columnar que utiliza el patrón
+    int (*filtrar)(const RegistroConsolidado *registro);
+    int (*relevante)(const ResumenLote *resumen);  // NULL: todos los lotes pueden tener registros del patrón
+    void (*acumular)(RegistroPatron *acumulado, const RegistroConsolidado *registro);
+    void (*combinar)(RegistroPatron *destino, const RegistroPatron *origen);
+    int (*cumple)(const RegistroPatron *acumulado, int umbral);
+    void (*formatear)(char *mensaje, size_t longitud, const RegistroPatron *acumulado);
+} DefinicionPatron;
+
+// Estado que mantiene cada hilo de patrón entre rondas
+// Los registros acumulados no se descartan entre rondas: en cada ronda sólo se leen los registros nuevos
+typedef struct ESTADO_PATRON {
+    const DefinicionPatron *definicion;
+    ParametrosPatron parametros;    // Parámetros con los que se ha construido el diccionario
+    GHashTable *registros;          // Clave USUARIO@inicio de la ventana -> RegistroPatron
+    CursorConsolidado cursor;
+    SketchCountMin *sketch;         // Modo aproximado (NULL en modo exacto)
+    int pendientes_confirmacion;    // Registros promovidos en esta ronda
+    AgregacionExterna *volcado;     // Volcado a disco del diccionario (NULL si todo cabe en memoria)
+    int volcado_fallido;            // No se ha podido volcar: el diccionario se queda en memoria hasta que se reinicie
+    long long posicion_agregados;   // Posición leída del fichero de agregados parciales (PARTIAL_AGGREGATES=1)
+    long long posicion_resumenes;   // Posición leída del fichero de resúmenes de lotes (BATCH_SUMMARIES=1)
+} EstadoPatron;
+
+
+const DefinicionPatron *obtenerDefinicionPatron(int numPatron);
+
+void cargarParametrosPatrones(const struct EntradaConfiguracion *entradas, int num_entradas, ParametrosPatron parametros[NUM_PATRONES_FRAUDE]);
+
+const char *nombreGranularidad(Granularidad granularidad);
+
+long long anchoVentanaPatron(const ParametrosPatron *parametros);
+
+GHashTable *crearDiccionarioPatron();
+
+RegistroPatron *obtenerRegistroPatron(GHashTable *registros, const char *usuario, long long inicio, Granularidad granularidad);
+
+void inicializarEstadoPatron(EstadoPatron *estado, int numPatron, const ParametrosPatron *parametros);
+
+int activarModoAproximadoPatron(EstadoPatron *estado, long long memoria_bytes, int profundidad);
+
+int activarVolcadoPatron(EstadoPatron *estado, const char *directorio, int num_particiones, long long memoria_bytes);
+
+void aplicarParametrosPatron(EstadoPatron *estado, const ParametrosPatron *parametros);
+
+int actualizarEstadoPatron(EstadoPatron *estado);
+
+int recorrerRegistrosPatron(EstadoPatron *estado, VisitarRegistroPatron visitar, void *contexto);
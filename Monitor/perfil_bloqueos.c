@@ -0,0 +1,407 @@
+// ------------------------------------------------------------------
+// PERFIL DE CONTENCIÓN DE LOS BLOQUEOS
+// ------------------------------------------------------------------
+
+// localtime_r y syscall no se declaran con -std=c99 sin esta macro
+#define _DEFAULT_SOURCE
+
+#include "perfil_bloqueos.h"
+#include "metricas_proceso.h"   // registrarDuracionHistograma
+#include "utilidades.h"         // obtener_nanosegundos_monotonicos
+
+#include <stdio.h>          // Fichero del informe
+#include <stdlib.h>         // malloc, qsort
+#include <string.h>         // strncpy, strcmp
+#include <time.h>           // Fecha del informe
+#include <unistd.h>         // getpid, syscall
+#include <sys/syscall.h>    // SYS_gettid
+#include <linux/limits.h>   // PATH_MAX
+
+#pragma region PerfilBloqueos
+/*
+    Perfil de contención (LOCK_PROFILING=1) del semáforo semaforo_consolidar_ficheros_entrada y de los mutex
+    mutex_escritura_pipe y mutex_escritura_log (y mutex_consolidacion con SNAPSHOT_READS=1).
+    Cada hilo tiene una entrada por bloqueo y sitio (función o módulo que lo pide) con el número de
+    adquisiciones, las que tuvieron que esperar, y los histogramas del tiempo de espera y del tiempo que
+    se tuvo el bloqueo. Cuando hay que esperar se apunta quién lo tenía al empezar la espera: otro hilo
+    de este proceso o, si no lo tiene ningún hilo de este proceso, el otro proceso (el semáforo es común
+    con FileProcessor/Monitor) o un hilo que lo acababa de soltar.
+    Sólo escribe en su entrada el hilo dueño, con sumas atómicas relajadas; el informe (SIGUSR1 y al
+    terminar) se escribe en LOCK_PROFILING_FILE, no en el log, para no medirse a sí mismo.
+    Con LOCK_PROFILING=0 las funciones sólo cogen y sueltan el bloqueo.
+*/
+
+// Quién tenía el bloqueo mientras el hilo de la entrada esperaba
+typedef struct TITULAR_PERFIL_BLOQUEOS {
+    int entrada;                // Entrada del titular o TITULAR_PERFIL_DESCONOCIDO
+    uint64_t veces;
+    uint64_t espera_ns;
+} TitularPerfilBloqueos;
+
+// Datos de un bloqueo pedido desde un sitio por un hilo
+typedef struct ENTRADA_PERFIL_BLOQUEOS {
+    int publicada;              // 1 cuando el resto de campos fijos ya están escritos
+    const BloqueoPerfilado *bloqueo;
+    char sitio[LONGITUD_SITIO_PERFIL_BLOQUEOS];
+    char hilo[LONGITUD_HILO_PERFIL_BLOQUEOS];
+    uint64_t adquisiciones;
+    uint64_t con_espera;        // Adquisiciones que encontraron el bloqueo cogido
+    HistogramaMetricas espera;
+    HistogramaMetricas retencion;
+    int num_titulares;
+    TitularPerfilBloqueos titulares[MAX_TITULARES_PERFIL_BLOQUEOS];
+    uint64_t otros_titulares_veces;     // Esperas a titulares que no caben en "titulares"
+    uint64_t otros_titulares_espera_ns;
+} EntradaPerfilBloqueos;
+
+static int perfil_bloqueos_activo = 0;
+static char fichero_informe_perfil[PATH_MAX];
+static char proceso_perfil[LONGITUD_HILO_PERFIL_BLOQUEOS];
+
+static EntradaPerfilBloqueos entradas_perfil[MAX_ENTRADAS_PERFIL_BLOQUEOS];
+static int num_entradas_perfil = 0;
+static uint64_t entradas_perfil_perdidas = 0;
+
+// Nombre del hilo para el informe y entradas que ya tiene (para no buscar en toda la tabla)
+static __thread char nombre_hilo_perfil[LONGITUD_HILO_PERFIL_BLOQUEOS];
+static __thread int entradas_hilo_perfil[MAX_ENTRADAS_HILO_PERFIL_BLOQUEOS];
+static __thread int num_entradas_hilo_perfil = 0;
+
+// Bloqueos distintos que aparecen en el informe
+#define MAX_BLOQUEOS_INFORME_PERFIL 16
+
+// Sólo evita que se mezclen dos informes
+static pthread_mutex_t mutex_informe_perfil = PTHREAD_MUTEX_INITIALIZER;
+
+// Función que activa el perfil (al arrancar, antes de crear los hilos; no cambia con SIGHUP)
+void iniciarPerfilBloqueos(int activo, const char *fichero_informe, const char *proceso) {
+    snprintf(fichero_informe_perfil, sizeof(fichero_informe_perfil), "%s", fichero_informe);
+    snprintf(proceso_perfil, sizeof(proceso_perfil), "%s", proceso);
+    __atomic_store_n(&perfil_bloqueos_activo, activo, __ATOMIC_RELEASE);
+}
+
+// Función que pone el nombre con el que aparece en el informe el hilo que llama (p.ej. la sucursal)
+// Las entradas que ya tuviera el hilo conservan el nombre anterior
+void nombrarHiloPerfilBloqueos(const char *nombre) {
+    snprintf(nombre_hilo_perfil, sizeof(nombre_hilo_perfil), "%s/%ld", nombre, (long)syscall(SYS_gettid));
+}
+
+// Función que devuelve la entrada del hilo que llama para el bloqueo y el sitio, creándola si no existe
+// Devuelve -1 si no caben más entradas (esas adquisiciones no se cuentan)
+static int entradaPerfil(const BloqueoPerfilado *bloqueo, const char *sitio) {
+    for (int i = 0; i < num_entradas_hilo_perfil; i++) {
+        EntradaPerfilBloqueos *entrada = &entradas_perfil[entradas_hilo_perfil[i]];
+        if (entrada->bloqueo == bloqueo && strcmp(entrada->sitio, sitio) == 0) {
+            return entradas_hilo_perfil[i];
+        }
+    }
+    if (num_entradas_hilo_perfil == MAX_ENTRADAS_HILO_PERFIL_BLOQUEOS
+            || __atomic_load_n(&num_entradas_perfil, __ATOMIC_RELAXED) >= MAX_ENTRADAS_PERFIL_BLOQUEOS) {
+        __atomic_fetch_add(&entradas_perfil_perdidas, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    int indice = __atomic_fetch_add(&num_entradas_perfil, 1, __ATOMIC_ACQ_REL);
+    if (indice >= MAX_ENTRADAS_PERFIL_BLOQUEOS) {
+        __atomic_fetch_add(&entradas_perfil_perdidas, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    if (nombre_hilo_perfil[0] == '\0') {
+        nombrarHiloPerfilBloqueos("hilo");
+    }
+    EntradaPerfilBloqueos *entrada = &entradas_perfil[indice];
+    entrada->bloqueo = bloqueo;
+    strncpy(entrada->sitio, sitio, LONGITUD_SITIO_PERFIL_BLOQUEOS - 1);
+    strncpy(entrada->hilo, nombre_hilo_perfil, LONGITUD_HILO_PERFIL_BLOQUEOS - 1);
+    __atomic_store_n(&entrada->publicada, 1, __ATOMIC_RELEASE);
+    entradas_hilo_perfil[num_entradas_hilo_perfil++] = indice;
+    return indice;
+}
+
+// Función que apunta en la entrada de quien espera el titular que tenía el bloqueo
+static void anotarTitular(EntradaPerfilBloqueos *entrada, int titular, long long espera_ns) {
+    for (int i = 0; i < entrada->num_titulares; i++) {
+        if (entrada->titulares[i].entrada == titular) {
+            __atomic_fetch_add(&entrada->titulares[i].veces, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&entrada->titulares[i].espera_ns, (uint64_t)espera_ns, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+    if (entrada->num_titulares < MAX_TITULARES_PERFIL_BLOQUEOS) {
+        TitularPerfilBloqueos *nuevo = &entrada->titulares[entrada->num_titulares];
+        nuevo->entrada = titular;
+        __atomic_store_n(&nuevo->veces, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&nuevo->espera_ns, (uint64_t)espera_ns, __ATOMIC_RELAXED);
+        __atomic_store_n(&entrada->num_titulares, entrada->num_titulares + 1, __ATOMIC_RELEASE);
+    } else {
+        __atomic_fetch_add(&entrada->otros_titulares_veces, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&entrada->otros_titulares_espera_ns, (uint64_t)espera_ns, __ATOMIC_RELAXED);
+    }
+}
+
+// Función que apunta una adquisición (el hilo ya tiene el bloqueo) y deja al hilo como titular
+static void anotarAdquisicion(BloqueoPerfilado *bloqueo, int indice, int con_espera, int titular, long long inicio_ns) {
+    long long adquirido_ns = obtener_nanosegundos_monotonicos();
+    if (indice != -1) {
+        EntradaPerfilBloqueos *entrada = &entradas_perfil[indice];
+        __atomic_fetch_add(&entrada->adquisiciones, 1, __ATOMIC_RELAXED);
+        registrarDuracionHistograma(&entrada->espera, adquirido_ns - inicio_ns);
+        if (con_espera) {
+            __atomic_fetch_add(&entrada->con_espera, 1, __ATOMIC_RELAXED);
+            anotarTitular(entrada, titular, adquirido_ns - inicio_ns);
+        }
+    }
+    bloqueo->adquirido_ns = adquirido_ns;
+    __atomic_store_n(&bloqueo->titular, indice != -1 ? indice : TITULAR_PERFIL_DESCONOCIDO, __ATOMIC_RELAXED);
+}
+
+// Función que apunta el tiempo que el titular ha tenido el bloqueo (antes de soltarlo)
+static void anotarLiberacion(BloqueoPerfilado *bloqueo) {
+    int titular = __atomic_load_n(&bloqueo->titular, __ATOMIC_RELAXED);
+    if (titular != TITULAR_PERFIL_DESCONOCIDO) {
+        registrarDuracionHistograma(&entradas_perfil[titular].retencion, obtener_nanosegundos_monotonicos() - bloqueo->adquirido_ns);
+        __atomic_store_n(&bloqueo->titular, TITULAR_PERFIL_DESCONOCIDO, __ATOMIC_RELAXED);
+    }
+}
+
+// Función que bloquea un mutex apuntando la espera desde "sitio"
+void bloquearMutexPerfilado(BloqueoPerfilado *bloqueo, pthread_mutex_t *mutex, const char *sitio) {
+    if (!__atomic_load_n(&perfil_bloqueos_activo, __ATOMIC_RELAXED)) {
+        pthread_mutex_lock(mutex);
+        return;
+    }
+    int indice = entradaPerfil(bloqueo, sitio);
+    long long inicio_ns = obtener_nanosegundos_monotonicos();
+    int con_espera = 0;
+    int titular = TITULAR_PERFIL_DESCONOCIDO;
+    if (pthread_mutex_trylock(mutex) != 0) {
+        con_espera = 1;
+        titular = __atomic_load_n(&bloqueo->titular, __ATOMIC_RELAXED);
+        pthread_mutex_lock(mutex);
+    }
+    anotarAdquisicion(bloqueo, indice, con_espera, titular, inicio_ns);
+}
+
+// Función que desbloquea un mutex apuntando el tiempo que se ha tenido
+void desbloquearMutexPerfilado(BloqueoPerfilado *bloqueo, pthread_mutex_t *mutex) {
+    anotarLiberacion(bloqueo);
+    pthread_mutex_unlock(mutex);
+}
+
+// Función que espera un semáforo apuntando la espera desde "sitio"
+void esperarSemaforoPerfilado(BloqueoPerfilado *bloqueo, sem_t *semaforo, const char *sitio) {
+    if (!__atomic_load_n(&perfil_bloqueos_activo, __ATOMIC_RELAXED)) {
+        sem_wait(semaforo);
+        return;
+    }
+    int indice = entradaPerfil(bloqueo, sitio);
+    long long inicio_ns = obtener_nanosegundos_monotonicos();
+    int con_espera = 0;
+    int titular = TITULAR_PERFIL_DESCONOCIDO;
+    if (sem_trywait(semaforo) != 0) {
+        con_espera = 1;
+        titular = __atomic_load_n(&bloqueo->titular, __ATOMIC_RELAXED);
+        sem_wait(semaforo);
+    }
+    anotarAdquisicion(bloqueo, indice, con_espera, titular, inicio_ns);
+}
+
+// Función que libera un semáforo apuntando el tiempo que se ha tenido
+void liberarSemaforoPerfilado(BloqueoPerfilado *bloqueo, sem_t *semaforo) {
+    anotarLiberacion(bloqueo);
+    sem_post(semaforo);
+}
+
+// Copia de una entrada para el informe (los datos se leen mientras los hilos siguen sumando)
+typedef struct RESUMEN_PERFIL_BLOQUEOS {
+    int indice;
+    uint64_t adquisiciones;
+    uint64_t con_espera;
+    HistogramaMetricas espera;
+    HistogramaMetricas retencion;
+} ResumenPerfilBloqueos;
+
+// Función que copia un histograma leyendo cada valor de forma atómica
+static void copiarHistogramaPerfil(const HistogramaMetricas *origen, HistogramaMetricas *destino) {
+    for (int c = 0; c < NUM_CUBOS_METRICAS; c++) {
+        destino->cubos[c] = __atomic_load_n(&origen->cubos[c], __ATOMIC_RELAXED);
+    }
+    destino->suma_ns = __atomic_load_n(&origen->suma_ns, __ATOMIC_RELAXED);
+    destino->maximo_ns = __atomic_load_n(&origen->maximo_ns, __ATOMIC_RELAXED);
+}
+
+// Función que escribe media, p99 y máximo (ms) de un histograma
+static void escribirHistogramaPerfil(FILE *informe, const HistogramaMetricas *histograma) {
+    uint64_t total = 0;
+    for (int c = 0; c < NUM_CUBOS_METRICAS; c++) {
+        total += histograma->cubos[c];
+    }
+    double p99 = 0;
+    uint64_t objetivo = (total * 99 + 99) / 100;
+    uint64_t acumulado = 0;
+    for (int c = 0; c < NUM_CUBOS_METRICAS && total > 0; c++) {
+        acumulado += histograma->cubos[c];
+        if (acumulado >= objetivo) {
+            p99 = limiteCuboMetricas(c) / 1000000.0;
+            break;
+        }
+    }
+    fprintf(informe, " %10.3f %10.3f %10.3f", total > 0 ? histograma->suma_ns / 1000000.0 / total : 0, p99, histograma->maximo_ns / 1000000.0);
+}
+
+// Función de orden de las entradas: primero las que más han esperado
+static int compararResumenesPerfil(const void *a, const void *b) {
+    const ResumenPerfilBloqueos *ra = a, *rb = b;
+    return ra->espera.suma_ns < rb->espera.suma_ns ? 1 : ra->espera.suma_ns > rb->espera.suma_ns ? -1 : 0;
+}
+
+// Función que escribe el nombre de quien tenía el bloqueo
+static void escribirTitularPerfil(FILE *informe, int titular) {
+    if (titular == TITULAR_PERFIL_DESCONOCIDO) {
+        fprintf(informe, "otro proceso o recién liberado");
+    } else {
+        fprintf(informe, "%s en %s", entradas_perfil[titular].hilo, entradas_perfil[titular].sitio);
+    }
+}
+
+// Función que añade el informe del perfil de bloqueos a LOCK_PROFILING_FILE (SIGUSR1 y al terminar)
+// Los bloqueos aparecen de más a menos tiempo total de espera. Devuelve EXIT_SUCCESS o -1 si el perfil
+// no está activo, no se puede abrir el fichero o ya se está escribiendo otro informe
+int escribirInformePerfilBloqueos(const char *motivo) {
+    if (!__atomic_load_n(&perfil_bloqueos_activo, __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+    // trylock: al terminar se puede llamar desde un manejador de señal que ha interrumpido otro informe
+    if (pthread_mutex_trylock(&mutex_informe_perfil) != 0) {
+        return -1;
+    }
+    FILE *informe = fopen(fichero_informe_perfil, "a");
+    int num_entradas = __atomic_load_n(&num_entradas_perfil, __ATOMIC_ACQUIRE);
+    if (num_entradas > MAX_ENTRADAS_PERFIL_BLOQUEOS) {
+        num_entradas = MAX_ENTRADAS_PERFIL_BLOQUEOS;
+    }
+    ResumenPerfilBloqueos *resumenes = malloc((num_entradas > 0 ? num_entradas : 1) * sizeof(ResumenPerfilBloqueos));
+    if (informe == NULL || resumenes == NULL) {
+        if (informe != NULL) {
+            fclose(informe);
+        }
+        free(resumenes);
+        pthread_mutex_unlock(&mutex_informe_perfil);
+        return -1;
+    }
+
+    // Copia de las entradas publicadas y bloqueos distintos
+    int num_resumenes = 0;
+    const BloqueoPerfilado *bloqueos[MAX_BLOQUEOS_INFORME_PERFIL];
+    uint64_t espera_bloqueos[MAX_BLOQUEOS_INFORME_PERFIL];
+    int num_bloqueos = 0;
+    for (int i = 0; i < num_entradas; i++) {
+        EntradaPerfilBloqueos *entrada = &entradas_perfil[i];
+        if (!__atomic_load_n(&entrada->publicada, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+        int b = 0;
+        while (b < num_bloqueos && bloqueos[b] != entrada->bloqueo) {
+            b++;
+        }
+        if (b == num_bloqueos) {
+            if (num_bloqueos == MAX_BLOQUEOS_INFORME_PERFIL) {
+                continue;
+            }
+            bloqueos[num_bloqueos] = entrada->bloqueo;
+            espera_bloqueos[num_bloqueos++] = 0;
+        }
+        ResumenPerfilBloqueos *resumen = &resumenes[num_resumenes++];
+        resumen->indice = i;
+        resumen->adquisiciones = __atomic_load_n(&entrada->adquisiciones, __ATOMIC_RELAXED);
+        resumen->con_espera = __atomic_load_n(&entrada->con_espera, __ATOMIC_RELAXED);
+        copiarHistogramaPerfil(&entrada->espera, &resumen->espera);
+        copiarHistogramaPerfil(&entrada->retencion, &resumen->retencion);
+        espera_bloqueos[b] += resumen->espera.suma_ns;
+    }
+    qsort(resumenes, num_resumenes, sizeof(ResumenPerfilBloqueos), compararResumenesPerfil);
+
+    char fecha[32];
+    time_t ahora = time(NULL);
+    struct tm tm_ahora;
+    strftime(fecha, sizeof(fecha), "%Y-%m-%d %H:%M:%S", localtime_r(&ahora, &tm_ahora));
+    fprintf(informe, "==== Perfil de bloqueos de %s (pid %d) %s - %s ====\n", proceso_perfil, (int)getpid(), fecha, motivo);
+
+    if (num_bloqueos == 0) {
+        fprintf(informe, "Ningún bloqueo perfilado se ha utilizado todavía\n");
+    }
+
+    // Bloqueos de más a menos espera
+    for (int n = 0; n < num_bloqueos; n++) {
+        int b = n;
+        for (int otro = n + 1; otro < num_bloqueos; otro++) {
+            if (espera_bloqueos[otro] > espera_bloqueos[b]) {
+                b = otro;
+            }
+        }
+        const BloqueoPerfilado *bloqueo = bloqueos[b];
+        uint64_t espera_ns = espera_bloqueos[b];
+        bloqueos[b] = bloqueos[n];
+        espera_bloqueos[b] = espera_bloqueos[n];
+
+        uint64_t adquisiciones = 0, con_espera = 0, retencion_ns = 0;
+        for (int r = 0; r < num_resumenes; r++) {
+            if (entradas_perfil[resumenes[r].indice].bloqueo == bloqueo) {
+                adquisiciones += resumenes[r].adquisiciones;
+                con_espera += resumenes[r].con_espera;
+                retencion_ns += resumenes[r].retencion.suma_ns;
+            }
+        }
+        fprintf(informe, "\n-- %s: %llu adquisiciones, %llu con espera (%.1f%%), espera total %.3f ms, retención total %.3f ms\n",
+            bloqueo->nombre, (unsigned long long)adquisiciones, (unsigned long long)con_espera,
+            adquisiciones > 0 ? 100.0 * con_espera / adquisiciones : 0, espera_ns / 1000000.0, retencion_ns / 1000000.0);
+        fprintf(informe, "   %-40s %-24s %10s %10s %10s %10s %10s %10s %10s %10s\n", "sitio", "hilo", "n", "esperas",
+            "esp. media", "esp. p99", "esp. max", "ret. media", "ret. p99", "ret. max");
+        for (int r = 0; r < num_resumenes; r++) {
+            const EntradaPerfilBloqueos *entrada = &entradas_perfil[resumenes[r].indice];
+            if (entrada->bloqueo != bloqueo) {
+                continue;
+            }
+            fprintf(informe, "   %-40s %-24s %10llu %10llu", entrada->sitio, entrada->hilo,
+                (unsigned long long)resumenes[r].adquisiciones, (unsigned long long)resumenes[r].con_espera);
+            escribirHistogramaPerfil(informe, &resumenes[r].espera);
+            escribirHistogramaPerfil(informe, &resumenes[r].retencion);
+            fprintf(informe, "\n");
+        }
+
+        // Quién lo tenía mientras se esperaba
+        fprintf(informe, "   Titular al empezar cada espera:\n");
+        if (con_espera == 0) {
+            fprintf(informe, "      Ninguna espera\n");
+        }
+        for (int r = 0; r < num_resumenes; r++) {
+            const EntradaPerfilBloqueos *entrada = &entradas_perfil[resumenes[r].indice];
+            if (entrada->bloqueo != bloqueo) {
+                continue;
+            }
+            int num_titulares = __atomic_load_n(&entrada->num_titulares, __ATOMIC_ACQUIRE);
+            for (int t = 0; t < num_titulares; t++) {
+                fprintf(informe, "      %s en %s esperó %llu veces (%.3f ms) a ", entrada->hilo, entrada->sitio,
+                    (unsigned long long)__atomic_load_n(&entrada->titulares[t].veces, __ATOMIC_RELAXED),
+                    __atomic_load_n(&entrada->titulares[t].espera_ns, __ATOMIC_RELAXED) / 1000000.0);
+                escribirTitularPerfil(informe, entrada->titulares[t].entrada);
+                fprintf(informe, "\n");
+            }
+            uint64_t otros = __atomic_load_n(&entrada->otros_titulares_veces, __ATOMIC_RELAXED);
+            if (otros > 0) {
+                fprintf(informe, "      %s en %s esperó %llu veces (%.3f ms) a otros titulares\n", entrada->hilo, entrada->sitio,
+                    (unsigned long long)otros, __atomic_load_n(&entrada->otros_titulares_espera_ns, __ATOMIC_RELAXED) / 1000000.0);
+            }
+        }
+    }
+    uint64_t perdidas = __atomic_load_n(&entradas_perfil_perdidas, __ATOMIC_RELAXED);
+    if (perdidas > 0) {
+        fprintf(informe, "\nAdquisiciones sin contar por falta de entradas: %llu\n", (unsigned long long)perdidas);
+    }
+    fprintf(informe, "\n");
+
+    fclose(informe);
+    free(resumenes);
+    pthread_mutex_unlock(&mutex_informe_perfil);
+    return EXIT_SUCCESS;
+}
+#pragma endregion PerfilBloqueos
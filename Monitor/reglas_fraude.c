@@ -0,0 +1,652 @@
+// ------------------------------------------------------------------
+// LENGUAJE DE REGLAS PARA PATRONES DE FRAUDE DEFINIDOS POR EL USUARIO
+// ------------------------------------------------------------------
+
+#include "reglas_fraude.h"
+#include "log_files.h"
+
+#include <ctype.h>          // isspace, isalpha, isdigit, tolower
+#include <stdarg.h>         // Mensajes de error con formato
+
+#pragma region ReglasFraude
+/*
+    Las reglas se escriben en el fichero RULES_FILE, una por línea, con el formato
+        nombre: group by <grupo>, <ventana> [where <condición> [and <condición>...]] having <agregado> <comparador> <número>
+
+    grupo:      user, branch (se pueden poner los dos)
+    ventana:    second(start), minute(start), hour(start) o day(start); con end se utiliza la fecha-hora
+                de fin y con un segundo parámetro se agrupan varios cubos: hour(start, 3)
+    condición:  <campo> <comparador> <valor>
+                campos numéricos: amount, type, duration (segundos entre inicio y fin)
+                campos de texto (sólo = y !=): status, branch, user, operation
+    agregado:   count(*), sum(campo), min(campo), max(campo), count_distinct(type)
+    comparador: <, <=, >, >=, =, !=
+
+    Ejemplo:
+        retiradas_dia: group by user, day(start) where amount < 0 having sum(amount) < -500
+
+    Cada regla se compila al cargar el fichero: la cláusula where se convierte en una secuencia de
+    instrucciones de comparación y el resto en los parámetros de la ventana y el agregado. Al leer
+    los datos no se vuelve a analizar ningún texto: todas las reglas se evalúan sobre cada registro
+    en una única lectura de los datos consolidados. Esa lectura es la del hilo de reglas: cada patrón
+    lee los datos con su propio cursor y sus propios parámetros, así que no hay una lectura común a
+    patrones y reglas y las reglas sólo comparten la lectura entre ellas.
+
+    El nombre es lo que hay antes del primer ':' que está fuera de comillas y antes de cualquier
+    comparador, de forma que where status = 'a:b' no se toma como nombre.
+
+    Con BATCH_SUMMARIES=1 se saltan los lotes en los que el código de ninguna regla puede cumplirse según
+    su resumen: importes fuera del rango del lote, tipos de operación que no aparecen, status = 'Error'
+    sin errores o user = 'X' fuera del filtro de Bloom. Las condiciones que el resumen no cubre se
+    suponen posibles.
+*/
+
+// Tipos de elementos léxicos de una regla
+typedef enum TIPO_TOKEN {
+    TOKEN_FIN,
+    TOKEN_PALABRA,
+    TOKEN_NUMERO,
+    TOKEN_CADENA,
+    TOKEN_SIMBOLO
+} TipoToken;
+
+// Estado del análisis de una regla
+typedef struct ANALIZADOR_REGLA {
+    const char *posicion;
+    TipoToken tipo;
+    char token[MAX_LONGITUD_VALOR];
+    char *error;
+    size_t longitud_error;
+    int fallo;
+} AnalizadorRegla;
+
+// Función que anota el primer error encontrado al analizar una regla
+static void errorAnalisis(AnalizadorRegla *analizador, const char *formato, ...) {
+    if (analizador->fallo) {
+        return;
+    }
+    analizador->fallo = 1;
+    va_list argumentos;
+    va_start(argumentos, formato);
+    vsnprintf(analizador->error, analizador->longitud_error, formato, argumentos);
+    va_end(argumentos);
+}
+
+// Función que lee el siguiente elemento léxico de la regla
+// Las palabras se pasan a minúsculas; los textos pueden ir entre comillas simples o dobles
+static void siguienteToken(AnalizadorRegla *analizador) {
+    const char *p = analizador->posicion;
+    size_t longitud = 0;
+    while (isspace((unsigned char)*p)) {
+        p++;
+    }
+    analizador->token[0] = '\0';
+
+    if (*p == '\0') {
+        analizador->tipo = TOKEN_FIN;
+    } else if (isalpha((unsigned char)*p) || *p == '_') {
+        analizador->tipo = TOKEN_PALABRA;
+        while (isalnum((unsigned char)*p) || *p == '_') {
+            if (longitud < sizeof(analizador->token) - 1) {
+                analizador->token[longitud++] = (char)tolower((unsigned char)*p);
+            }
+            p++;
+        }
+    } else if (isdigit((unsigned char)*p) || (*p == '-' && isdigit((unsigned char)p[1]))) {
+        analizador->tipo = TOKEN_NUMERO;
+        do {
+            if (longitud < sizeof(analizador->token) - 1) {
+                analizador->token[longitud++] = *p;
+            }
+            p++;
+        } while (isdigit((unsigned char)*p));
+    } else if (*p == '\'' || *p == '"') {
+        char comillas = *p++;
+        analizador->tipo = TOKEN_CADENA;
+        while (*p != '\0' && *p != comillas) {
+            if (longitud < sizeof(analizador->token) - 1) {
+                analizador->token[longitud++] = *p;
+            }
+            p++;
+        }
+        if (*p == comillas) {
+            p++;
+        } else {
+            errorAnalisis(analizador, "texto sin cerrar");
+        }
+    } else {
+        analizador->tipo = TOKEN_SIMBOLO;
+        // Símbolos de dos caracteres
+        if ((p[0] == '<' || p[0] == '>' || p[0] == '!' || p[0] == '=') && p[1] == '=') {
+            analizador->token[longitud++] = *p++;
+        } else if (p[0] == '<' && p[1] == '>') {
+            analizador->token[longitud++] = *p++;
+        }
+        analizador->token[longitud++] = *p++;
+    }
+    analizador->token[longitud] = '\0';
+    analizador->posicion = p;
+}
+
+// Funciones de ayuda para reconocer y exigir elementos léxicos
+static int esPalabra(AnalizadorRegla *analizador, const char *palabra) {
+    return analizador->tipo == TOKEN_PALABRA && strcmp(analizador->token, palabra) == 0;
+}
+
+static int esSimbolo(AnalizadorRegla *analizador, const char *simbolo) {
+    return analizador->tipo == TOKEN_SIMBOLO && strcmp(analizador->token, simbolo) == 0;
+}
+
+static void esperarPalabra(AnalizadorRegla *analizador, const char *palabra) {
+    if (!esPalabra(analizador, palabra)) {
+        errorAnalisis(analizador, "se esperaba '%s' y se encontró '%s'", palabra, analizador->token);
+    }
+    siguienteToken(analizador);
+}
+
+static void esperarSimbolo(AnalizadorRegla *analizador, const char *simbolo) {
+    if (!esSimbolo(analizador, simbolo)) {
+        errorAnalisis(analizador, "se esperaba '%s' y se encontró '%s'", simbolo, analizador->token);
+    }
+    siguienteToken(analizador);
+}
+
+static int esperarNumero(AnalizadorRegla *analizador) {
+    int valor = 0;
+    if (analizador->tipo != TOKEN_NUMERO) {
+        errorAnalisis(analizador, "se esperaba un número y se encontró '%s'", analizador->token);
+    } else {
+        valor = atoi(analizador->token);
+    }
+    siguienteToken(analizador);
+    return valor;
+}
+
+// Función que reconoce un campo de registro. Devuelve 1 si es numérico, 0 si es de texto y -1 si no existe
+static int analizarCampo(AnalizadorRegla *analizador, CampoRegla *campo) {
+    static const struct {const char *nombre; CampoRegla campo; int numerico;} campos[] = {
+        {"amount", CAMPO_IMPORTE, 1},
+        {"type", CAMPO_TIPO, 1},
+        {"duration", CAMPO_DURACION, 1},
+        {"status", CAMPO_ESTADO, 0},
+        {"branch", CAMPO_SUCURSAL, 0},
+        {"user", CAMPO_USUARIO, 0},
+        {"operation", CAMPO_OPERACION, 0},
+    };
+    for (size_t i = 0; i < sizeof(campos) / sizeof(campos[0]); i++) {
+        if (esPalabra(analizador, campos[i].nombre)) {
+            *campo = campos[i].campo;
+            siguienteToken(analizador);
+            return campos[i].numerico;
+        }
+    }
+    errorAnalisis(analizador, "campo desconocido '%s'", analizador->token);
+    siguienteToken(analizador);
+    return -1;
+}
+
+static ComparadorRegla analizarComparador(AnalizadorRegla *analizador) {
+    static const struct {const char *simbolo; ComparadorRegla comparador;} comparadores[] = {
+        {"<", COMPARADOR_MENOR}, {"<=", COMPARADOR_MENOR_IGUAL},
+        {">", COMPARADOR_MAYOR}, {">=", COMPARADOR_MAYOR_IGUAL},
+        {"=", COMPARADOR_IGUAL}, {"==", COMPARADOR_IGUAL},
+        {"!=", COMPARADOR_DISTINTO}, {"<>", COMPARADOR_DISTINTO},
+    };
+    for (size_t i = 0; i < sizeof(comparadores) / sizeof(comparadores[0]); i++) {
+        if (esSimbolo(analizador, comparadores[i].simbolo)) {
+            siguienteToken(analizador);
+            return comparadores[i].comparador;
+        }
+    }
+    errorAnalisis(analizador, "se esperaba un comparador y se encontró '%s'", analizador->token);
+    siguienteToken(analizador);
+    return COMPARADOR_IGUAL;
+}
+
+// group by user, branch, day(start)
+static void analizarAgrupacion(AnalizadorRegla *analizador, ReglaFraude *regla) {
+    static const char *ventanas[] = {"second", "minute", "hour", "day"};
+    int hay_ventana = 0;
+
+    esperarPalabra(analizador, "group");
+    esperarPalabra(analizador, "by");
+    do {
+        if (hay_ventana || regla->agrupar_usuario || regla->agrupar_sucursal) {
+            // Separador entre elementos de la agrupación
+            siguienteToken(analizador);
+        }
+        if (esPalabra(analizador, "user")) {
+            regla->agrupar_usuario = 1;
+            siguienteToken(analizador);
+            continue;
+        }
+        if (esPalabra(analizador, "branch")) {
+            regla->agrupar_sucursal = 1;
+            siguienteToken(analizador);
+            continue;
+        }
+        int encontrada = 0;
+        for (int g = GRANULARIDAD_SEGUNDO; g <= GRANULARIDAD_DIA; g++) {
+            if (esPalabra(analizador, ventanas[g])) {
+                regla->ventana.granularidad = (Granularidad)g;
+                encontrada = 1;
+            }
+        }
+        if (!encontrada) {
+            errorAnalisis(analizador, "se esperaba user, branch o una ventana y se encontró '%s'", analizador->token);
+            return;
+        }
+        hay_ventana = 1;
+        siguienteToken(analizador);
+        esperarSimbolo(analizador, "(");
+        if (esPalabra(analizador, "end")) {
+            regla->usar_fecha_fin = 1;
+            siguienteToken(analizador);
+        } else {
+            esperarPalabra(analizador, "start");
+        }
+        if (esSimbolo(analizador, ",")) {
+            siguienteToken(analizador);
+            regla->ventana.longitud_ventana = esperarNumero(analizador);
+            if (regla->ventana.longitud_ventana < 1) {
+                errorAnalisis(analizador, "la longitud de la ventana tiene que ser mayor que 0");
+            }
+        }
+        esperarSimbolo(analizador, ")");
+    } while (!analizador->fallo && esSimbolo(analizador, ","));
+
+    if (!hay_ventana) {
+        errorAnalisis(analizador, "falta la ventana de tiempo (second, minute, hour o day)");
+    } else if (!regla->agrupar_usuario && !regla->agrupar_sucursal) {
+        errorAnalisis(analizador, "hay que agrupar por user o branch");
+    }
+}
+
+// where campo comparador valor [and ...]
+static void analizarCondiciones(AnalizadorRegla *analizador, ReglaFraude *regla) {
+    do {
+        siguienteToken(analizador);     // where / and
+        if (regla->num_instrucciones >= MAX_CONDICIONES_REGLA) {
+            errorAnalisis(analizador, "demasiadas condiciones (máximo %d)", MAX_CONDICIONES_REGLA);
+            return;
+        }
+        InstruccionRegla *instruccion = &regla->codigo[regla->num_instrucciones];
+        memset(instruccion, 0, sizeof(*instruccion));
+        int numerico = analizarCampo(analizador, &instruccion->campo);
+        instruccion->comparador = analizarComparador(analizador);
+        if (numerico == 1) {
+            instruccion->codigo = INSTRUCCION_COMPARAR_ENTERO;
+            instruccion->valor_entero = esperarNumero(analizador);
+        } else if (numerico == 0) {
+            instruccion->codigo = INSTRUCCION_COMPARAR_CADENA;
+            if (instruccion->comparador != COMPARADOR_IGUAL && instruccion->comparador != COMPARADOR_DISTINTO) {
+                errorAnalisis(analizador, "los campos de texto sólo admiten = y !=");
+            }
+            if (analizador->tipo != TOKEN_CADENA) {
+                errorAnalisis(analizador, "se esperaba un texto entre comillas y se encontró '%s'", analizador->token);
+            }
+            snprintf(instruccion->valor_cadena, sizeof(instruccion->valor_cadena), "%s", analizador->token);
+            siguienteToken(analizador);
+        }
+        regla->num_instrucciones++;
+    } while (!analizador->fallo && esPalabra(analizador, "and"));
+}
+
+// having agregado comparador número
+static void analizarAgregado(AnalizadorRegla *analizador, ReglaFraude *regla) {
+    esperarPalabra(analizador, "having");
+    const char *inicio = analizador->posicion - strlen(analizador->token);
+
+    if (esPalabra(analizador, "count")) {
+        regla->agregado = AGREGADO_CONTAR;
+        siguienteToken(analizador);
+        esperarSimbolo(analizador, "(");
+        esperarSimbolo(analizador, "*");
+    } else if (esPalabra(analizador, "count_distinct")) {
+        regla->agregado = AGREGADO_TIPOS_DISTINTOS;
+        siguienteToken(analizador);
+        esperarSimbolo(analizador, "(");
+        esperarPalabra(analizador, "type");
+    } else {
+        if (esPalabra(analizador, "sum")) {
+            regla->agregado = AGREGADO_SUMA;
+        } else if (esPalabra(analizador, "min")) {
+            regla->agregado = AGREGADO_MINIMO;
+        } else if (esPalabra(analizador, "max")) {
+            regla->agregado = AGREGADO_MAXIMO;
+        } else {
+            errorAnalisis(analizador, "agregado desconocido '%s'", analizador->token);
+            return;
+        }
+        siguienteToken(analizador);
+        esperarSimbolo(analizador, "(");
+        if (analizarCampo(analizador, &regla->campo_agregado) == 0) {
+            errorAnalisis(analizador, "sólo se pueden agregar campos numéricos");
+        }
+    }
+    // Guardar el texto del agregado tal como está escrito para el mensaje de resultado
+    int longitud = (int)(analizador->posicion - inicio);
+    snprintf(regla->texto_agregado, sizeof(regla->texto_agregado), "%.*s", longitud, inicio);
+    esperarSimbolo(analizador, ")");
+
+    regla->comparador = analizarComparador(analizador);
+    regla->umbral = esperarNumero(analizador);
+}
+
+// Función que compila el texto de una regla
+// Devuelve 0 si la regla es correcta o -1 con la descripción del error en error
+int compilarReglaFraude(const char *texto, ReglaFraude *regla, char *error, size_t longitud_error) {
+    AnalizadorRegla analizador;
+    analizador.posicion = texto;
+    analizador.error = error;
+    analizador.longitud_error = longitud_error;
+    analizador.fallo = 0;
+
+    regla->agrupar_usuario = 0;
+    regla->agrupar_sucursal = 0;
+    regla->usar_fecha_fin = 0;
+    regla->ventana.activo = 1;
+    regla->ventana.umbral = 0;
+    regla->ventana.granularidad = GRANULARIDAD_DIA;
+    regla->ventana.longitud_ventana = 1;
+    regla->num_instrucciones = 0;
+    regla->texto_agregado[0] = '\0';
+    regla->registros = NULL;
+
+    siguienteToken(&analizador);
+    analizarAgrupacion(&analizador, regla);
+    if (!analizador.fallo && esPalabra(&analizador, "where")) {
+        analizarCondiciones(&analizador, regla);
+    }
+    if (!analizador.fallo) {
+        analizarAgregado(&analizador, regla);
+    }
+    if (!analizador.fallo && analizador.tipo != TOKEN_FIN) {
+        errorAnalisis(&analizador, "texto sobrante '%s'", analizador.token);
+    }
+    return analizador.fallo ? -1 : 0;
+}
+
+// Función que busca el ':' que separa el nombre de la regla (NULL si la regla no tiene nombre)
+// Sólo cuenta un ':' fuera de comillas y antes del primer comparador
+static char *separadorNombreRegla(char *texto) {
+    char comillas = '\0';
+    for (char *p = texto; *p != '\0'; p++) {
+        if (comillas != '\0') {
+            if (*p == comillas) {
+                comillas = '\0';
+            }
+        } else if (*p == '\'' || *p == '"') {
+            comillas = *p;
+        } else if (*p == ':') {
+            return p;
+        } else if (strchr("<>=!", *p) != NULL) {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+// Función que lee y compila las reglas de un fichero
+// Las reglas con errores se descartan y se indica el motivo en el log
+// Si el fichero no existe se devuelve un conjunto vacío
+ConjuntoReglas *cargarFicheroReglas(const char *nombre_fichero, int primer_numero) {
+    ConjuntoReglas *conjunto = g_new0(ConjuntoReglas, 1);
+    inicializarCursorConsolidado(&conjunto->cursor);
+    conjunto->posicion_resumenes = 0;
+
+    FILE *fichero = fopen(nombre_fichero, "r");
+    if (fichero == NULL) {
+        escribirEnLog(LOG_INFO, "reglas_fraude", "No hay fichero de reglas %s\n", nombre_fichero);
+        return conjunto;
+    }
+
+    char linea[MAX_LONGITUD_REGLA];
+    char error[200];
+    int num_linea = 0;
+    while (fgets(linea, sizeof(linea), fichero)) {
+        num_linea++;
+        linea[strcspn(linea, "\r\n")] = '\0';
+        char *texto = linea;
+        while (isspace((unsigned char)*texto)) {
+            texto++;
+        }
+        // Ignorar líneas vacías y comentarios
+        if (*texto == '\0' || *texto == '#' || *texto == ';') {
+            continue;
+        }
+        if (conjunto->num_reglas >= MAX_REGLAS_FRAUDE) {
+            escribirEnLog(LOG_WARNING, "reglas_fraude", "Se alcanzó el máximo de %d reglas, se ignora el resto del fichero\n", MAX_REGLAS_FRAUDE);
+            break;
+        }
+
+        ReglaFraude *regla = &conjunto->reglas[conjunto->num_reglas];
+        regla->numero = primer_numero + conjunto->num_reglas;
+        // Nombre opcional delante de ':'
+        char *dos_puntos = separadorNombreRegla(texto);
+        if (dos_puntos != NULL) {
+            char *fin_nombre = dos_puntos;
+            while (fin_nombre > texto && isspace((unsigned char)fin_nombre[-1])) {
+                fin_nombre--;
+            }
+            *fin_nombre = '\0';
+            snprintf(regla->nombre, sizeof(regla->nombre), "%s", texto);
+            texto = dos_puntos + 1;
+        } else {
+            snprintf(regla->nombre, sizeof(regla->nombre), "regla_%02d", regla->numero);
+        }
+
+        if (compilarReglaFraude(texto, regla, error, sizeof(error)) != 0) {
+            escribirEnLog(LOG_ERROR, "reglas_fraude", "%s línea %d: regla %s descartada: %s\n", nombre_fichero, num_linea, regla->nombre, error);
+            continue;
+        }
+        regla->registros = crearDiccionarioPatron();
+        conjunto->num_reglas++;
+        escribirEnLog(LOG_INFO, "reglas_fraude", "Regla %02d %s compilada: %d condiciones, ventana %d x %s, having %s\n",
+            regla->numero, regla->nombre, regla->num_instrucciones, regla->ventana.longitud_ventana,
+            nombreGranularidad(regla->ventana.granularidad), regla->texto_agregado);
+    }
+    fclose(fichero);
+    return conjunto;
+}
+
+// Función que libera un conjunto de reglas y sus diccionarios
+void destruirConjuntoReglas(ConjuntoReglas *conjunto) {
+    if (conjunto == NULL) {
+        return;
+    }
+    for (int i = 0; i < conjunto->num_reglas; i++) {
+        g_hash_table_destroy(conjunto->reglas[i].registros);
+    }
+    g_free(conjunto);
+}
+
+// Funciones de evaluación del código compilado
+static int valorEnteroCampo(const RegistroConsolidado *registro, CampoRegla campo) {
+    switch (campo) {
+        case CAMPO_IMPORTE: return registro->importe;
+        case CAMPO_TIPO: return registro->tipoOperacion2;
+        case CAMPO_DURACION: return (int)(registro->instante2 - registro->instante1);
+        default: return 0;
+    }
+}
+
+static const char *valorCadenaCampo(const RegistroConsolidado *registro, CampoRegla campo) {
+    switch (campo) {
+        case CAMPO_ESTADO: return registro->estado;
+        case CAMPO_SUCURSAL: return registro->sucursal;
+        case CAMPO_USUARIO: return registro->usuario;
+        case CAMPO_OPERACION: return registro->tipoOperacion1;
+        default: return "";
+    }
+}
+
+static int compararEnteros(int valor, ComparadorRegla comparador, int referencia) {
+    switch (comparador) {
+        case COMPARADOR_MENOR: return valor < referencia;
+        case COMPARADOR_MENOR_IGUAL: return valor <= referencia;
+        case COMPARADOR_MAYOR: return valor > referencia;
+        case COMPARADOR_MAYOR_IGUAL: return valor >= referencia;
+        case COMPARADOR_IGUAL: return valor == referencia;
+        default: return valor != referencia;
+    }
+}
+
+// Función que ejecuta el código de la cláusula where sobre un registro
+static int ejecutarCodigoRegla(const ReglaFraude *regla, const RegistroConsolidado *registro) {
+    for (int i = 0; i < regla->num_instrucciones; i++) {
+        const InstruccionRegla *instruccion = &regla->codigo[i];
+        int cumple;
+        if (instruccion->codigo == INSTRUCCION_COMPARAR_ENTERO) {
+            cumple = compararEnteros(valorEnteroCampo(registro, instruccion->campo), instruccion->comparador, instruccion->valor_entero);
+        } else {
+            int iguales = strcmp(valorCadenaCampo(registro, instruccion->campo), instruccion->valor_cadena) == 0;
+            cumple = instruccion->comparador == COMPARADOR_IGUAL ? iguales : !iguales;
+        }
+        if (!cumple) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Función que acumula un registro en el agregado de una regla
+static void acumularRegla(const ReglaFraude *regla, RegistroPatron *acumulado, const RegistroConsolidado *registro) {
+    int valor = valorEnteroCampo(registro, regla->campo_agregado);
+    switch (regla->agregado) {
+        case AGREGADO_CONTAR:
+            acumulado->cantidad++;
+            break;
+        case AGREGADO_SUMA:
+            acumulado->cantidad += valor;
+            break;
+        case AGREGADO_MINIMO:
+            if (acumulado->num_registros == 0 || valor < acumulado->cantidad) {
+                acumulado->cantidad = valor;
+            }
+            break;
+        case AGREGADO_MAXIMO:
+            if (acumulado->num_registros == 0 || valor > acumulado->cantidad) {
+                acumulado->cantidad = valor;
+            }
+            break;
+        case AGREGADO_TIPOS_DISTINTOS:
+            if (registro->tipoOperacion2 == 1) {acumulado->operacion1Presente++;}
+            if (registro->tipoOperacion2 == 2) {acumulado->operacion2Presente++;}
+            if (registro->tipoOperacion2 == 3) {acumulado->operacion3Presente++;}
+            if (registro->tipoOperacion2 == 4) {acumulado->operacion4Presente++;}
+            acumulado->cantidad = (acumulado->operacion1Presente > 0) + (acumulado->operacion2Presente > 0)
+                                + (acumulado->operacion3Presente > 0) + (acumulado->operacion4Presente > 0);
+            break;
+    }
+    acumulado->num_registros++;
+}
+
+// Función que evalúa todas las reglas sobre un registro consolidado
+static void procesarRegistroReglas(RegistroConsolidado *registro, void *contexto) {
+    ConjuntoReglas *conjunto = (ConjuntoReglas *)contexto;
+    char grupo[100];
+    for (int i = 0; i < conjunto->num_reglas; i++) {
+        ReglaFraude *regla = &conjunto->reglas[i];
+        long long instante = regla->usar_fecha_fin ? registro->instante2 : registro->instante1;
+        if (instante < 0 || !ejecutarCodigoRegla(regla, registro)) {
+            continue;
+        }
+        if (regla->agrupar_sucursal && regla->agrupar_usuario) {
+            snprintf(grupo, sizeof(grupo), "%s/%s", registro->sucursal, registro->usuario);
+        } else {
+            snprintf(grupo, sizeof(grupo), "%s", regla->agrupar_sucursal ? registro->sucursal : registro->usuario);
+        }
+        long long ancho = anchoVentanaPatron(&regla->ventana);
+        RegistroPatron *acumulado = obtenerRegistroPatron(regla->registros, grupo, instante - instante % ancho, regla->ventana.granularidad);
+        acumularRegla(regla, acumulado, registro);
+    }
+}
+
+// Función que descarta lo acumulado cuando los datos consolidados se vuelven a leer desde el principio
+static void reiniciarConjuntoReglas(void *contexto) {
+    ConjuntoReglas *conjunto = (ConjuntoReglas *)contexto;
+    for (int i = 0; i < conjunto->num_reglas; i++) {
+        g_hash_table_remove_all(conjunto->reglas[i].registros);
+    }
+    conjunto->posicion_resumenes = 0;
+}
+
+// Función que indica si alguna instrucción de una regla no puede cumplirse en ningún registro de un lote
+// Sólo se descartan las condiciones que el resumen permite decidir
+static int instruccionImposibleEnLote(const InstruccionRegla *instruccion, const ResumenLote *resumen) {
+    if (instruccion->codigo == INSTRUCCION_COMPARAR_ENTERO) {
+        if (instruccion->campo == CAMPO_IMPORTE) {
+            // Algún importe del rango [mínimo, máximo] tiene que poder cumplir la comparación
+            int referencia = instruccion->valor_entero;
+            switch (instruccion->comparador) {
+                case COMPARADOR_MENOR: return !(resumen->importe_minimo < referencia);
+                case COMPARADOR_MENOR_IGUAL: return !(resumen->importe_minimo <= referencia);
+                case COMPARADOR_MAYOR: return !(resumen->importe_maximo > referencia);
+                case COMPARADOR_MAYOR_IGUAL: return !(resumen->importe_maximo >= referencia);
+                case COMPARADOR_IGUAL: return referencia < resumen->importe_minimo || referencia > resumen->importe_maximo;
+                default: return resumen->importe_minimo == referencia && resumen->importe_maximo == referencia;
+            }
+        }
+        if (instruccion->campo == CAMPO_TIPO) {
+            // Algún tipo presente en el lote tiene que cumplir la comparación (los de "otros" se suponen posibles)
+            if (resumenPuedeTenerTipo(resumen, BIT_TIPOS_RESUMEN_OTROS)) {
+                return 0;
+            }
+            for (int tipo = 0; tipo < BIT_TIPOS_RESUMEN_OTROS; tipo++) {
+                if (resumenPuedeTenerTipo(resumen, tipo) && compararEnteros(tipo, instruccion->comparador, instruccion->valor_entero)) {
+                    return 0;
+                }
+            }
+            return 1;
+        }
+        return 0;
+    }
+    if (instruccion->campo == CAMPO_ESTADO && strcmp(instruccion->valor_cadena, "Error") == 0) {
+        return instruccion->comparador == COMPARADOR_IGUAL ? resumen->errores == 0 : resumen->errores == resumen->registros;
+    }
+    if (instruccion->campo == CAMPO_USUARIO && instruccion->comparador == COMPARADOR_IGUAL) {
+        return !resumenPuedeTenerUsuario(resumen, instruccion->valor_cadena);
+    }
+    return 0;
+}
+
+// Función que indica si algún registro de un lote puede cumplir el código de alguna regla
+static int relevanteLoteReglas(const ResumenLote *resumen, void *contexto) {
+    ConjuntoReglas *conjunto = (ConjuntoReglas *)contexto;
+    for (int i = 0; i < conjunto->num_reglas; i++) {
+        const ReglaFraude *regla = &conjunto->reglas[i];
+        int posible = 1;
+        for (int j = 0; j < regla->num_instrucciones && posible; j++) {
+            posible = !instruccionImposibleEnLote(&regla->codigo[j], resumen);
+        }
+        if (posible) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Función que acumula en todas las reglas los registros desde la posición del cursor hasta su límite
+static int leerTramoReglas(CursorConsolidado *cursor, void *contexto) {
+    return leerNuevosRegistrosConsolidados(cursor, procesarRegistroReglas, reiniciarConjuntoReglas, contexto);
+}
+
+// Función que acumula en todas las reglas los registros consolidados añadidos desde la ronda anterior
+// Devuelve el número de registros nuevos o -1 si no se han podido leer los datos
+int actualizarConjuntoReglas(ConjuntoReglas *conjunto) {
+    return leerLotesRelevantes(&conjunto->posicion_resumenes, &conjunto->cursor, relevanteLoteReglas, leerTramoReglas, conjunto, "Reglas");
+}
+
+// Función que indica si una ventana cumple la condición having de la regla
+int cumpleReglaFraude(const ReglaFraude *regla, const RegistroPatron *acumulado) {
+    return compararEnteros(acumulado->cantidad, regla->comparador, regla->umbral);
+}
+
+// Función que compone el mensaje de resultado de una ventana que cumple la regla
+void formatearResultadoRegla(char *mensaje, size_t longitud, const ReglaFraude *regla, const RegistroPatron *acumulado) {
+    snprintf(mensaje, longitud, "%02d:::Registro fraude regla %s:::Clave=%s:::%s=%d\n",
+        regla->numero, regla->nombre, acumulado->clave, regla->texto_agregado, acumulado->cantidad);
+}
+
+#pragma endregion ReglasFraude
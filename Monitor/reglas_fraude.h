@@ -0,0 +1,100 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <glib.h>           // Manejo de diccionarios GLib utilizado para la detección de patrones de fraude
+
+#include "constants.h"          // Constantes de la aplicación
+#include "datos_consolidados.h" // Lectura incremental de los datos consolidados
+#include "patrones_fraude.h"    // Ventanas y registros acumulados de los patrones
+#pragma endregion Librerias
+
+
+// Campos de un registro consolidado que se pueden utilizar en una regla
+typedef enum CAMPO_REGLA {
+    CAMPO_IMPORTE,          // amount
+    CAMPO_TIPO,             // type (tipoOperacion2)
+    CAMPO_DURACION,         // duration (segundos entre fechaHora1 y fechaHora2)
+    CAMPO_ESTADO,           // status
+    CAMPO_SUCURSAL,         // branch
+    CAMPO_USUARIO,          // user
+    CAMPO_OPERACION         // operation (tipoOperacion1)
+} CampoRegla;
+
+typedef enum COMPARADOR_REGLA {
+    COMPARADOR_MENOR,
+    COMPARADOR_MENOR_IGUAL,
+    COMPARADOR_MAYOR,
+    COMPARADOR_MAYOR_IGUAL,
+    COMPARADOR_IGUAL,
+    COMPARADOR_DISTINTO
+} ComparadorRegla;
+
+typedef enum AGREGADO_REGLA {
+    AGREGADO_CONTAR,            // count(*)
+    AGREGADO_SUMA,              // sum(campo)
+    AGREGADO_MINIMO,            // min(campo)
+    AGREGADO_MAXIMO,            // max(campo)
+    AGREGADO_TIPOS_DISTINTOS    // count_distinct(type)
+} AgregadoRegla;
+
+// Instrucción del código compilado de la cláusula where
+// El código es una secuencia de comparaciones que se tienen que cumplir todas (and)
+typedef enum CODIGO_INSTRUCCION {
+    INSTRUCCION_COMPARAR_ENTERO,
+    INSTRUCCION_COMPARAR_CADENA
+} CodigoInstruccion;
+
+typedef struct INSTRUCCION_REGLA {
+    CodigoInstruccion codigo;
+    CampoRegla campo;
+    ComparadorRegla comparador;
+    int valor_entero;
+    char valor_cadena[MAX_LONGITUD_VALOR];
+} InstruccionRegla;
+
+// Regla compilada
+// Ejemplo: group by user, day(start) where amount < 0 having sum(amount) < -500
+typedef struct REGLA_FRAUDE {
+    int numero;                                 // Número de la regla (continúa la numeración de los patrones)
+    char nombre[MAX_LONGITUD_CLAVE];
+    int agrupar_usuario;                        // group by user
+    int agrupar_sucursal;                       // group by branch
+    int usar_fecha_fin;                         // day(end) en lugar de day(start)
+    ParametrosPatron ventana;                   // Granularidad y longitud de la ventana
+    InstruccionRegla codigo[MAX_CONDICIONES_REGLA];
+    int num_instrucciones;
+    AgregadoRegla agregado;
+    CampoRegla campo_agregado;
+    ComparadorRegla comparador;                 // having agregado comparador umbral
+    int umbral;
+    char texto_agregado[MAX_LONGITUD_CLAVE];    // Texto del agregado para el mensaje de resultado
+    GHashTable *registros;                      // Clave grupo@inicio de la ventana -> RegistroPatron
+} ReglaFraude;
+
+// Conjunto de reglas leídas de un fichero de reglas
+// Todas las reglas se evalúan en una única lectura de los datos consolidados
+typedef struct CONJUNTO_REGLAS {
+    ReglaFraude reglas[MAX_REGLAS_FRAUDE];
+    int num_reglas;
+    CursorConsolidado cursor;
+    long long posicion_resumenes;   // Posición leída del fichero de resúmenes de lotes (BATCH_SUMMARIES=1)
+} ConjuntoReglas;
+
+
+int compilarReglaFraude(const char *texto, ReglaFraude *regla, char *error, size_t longitud_error);
+
+ConjuntoReglas *cargarFicheroReglas(const char *nombre_fichero, int primer_numero);
+
+void destruirConjuntoReglas(ConjuntoReglas *conjunto);
+
+int actualizarConjuntoReglas(ConjuntoReglas *conjunto);
+
+int cumpleReglaFraude(const ReglaFraude *regla, const RegistroPatron *acumulado);
+
+void formatearResultadoRegla(char *mensaje, size_t longitud, const ReglaFraude *regla, const RegistroPatron *acumulado);
@@ -0,0 +1,178 @@
+// ------------------------------------------------------------------
+// LECTURA DE LOS DATOS CONSOLIDADOS SALTANDO LOS LOTES IRRELEVANTES
+// ------------------------------------------------------------------
+
+#include "resumenes_lotes.h"
+#include "log_files.h"
+#include "config_files.h"
+#include "parametros_configuracion.h"
+
+#pragma region ResumenesLotes
+/*
+    Con BATCH_SUMMARIES=1 FileProcessor añade al fichero SUMMARY_FILE un resumen por cada fichero de
+    sucursal que consolida (ver formato_resumenes.h). Antes de leer los registros nuevos, un lector
+    recorre los resúmenes que siguen a su cursor:
+        - el lote empieza en la posición del cursor y no le interesa: el cursor pasa al final del lote
+          sin leer sus registros
+        - el lote empieza en la posición del cursor y le interesa: se leen sus registros (con el límite
+          del cursor en el final del lote) y se sigue con el siguiente
+        - el lote termina antes de la posición del cursor: sus registros ya se han leído, se salta
+        - el lote es de otros datos consolidados (otra identidad): se salta
+        - en cualquier otro caso (o si el lote pasa de la marca de confirmación) se deja de leer resúmenes
+    Lo que quede se lee de los datos consolidados como si no hubiera resúmenes. Igual que con los agregados
+    parciales, hasta que el cursor no ha leído una vez los datos no se conoce su identidad, así que los
+    resúmenes sólo se utilizan a partir de la segunda lectura.
+*/
+
+// Función que convierte un dígito hexadecimal (-1 si no lo es)
+static int valorHexadecimal(char caracter) {
+    if (caracter >= '0' && caracter <= '9') {
+        return caracter - '0';
+    }
+    if (caracter >= 'a' && caracter <= 'f') {
+        return caracter - 'a' + 10;
+    }
+    return -1;
+}
+
+// Función que lee una línea completa (terminada en \n) de resumen
+// Devuelve 0 o -1 si la línea no está completa o no es un resumen válido
+static int leerResumenLote(FILE *fichero, char *linea, size_t longitud, OrigenDatosConsolidados origen, ResumenLote *resumen) {
+    if (fgets(linea, (int)longitud, fichero) == NULL) {
+        return -1;
+    }
+    size_t largo = strlen(linea);
+    if (largo < 2 || linea[0] != 'R' || linea[1] != ';' || linea[largo - 1] != '\n') {
+        return -1;
+    }
+    linea[largo - 1] = '\0';
+    char *campos[18];
+    int num_campos = 0;
+    char *inicio = linea + 2;
+    while (num_campos < 18) {
+        campos[num_campos++] = inicio;
+        char *separador = strchr(inicio, ';');
+        if (separador == NULL) {
+            break;
+        }
+        *separador = '\0';
+        inicio = separador + 1;
+    }
+    if (num_campos != 17) {
+        return -1;
+    }
+    // Los rangos y las identidades están en el orden de OrigenDatosConsolidados: fichero, memoria, columnar
+    resumen->desde = atoll(campos[2 * origen]);
+    resumen->hasta = atoll(campos[1 + 2 * origen]);
+    if (sscanf(campos[6 + origen], "%llu:%llu", &resumen->dispositivo, &resumen->inodo) != 2) {
+        return -1;
+    }
+    resumen->registros = atoi(campos[9]);
+    resumen->importe_minimo = atoi(campos[10]);
+    resumen->importe_maximo = atoi(campos[11]);
+    resumen->errores = atoi(campos[12]);
+    resumen->tipos = (uint32_t)strtoul(campos[13], NULL, 10);
+    resumen->instante_minimo = atoll(campos[14]);
+    resumen->instante_maximo = atoll(campos[15]);
+
+    size_t digitos = strlen(campos[16]);
+    if (digitos % 2 != 0 || digitos / 2 > sizeof(resumen->bloom)) {
+        return -1;
+    }
+    resumen->bits_bloom = (int)(digitos / 2 * 8);
+    for (size_t i = 0; i < digitos / 2; i++) {
+        int alto = valorHexadecimal(campos[16][2 * i]);
+        int bajo = valorHexadecimal(campos[16][2 * i + 1]);
+        if (alto < 0 || bajo < 0) {
+            return -1;
+        }
+        resumen->bloom[i] = (unsigned char)(alto * 16 + bajo);
+    }
+    return 0;
+}
+
+// Función que indica si un lote puede tener registros de un tipo de operación 2
+int resumenPuedeTenerTipo(const ResumenLote *resumen, int tipo) {
+    int bit = tipo >= 0 && tipo < BIT_TIPOS_RESUMEN_OTROS ? tipo : BIT_TIPOS_RESUMEN_OTROS;
+    return (resumen->tipos >> bit) & 1u;
+}
+
+// Función que indica si un lote puede tener registros de un usuario (filtro de Bloom)
+// Sin filtro de Bloom se supone que sí
+int resumenPuedeTenerUsuario(const ResumenLote *resumen, const char *usuario) {
+    for (int i = 0; i < HASHES_BLOOM_RESUMEN && resumen->bits_bloom > 0; i++) {
+        uint32_t bit = posicionBloomResumen(usuario, i, (uint32_t)resumen->bits_bloom);
+        if ((resumen->bloom[bit / 8] & (1u << (bit % 8))) == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Función que lee los registros nuevos saltando los lotes que no le interesan al lector
+// posicion_resumenes guarda entre rondas hasta dónde se ha leído el fichero de resúmenes
+// Devuelve el número de registros leídos o -1 si no se han podido leer los datos
+int leerLotesRelevantes(long long *posicion_resumenes, CursorConsolidado *cursor, RelevanciaLote relevante, LeerTramoConsolidado leer,
+    void *contexto, const char *nombre_lector) {
+    FILE *fichero = NULL;
+    if ((cursor->inodo != 0 || cursor->dispositivo != 0) && obtenerParametros()->resumenes_lotes) {
+        char nombre_fichero[PATH_MAX];
+        snprintf(nombre_fichero, sizeof(nombre_fichero), "%s/%s", obtenerParametros()->carpeta_datos, obtenerParametros()->fichero_resumenes);
+        fichero = fopen(nombre_fichero, "r");
+    }
+
+    int num_registros = 0;
+    int lotes_saltados = 0;
+    int registros_saltados = 0;
+    if (fichero != NULL) {
+        OrigenDatosConsolidados origen = obtenerOrigenDatosConsolidados();
+        char *linea = malloc(LONGITUD_MAXIMA_RESUMEN);
+        ResumenLote *resumen = malloc(sizeof(ResumenLote));
+        while (fseek(fichero, *posicion_resumenes, SEEK_SET) == 0
+            && leerResumenLote(fichero, linea, LONGITUD_MAXIMA_RESUMEN, origen, resumen) == 0) {
+            long long fin_resumen = ftell(fichero);
+            if (resumen->dispositivo != (unsigned long long)cursor->dispositivo || resumen->inodo != (unsigned long long)cursor->inodo
+                || resumen->hasta <= cursor->posicion) {
+                // Lote de un consolidado anterior o registros ya leídos
+                *posicion_resumenes = fin_resumen;
+                continue;
+            }
+            long long limite = obtenerLimiteLecturaConsolidado(cursor, origen);
+            if (resumen->desde != cursor->posicion || (limite >= 0 && resumen->hasta > limite)) {
+                break;
+            }
+            if (resumen->registros == 0 || !relevante(resumen, contexto)) {
+                cursor->posicion = resumen->hasta;
+                lotes_saltados++;
+                registros_saltados += resumen->registros;
+            } else {
+                cursor->limite = resumen->hasta;
+                int leidos = leer(cursor, contexto);
+                cursor->limite = -1;
+                if (leidos == -1) {
+                    num_registros = -1;
+                    break;
+                }
+                num_registros += leidos;
+                if (cursor->posicion != resumen->hasta) {
+                    // Los datos han cambiado de identidad o no se han leído completos: se sigue sin resúmenes
+                    break;
+                }
+            }
+            *posicion_resumenes = fin_resumen;
+        }
+        free(resumen);
+        free(linea);
+        fclose(fichero);
+    }
+    if (lotes_saltados > 0) {
+        escribirEnLog(LOG_INFO, "resumenes_lotes", "%s: %d lotes saltados sin leer (%d registros)\n", nombre_lector, lotes_saltados, registros_saltados);
+    }
+    if (num_registros == -1) {
+        return -1;
+    }
+    int leidos = leer(cursor, contexto);
+    return leidos == -1 ? -1 : num_registros + leidos;
+}
+
+#pragma endregion ResumenesLotes
@@ -0,0 +1,50 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <stdint.h>         // Enteros de tamaño fijo para la máscara de tipos
+#include <linux/limits.h>   // Define varias constantes que representan los límites del sistema en sistemas operativos Linux
+
+#include "constants.h"          // Constantes de la aplicación
+#include "formato_resumenes.h"  // Formato del fichero de resúmenes de lotes
+#include "datos_consolidados.h" // Cursor y límite de lectura de los datos consolidados
+#pragma endregion Librerias
+
+
+// Resumen de un lote consolidado por FileProcessor
+typedef struct RESUMEN_LOTE {
+    long long desde;            // Bytes que ocupa el lote en los datos consolidados que se leen
+    long long hasta;
+    unsigned long long dispositivo;  // Identidad de los datos consolidados que se leen cuando se escribió el lote
+    unsigned long long inodo;
+    int registros;
+    int importe_minimo;
+    int importe_maximo;
+    int errores;                // Registros con estado Error
+    uint32_t tipos;             // Máscara de tipos de operación 2 (ver formato_resumenes.h)
+    long long instante_minimo;
+    long long instante_maximo;
+    int bits_bloom;             // 0: el lote no tiene filtro de Bloom
+    unsigned char bloom[MAX_BITS_BLOOM_RESUMEN / 8];
+} ResumenLote;
+
+// Función que indica si un lote puede tener registros que interesan al lector
+// Devuelve 1 si hay que leer el lote o 0 si se puede saltar
+typedef int (*RelevanciaLote)(const ResumenLote *resumen, void *contexto);
+
+// Función que lee los registros desde la posición del cursor hasta su límite
+// Devuelve el número de registros leídos o -1 si no se han podido leer los datos
+typedef int (*LeerTramoConsolidado)(CursorConsolidado *cursor, void *contexto);
+
+
+int resumenPuedeTenerTipo(const ResumenLote *resumen, int tipo);
+
+int resumenPuedeTenerUsuario(const ResumenLote *resumen, const char *usuario);
+
+int leerLotesRelevantes(long long *posicion_resumenes, CursorConsolidado *cursor, RelevanciaLote relevante, LeerTramoConsolidado leer,
+    void *contexto, const char *nombre_lector);
@@ -0,0 +1,43 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <time.h>           // Tratamiento de datos temporales
+#include <sys/types.h>      // Definiciones de typos de datos: pid_t, size_t...
+#include <linux/limits.h>   // Define varias constantes que representan los límites del sistema en sistemas operativos Linux
+#pragma endregion Librerias
+
+
+// Rotación de un fichero de log (claves LOG_ROTATE_* del fichero de configuración)
+typedef struct ROTACION_LOG {
+    char nombre[PATH_MAX];          // Fichero que se rota; los rotados son nombre.1 (el más reciente) ... nombre.N
+    long long tamano_maximo;        // Bytes (0 sin rotación por tamaño)
+    int intervalo;                  // Segundos (0 sin rotación por tiempo)
+    int conservar;                  // Ficheros rotados que se conservan
+    int preasignar;                 // Preparar el siguiente fichero con el espacio ya reservado
+    int comprimir;                  // Comprimir con gzip los ficheros rotados
+    time_t apertura;                // Instante en que se empezó el fichero actual
+    long tamano_inicial;            // Tamaño del fichero actual al empezarlo (no se rota por tiempo si no ha crecido)
+    int siguiente;                  // Descriptor del siguiente fichero preparado (-1 si no hay)
+    pid_t compresion;               // gzip en curso (0 si no hay)
+} RotacionLog;
+
+
+void configurarRotacionLog(RotacionLog *rotacion, const char *nombre);
+
+int rotacionLogActiva(const RotacionLog *rotacion);
+
+void empezarFicheroLog(RotacionLog *rotacion, FILE *archivo);
+
+int necesitaRotacionLog(RotacionLog *rotacion, FILE *archivo);
+
+void prepararSiguienteLog(RotacionLog *rotacion);
+
+FILE *rotarLog(RotacionLog *rotacion, FILE *archivo, const char *modo);
+
+void cerrarFicheroLog(FILE *archivo);
+
+void finalizarRotacionLog(RotacionLog *rotacion);
@@ -0,0 +1,91 @@
+// ------------------------------------------------------------------
+// SKETCH COUNT-MIN PARA EL MODO DE CONTEO APROXIMADO
+// ------------------------------------------------------------------
+
+#include "sketch_count_min.h"
+
+#pragma region SketchCountMin
+/*
+    Cada fila del sketch tiene su propia función de hash; al incrementar una clave se incrementa
+    un contador en cada fila y la estimación es el mínimo de esos contadores.
+
+    Se utiliza actualización conservadora: sólo se incrementan los contadores que valen lo mismo que
+    la estimación actual. La estimación sigue siendo una cota superior del valor real pero se acerca
+    mucho más cuando el sketch está cargado.
+
+    Las funciones de hash de las filas se obtienen de dos hash de 64 bits de la clave (h1 + i * h2).
+*/
+
+// Función que calcula el hash FNV-1a de 64 bits de una clave
+static uint64_t hashClave(const char *clave, uint64_t semilla) {
+    uint64_t hash = 14695981039346656037ULL ^ semilla;
+    for (const unsigned char *p = (const unsigned char *)clave; *p != '\0'; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    // Mezcla final para repartir los bits altos
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Función que calcula la posición de la clave en cada fila del sketch
+static void posicionesClave(const SketchCountMin *sketch, const char *clave, size_t *posiciones) {
+    uint64_t h1 = hashClave(clave, 0);
+    uint64_t h2 = hashClave(clave, 0x9e3779b97f4a7c15ULL) | 1;
+    for (int fila = 0; fila < sketch->profundidad; fila++) {
+        posiciones[fila] = (size_t)fila * sketch->anchura + (size_t)((h1 + fila * h2) % (uint64_t)sketch->anchura);
+    }
+}
+
+// Función que crea un sketch que ocupa como máximo memoria_bytes
+// Devuelve NULL si la memoria no alcanza para al menos un contador por fila
+SketchCountMin *crearSketchCountMin(long long memoria_bytes, int profundidad) {
+    if (profundidad < 1) {
+        profundidad = 1;
+    }
+    long long anchura = memoria_bytes / ((long long)sizeof(uint32_t) * profundidad);
+    if (anchura < 1) {
+        return NULL;
+    }
+    SketchCountMin *sketch = malloc(sizeof(SketchCountMin));
+    if (sketch == NULL) {
+        return NULL;
+    }
+    sketch->profundidad = profundidad;
+    sketch->anchura = (int)anchura;
+    sketch->contadores = calloc((size_t)profundidad * anchura, sizeof(uint32_t));
+    if (sketch->contadores == NULL) {
+        free(sketch);
+        return NULL;
+    }
+    return sketch;
+}
+
+// Función que pone a cero todos los contadores
+void vaciarSketchCountMin(SketchCountMin *sketch) {
+    memset(sketch->contadores, 0, (size_t)sketch->profundidad * sketch->anchura * sizeof(uint32_t));
+}
+
+// Función que incrementa en 1 la clave y devuelve la nueva estimación
+uint32_t incrementarSketchCountMin(SketchCountMin *sketch, const char *clave) {
+    size_t posiciones[sketch->profundidad];
+    posicionesClave(sketch, clave, posiciones);
+
+    uint32_t minimo = UINT32_MAX;
+    for (int fila = 0; fila < sketch->profundidad; fila++) {
+        if (sketch->contadores[posiciones[fila]] < minimo) {
+            minimo = sketch->contadores[posiciones[fila]];
+        }
+    }
+    // Actualización conservadora
+    for (int fila = 0; fila < sketch->profundidad; fila++) {
+        if (sketch->contadores[posiciones[fila]] == minimo) {
+            sketch->contadores[posiciones[fila]]++;
+        }
+    }
+    return minimo + 1;
+}
+
+#pragma endregion SketchCountMin
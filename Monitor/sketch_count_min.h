@@ -0,0 +1,28 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <stdint.h>         // Tipos enteros de tamaño fijo
+#pragma endregion Librerias
+
+
+// Sketch Count-Min: estima el número de apariciones de cada clave con una memoria fija
+// La estimación nunca es menor que el valor real y sólo puede ser mayor por colisiones
+// Cada patrón en modo aproximado crea su sketch al arrancar y lo conserva (vaciándolo al volver a leer los datos)
+// mientras dura el hilo del patrón, igual que su diccionario
+typedef struct SKETCH_COUNT_MIN {
+    int profundidad;            // Número de filas (funciones de hash)
+    int anchura;                // Contadores por fila
+    uint32_t *contadores;       // profundidad x anchura contadores
+} SketchCountMin;
+
+SketchCountMin *crearSketchCountMin(long long memoria_bytes, int profundidad);
+
+void vaciarSketchCountMin(SketchCountMin *sketch);
+
+uint32_t incrementarSketchCountMin(SketchCountMin *sketch, const char *clave);
@@ -0,0 +1,364 @@
+// ------------------------------------------------------------------
+// INFORME DE USUARIOS CON MÁS ACTIVIDAD POR VENTANA DE TIEMPO
+// ------------------------------------------------------------------
+
+#include "top_usuarios.h"
+#include "log_files.h"
+
+#pragma region TopUsuarios
+/*
+    Para cada ventana de TOPK_WINDOWS (por defecto la última hora y el último día) se mantienen los TOPK_SIZE
+    usuarios con más operaciones y con más importe retirado, con una memoria fija por ventana aunque haya
+    muchos usuarios:
+        - cada ventana es deslizante y está formada por TOPK_BUCKETS cubos de tiempo; la ventana termina en
+          el cubo de la fecha de inicio más reciente leída, así que "la última hora" se mide con el tiempo
+          de los datos y con la precisión de un cubo
+        - cada cubo tiene un resumen Space-Saving de k contadores por métrica: un usuario que no tiene
+          contador sustituye al de menor cuenta y hereda esa cuenta como error
+        - el informe suma los resúmenes de los cubos de la ventana y ordena los usuarios por el valor
+          estimado; error_maximo indica cuánto puede sobrar en ese valor (0: valor exacto)
+        - un registro cuyo cubo ya ha salido de la ventana se descarta en esa ventana
+    El informe se vuelve a escribir en cada ronda (TOPK_REPORT_FILE) y las primeras posiciones se escriben en
+    el log con las métricas (METRICS_INTERVAL_MS).
+*/
+
+// Columnas que utiliza el informe
+#define COLUMNAS_TOP (MASCARA_COLUMNA(COLUMNA_USUARIO) | MASCARA_COLUMNA(COLUMNA_FECHA_INICIO) | MASCARA_COLUMNA(COLUMNA_IMPORTE))
+
+// Posiciones de cada ventana y métrica que se escriben con las métricas
+#define POSICIONES_METRICAS_TOP 3
+
+static const char *nombres_metricas_top[NUM_METRICAS_TOP] = {"operaciones", "retirado"};
+
+// Función que crea un resumen vacío de capacidad contadores
+SpaceSaving *crearSpaceSaving(int capacidad) {
+    SpaceSaving *resumen = g_new0(SpaceSaving, 1);
+    resumen->capacidad = capacidad;
+    resumen->contadores = g_new0(ContadorUsuario, capacidad);
+    resumen->monticulo = g_new0(int, capacidad);
+    resumen->indices = g_hash_table_new(g_str_hash, g_str_equal);
+    return resumen;
+}
+
+void destruirSpaceSaving(SpaceSaving *resumen) {
+    if (resumen == NULL) {
+        return;
+    }
+    g_hash_table_destroy(resumen->indices);
+    g_free(resumen->monticulo);
+    g_free(resumen->contadores);
+    g_free(resumen);
+}
+
+void vaciarSpaceSaving(SpaceSaving *resumen) {
+    g_hash_table_remove_all(resumen->indices);
+    resumen->num_contadores = 0;
+}
+
+// Funciones del montículo de mínimos por cuenta
+static void intercambiarMonticulo(SpaceSaving *resumen, int a, int b) {
+    int indice = resumen->monticulo[a];
+    resumen->monticulo[a] = resumen->monticulo[b];
+    resumen->monticulo[b] = indice;
+    resumen->contadores[resumen->monticulo[a]].posicion_monticulo = a;
+    resumen->contadores[resumen->monticulo[b]].posicion_monticulo = b;
+}
+
+static long long cuentaMonticulo(const SpaceSaving *resumen, int posicion) {
+    return resumen->contadores[resumen->monticulo[posicion]].cuenta;
+}
+
+static void subirMonticulo(SpaceSaving *resumen, int posicion) {
+    while (posicion > 0 && cuentaMonticulo(resumen, (posicion - 1) / 2) > cuentaMonticulo(resumen, posicion)) {
+        intercambiarMonticulo(resumen, posicion, (posicion - 1) / 2);
+        posicion = (posicion - 1) / 2;
+    }
+}
+
+static void bajarMonticulo(SpaceSaving *resumen, int posicion) {
+    while (1) {
+        int menor = posicion;
+        int izquierdo = 2 * posicion + 1;
+        int derecho = izquierdo + 1;
+        if (izquierdo < resumen->num_contadores && cuentaMonticulo(resumen, izquierdo) < cuentaMonticulo(resumen, menor)) {
+            menor = izquierdo;
+        }
+        if (derecho < resumen->num_contadores && cuentaMonticulo(resumen, derecho) < cuentaMonticulo(resumen, menor)) {
+            menor = derecho;
+        }
+        if (menor == posicion) {
+            return;
+        }
+        intercambiarMonticulo(resumen, posicion, menor);
+        posicion = menor;
+    }
+}
+
+// Función que suma peso al valor de un usuario (peso > 0)
+void anadirSpaceSaving(SpaceSaving *resumen, const char *usuario, long long peso) {
+    char clave[MAX_LONGITUD_CLAVE];
+    snprintf(clave, sizeof(clave), "%s", usuario);
+    gpointer valor = g_hash_table_lookup(resumen->indices, clave);
+    if (valor != NULL) {
+        ContadorUsuario *contador = &resumen->contadores[GPOINTER_TO_INT(valor) - 1];
+        contador->cuenta += peso;
+        bajarMonticulo(resumen, contador->posicion_monticulo);
+        return;
+    }
+    int indice;
+    long long error = 0;
+    if (resumen->num_contadores < resumen->capacidad) {
+        // Queda un contador libre
+        indice = resumen->num_contadores;
+        resumen->monticulo[indice] = indice;
+        resumen->contadores[indice].posicion_monticulo = indice;
+        resumen->num_contadores++;
+    } else {
+        // Se sustituye el contador de menor cuenta, que pasa a ser el error del usuario nuevo
+        indice = resumen->monticulo[0];
+        g_hash_table_remove(resumen->indices, resumen->contadores[indice].usuario);
+        error = resumen->contadores[indice].cuenta;
+    }
+    ContadorUsuario *contador = &resumen->contadores[indice];
+    snprintf(contador->usuario, sizeof(contador->usuario), "%s", clave);
+    contador->cuenta = error + peso;
+    contador->error = error;
+    g_hash_table_insert(resumen->indices, contador->usuario, GINT_TO_POINTER(indice + 1));
+    subirMonticulo(resumen, contador->posicion_monticulo);
+    bajarMonticulo(resumen, contador->posicion_monticulo);
+}
+
+// Función que crea el informe para las ventanas (segundos separados por comas) con num_cubos cubos cada una
+TopUsuarios *crearTopUsuarios(int k, const char *ventanas, int num_cubos) {
+    if (k < 1) {
+        k = 100;
+    }
+    if (num_cubos < 1 || num_cubos > MAX_CUBOS_VENTANA_TOP) {
+        escribirEnLog(LOG_WARNING, "top_usuarios", "TOPK_BUCKETS=%d fuera de rango (1..%d), se utiliza 12\n", num_cubos, MAX_CUBOS_VENTANA_TOP);
+        num_cubos = 12;
+    }
+    TopUsuarios *top = g_new0(TopUsuarios, 1);
+    top->k = k;
+    pthread_mutex_init(&top->mutex_metricas, NULL);
+    inicializarCursorConsolidado(&top->cursor);
+    top->cursor.columnas = COLUMNAS_TOP;
+
+    const char *texto = ventanas;
+    while (*texto != '\0' && top->num_ventanas < MAX_VENTANAS_TOP) {
+        char *fin;
+        long long ancho = strtoll(texto, &fin, 10);
+        if (fin == texto) {
+            break;
+        }
+        if (ancho > 0) {
+            VentanaTop *ventana = &top->ventanas[top->num_ventanas++];
+            ventana->ancho = ancho;
+            ventana->num_cubos = num_cubos;
+            ventana->ancho_cubo = (ancho + num_cubos - 1) / num_cubos;
+            ventana->cubo_maximo = -1;
+            ventana->cubos = g_new0(CuboTop, num_cubos);
+            for (int c = 0; c < num_cubos; c++) {
+                ventana->cubos[c].numero = -1;
+                for (int m = 0; m < NUM_METRICAS_TOP; m++) {
+                    ventana->cubos[c].resumenes[m] = crearSpaceSaving(k);
+                }
+            }
+        }
+        texto = *fin == ',' ? fin + 1 : fin;
+    }
+    escribirEnLog(LOG_INFO, "top_usuarios", "Informe de %d usuarios en %d ventanas de %d cubos (%zu bytes de contadores por ventana)\n",
+        k, top->num_ventanas, num_cubos, (size_t)num_cubos * NUM_METRICAS_TOP * k * (sizeof(ContadorUsuario) + sizeof(int)));
+    return top;
+}
+
+void destruirTopUsuarios(TopUsuarios *top) {
+    if (top == NULL) {
+        return;
+    }
+    for (int v = 0; v < top->num_ventanas; v++) {
+        for (int c = 0; c < top->ventanas[v].num_cubos; c++) {
+            for (int m = 0; m < NUM_METRICAS_TOP; m++) {
+                destruirSpaceSaving(top->ventanas[v].cubos[c].resumenes[m]);
+            }
+        }
+        g_free(top->ventanas[v].cubos);
+    }
+    pthread_mutex_destroy(&top->mutex_metricas);
+    g_free(top);
+}
+
+// Función que añade un registro a los cubos de todas las ventanas
+static void procesarRegistroTop(RegistroConsolidado *registro, void *contexto) {
+    TopUsuarios *top = (TopUsuarios *)contexto;
+    if (registro->instante1 < 0) {
+        return;
+    }
+    long long pesos[NUM_METRICAS_TOP] = {1, registro->importe < 0 ? -(long long)registro->importe : 0};
+    for (int v = 0; v < top->num_ventanas; v++) {
+        VentanaTop *ventana = &top->ventanas[v];
+        long long numero = registro->instante1 / ventana->ancho_cubo;
+        if (ventana->cubo_maximo >= 0 && numero <= ventana->cubo_maximo - ventana->num_cubos) {
+            ventana->descartados++;
+            continue;
+        }
+        if (numero > ventana->cubo_maximo) {
+            ventana->cubo_maximo = numero;
+        }
+        CuboTop *cubo = &ventana->cubos[numero % ventana->num_cubos];
+        if (cubo->numero != numero) {
+            // El cubo del anillo tenía un cubo que ya ha salido de la ventana
+            for (int m = 0; m < NUM_METRICAS_TOP; m++) {
+                vaciarSpaceSaving(cubo->resumenes[m]);
+            }
+            cubo->numero = numero;
+        }
+        for (int m = 0; m < NUM_METRICAS_TOP; m++) {
+            if (pesos[m] > 0) {
+                anadirSpaceSaving(cubo->resumenes[m], registro->usuario, pesos[m]);
+            }
+        }
+    }
+}
+
+// Función que descarta lo acumulado cuando los datos consolidados se vuelven a leer desde el principio
+static void reiniciarTopUsuarios(void *contexto) {
+    TopUsuarios *top = (TopUsuarios *)contexto;
+    for (int v = 0; v < top->num_ventanas; v++) {
+        VentanaTop *ventana = &top->ventanas[v];
+        for (int c = 0; c < ventana->num_cubos; c++) {
+            ventana->cubos[c].numero = -1;
+            for (int m = 0; m < NUM_METRICAS_TOP; m++) {
+                vaciarSpaceSaving(ventana->cubos[c].resumenes[m]);
+            }
+        }
+        ventana->cubo_maximo = -1;
+        ventana->descartados = 0;
+    }
+}
+
+// Función que procesa los registros consolidados añadidos desde la ronda anterior
+// Devuelve el número de registros nuevos o -1 si no se han podido leer los datos
+int actualizarTopUsuarios(TopUsuarios *top) {
+    return leerNuevosRegistrosConsolidados(&top->cursor, procesarRegistroTop, reiniciarTopUsuarios, top);
+}
+
+// Valor de un usuario en la suma de los cubos de una ventana
+typedef struct VALOR_TOP {
+    const char *usuario;
+    long long valor;
+    long long error;
+    long long minimos_presentes;    // Mínimos de los cubos llenos en los que el usuario tiene contador
+} ValorTop;
+
+static gint compararValoresTop(gconstpointer a, gconstpointer b) {
+    const ValorTop *x = *(const ValorTop * const *)a;
+    const ValorTop *y = *(const ValorTop * const *)b;
+    if (x->valor != y->valor) {
+        return x->valor > y->valor ? -1 : 1;
+    }
+    return strcmp(x->usuario, y->usuario);
+}
+
+// Función que suma los resúmenes de una métrica en los cubos de una ventana y los ordena por valor
+// Devuelve los valores ordenados (hay que liberarlos con g_ptr_array_free)
+static GPtrArray *sumarVentanaTop(const VentanaTop *ventana, MetricaTop metrica) {
+    GHashTable *valores = g_hash_table_new(g_str_hash, g_str_equal);
+    GPtrArray *ordenados = g_ptr_array_new_with_free_func(g_free);
+    // Un usuario sin contador en un cubo lleno puede tener en ese cubo hasta la cuenta mínima del cubo
+    long long minimos_llenos = 0;
+    for (int c = 0; c < ventana->num_cubos; c++) {
+        const CuboTop *cubo = &ventana->cubos[c];
+        if (cubo->numero < 0 || cubo->numero <= ventana->cubo_maximo - ventana->num_cubos) {
+            continue;
+        }
+        const SpaceSaving *resumen = cubo->resumenes[metrica];
+        long long minimo = 0;
+        if (resumen->num_contadores == resumen->capacidad) {
+            minimo = resumen->contadores[resumen->monticulo[0]].cuenta;
+            minimos_llenos += minimo;
+        }
+        for (int i = 0; i < resumen->num_contadores; i++) {
+            const ContadorUsuario *contador = &resumen->contadores[i];
+            ValorTop *valor = g_hash_table_lookup(valores, contador->usuario);
+            if (valor == NULL) {
+                valor = g_new0(ValorTop, 1);
+                valor->usuario = contador->usuario;
+                g_hash_table_insert(valores, (gpointer)valor->usuario, valor);
+                g_ptr_array_add(ordenados, valor);
+            }
+            valor->valor += contador->cuenta;
+            valor->error += contador->error;
+            valor->minimos_presentes += minimo;
+        }
+    }
+    for (guint i = 0; i < ordenados->len; i++) {
+        ValorTop *valor = g_ptr_array_index(ordenados, i);
+        valor->error += minimos_llenos - valor->minimos_presentes;
+    }
+    g_hash_table_destroy(valores);
+    g_ptr_array_sort(ordenados, compararValoresTop);
+    return ordenados;
+}
+
+// Función que escribe el informe de todas las ventanas y guarda las primeras posiciones para las métricas
+// El informe se escribe en un fichero temporal que sustituye al anterior, así nunca se lee a medias
+// Devuelve 0 o -1 en caso de error
+int escribirInformeTopUsuarios(TopUsuarios *top, const char *nombre_fichero) {
+    char nombre_temporal[PATH_MAX];
+    snprintf(nombre_temporal, sizeof(nombre_temporal), "%s.tmp", nombre_fichero);
+    FILE *fichero = fopen(nombre_temporal, "w");
+    if (fichero == NULL) {
+        escribirEnLog(LOG_ERROR, "top_usuarios", "Error al escribir el informe %s\n", nombre_temporal);
+        return -1;
+    }
+    fprintf(fichero, "# Usuarios con más actividad por ventana (Space-Saving con %d contadores por cubo)\n", top->k);
+    fprintf(fichero, "# ventana;hasta;metrica;posicion;usuario;valor;error_maximo\n");
+    char metricas[MAX_VENTANAS_TOP][NUM_METRICAS_TOP][200];
+    for (int v = 0; v < top->num_ventanas; v++) {
+        const VentanaTop *ventana = &top->ventanas[v];
+        // La ventana termina al final del cubo más reciente (segundos desde 01/01/1970)
+        long long hasta = (ventana->cubo_maximo + 1) * ventana->ancho_cubo;
+        for (int m = 0; m < NUM_METRICAS_TOP; m++) {
+            GPtrArray *ordenados = sumarVentanaTop(ventana, (MetricaTop)m);
+            size_t longitud = 0;
+            metricas[v][m][0] = '\0';
+            for (guint i = 0; i < ordenados->len && (int)i < top->k; i++) {
+                const ValorTop *valor = g_ptr_array_index(ordenados, i);
+                fprintf(fichero, "%lld;%lld;%s;%u;%s;%lld;%lld\n", ventana->ancho, hasta, nombres_metricas_top[m], i + 1,
+                    valor->usuario, valor->valor, valor->error);
+                if (i < POSICIONES_METRICAS_TOP && longitud < sizeof(metricas[v][m])) {
+                    longitud += snprintf(metricas[v][m] + longitud, sizeof(metricas[v][m]) - longitud, " %s=%lld", valor->usuario, valor->valor);
+                }
+            }
+            g_ptr_array_free(ordenados, TRUE);
+        }
+    }
+    int resultado = fclose(fichero) == 0 && rename(nombre_temporal, nombre_fichero) == 0 ? 0 : -1;
+    if (resultado != 0) {
+        escribirEnLog(LOG_ERROR, "top_usuarios", "Error al sustituir el informe %s\n", nombre_fichero);
+    }
+    pthread_mutex_lock(&top->mutex_metricas);
+    memcpy(top->metricas, metricas, sizeof(metricas));
+    for (int v = 0; v < top->num_ventanas; v++) {
+        top->descartados_metricas[v] = top->ventanas[v].descartados;
+    }
+    pthread_mutex_unlock(&top->mutex_metricas);
+    return resultado;
+}
+
+// Función que escribe en el log las primeras posiciones del último informe de cada ventana y métrica
+void escribirMetricasTopUsuarios(TopUsuarios *top) {
+    if (top == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&top->mutex_metricas);
+    for (int v = 0; v < top->num_ventanas; v++) {
+        for (int m = 0; m < NUM_METRICAS_TOP; m++) {
+            escribirEnLog(LOG_INFO, "Monitor: metricas_top_usuarios", "Ventana %lld s, %s (%lld registros descartados):%s\n",
+                top->ventanas[v].ancho, nombres_metricas_top[m], top->descartados_metricas[v], top->metricas[v][m]);
+        }
+    }
+    pthread_mutex_unlock(&top->mutex_metricas);
+}
+
+#pragma endregion TopUsuarios
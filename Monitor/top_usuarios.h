@@ -0,0 +1,88 @@
+#pragma once
+
+// ------------------------------------------------------------------
+// Librerías necesarias y explicación
+// ------------------------------------------------------------------
+#pragma region Librerias
+#include <stdio.h>          // Funciones estándar de entrada y salida
+#include <stdlib.h>         // Funciones útiles para varias operaciones: atoi, exit, malloc, rand...
+#include <string.h>         // Tratamiento de cadenas de caracteres
+#include <pthread.h>        // Mutex de la copia de las primeras posiciones para las métricas
+#include <glib.h>           // Diccionario de usuarios de cada resumen
+
+#include "constants.h"          // Constantes de la aplicación
+#include "datos_consolidados.h" // Lectura incremental de los datos consolidados
+#pragma endregion Librerias
+
+
+// Contador de un usuario en un resumen Space-Saving
+typedef struct CONTADOR_USUARIO {
+    char usuario[MAX_LONGITUD_CLAVE];
+    long long cuenta;               // Valor estimado (nunca menor que el real)
+    long long error;                // Cuánto puede sobrar en la estimación
+    int posicion_monticulo;
+} ContadorUsuario;
+
+// Resumen Space-Saving: los k usuarios con mayor valor con una memoria fija de k contadores
+// Un montículo de mínimos por cuenta permite encontrar en O(log k) el contador que se sustituye
+typedef struct SPACE_SAVING {
+    int capacidad;
+    int num_contadores;
+    ContadorUsuario *contadores;
+    int *monticulo;                 // Índices de los contadores ordenados como montículo de mínimos
+    GHashTable *indices;            // Usuario -> índice del contador + 1
+} SpaceSaving;
+
+// Métricas que se ordenan en el informe
+typedef enum METRICA_TOP {
+    METRICA_TOP_OPERACIONES,        // Número de operaciones
+    METRICA_TOP_RETIRADO,           // Importe retirado (suma de los importes negativos en valor absoluto)
+    NUM_METRICAS_TOP
+} MetricaTop;
+
+// Cubo de tiempo de una ventana deslizante con un resumen por métrica
+typedef struct CUBO_TOP {
+    long long numero;               // Inicio del cubo / ancho del cubo (-1 si está vacío)
+    SpaceSaving *resumenes[NUM_METRICAS_TOP];
+} CuboTop;
+
+// Ventana deslizante formada por num_cubos cubos que termina en el cubo del registro más reciente
+typedef struct VENTANA_TOP {
+    long long ancho;                // Segundos de la ventana
+    long long ancho_cubo;
+    int num_cubos;
+    CuboTop *cubos;                 // Anillo de cubos (posición: número % num_cubos)
+    long long cubo_maximo;          // Número del cubo más reciente (-1 si no hay ninguno)
+    long long descartados;          // Registros que llegan cuando su cubo ya ha salido de la ventana
+} VentanaTop;
+
+// Estado del informe de usuarios con más actividad por ventana que se mantiene entre rondas
+typedef struct TOP_USUARIOS {
+    int k;
+    VentanaTop ventanas[MAX_VENTANAS_TOP];
+    int num_ventanas;
+    CursorConsolidado cursor;
+    // Primeras posiciones del último informe para las métricas
+    pthread_mutex_t mutex_metricas;
+    char metricas[MAX_VENTANAS_TOP][NUM_METRICAS_TOP][200];
+    long long descartados_metricas[MAX_VENTANAS_TOP];
+} TopUsuarios;
+
+
+SpaceSaving *crearSpaceSaving(int capacidad);
+
+void destruirSpaceSaving(SpaceSaving *resumen);
+
+void vaciarSpaceSaving(SpaceSaving *resumen);
+
+void anadirSpaceSaving(SpaceSaving *resumen, const char *usuario, long long peso);
+
+TopUsuarios *crearTopUsuarios(int k, const char *ventanas, int num_cubos);
+
+void destruirTopUsuarios(TopUsuarios *top);
+
+int actualizarTopUsuarios(TopUsuarios *top);
+
+int escribirInformeTopUsuarios(TopUsuarios *top, const char *nombre_fichero);
+
+void escribirMetricasTopUsuarios(TopUsuarios *top);
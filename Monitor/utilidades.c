@@ -2,9 +2,13 @@
 // FUNCIONES UTILES
 // ------------------------------------------------------------------
 
+// localtime_r no se declara con -std=c99
+#define _DEFAULT_SOURCE
+
 #include "utilidades.h"
 #include "log_files.h"
 #include "config_files.h"
+#include "parametros_configuracion.h"
 
 #pragma region Utilidades
 
@@ -20,14 +24,9 @@ void sleep_centiseconds(int n) {
 
 // Función que simula un retardo según los parámetros del fichero de configuración
 void simulaRetardo(const char* mensaje) {
-    int retardoMin;
-    int retardoMax;
-    const char* retardoMinTexto;
-    const char* retardoMaxTexto;
-    retardoMinTexto = obtener_valor_configuracion("SIMULATE_SLEEP_MIN", "1");
-    retardoMaxTexto = obtener_valor_configuracion("SIMULATE_SLEEP_MAX", "2");
-    retardoMin = atoi(retardoMinTexto);
-    retardoMax = atoi(retardoMaxTexto);
+    const ParametrosConfiguracion *parametros = obtenerParametros();
+    int retardoMin = parametros->retardo_minimo;
+    int retardoMax = parametros->retardo_maximo;
     int retardo;
 
     // Inicializamos la semilla para generar números aleatorios
@@ -41,42 +40,52 @@ void simulaRetardo(const char* mensaje) {
 
 }
 
-// Función para obtener la hora actual en formato HH:MM
-char* obtener_hora_actual() {
-    // Variable local para almacenar la hora actual
-    static char hora_actual[10]; // "HH:MM:SS\0"
-
-    // Obtener la hora actual
-    time_t rawtime;
-    struct tm *timeinfo;
-
-    time(&rawtime);
-    timeinfo = localtime(&rawtime);
-
-    // Formatear la hora actual como "HH:MM"
-    strftime(hora_actual, sizeof(hora_actual), "%H:%M:%S", timeinfo);
+// Fecha y hora formateadas del último segundo que ha pedido cada hilo
+// Cada hilo tiene la suya, así que no hace falta mutex y localtime_r (que coge el bloqueo de la zona horaria)
+// se llama como mucho una vez por segundo y por hilo
+static __thread FechaHoraFormateada fecha_hora_hilo = {-1, "", "", ""};
+
+// Función que devuelve la fecha y hora de un segundo formateadas en los formatos de la aplicación
+// El resultado es del hilo que llama y vale hasta que ese hilo pide otro segundo
+const FechaHoraFormateada *obtenerFechaHoraFormateada(time_t segundo) {
+    if (segundo != fecha_hora_hilo.segundo) {
+        struct tm infoTiempo;
+        localtime_r(&segundo, &infoTiempo);
+        strftime(fecha_hora_hilo.fecha_hora, sizeof(fecha_hora_hilo.fecha_hora), "%Y-%m-%d %H:%M:%S", &infoTiempo);
+        strftime(fecha_hora_hilo.fecha_hora2, sizeof(fecha_hora_hilo.fecha_hora2), "%Y-%m-%d:::%H:%M:%S", &infoTiempo);
+        strftime(fecha_hora_hilo.hora, sizeof(fecha_hora_hilo.hora), "%H:%M:%S", &infoTiempo);
+        fecha_hora_hilo.segundo = segundo;
+    }
+    return &fecha_hora_hilo;
+}
 
-    return hora_actual;
+// Función para obtener la hora actual en formato HH:MM:SS
+// hora_actual tiene que tener sitio para 9 caracteres y el '\0'
+void obtener_hora_actual(char *hora_actual) {
+    strcpy(hora_actual, obtenerFechaHoraFormateada(time(NULL))->hora);
 }
 
 // Función para obtener la fecha y hora actual (MODELO ESTÁNDAR)
 void obtenerFechaHora(char *fechaHora) {
-    time_t tiempoActual;
-    struct tm *infoTiempo;
-
-    time(&tiempoActual);
-    infoTiempo = localtime(&tiempoActual);
-    strftime(fechaHora, 20, "%Y-%m-%d %H:%M:%S", infoTiempo);
+    strcpy(fechaHora, obtenerFechaHoraFormateada(time(NULL))->fecha_hora);
 }
 
 // Función para obtener la fecha y hora actual (MODELO PEDIDO POR MARLON)
 void obtenerFechaHora2(char *fechaHora2) {
-    time_t tiempoActual;
-    struct tm *infoTiempo;
+    strcpy(fechaHora2, obtenerFechaHoraFormateada(time(NULL))->fecha_hora2);
+}
+
+// Función para obtener el instante actual en milisegundos según un reloj monotónico
+// No le afectan los cambios de hora del sistema, así que sirve para medir intervalos
+long long obtener_milisegundos_monotonicos() {
+    return obtener_nanosegundos_monotonicos() / 1000000;
+}
 
-    time(&tiempoActual);
-    infoTiempo = localtime(&tiempoActual);
-    strftime(fechaHora2, 25, "%Y-%m-%d:::%H:%M:%S", infoTiempo);
+// Función para obtener el instante actual en nanosegundos según un reloj monotónico
+long long obtener_nanosegundos_monotonicos() {
+    struct timespec instante;
+    clock_gettime(CLOCK_MONOTONIC, &instante);
+    return (long long)instante.tv_sec * 1000000000LL + instante.tv_nsec;
 }
 
 
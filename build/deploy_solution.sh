@@ -122,6 +122,18 @@ echo usermonitor:1234 | sudo chpasswd
     echo "Make de Monitor..."
     cd ../Monitor
     ./build.sh
+
+    # Make de logdecode
+    echo
+    echo "Make de logdecode..."
+    cd ../LogDecode
+    ./build.sh
+
+    # Make de fpstat
+    echo
+    echo "Make de fpstat..."
+    cd ../FpStat
+    ./build.sh
 )
 
 
@@ -143,6 +155,8 @@ mkdir -p ${rootFolder}/bin/logs
 # Copiamos los ejecutables
 sudo cp ../bin/FileProcessor ${rootFolder}/bin
 sudo cp ../bin/Monitor ${rootFolder}/bin
+sudo cp ../bin/logdecode ${rootFolder}/bin
+sudo cp ../bin/fpstat ${rootFolder}/bin
 sudo cp ../bin/create_folder_structure.sh ${rootFolder}/bin 
 sudo cp ../bin/runFileProcessor.sh ${rootFolder}/bin 
 sudo cp ../bin/runMonitor.sh ${rootFolder}/bin 
@@ -188,6 +202,8 @@ sudo chmod u=rx,g-rwx,o-rwx ${rootFolder}/bin/runFileProcessor.sh
 sudo chown userfp:ufvauditores ${rootFolder}/bin/create_folder_structure.sh
 sudo chmod u=rx,g-rwx,o-rwx ${rootFolder}/bin/create_folder_structure.sh
 sudo chmod u=rw,g=rw,o-rwx ${rootFolder}/bin/conf/fp.conf
+sudo chmod u=rx,g=rx,o-rwx ${rootFolder}/bin/logdecode
+sudo chmod u=rx,g=rx,o-rwx ${rootFolder}/bin/fpstat
 
 sudo chmod u=rwx,g=rwx,o-rwx ${rootFolder}/bin/logs
 